@@ -0,0 +1,218 @@
+/*
+ Adaptive set source file.
+ Here we implement the adaptive set - its operations are forwarded to the current implementation, and an insertion of a value too large for the bit set
+ moves the set to a van Emde Boas tree first.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include "adaptive_set.h"
+
+#include "bit_set.h"
+
+#include "veb_tree.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Move the values of the bit set of the adaptive set, with their counts and payloads, to a new van Emde Boas tree.
+ Returns FALSE on an allocation error, in which case the adaptive set is left unchanged. */
+
+static bool adaptive_set_widen(adaptive_set *set);
+
+
+/* Ordered set operations (see ordered_set.h). */
+
+static void* adaptive_set_create(void);
+
+static void adaptive_set_destroy(void *set);
+
+static bool adaptive_set_insert(void *set, unsigned int val, unsigned int count, bool *exists);
+
+static bool adaptive_set_remove(void *set, unsigned int val, bool *deleted);
+
+static unsigned int adaptive_set_instances(void *set, unsigned int val);
+
+static void** adaptive_set_payload(void *set, unsigned int val);
+
+static bool adaptive_set_lower_bound(void *set, unsigned int val, unsigned int *found);
+
+static bool adaptive_set_successor(void *set, unsigned int val, unsigned int *found);
+
+static bool adaptive_set_predecessor(void *set, unsigned int val, unsigned int *found);
+
+static bool adaptive_set_max(void *set, unsigned int *found);
+
+static unsigned int adaptive_set_size(void *set);
+
+
+const ordered_set_ops adaptive_set_ops = {adaptive_set_create, adaptive_set_destroy, adaptive_set_insert, adaptive_set_remove, adaptive_set_instances,
+                                          adaptive_set_payload, adaptive_set_lower_bound, adaptive_set_successor, adaptive_set_predecessor,
+                                          adaptive_set_max, adaptive_set_size};
+
+
+/* The implementation: */
+
+
+static void* adaptive_set_create(void)
+{
+
+    adaptive_set *set = calloc(sizeof(adaptive_set), 1);
+
+    if (set == NULL) {
+
+        return NULL;
+    }
+
+    set->ops = &bit_set_ops;
+    set->set = bit_set_ops.create();
+
+    if (set->set == NULL) {
+
+        free(set);
+        return NULL;
+    }
+
+    return set;
+}
+
+
+static void adaptive_set_destroy(void *the_set)
+{
+
+    adaptive_set *set = the_set;
+
+    set->ops->destroy(set->set);
+    free(set);
+}
+
+
+static bool adaptive_set_widen(adaptive_set *set)
+{
+
+    bit_set *old_set = set->set;
+    void *new_set = veb_tree_ops.create();
+    unsigned int val = 0;
+    bool has_val = false;
+    bool exists = false;
+
+    if (new_set == NULL) {
+
+        return false;
+    }
+
+    /* Walk the values of the bit set in order, and copy each of them with its count (and payload, if the bit set has any) to the tree. */
+
+    for (has_val = bit_set_ops.lower_bound(old_set, 0, &val); has_val; has_val = bit_set_ops.successor(old_set, val, &val)) {
+
+        if (!veb_tree_ops.insert(new_set, val, bit_set_ops.instances(old_set, val), &exists)) {
+
+            veb_tree_ops.destroy(new_set);
+            return false;
+        }
+
+        if (old_set->payloads != NULL) {
+
+            *(veb_tree_ops.payload(new_set, val)) = *(bit_set_ops.payload(old_set, val));
+        }
+    }
+
+    bit_set_ops.destroy(old_set);
+
+    set->ops = &veb_tree_ops;
+    set->set = new_set;
+
+    return true;
+}
+
+
+static bool adaptive_set_insert(void *the_set, unsigned int val, unsigned int count, bool *exists)
+{
+
+    adaptive_set *set = the_set;
+
+    *exists = false;
+
+    if ((val >= BIT_SET_UNIVERSE) && (set->ops == &bit_set_ops) && !adaptive_set_widen(set)) {
+
+        return false;
+    }
+
+    return set->ops->insert(set->set, val, count, exists);
+}
+
+
+static bool adaptive_set_remove(void *the_set, unsigned int val, bool *deleted)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->remove(set->set, val, deleted);
+}
+
+
+static unsigned int adaptive_set_instances(void *the_set, unsigned int val)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->instances(set->set, val);
+}
+
+
+static void** adaptive_set_payload(void *the_set, unsigned int val)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->payload(set->set, val);
+}
+
+
+static bool adaptive_set_lower_bound(void *the_set, unsigned int val, unsigned int *found)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->lower_bound(set->set, val, found);
+}
+
+
+static bool adaptive_set_successor(void *the_set, unsigned int val, unsigned int *found)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->successor(set->set, val, found);
+}
+
+
+static bool adaptive_set_predecessor(void *the_set, unsigned int val, unsigned int *found)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->predecessor(set->set, val, found);
+}
+
+
+static bool adaptive_set_max(void *the_set, unsigned int *found)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->max(set->set, found);
+}
+
+
+static unsigned int adaptive_set_size(void *the_set)
+{
+
+    adaptive_set *set = the_set;
+
+    return set->ops->size(set->set);
+}
@@ -0,0 +1,27 @@
+/* Adaptive set header file.
+ Contains the structure and functions' prototype declarations of the adaptive set - an ordered set which picks its implementation by the observed values.
+ Every adaptive set starts as a bit set (bit_set.h), which is much smaller and faster than a tree while all the values are below BIT_SET_UNIVERSE.
+ The first insertion of a larger value moves the set, with its counts and payloads, to a van Emde Boas tree (veb_tree.h), where it stays. */
+
+
+#include <stdbool.h>
+
+#include "ordered_set.h"
+
+#ifndef ADAPTIVE_SET_H_
+#define ADAPTIVE_SET_H_
+
+
+typedef struct adaptive_set_s {			/* Adaptive set structure. */
+
+    const ordered_set_ops *ops;			/* The current implementation - bit_set_ops or veb_tree_ops. */
+    void *set;			/* The current set. */
+} adaptive_set;
+
+
+/* Operations of the adaptive set as an ordered set (see ordered_set.h.) */
+
+extern const ordered_set_ops adaptive_set_ops;
+
+
+#endif /* ADAPTIVE_SET_H_ */
@@ -0,0 +1,155 @@
+/*
+ Arena source file.
+ Here we implement the arena - a bump allocator over a list of blocks, with a free list for every size class.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "arena.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the size class of an object of the given size (the index of its free list.) */
+
+static unsigned int arena_class(size_t size);
+
+
+/* Add a new block to the arena, large enough for an object of the given (rounded) size. Returns FALSE on an allocation error, TRUE otherwise. */
+
+static bool arena_grow(arena *arena, size_t size);
+
+
+/* The implementation: */
+
+
+arena* arena_create(void)
+{
+
+    arena *new_arena = calloc(sizeof(arena), 1);
+
+    if (new_arena == NULL) {
+
+        return NULL;
+    }
+
+    new_arena->block_size = ARENA_MIN_BLOCK;
+
+    return new_arena;
+}
+
+
+void arena_destroy(arena *arena)
+{
+
+    arena_block *block = arena->blocks;
+    arena_block *next = NULL;
+
+    while (block != NULL) {
+
+        next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
+
+
+static unsigned int arena_class(size_t size)
+{
+
+    return (unsigned int) ((size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT) - 1;
+}
+
+
+static bool arena_grow(arena *arena, size_t size)
+{
+
+    size_t block_size = (arena->block_size < size) ? size : arena->block_size;
+    arena_block *block = malloc(sizeof(arena_block) + block_size);
+
+    if (block == NULL) {
+
+        return false;
+    }
+
+    /* The rest of the previous block is left unused - it's smaller than the object. */
+
+    block->next = arena->blocks;
+    block->size = block_size;
+    arena->blocks = block;
+
+    arena->free_space = (char *) (block + 1);
+    arena->free_size = block_size;
+
+    if (arena->block_size < ARENA_MAX_BLOCK) {
+
+        arena->block_size *= 2;
+    }
+
+    return true;
+}
+
+
+void* arena_alloc(arena *arena, size_t size)
+{
+
+    unsigned int class = 0;
+    size_t rounded = 0;
+    void *object = NULL;
+
+    if ((size == 0) || (size > ARENA_MAX_SIZE)) {
+
+        return NULL;
+    }
+
+    class = arena_class(size);
+    rounded = (class + 1) * ARENA_ALIGNMENT;
+
+    if (arena->free_lists[class] != NULL) {			/* Reuse a freed object of the same size class. */
+
+        object = arena->free_lists[class];
+        arena->free_lists[class] = arena->free_lists[class]->next;
+    }
+
+    else {
+
+        if ((arena->free_size < rounded) && !arena_grow(arena, rounded)) {
+
+            return NULL;
+        }
+
+        object = arena->free_space;
+        arena->free_space += rounded;
+        arena->free_size -= rounded;
+    }
+
+    memset(object, 0, rounded);
+
+    return object;
+}
+
+
+void arena_free(arena *arena, void *object, size_t size)
+{
+
+    arena_free_object *free_object = object;
+    unsigned int class = 0;
+
+    if (object == NULL) {
+
+        return;
+    }
+
+    class = arena_class(size);
+
+    free_object->next = arena->free_lists[class];
+    arena->free_lists[class] = free_object;
+}
@@ -0,0 +1,74 @@
+/* Arena header file.
+ Contains the structure and functions' prototype declarations of the arena - an allocator of small objects (nodes and keys of trees) out of large
+ memory blocks. The freed objects are kept in a free list of their size class and reused by the next allocations of that class, and destroying the
+ arena releases all of its objects at once, by freeing its blocks - without visiting the objects. The blocks grow geometrically, so an arena of n
+ objects has O(log n) blocks. */
+
+
+#include <stddef.h>
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+
+#define ARENA_ALIGNMENT 16			/* The objects are aligned to (and their sizes rounded up to) ARENA_ALIGNMENT bytes. */
+
+#define ARENA_MAX_SIZE 256			/* The largest object of the arena. */
+
+#define ARENA_CLASSES (ARENA_MAX_SIZE / ARENA_ALIGNMENT)			/* Number of the size classes - one for every multiple of ARENA_ALIGNMENT. */
+
+#define ARENA_MIN_BLOCK (64 * 1024)			/* Size of the first block. Every following block is twice as large, up to ARENA_MAX_BLOCK. */
+
+#define ARENA_MAX_BLOCK (16 * 1024 * 1024)
+
+
+typedef struct arena_block_s arena_block;
+
+
+struct arena_block_s {			/* Header of a memory block - the objects follow it. */
+
+    arena_block *next;
+    size_t size;			/* Keeps the header a multiple of ARENA_ALIGNMENT. */
+};
+
+
+typedef struct arena_free_object_s arena_free_object;
+
+
+struct arena_free_object_s {			/* A freed object, linked in the free list of its size class. */
+
+    arena_free_object *next;
+};
+
+
+typedef struct arena_s {			/* Arena structure. */
+
+    arena_block *blocks;			/* List of the blocks, the newest first. */
+    char *free_space;			/* The space of the newest block which wasn't allocated yet, and its size. */
+    size_t free_size;
+    size_t block_size;			/* Size of the next block. */
+    arena_free_object *free_lists[ARENA_CLASSES];			/* free_lists[i] - the freed objects of (i + 1) * ARENA_ALIGNMENT bytes. */
+} arena;
+
+
+/* Create an empty arena. Returns NULL on an allocation error, otherwise returns a pointer to arena. */
+
+arena* arena_create(void);
+
+
+/* Free the arena with all of its objects. */
+
+void arena_destroy(arena *arena);
+
+
+/* Allocate a zeroed object of the given size (at most ARENA_MAX_SIZE.) Returns NULL on an allocation error. */
+
+void* arena_alloc(arena *arena, size_t size);
+
+
+/* Free an object of the arena - size must be the size it was allocated with. Nothing is done for NULL. */
+
+void arena_free(arena *arena, void *object, size_t size);
+
+
+#endif /* ARENA_H_ */
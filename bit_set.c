@@ -0,0 +1,403 @@
+/*
+ Bit set source file.
+ Here we implement the hierarchical bit set and its operations as an ordered set of the box index.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "bit_set.h"
+
+
+#define BIT_SET_MIN_CAPACITY 4
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the rank of the given value - the number of values of the set which are smaller than it. */
+
+static unsigned int bit_set_rank(bit_set *set, unsigned int val);
+
+
+/* Return TRUE if the given value is in the set. */
+
+static bool bit_set_contains(bit_set *set, unsigned int val);
+
+
+/* Make room for one more value in counts and payloads. Returns FALSE on an allocation error. */
+
+static bool bit_set_reserve(bit_set *set);
+
+
+/* Ordered set operations (see ordered_set.h). */
+
+static void* bit_set_op_create(void);
+
+static void bit_set_op_destroy(void *set);
+
+static bool bit_set_insert(void *set, unsigned int val, unsigned int count, bool *exists);
+
+static bool bit_set_remove(void *set, unsigned int val, bool *deleted);
+
+static unsigned int bit_set_instances(void *set, unsigned int val);
+
+static void** bit_set_payload(void *set, unsigned int val);
+
+static bool bit_set_lower_bound(void *set, unsigned int val, unsigned int *found);
+
+static bool bit_set_successor(void *set, unsigned int val, unsigned int *found);
+
+static bool bit_set_predecessor(void *set, unsigned int val, unsigned int *found);
+
+static bool bit_set_max(void *set, unsigned int *found);
+
+static unsigned int bit_set_size(void *set);
+
+
+const ordered_set_ops bit_set_ops = {bit_set_op_create, bit_set_op_destroy, bit_set_insert, bit_set_remove, bit_set_instances, bit_set_payload,
+                                     bit_set_lower_bound, bit_set_successor, bit_set_predecessor, bit_set_max, bit_set_size};
+
+
+/* The implementation: */
+
+
+bit_set* bit_set_create(void)
+{
+
+    return calloc(sizeof(bit_set), 1);
+}
+
+
+void bit_set_destroy(bit_set *set)
+{
+
+    free(set->counts);
+    free(set->payloads);
+    free(set);
+}
+
+
+static unsigned int bit_set_rank(bit_set *set, unsigned int val)
+{
+
+    unsigned int word = val >> 6;
+    unsigned int rank = 0;
+    unsigned int i = 0;
+
+    for (i = 0; i < word; ++i) {
+
+        rank += __builtin_popcountll(set->words[i]);
+    }
+
+    return rank + __builtin_popcountll(set->words[word] & ((1ULL << (val & 63)) - 1));
+}
+
+
+static bool bit_set_contains(bit_set *set, unsigned int val)
+{
+
+    return (val < BIT_SET_UNIVERSE) && ((set->words[val >> 6] >> (val & 63)) & 1);
+}
+
+
+static bool bit_set_reserve(bit_set *set)
+{
+
+    unsigned int capacity = (set->capacity == 0) ? BIT_SET_MIN_CAPACITY : set->capacity * 2;
+    unsigned int *counts = NULL;
+    void **payloads = NULL;
+
+    if (set->size < set->capacity) {
+
+        return true;
+    }
+
+    counts = realloc(set->counts, sizeof(unsigned int) * capacity);
+
+    if (counts == NULL) {
+
+        return false;
+    }
+
+    set->counts = counts;
+
+    if (set->payloads != NULL) {
+
+        payloads = realloc(set->payloads, sizeof(void *) * capacity);
+
+        if (payloads == NULL) {
+
+            return false;
+        }
+
+        set->payloads = payloads;
+    }
+
+    set->capacity = capacity;
+
+    return true;
+}
+
+
+static void* bit_set_op_create(void)
+{
+
+    return bit_set_create();
+}
+
+
+static void bit_set_op_destroy(void *set)
+{
+
+    bit_set_destroy(set);
+}
+
+
+static bool bit_set_insert(void *the_set, unsigned int val, unsigned int count, bool *exists)
+{
+
+    bit_set *set = the_set;
+    unsigned int rank = 0;
+
+    *exists = false;
+
+    if (val >= BIT_SET_UNIVERSE) {
+
+        return false;
+    }
+
+    rank = bit_set_rank(set, val);
+
+    if (bit_set_contains(set, val)) {			/* The value exists in the set - we simply increase its count. */
+
+        *exists = true;
+        set->counts[rank] += count;
+
+        return true;
+    }
+
+    if (!bit_set_reserve(set)) {
+
+        return false;
+    }
+
+    /* Shift the counts (and payloads) of the larger values, to make room for the new value at its rank. */
+
+    memmove(&(set->counts[rank + 1]), &(set->counts[rank]), sizeof(unsigned int) * (set->size - rank));
+    set->counts[rank] = count;
+
+    if (set->payloads != NULL) {
+
+        memmove(&(set->payloads[rank + 1]), &(set->payloads[rank]), sizeof(void *) * (set->size - rank));
+        set->payloads[rank] = NULL;
+    }
+
+    set->words[val >> 6] |= 1ULL << (val & 63);
+    set->summary |= 1ULL << (val >> 6);
+    set->size++;
+
+    return true;
+}
+
+
+static bool bit_set_remove(void *the_set, unsigned int val, bool *deleted)
+{
+
+    bit_set *set = the_set;
+    unsigned int rank = 0;
+
+    *deleted = false;
+
+    if (!bit_set_contains(set, val)) {
+
+        return false;
+    }
+
+    rank = bit_set_rank(set, val);
+
+    if (--set->counts[rank] > 0) {
+
+        return true;
+    }
+
+    /* The last instance of the value was removed - delete its bit, and close the gap in the counts (and payloads.) */
+
+    set->size--;
+
+    memmove(&(set->counts[rank]), &(set->counts[rank + 1]), sizeof(unsigned int) * (set->size - rank));
+
+    if (set->payloads != NULL) {
+
+        memmove(&(set->payloads[rank]), &(set->payloads[rank + 1]), sizeof(void *) * (set->size - rank));
+    }
+
+    set->words[val >> 6] &= ~(1ULL << (val & 63));
+
+    if (set->words[val >> 6] == 0) {
+
+        set->summary &= ~(1ULL << (val >> 6));
+    }
+
+    *deleted = true;
+
+    return true;
+}
+
+
+static unsigned int bit_set_instances(void *the_set, unsigned int val)
+{
+
+    bit_set *set = the_set;
+
+    return bit_set_contains(set, val) ? set->counts[bit_set_rank(set, val)] : 0;
+}
+
+
+static void** bit_set_payload(void *the_set, unsigned int val)
+{
+
+    bit_set *set = the_set;
+
+    if (!bit_set_contains(set, val)) {
+
+        return NULL;
+    }
+
+    if (set->payloads == NULL) {			/* The payloads are allocated only for the sets which use them. */
+
+        set->payloads = calloc(sizeof(void *), set->capacity);
+
+        if (set->payloads == NULL) {
+
+            return NULL;
+        }
+    }
+
+    return &(set->payloads[bit_set_rank(set, val)]);
+}
+
+
+static bool bit_set_lower_bound(void *the_set, unsigned int val, unsigned int *found)
+{
+
+    if (bit_set_contains(the_set, val)) {
+
+        *found = val;
+
+        return true;
+    }
+
+    return bit_set_successor(the_set, val, found);
+}
+
+
+static bool bit_set_successor(void *the_set, unsigned int val, unsigned int *found)
+{
+
+    bit_set *set = the_set;
+    unsigned int word = 0;
+    unsigned long long bits = 0;
+
+    if (val >= BIT_SET_UNIVERSE - 1) {
+
+        return false;
+    }
+
+    val++;
+    word = val >> 6;
+    bits = set->words[word] & (~0ULL << (val & 63));			/* Bits of the word of val, starting from val. */
+
+    if (bits == 0) {
+
+        /* Find the next non-empty word through the summary. */
+
+        bits = (word == BIT_SET_WORDS - 1) ? 0 : set->summary & (~0ULL << (word + 1));
+
+        if (bits == 0) {
+
+            return false;
+        }
+
+        word = __builtin_ctzll(bits);
+        bits = set->words[word];
+    }
+
+    *found = word * 64 + __builtin_ctzll(bits);
+
+    return true;
+}
+
+
+static bool bit_set_predecessor(void *the_set, unsigned int val, unsigned int *found)
+{
+
+    bit_set *set = the_set;
+    unsigned int word = 0;
+    unsigned long long bits = 0;
+
+    if (val == 0) {
+
+        return false;
+    }
+
+    if (val > BIT_SET_UNIVERSE) {
+
+        val = BIT_SET_UNIVERSE;
+    }
+
+    val--;
+    word = val >> 6;
+    bits = set->words[word] & (~0ULL >> (63 - (val & 63)));			/* Bits of the word of val, up to val. */
+
+    if (bits == 0) {
+
+        /* Find the previous non-empty word through the summary. */
+
+        bits = set->summary & ((1ULL << word) - 1);
+
+        if (bits == 0) {
+
+            return false;
+        }
+
+        word = 63 - __builtin_clzll(bits);
+        bits = set->words[word];
+    }
+
+    *found = word * 64 + 63 - __builtin_clzll(bits);
+
+    return true;
+}
+
+
+static bool bit_set_max(void *the_set, unsigned int *found)
+{
+
+    bit_set *set = the_set;
+    unsigned int word = 0;
+
+    if (set->summary == 0) {
+
+        return false;
+    }
+
+    word = 63 - __builtin_clzll(set->summary);
+
+    *found = word * 64 + 63 - __builtin_clzll(set->words[word]);
+
+    return true;
+}
+
+
+static unsigned int bit_set_size(void *the_set)
+{
+
+    bit_set *set = the_set;
+
+    return set->size;
+}
@@ -0,0 +1,51 @@
+/* Bit set header file.
+ Contains the structure and functions' prototype declarations of a hierarchical bit set over a small universe of values (below BIT_SET_UNIVERSE.)
+ The values are bits of a bitmap of BIT_SET_WORDS words, and a summary word has a bit for every non-empty word of the bitmap, so successor, predecessor
+ and maximum take a couple of count-trailing/leading-zeros instructions. The counts (and payloads) of the values are kept in compact arrays, in the order
+ of the values - the index of a value is its rank, computed by counting the set bits which precede it.
+ The adaptive set (adaptive_set.h) uses the bit set while the values are small, and picks another ordered set otherwise. */
+
+
+#include <stdbool.h>
+
+#include "ordered_set.h"
+
+#ifndef BIT_SET_H_
+#define BIT_SET_H_
+
+
+#define BIT_SET_BITS 12			/* Number of bits of the values of the set. */
+
+#define BIT_SET_UNIVERSE (1U << BIT_SET_BITS)			/* The values of the set are in [0, BIT_SET_UNIVERSE). */
+
+#define BIT_SET_WORDS (BIT_SET_UNIVERSE / 64)			/* Number of words of the bitmap - one summary word covers all of them. */
+
+
+typedef struct bit_set_s {			/* Bit set structure. */
+
+    unsigned long long summary;			/* Bit i is set if words[i] isn't zero. */
+    unsigned long long words[BIT_SET_WORDS];			/* The bitmap of the values. */
+    unsigned int size;			/* Number of different (unique) values in the set. */
+    unsigned int capacity;			/* Number of allocated elements of counts and payloads. */
+    unsigned int *counts;			/* counts[rank] - number of instances of the value of the given rank. */
+    void **payloads;			/* payloads[rank] - payload of the value of the given rank. Allocated on the first request for a payload. */
+} bit_set;
+
+
+/* Operations of the bit set as an ordered set (see ordered_set.h.) Insertion of a value which is not below BIT_SET_UNIVERSE fails. */
+
+extern const ordered_set_ops bit_set_ops;
+
+
+/* Create a bit set instance - allocates and initializes an empty set.
+ Returns NULL on an allocation error, otherwise returns a pointer to bit_set. */
+
+bit_set* bit_set_create(void);
+
+
+/* Free the set. */
+
+void bit_set_destroy(bit_set *set);
+
+
+#endif /* BIT_SET_H_ */
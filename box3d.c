@@ -0,0 +1,671 @@
+/*
+ Box 3D source file.
+ Here we implement the k-d tree of the three-dimensional box factory - insertion and removal with the upkeep of the subtree summaries, the rebuilding of
+ unbalanced subtrees, and the branch and bound search of GETBOX.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include "box3d.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Compute the product of the given dimensions into volume. Returns FALSE if it doesn't fit in a box_volume, TRUE otherwise. */
+
+static bool box3d_product(box_dim dims[], box_volume *volume);
+
+
+/* Return the volume of the box of the given node. */
+
+static box_volume box3d_volume(box3d_node *node);
+
+
+/* Recompute the summaries of the given node (size, live, min_volume, min_dims and max_dims) from the node itself and its children. */
+
+static void box3d_update_node(box3d_node *node);
+
+
+/* Return TRUE if the box of the given node has the given dimensions. */
+
+static bool box3d_same(box3d_node *node, box_dim dims[]);
+
+
+/* Add delta (1 or -1) to the number of instances of the node of the given dimensions in the given subtree, if there is such a node (a node of a removed
+ box may get an instance again.) Returns FALSE if there's no such node, or if it has no instances to remove. */
+
+static bool box3d_change_count(box3d_node *node, box_dim dims[], int delta);
+
+
+/* Insert a new node of a box of the given dimensions to the subtree at *link, whose root splits by the given axis. depth would contain the depth of the
+ new node in the subtree (the root's depth is 1.) Returns FALSE on an allocation error. */
+
+static bool box3d_insert_node(box3d_node **link, box_dim dims[], unsigned int axis, unsigned int *depth);
+
+
+/* Rebuild the subtree of the highest unbalanced node on the path of the new node of the given dimensions, in the subtree at *link. */
+
+static void box3d_balance_path(box3d_node **link, box_dim dims[]);
+
+
+/* Free the nodes of the given subtree. */
+
+static void box3d_free_nodes(box3d_node *node);
+
+
+/* Rebuild the subtree at *link as a balanced k-d tree of the nodes with instances (the others are freed.) If there's no memory for the rebuilding, the
+ subtree is left as it is. */
+
+static void box3d_rebuild(box3d_node **link);
+
+
+/* Append the nodes of the given subtree with instances to nodes, from index *count on, and free the other nodes. */
+
+static void box3d_collect(box3d_node *node, box3d_node **nodes, unsigned int *count);
+
+
+/* Build a balanced k-d tree of the given nodes, whose root splits by the given axis. Returns its root. */
+
+static box3d_node* box3d_build(box3d_node **nodes, unsigned int count, unsigned int axis);
+
+
+/* Reorder the given nodes so that the node at index k is the one which would be there if they were sorted by the given axis - the nodes before it have
+ values up to its value, and the nodes after it have values from its value up (quickselect.) */
+
+static void box3d_select(box3d_node **nodes, unsigned int count, unsigned int k, unsigned int axis);
+
+
+/* Return TRUE if the box of node a should be returned by GETBOX before the box of node b - it has a smaller volume, or the same volume and smaller
+ dimensions (length, then width, then height.) */
+
+static bool box3d_better(box3d_node *a, box3d_node *b);
+
+
+/* Return a lower bound of the volume of the boxes of the given subtree which are suitable for the given query - the volume of the smallest box which is
+ at least as large as both the query and the minimal dimensions of the subtree, or the minimal volume of the subtree if it is larger. */
+
+static box_volume box3d_bound(box3d_node *node, box_dim query[]);
+
+
+/* The branch and bound search of GETBOX - update *best to the best suitable box of the subtree, if it is better than *best (NULL if none found yet.) */
+
+static void box3d_search(box3d_node *node, box_dim query[], box3d_node **best);
+
+
+/* The implementation: */
+
+
+box3d_factory* box3d_factory_create(void)
+{
+
+    return calloc(sizeof(box3d_factory), 1);
+}
+
+
+static void box3d_free_nodes(box3d_node *node)
+{
+
+    if (node == NULL) {
+
+        return;
+    }
+
+    /* The tree is kept balanced (see BOX3D_BALANCE), so the recursion is as deep as the tree - logarithmic in its size. */
+
+    box3d_free_nodes(node->left);
+    box3d_free_nodes(node->right);
+
+    free(node);
+}
+
+
+void box3d_factory_destroy(box3d_factory *factory)
+{
+
+    box3d_free_nodes(factory->root);
+
+    free(factory);
+}
+
+
+static bool box3d_product(box_dim dims[], box_volume *volume)
+{
+
+    unsigned int i = 0;
+
+    *volume = 1;
+
+    for (i = 0; i < BOX3D_DIMENSIONS; ++i) {
+
+        if (__builtin_mul_overflow(*volume, (box_volume) dims[i], volume)) {
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static box_volume box3d_volume(box3d_node *node)
+{
+
+    box_volume volume = 0;
+
+    box3d_product(node->dims, &volume);			/* The boxes which were inserted always have a volume. */
+
+    return volume;
+}
+
+
+static void box3d_update_node(box3d_node *node)
+{
+
+    box3d_node *children[2] = {node->left, node->right};
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    node->size = 1;
+    node->live = (node->count > 0) ? 1 : 0;
+    node->min_volume = (node->count > 0) ? box3d_volume(node) : 0;
+
+    for (j = 0; j < BOX3D_DIMENSIONS; ++j) {
+
+        node->min_dims[j] = (node->count > 0) ? node->dims[j] : 0;
+        node->max_dims[j] = (node->count > 0) ? node->dims[j] : 0;
+    }
+
+    for (i = 0; i < 2; ++i) {
+
+        if (children[i] == NULL) {
+
+            continue;
+        }
+
+        node->size += children[i]->size;
+
+        if (children[i]->live == 0) {
+
+            continue;
+        }
+
+        if ((node->live == 0) || (children[i]->min_volume < node->min_volume)) {
+
+            node->min_volume = children[i]->min_volume;
+        }
+
+        for (j = 0; j < BOX3D_DIMENSIONS; ++j) {
+
+            if ((node->live == 0) || (children[i]->min_dims[j] < node->min_dims[j])) {
+
+                node->min_dims[j] = children[i]->min_dims[j];
+            }
+
+            if (children[i]->max_dims[j] > node->max_dims[j]) {
+
+                node->max_dims[j] = children[i]->max_dims[j];
+            }
+        }
+
+        node->live += children[i]->live;
+    }
+}
+
+
+static bool box3d_same(box3d_node *node, box_dim dims[])
+{
+
+    return (node->dims[0] == dims[0]) && (node->dims[1] == dims[1]) && (node->dims[2] == dims[2]);
+}
+
+
+static bool box3d_change_count(box3d_node *node, box_dim dims[], int delta)
+{
+
+    bool found = false;
+
+    if (node == NULL) {
+
+        return false;
+    }
+
+    if (box3d_same(node, dims)) {
+
+        if ((delta < 0) && (node->count == 0)) {			/* The node of a removed box. */
+
+            return false;
+        }
+
+        node->count += delta;
+        found = true;
+    }
+
+    /* Smaller values of the axis are in the left subtree and larger ones in the right subtree. Equal values may be in both, since a rebuilt subtree is
+     split at its median. */
+
+    else {
+
+        if (dims[node->axis] <= node->dims[node->axis]) {
+
+            found = box3d_change_count(node->left, dims, delta);
+        }
+
+        if (!found && (dims[node->axis] >= node->dims[node->axis])) {
+
+            found = box3d_change_count(node->right, dims, delta);
+        }
+    }
+
+    if (found) {
+
+        box3d_update_node(node);
+    }
+
+    return found;
+}
+
+
+static bool box3d_insert_node(box3d_node **link, box_dim dims[], unsigned int axis, unsigned int *depth)
+{
+
+    box3d_node *node = *link;
+    unsigned int i = 0;
+
+    if (node == NULL) {			/* Create the node here. */
+
+        node = calloc(sizeof(box3d_node), 1);
+
+        if (node == NULL) {
+
+            return false;
+        }
+
+        for (i = 0; i < BOX3D_DIMENSIONS; ++i) {
+
+            node->dims[i] = dims[i];
+        }
+
+        node->count = 1;
+        node->axis = axis;
+
+        box3d_update_node(node);
+
+        *link = node;
+        *depth = 1;
+
+        return true;
+    }
+
+    if (!box3d_insert_node((dims[node->axis] < node->dims[node->axis]) ? &(node->left) : &(node->right), dims, (node->axis + 1) % BOX3D_DIMENSIONS,
+                           depth)) {
+
+        return false;
+    }
+
+    (*depth)++;
+
+    box3d_update_node(node);
+
+    return true;
+}
+
+
+static void box3d_balance_path(box3d_node **link, box_dim dims[])
+{
+
+    box3d_node *node = *link;
+    unsigned int largest_child = (node->left != NULL) ? node->left->size : 0;
+
+    if ((node->right != NULL) && (node->right->size > largest_child)) {
+
+        largest_child = node->right->size;
+    }
+
+    if (largest_child > BOX3D_BALANCE * node->size) {
+
+        box3d_rebuild(link);
+
+        return;
+    }
+
+    if (box3d_same(node, dims)) {			/* The new node itself. */
+
+        return;
+    }
+
+    box3d_balance_path((dims[node->axis] < node->dims[node->axis]) ? &(node->left) : &(node->right), dims);
+
+    box3d_update_node(node);			/* The rebuilding may have freed nodes of removed boxes below. */
+}
+
+
+bool box3d_factory_insert(box3d_factory *factory, box_dim length, box_dim width, box_dim height)
+{
+
+    box_dim dims[BOX3D_DIMENSIONS] = {length, width, height};
+    box_volume volume = 0;
+    unsigned int depth = 0;
+    unsigned int max_depth = 1;
+    double max_size = 1;
+
+    if (!box3d_product(dims, &volume)) {			/* The volume of every box must fit in a box_volume. */
+
+        return false;
+    }
+
+    /* If the box already has a node - only its number of instances grows. */
+
+    if (!box3d_change_count(factory->root, dims, 1)) {
+
+        if (!box3d_insert_node(&(factory->root), dims, 0, &depth)) {
+
+            return false;
+        }
+
+        /* Like in a scapegoat tree - only a node deeper than log(size) in base (1 / BOX3D_BALANCE) means that some subtree on its path is unbalanced. */
+
+        while (max_size < factory->root->size) {
+
+            max_size /= BOX3D_BALANCE;
+            max_depth++;
+        }
+
+        if (depth > max_depth) {
+
+            box3d_balance_path(&(factory->root), dims);
+        }
+    }
+
+    factory->boxes++;
+
+    return true;
+}
+
+
+bool box3d_factory_remove(box3d_factory *factory, box_dim length, box_dim width, box_dim height)
+{
+
+    box_dim dims[BOX3D_DIMENSIONS] = {length, width, height};
+
+    if (!box3d_change_count(factory->root, dims, -1)) {
+
+        return false;
+    }
+
+    factory->boxes--;
+
+    /* Rebuild the tree without the nodes of the removed boxes once they are the majority, so they don't slow down the searches. */
+
+    if (factory->root->size - factory->root->live > factory->root->live) {
+
+        box3d_rebuild(&(factory->root));
+    }
+
+    return true;
+}
+
+
+static void box3d_collect(box3d_node *node, box3d_node **nodes, unsigned int *count)
+{
+
+    if (node == NULL) {
+
+        return;
+    }
+
+    box3d_collect(node->left, nodes, count);
+    box3d_collect(node->right, nodes, count);
+
+    if (node->count > 0) {
+
+        node->left = NULL;
+        node->right = NULL;
+        nodes[(*count)++] = node;
+    }
+
+    else {
+
+        free(node);
+    }
+}
+
+
+static void box3d_select(box3d_node **nodes, unsigned int count, unsigned int k, unsigned int axis)
+{
+
+    box3d_node *swap = NULL;
+    unsigned int low = 0;
+    unsigned int high = count - 1;
+    unsigned int pivot = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    while (low < high) {
+
+        /* Partition [low, high] around the value of its middle node (Hoare's scheme), then continue in the part which holds index k. */
+
+        pivot = nodes[low + (high - low) / 2]->dims[axis];
+        i = low;
+        j = high;
+
+        while (i <= j) {
+
+            while (nodes[i]->dims[axis] < pivot) {
+
+                i++;
+            }
+
+            while (nodes[j]->dims[axis] > pivot) {
+
+                j--;
+            }
+
+            if (i <= j) {
+
+                swap = nodes[i];
+                nodes[i] = nodes[j];
+                nodes[j] = swap;
+
+                i++;
+
+                if (j == 0) {
+
+                    break;
+                }
+
+                j--;
+            }
+        }
+
+        /* Now the nodes of [low, j] have values up to pivot, the ones of [i, high] from pivot up, and the ones between them are equal to it. */
+
+        if (k <= j) {
+
+            high = j;
+        }
+
+        else if (k >= i) {
+
+            low = i;
+        }
+
+        else {
+
+            return;
+        }
+    }
+}
+
+
+static box3d_node* box3d_build(box3d_node **nodes, unsigned int count, unsigned int axis)
+{
+
+    box3d_node *node = NULL;
+    unsigned int middle = count / 2;
+
+    if (count == 0) {
+
+        return NULL;
+    }
+
+    box3d_select(nodes, count, middle, axis);			/* Split at the median. */
+
+    node = nodes[middle];
+    node->axis = axis;
+    node->left = box3d_build(nodes, middle, (axis + 1) % BOX3D_DIMENSIONS);
+    node->right = box3d_build(nodes + middle + 1, count - middle - 1, (axis + 1) % BOX3D_DIMENSIONS);
+
+    box3d_update_node(node);
+
+    return node;
+}
+
+
+static void box3d_rebuild(box3d_node **link)
+{
+
+    box3d_node **nodes = malloc(sizeof(box3d_node *) * ((*link)->live + 1));
+    unsigned int axis = (*link)->axis;
+    unsigned int count = 0;
+
+    if (nodes == NULL) {
+
+        return;
+    }
+
+    box3d_collect(*link, nodes, &count);
+
+    *link = box3d_build(nodes, count, axis);
+
+    free(nodes);
+}
+
+
+static bool box3d_better(box3d_node *a, box3d_node *b)
+{
+
+    box_volume volume_a = box3d_volume(a);
+    box_volume volume_b = box3d_volume(b);
+    unsigned int i = 0;
+
+    if (volume_a != volume_b) {
+
+        return volume_a < volume_b;
+    }
+
+    for (i = 0; i < BOX3D_DIMENSIONS; ++i) {
+
+        if (a->dims[i] != b->dims[i]) {
+
+            return a->dims[i] < b->dims[i];
+        }
+    }
+
+    return false;
+}
+
+
+static box_volume box3d_bound(box3d_node *node, box_dim query[])
+{
+
+    box_dim dims[BOX3D_DIMENSIONS];
+    box_volume bound = 0;
+    unsigned int i = 0;
+
+    for (i = 0; i < BOX3D_DIMENSIONS; ++i) {
+
+        dims[i] = (node->min_dims[i] > query[i]) ? node->min_dims[i] : query[i];
+    }
+
+    /* If the product doesn't fit, no box of the factory is large enough - the largest volume is a bound which prunes the subtree. */
+
+    if (!box3d_product(dims, &bound)) {
+
+        return ~((box_volume) 0);
+    }
+
+    return (bound > node->min_volume) ? bound : node->min_volume;
+}
+
+
+static void box3d_search(box3d_node *node, box_dim query[], box3d_node **best)
+{
+
+    box3d_node *first = NULL;
+    box3d_node *second = NULL;
+    unsigned int i = 0;
+
+    if ((node == NULL) || (node->live == 0)) {
+
+        return;
+    }
+
+    /* Prune the subtree if it has no box large enough in some dimension, or no box which may beat the best one. */
+
+    for (i = 0; i < BOX3D_DIMENSIONS; ++i) {
+
+        if (node->max_dims[i] < query[i]) {
+
+            return;
+        }
+    }
+
+    if ((*best != NULL) && (box3d_bound(node, query) > box3d_volume(*best))) {
+
+        return;
+    }
+
+    if ((node->count > 0) && (node->dims[0] >= query[0]) && (node->dims[1] >= query[1]) && (node->dims[2] >= query[2]) &&
+        ((*best == NULL) || box3d_better(node, *best))) {
+
+        *best = node;
+    }
+
+    /* Search the child with the smaller bound first - its result is more likely to prune the other one. */
+
+    first = node->left;
+    second = node->right;
+
+    if ((first == NULL) || (first->live == 0) || ((second != NULL) && (second->live > 0) && (box3d_bound(second, query) < box3d_bound(first, query)))) {
+
+        first = node->right;
+        second = node->left;
+    }
+
+    box3d_search(first, query, best);
+    box3d_search(second, query, best);
+}
+
+
+bool box3d_factory_get_box(box3d_factory *factory, box_dim length, box_dim width, box_dim height, bool rotate, box_dim *found_length,
+                           box_dim *found_width, box_dim *found_height)
+{
+
+    box_dim query[BOX3D_DIMENSIONS] = {length, width, height};
+    box_dim rotated_query[BOX3D_DIMENSIONS] = {width, length, height};
+    box3d_node *best = NULL;
+
+    box3d_search(factory->root, query, &best);
+
+    /* With rotation, a box may also fit the present turned by 90 degrees - the same as the box fitting the present with length and width swapped. */
+
+    if (rotate && (length != width)) {
+
+        box3d_search(factory->root, rotated_query, &best);
+    }
+
+    if (best == NULL) {
+
+        return false;
+    }
+
+    *found_length = best->dims[0];
+    *found_width = best->dims[1];
+    *found_height = best->dims[2];
+
+    return true;
+}
@@ -0,0 +1,81 @@
+/* Box 3D header file.
+ Contains the structures and functions' prototype declarations of the three-dimensional box factory - boxes of length x width x height, instead of the
+ square based boxes of box_factory.h. It is a separate inventory, with the same operations: INSERTBOX, REMOVEBOX and GETBOX (the suitable box of the
+ minimal volume, where a suitable box is at least as large as the present in every dimension - or, if asked for, with its footprint rotated.)
+ The boxes are kept in a k-d tree: every node holds a box (its dimensions and its number of instances) and splits its subtree by one dimension -
+ length, width and height in turn. Every node also keeps the minimal volume and the minimal and maximal dimensions of the boxes of its subtree, so GETBOX skips
+ the subtrees which have no suitable box, or no box which may be smaller than the best one found so far.
+ The tree is kept balanced like a scapegoat tree: when a new node is deeper than log(size) in base (1 / BOX3D_BALANCE), the topmost subtree on its path
+ whose child holds too large a part of it is rebuilt. The nodes of removed boxes stay in the tree (without instances) until they are as many as the
+ others, when the whole tree is rebuilt without them. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#ifndef BOX3D_H_
+#define BOX3D_H_
+
+
+#define BOX3D_DIMENSIONS 3
+
+#define BOX3D_BALANCE 0.7			/* A child may hold at most this part of the nodes of its parent's subtree, or the subtree is rebuilt. */
+
+
+typedef struct box3d_node_s box3d_node;
+
+
+struct box3d_node_s {			/* Node of the k-d tree. */
+
+    box_dim dims[BOX3D_DIMENSIONS];			/* Length, width and height of the box. */
+    unsigned int count;			/* Number of instances of the box (0 for a node of a removed box.) */
+    unsigned int axis;			/* The dimension which splits the subtree: the left one has values up to the node's, the right one from the node's up. */
+    box3d_node *left;
+    box3d_node *right;
+
+    unsigned int size;			/* Number of nodes in the subtree (including the node itself.) */
+    unsigned int live;			/* Number of nodes with instances in the subtree. */
+    box_volume min_volume;		/* The minimal volume of the boxes with instances in the subtree (meaningless if live is 0.) */
+    box_dim min_dims[BOX3D_DIMENSIONS];		/* The minimal and the maximal dimensions of the boxes with instances in the subtree. */
+    box_dim max_dims[BOX3D_DIMENSIONS];
+};
+
+
+typedef struct box3d_factory_s {			/* Box 3D factory structure. */
+
+    box3d_node *root;
+    unsigned long long boxes;			/* Number of boxes in the factory. */
+} box3d_factory;
+
+
+/* Create a 3D box factory instance. Returns NULL on an allocation error, otherwise returns a pointer to box3d_factory. */
+
+box3d_factory* box3d_factory_create(void);
+
+
+/* Free the 3D box factory with all of its boxes (the nodes of the removed boxes too.) */
+
+void box3d_factory_destroy(box3d_factory *factory);
+
+
+/* INSERTBOX - adds a box of the given dimensions. Returns FALSE on an allocation error, or if the volume of the box doesn't fit in a box_volume,
+ TRUE otherwise. */
+
+bool box3d_factory_insert(box3d_factory *factory, box_dim length, box_dim width, box_dim height);
+
+
+/* REMOVEBOX - removes a box of the given dimensions. Returns FALSE if there's no box of the given dimensions, TRUE otherwise. */
+
+bool box3d_factory_remove(box3d_factory *factory, box_dim length, box_dim width, box_dim height);
+
+
+/* GETBOX - returns FALSE if a box suitable for a present of the given dimensions is not found, TRUE otherwise, in which case found_length, found_width
+ and found_height contain the dimensions of the suitable box of the minimal volume (the smallest dimensions first, among the boxes of the same volume.)
+ If rotate is TRUE, the footprint of a box may also be turned by 90 degrees - a box of length l and width w fits a present of length w and width l. */
+
+bool box3d_factory_get_box(box3d_factory *factory, box_dim length, box_dim width, box_dim height, bool rotate, box_dim *found_length,
+                           box_dim *found_width, box_dim *found_height);
+
+
+#endif /* BOX3D_H_ */
@@ -0,0 +1,435 @@
+/*
+ Box approx source file.
+ Here we implement the buckets of the volume classes and their tries. Like in box_dominance.c, the keys of the trees of the heights of the leaves are the
+ heights themselves, stored in the key pointers.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdint.h>
+
+#include <stdlib.h>
+
+#include <math.h>
+
+#include "rb_tree.h"
+
+#include "box_approx.h"
+
+
+/* Convert a height to a key of a tree of the heights, and back. */
+
+#define HEIGHT_KEY(height) ((void *) (uintptr_t) (height))
+
+#define KEY_HEIGHT(key) ((box_dim) (uintptr_t) (key))
+
+
+/* Return the bit of the side which selects the child of a node at the given depth of a trie (the most significant bit first.) */
+
+#define SIDE_BIT(side, depth) (((side) >> (BOX_APPROX_BITS - 1 - (depth))) & 1)
+
+
+#define BOX_APPROX_MAX_LOG_VOLUME (2 * BOX_DIM_BITS * 0.6932)			/* log of the largest volume, 2^(2 * BOX_DIM_BITS) (ln(2) is about 0.6931.) */
+
+
+/* Functions' prototype declarations: */
+
+
+/* Comparison function between two keys of a tree of the heights. Return 0 if two keys are equal, 1 if a > b, and -1 if a < b. */
+
+static int compare_height_keys(void *a, void *b);
+
+
+/* Return the volume class of the given dimensions - 0 for a zero volume, otherwise 1 + the k for which (1 + epsilon)^k <= volume < (1 + epsilon)^(k + 1). */
+
+static unsigned int box_approx_class(box_approx *approx, box_dim side, box_dim height);
+
+
+/* Free the empty nodes of the given path of a trie (path[0] is the root, and the path has length nodes), from the bottom up, and update the maximal
+ heights of the others. Called after a removal from the leaf of the path, and to undo a failed insertion. */
+
+static void box_approx_fix_path(box_approx *approx, unsigned int bucket, box_approx_node **path, unsigned int length, box_dim side);
+
+
+/* Return TRUE if the given node of a trie has no boxes. */
+
+static bool box_approx_node_empty(box_approx_node *node);
+
+
+/* Search the trie of a bucket for a box with a side of at least the given side and a height of at least the given height.
+ Returns FALSE if there's no such box, TRUE otherwise. */
+
+static bool box_approx_get_bucket(box_approx_node *root, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height);
+
+
+/* Free the given node of a trie, with the tree of a leaf and the nodes below it. */
+
+static void box_approx_destroy_node(box_approx_node *node);
+
+
+/* The implementation: */
+
+
+static int compare_height_keys(void *a, void *b)
+{
+
+    if (KEY_HEIGHT(a) < KEY_HEIGHT(b)) {
+
+        return -1;
+    }
+
+    if (KEY_HEIGHT(a) > KEY_HEIGHT(b)) {
+
+        return 1;
+    }
+
+    return 0;
+}
+
+
+box_approx* box_approx_create(double epsilon)
+{
+
+    box_approx *approx = NULL;
+
+    if (!(epsilon >= BOX_APPROX_MIN_EPSILON)) {
+
+        return NULL;
+    }
+
+    approx = calloc(sizeof(box_approx), 1);
+
+    if (approx == NULL) {
+
+        return NULL;
+    }
+
+    approx->epsilon = epsilon;
+    approx->log_base = log(1 + epsilon);
+    approx->bucket_count = (unsigned int) (BOX_APPROX_MAX_LOG_VOLUME / approx->log_base) + 2;
+
+    approx->buckets = calloc(sizeof(box_approx_node *), approx->bucket_count);
+    approx->nonempty = calloc(sizeof(unsigned long long), (approx->bucket_count + 63) / 64);
+
+    if ((approx->buckets == NULL) || (approx->nonempty == NULL)) {
+
+        free(approx->buckets);
+        free(approx->nonempty);
+        free(approx);
+
+        return NULL;
+    }
+
+    return approx;
+}
+
+
+static void box_approx_destroy_node(box_approx_node *node)
+{
+
+    unsigned int bit = 0;
+
+    for (bit = 0; bit < 2; ++bit) {
+
+        if (node->children[bit] != NULL) {
+
+            box_approx_destroy_node(node->children[bit]);
+        }
+    }
+
+    if (node->heights != NULL) {
+
+        rb_tree_destroy(node->heights, NULL, NULL);			/* The keys are the heights themselves - nothing to free. */
+    }
+
+    free(node);
+}
+
+
+void box_approx_destroy(box_approx *approx)
+{
+
+    unsigned int bucket = 0;
+
+    for (bucket = 0; bucket < approx->bucket_count; ++bucket) {
+
+        if (approx->buckets[bucket] != NULL) {
+
+            box_approx_destroy_node(approx->buckets[bucket]);
+        }
+    }
+
+    free(approx->buckets);
+    free(approx->nonempty);
+    free(approx);
+}
+
+
+static unsigned int box_approx_class(box_approx *approx, box_dim side, box_dim height)
+{
+
+    double volume = (double) side * side * height;
+    unsigned int class = 0;
+
+    if (volume < 1) {
+
+        return 0;
+    }
+
+    class = (unsigned int) (log(volume) / approx->log_base) + 1;
+
+    return (class < approx->bucket_count) ? class : approx->bucket_count - 1;
+}
+
+
+static bool box_approx_node_empty(box_approx_node *node)
+{
+
+    if (node->heights != NULL) {
+
+        return node->heights->count == 0;
+    }
+
+    return (node->children[0] == NULL) && (node->children[1] == NULL);
+}
+
+
+bool box_approx_insert(box_approx *approx, box_dim side, box_dim height)
+{
+
+    box_approx_node *path[BOX_APPROX_BITS + 1];
+    box_approx_node *node = NULL;
+    unsigned int bucket = box_approx_class(approx, side, height);
+    unsigned int depth = 0;
+    bool exists = false;
+
+    if (approx->buckets[bucket] == NULL) {
+
+        approx->buckets[bucket] = calloc(sizeof(box_approx_node), 1);
+
+        if (approx->buckets[bucket] == NULL) {
+
+            return false;
+        }
+
+        approx->nonempty[bucket / 64] |= 1ULL << (bucket % 64);
+    }
+
+    path[0] = approx->buckets[bucket];
+
+    /* Walk (and create, where needed) the path of the side down to its leaf. */
+
+    for (depth = 0; depth < BOX_APPROX_BITS; ++depth) {
+
+        node = path[depth]->children[SIDE_BIT(side, depth)];
+
+        if (node == NULL) {
+
+            node = calloc(sizeof(box_approx_node), 1);
+
+            if (node == NULL) {
+
+                box_approx_fix_path(approx, bucket, path, depth + 1, side);			/* Free the empty nodes created so far. */
+
+                return false;
+            }
+
+            path[depth]->children[SIDE_BIT(side, depth)] = node;
+        }
+
+        path[depth + 1] = node;
+    }
+
+    if (node->heights == NULL) {
+
+        node->heights = rb_tree_create((rb_tree_compare) compare_height_keys);
+    }
+
+    if ((node->heights == NULL) || !rb_tree_insert(node->heights, HEIGHT_KEY(height), &exists)) {
+
+        box_approx_fix_path(approx, bucket, path, BOX_APPROX_BITS + 1, side);
+
+        return false;
+    }
+
+    for (depth = 0; depth <= BOX_APPROX_BITS; ++depth) {			/* The new box may raise the maximal heights of the path. */
+
+        if (path[depth]->max_height < height) {
+
+            path[depth]->max_height = height;
+        }
+    }
+
+    return true;
+}
+
+
+static void box_approx_fix_path(box_approx *approx, unsigned int bucket, box_approx_node **path, unsigned int length, box_dim side)
+{
+
+    box_approx_node *node = NULL;
+    unsigned int depth = length;
+
+    while (depth > 0) {
+
+        node = path[--depth];
+
+        if (box_approx_node_empty(node)) {
+
+            if (depth > 0) {
+
+                path[depth - 1]->children[SIDE_BIT(side, depth - 1)] = NULL;
+            }
+
+            else {			/* The bucket has been emptied. */
+
+                approx->buckets[bucket] = NULL;
+                approx->nonempty[bucket / 64] &= ~(1ULL << (bucket % 64));
+            }
+
+            free(node->heights);
+            free(node);
+
+            continue;
+        }
+
+        /* The maximal height of a leaf is the maximal key of its tree, and of another node - the larger one of its children. */
+
+        if (node->heights != NULL) {
+
+            node->max_height = KEY_HEIGHT(node->heights->max->key);
+        }
+
+        else {
+
+            node->max_height = 0;
+
+            if ((node->children[0] != NULL) && (node->children[0]->max_height > node->max_height)) {
+
+                node->max_height = node->children[0]->max_height;
+            }
+
+            if ((node->children[1] != NULL) && (node->children[1]->max_height > node->max_height)) {
+
+                node->max_height = node->children[1]->max_height;
+            }
+        }
+    }
+}
+
+
+void box_approx_remove(box_approx *approx, box_dim side, box_dim height)
+{
+
+    box_approx_node *path[BOX_APPROX_BITS + 1];
+    unsigned int bucket = box_approx_class(approx, side, height);
+    unsigned int depth = 0;
+    void *deleted = NULL;
+
+    path[0] = approx->buckets[bucket];
+
+    for (depth = 0; depth < BOX_APPROX_BITS; ++depth) {
+
+        path[depth + 1] = path[depth]->children[SIDE_BIT(side, depth)];
+    }
+
+    rb_tree_remove(path[BOX_APPROX_BITS]->heights, HEIGHT_KEY(height), &deleted);
+
+    box_approx_fix_path(approx, bucket, path, BOX_APPROX_BITS + 1, side);
+}
+
+
+static bool box_approx_get_bucket(box_approx_node *root, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height)
+{
+
+    box_approx_node *node = root;
+    box_approx_node *candidate = NULL;
+    box_dim prefix = 0;
+    box_dim candidate_prefix = 0;
+    unsigned int candidate_depth = 0;
+    unsigned int depth = 0;
+
+    /* Follow the path of the side. Wherever the side has a 0 bit, all the sides under the 1 child are larger than it - remember the deepest such child
+     which has a high enough box (it has the smallest sides.) */
+
+    for (depth = 0; (node != NULL) && (depth < BOX_APPROX_BITS); ++depth) {
+
+        if ((SIDE_BIT(side, depth) == 0) && (node->children[1] != NULL) && (node->children[1]->max_height >= height)) {
+
+            candidate = node->children[1];
+            candidate_prefix = (prefix << 1) | 1;
+            candidate_depth = depth + 1;
+        }
+
+        prefix = (prefix << 1) | SIDE_BIT(side, depth);
+        node = node->children[SIDE_BIT(side, depth)];
+    }
+
+    if ((node != NULL) && (node->max_height >= height)) {			/* A box with exactly the given side. */
+
+        candidate = node;
+        candidate_prefix = prefix;
+        candidate_depth = BOX_APPROX_BITS;
+    }
+
+    if (candidate == NULL) {
+
+        return false;
+    }
+
+    /* Go down from the candidate to a leaf with a high enough box, preferring the smaller sides. */
+
+    for (depth = candidate_depth; depth < BOX_APPROX_BITS; ++depth) {
+
+        if ((candidate->children[0] != NULL) && (candidate->children[0]->max_height >= height)) {
+
+            candidate = candidate->children[0];
+            candidate_prefix <<= 1;
+        }
+
+        else {
+
+            candidate = candidate->children[1];
+            candidate_prefix = (candidate_prefix << 1) | 1;
+        }
+    }
+
+    *found_side = candidate_prefix;
+    *found_height = KEY_HEIGHT(rb_tree_search_smallest_from(candidate->heights, HEIGHT_KEY(height))->key);
+
+    return true;
+}
+
+
+bool box_approx_get(box_approx *approx, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height)
+{
+
+    unsigned int bucket = box_approx_class(approx, side, height);
+    unsigned int word = bucket / 64;
+    unsigned long long bits = approx->nonempty[word] & (~0ULL << (bucket % 64));
+
+    /* A suitable box has at least the volume of the present - check the non-empty buckets from its class up. */
+
+    for (;;) {
+
+        while (bits != 0) {
+
+            bucket = word * 64 + __builtin_ctzll(bits);
+
+            if (box_approx_get_bucket(approx->buckets[bucket], side, height, found_side, found_height)) {
+
+                return true;
+            }
+
+            bits &= bits - 1;
+        }
+
+        if (++word == (approx->bucket_count + 63) / 64) {
+
+            return false;
+        }
+
+        bits = approx->nonempty[word];
+    }
+}
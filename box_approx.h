@@ -0,0 +1,73 @@
+/* Box approx header file.
+ Contains the structures and functions' prototype declarations of the approximate GETBOX of the box factory.
+ The boxes are kept in buckets by their volume class - the class of a volume v is the k for which (1 + epsilon)^k <= v < (1 + epsilon)^(k + 1).
+ Every bucket has a dominance structure over (side, height): a binary trie over the bits of the side, whose nodes keep the maximal height of their
+ boxes, so finding a box of the bucket with at least a given side and at least a given height takes O(BOX_APPROX_BITS) steps.
+ A suitable box has at least the volume of the present, so the query checks the non-empty buckets from the class of the present up, and returns a box
+ of the first bucket which has a suitable one. The box of minimal volume is in that bucket or in a later one, so the returned volume is less than
+ (1 + epsilon) times the minimal suitable volume. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#include "rb_tree.h"
+
+#ifndef BOX_APPROX_H_
+#define BOX_APPROX_H_
+
+
+#define BOX_APPROX_BITS BOX_SIDE_BITS			/* Number of bits of the side - the depth of the tries. */
+
+#define BOX_APPROX_MIN_EPSILON 0.001			/* The smallest epsilon allowed - smaller ones would need too many buckets. */
+
+
+typedef struct box_approx_node_s box_approx_node;
+
+
+struct box_approx_node_s {			/* Node of the trie of a bucket. */
+
+    box_approx_node *children[2];			/* The nodes of the sides with the next bit 0 / 1, NULL if there are no such boxes. */
+    box_dim max_height;			/* The maximal height of the boxes of the node. */
+    rb_tree *heights;			/* Tree of the heights of the boxes of a leaf (a single side), counted. NULL for the other nodes. */
+};
+
+
+typedef struct box_approx_s {			/* Box approx structure. */
+
+    double epsilon;
+    double log_base;			/* log(1 + epsilon). */
+    unsigned int bucket_count;
+    box_approx_node **buckets;			/* buckets[k] - the root of the trie of the volume class k, NULL if the bucket is empty. */
+    unsigned long long *nonempty;			/* Bitmap of the non-empty buckets, so the empty ones are skipped a word at a time. */
+} box_approx;
+
+
+/* Create an empty approximate index with the given epsilon. Returns NULL on an allocation error, or if epsilon is smaller than BOX_APPROX_MIN_EPSILON. */
+
+box_approx* box_approx_create(double epsilon);
+
+
+/* Free the approximate index with all of its buckets. */
+
+void box_approx_destroy(box_approx *approx);
+
+
+/* Add a box of the given dimensions. Returns FALSE on an allocation error (the index is left unchanged), TRUE otherwise. */
+
+bool box_approx_insert(box_approx *approx, box_dim side, box_dim height);
+
+
+/* Remove a box of the given dimensions, which must be in the index. */
+
+void box_approx_remove(box_approx *approx, box_dim side, box_dim height);
+
+
+/* Approximate GETBOX - returns FALSE if there's no suitable box, TRUE otherwise, in which case found_side and found_height contain the dimensions of
+ a suitable box whose volume is less than (1 + epsilon) times the minimal suitable volume. */
+
+bool box_approx_get(box_approx *approx, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height);
+
+
+#endif /* BOX_APPROX_H_ */
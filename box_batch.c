@@ -0,0 +1,522 @@
+/*
+ Box batch source file.
+ Here we implement the batch mode of the box factory - the parsing of the commands from the input buffer, and the results in the output buffer.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* read and write of the descriptors of the batch. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <errno.h>
+
+#include <math.h>
+
+#include <unistd.h>
+
+#include "box_factory.h"
+
+#include "box_batch.h"
+
+
+#define BOX_BATCH_PUT(batch, text) box_batch_put(batch, text, sizeof(text) - 1)			/* Append a string literal to the results. */
+
+
+typedef enum box_batch_command_e {			/* The commands of the batch mode. */
+
+    BOX_BATCH_INSERT,
+    BOX_BATCH_REMOVE,
+    BOX_BATCH_GET,
+    BOX_BATCH_CHECK,
+    BOX_BATCH_TAKE
+} box_batch_command;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Make sure the input buffer has a whole command, unless the input ends before it - the bytes which weren't parsed yet are moved to the start of the
+ buffer, and followed by the next bytes of the input. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_batch_fill(box_batch *batch);
+
+
+/* Write the results in the output buffer, and empty it. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_batch_flush(box_batch *batch);
+
+
+/* Append the given bytes to the results. */
+
+static void box_batch_put(box_batch *batch, const char *text, size_t size);
+
+
+/* Append a dimension to the results, in decimal (the same as BOX_DIM_FORMAT.) */
+
+static void box_batch_put_dim(box_batch *batch, box_dim val);
+
+
+/* Skip the white space of the input (counting its lines.) */
+
+static void box_batch_skip_space(box_batch *batch);
+
+
+/* Parse the next command of the input - its word and its two numbers. Returns FALSE if the command is invalid, TRUE otherwise. */
+
+static bool box_batch_parse(box_batch *batch, box_batch_command *command, box_dim *side, box_dim *height);
+
+
+/* Parse a decimal number of the input. Returns FALSE if there are no digits, or if the number doesn't fit in a box_dim, TRUE otherwise. */
+
+static bool box_batch_parse_dim(box_batch *batch, box_dim *val);
+
+
+/* Run a single command, and append its results - the same as box_menu_insert, box_menu_remove, box_menu_get and box_menu_check, followed by the empty
+ line of menu_run. Returns FALSE if the run stops (an insertion failed), TRUE otherwise. */
+
+static bool box_batch_insert(box_batch *batch, box_dim side, box_dim height);
+
+static void box_batch_remove(box_batch *batch, box_dim side, box_dim height);
+
+static bool box_batch_get(box_batch *batch, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height);
+
+static void box_batch_check(box_batch *batch, box_dim side, box_dim height);
+
+
+/* The implementation: */
+
+
+static bool box_batch_fill(box_batch *batch)
+{
+
+    ssize_t result = 0;
+
+    if (batch->end_of_input || (batch->in_size - batch->in_position >= BOX_BATCH_MAX_COMMAND)) {
+
+        return true;
+    }
+
+    memmove(batch->in, batch->in + batch->in_position, batch->in_size - batch->in_position);
+    batch->in_size -= batch->in_position;
+    batch->in_position = 0;
+
+    /* A pipe returns what it has - read until there is a whole command, or the input ends. */
+
+    while (!batch->end_of_input && (batch->in_size < BOX_BATCH_MAX_COMMAND)) {
+
+        result = read(batch->input, batch->in + batch->in_size, BOX_BATCH_BUFFER_SIZE - batch->in_size);
+
+        if (result < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            return false;
+        }
+
+        if (result == 0) {
+
+            batch->end_of_input = true;
+        }
+
+        batch->in_size += (size_t) result;
+    }
+
+    return true;
+}
+
+
+static bool box_batch_flush(box_batch *batch)
+{
+
+    size_t done = 0;
+    ssize_t result = 0;
+
+    while (done < batch->out_size) {
+
+        result = write(batch->output, batch->out + done, batch->out_size - done);
+
+        if (result < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            batch->failed = true;
+            break;
+        }
+
+        done += (size_t) result;
+    }
+
+    batch->out_size = 0;
+
+    return !batch->failed;
+}
+
+
+static void box_batch_put(box_batch *batch, const char *text, size_t size)
+{
+
+    if (batch->out_size + size > BOX_BATCH_BUFFER_SIZE) {
+
+        box_batch_flush(batch);
+    }
+
+    memcpy(batch->out + batch->out_size, text, size);
+    batch->out_size += size;
+}
+
+
+static void box_batch_put_dim(box_batch *batch, box_dim val)
+{
+
+    char digits[3 * sizeof(box_dim)];			/* More than the decimal digits of the largest box_dim. */
+    unsigned int count = 0;
+
+    /* The digits are made from the lowest one up, at the end of the array. */
+
+    do {
+
+        digits[sizeof(digits) - 1 - count] = (char) ('0' + val % 10);
+        val /= 10;
+        count++;
+    } while (val != 0);
+
+    box_batch_put(batch, digits + sizeof(digits) - count, count);
+}
+
+
+static void box_batch_skip_space(box_batch *batch)
+{
+
+    char c = 0;
+
+    while (batch->in_position < batch->in_size) {
+
+        c = batch->in[batch->in_position];
+
+        if ((c != ' ') && (c != '\t') && (c != '\r') && (c != '\n')) {
+
+            break;
+        }
+
+        if (c == '\n') {
+
+            batch->line++;
+        }
+
+        batch->in_position++;
+    }
+}
+
+
+static bool box_batch_parse_dim(box_batch *batch, box_dim *val)
+{
+
+    const char *in = batch->in;
+    size_t position = batch->in_position;
+    box_dim digit = 0;
+
+    *val = 0;
+
+    while ((position < batch->in_size) && (in[position] >= '0') && (in[position] <= '9')) {
+
+        digit = (box_dim) (in[position] - '0');
+
+        if (*val > (((box_dim) ~((box_dim) 0)) - digit) / 10) {			/* The number doesn't fit in a box_dim. */
+
+            return false;
+        }
+
+        *val = *val * 10 + digit;
+        position++;
+    }
+
+    if (position == batch->in_position) {
+
+        return false;
+    }
+
+    batch->in_position = position;
+
+    return true;
+}
+
+
+static bool box_batch_parse(box_batch *batch, box_batch_command *command, box_dim *side, box_dim *height)
+{
+
+    static const struct {
+
+        const char *word;
+        box_batch_command command;
+    } commands[] = {{"INSERT", BOX_BATCH_INSERT}, {"REMOVE", BOX_BATCH_REMOVE}, {"GET", BOX_BATCH_GET}, {"CHECK", BOX_BATCH_CHECK},
+                    {"TAKE", BOX_BATCH_TAKE}};
+
+    const char *word = batch->in + batch->in_position;
+    size_t length = 0;
+    unsigned int i = 0;
+    bool known = false;
+
+    while ((batch->in_position + length < batch->in_size) && (word[length] >= 'A') && (word[length] <= 'Z')) {
+
+        length++;
+    }
+
+    /* The full word, or its first letter. */
+
+    for (i = 0; (i < sizeof(commands) / sizeof(commands[0])) && !known; ++i) {
+
+        if ((length == 1) ? (word[0] == commands[i].word[0]) : ((length == strlen(commands[i].word)) && (memcmp(word, commands[i].word, length) == 0))) {
+
+            *command = commands[i].command;
+            known = true;
+        }
+    }
+
+    if (!known) {
+
+        return false;
+    }
+
+    batch->in_position += length;
+
+    /* The numbers - each one after white space, which doesn't end the command (a command may span lines.) */
+
+    box_batch_skip_space(batch);
+
+    if ((batch->in_position == batch->in_size) || !box_batch_parse_dim(batch, side)) {
+
+        return false;
+    }
+
+    box_batch_skip_space(batch);
+
+    return (batch->in_position < batch->in_size) && box_batch_parse_dim(batch, height);
+}
+
+
+static bool box_batch_insert(box_batch *batch, box_dim side, box_dim height)
+{
+
+    bool inserted = false;
+
+    BOX_BATCH_PUT(batch, "Requesting to insert a box with side=");
+    box_batch_put_dim(batch, side);
+    BOX_BATCH_PUT(batch, " and height=");
+    box_batch_put_dim(batch, height);
+    BOX_BATCH_PUT(batch, "\n");
+
+    inserted = box_factory_insert(batch->factory, side, height);
+
+    if (!inserted) {
+
+        BOX_BATCH_PUT(batch, "Error: Insertion failed\n\n");
+    }
+
+    else {
+
+        BOX_BATCH_PUT(batch, "Inserted a box with side=");
+        box_batch_put_dim(batch, side);
+        BOX_BATCH_PUT(batch, " and height=");
+        box_batch_put_dim(batch, height);
+        BOX_BATCH_PUT(batch, "\n\n");
+    }
+
+    return inserted;
+}
+
+
+static void box_batch_remove(box_batch *batch, box_dim side, box_dim height)
+{
+
+    BOX_BATCH_PUT(batch, "Requesting to remove a box with side=");
+    box_batch_put_dim(batch, side);
+    BOX_BATCH_PUT(batch, " and height=");
+    box_batch_put_dim(batch, height);
+    BOX_BATCH_PUT(batch, "\n");
+
+    if (!box_factory_remove(batch->factory, side, height)) {
+
+        BOX_BATCH_PUT(batch, "Error: Box of the given dimensions is not found\n\n");
+    }
+
+    else {
+
+        BOX_BATCH_PUT(batch, "Removed a box with side=");
+        box_batch_put_dim(batch, side);
+        BOX_BATCH_PUT(batch, " and height=");
+        box_batch_put_dim(batch, height);
+        BOX_BATCH_PUT(batch, "\n\n");
+    }
+}
+
+
+static bool box_batch_get(box_batch *batch, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height)
+{
+
+    box_dim found_side_square = 0;
+    bool found = false;
+
+    BOX_BATCH_PUT(batch, "Searching for a box of minimal volume with minimum side=");
+    box_batch_put_dim(batch, side);
+    BOX_BATCH_PUT(batch, " and height=");
+    box_batch_put_dim(batch, height);
+    BOX_BATCH_PUT(batch, "\n");
+
+    found = box_factory_get_box(batch->factory, side, height, &found_side_square, found_height);
+
+    if (found) {
+
+        *found_side = (box_dim) (sqrt((double) found_side_square) + 0.5);			/* The side the menu prints. */
+
+        BOX_BATCH_PUT(batch, "Found a box with side=");
+        box_batch_put_dim(batch, *found_side);
+        BOX_BATCH_PUT(batch, " and height=");
+        box_batch_put_dim(batch, *found_height);
+        BOX_BATCH_PUT(batch, "\n\n");
+    }
+
+    else {
+
+        BOX_BATCH_PUT(batch, "Error: The suitable box is not found\n\n");
+    }
+
+    return found;
+}
+
+
+static void box_batch_check(box_batch *batch, box_dim side, box_dim height)
+{
+
+    BOX_BATCH_PUT(batch, "Checking whether a box with minimum side=");
+    box_batch_put_dim(batch, side);
+    BOX_BATCH_PUT(batch, " and height=");
+    box_batch_put_dim(batch, height);
+    BOX_BATCH_PUT(batch, " exists\n");
+
+    if (!box_factory_check_box(batch->factory, side, height)) {
+
+        BOX_BATCH_PUT(batch, "The suitable box does not exist\n\n");
+    }
+
+    else {
+
+        BOX_BATCH_PUT(batch, "There is a suitable box\n\n");
+    }
+}
+
+
+bool box_batch_run(box_factory *factory, int input, int output)
+{
+
+    box_batch batch;
+    box_batch_command command = BOX_BATCH_INSERT;
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side = 0;
+    box_dim found_height = 0;
+    size_t start = 0;
+    bool running = true;
+    bool valid = true;
+
+    memset(&batch, 0, sizeof(box_batch));
+
+    batch.factory = factory;
+    batch.input = input;
+    batch.output = output;
+    batch.line = 1;
+    batch.in = malloc(BOX_BATCH_BUFFER_SIZE);
+    batch.out = malloc(BOX_BATCH_BUFFER_SIZE);
+
+    if ((batch.in == NULL) || (batch.out == NULL)) {
+
+        free(batch.in);
+        free(batch.out);
+
+        return false;
+    }
+
+    while (running && !batch.failed) {
+
+        /* Skip the white space before the command (refilling the buffer as long as it's all white space), and make sure the buffer has the whole
+         command - the buffer has BOX_BATCH_MAX_COMMAND bytes of it then, so a shorter command can't be cut by its end. */
+
+        do {
+
+            batch.failed = !box_batch_fill(&batch);
+            box_batch_skip_space(&batch);
+        } while (!batch.failed && (batch.in_position == batch.in_size) && !batch.end_of_input);
+
+        if (batch.failed || (batch.in_position == batch.in_size)) {			/* An I/O error, or the end of the input. */
+
+            break;
+        }
+
+        if (!box_batch_fill(&batch)) {
+
+            batch.failed = true;
+            break;
+        }
+
+        start = batch.in_position;
+        valid = box_batch_parse(&batch, &command, &side, &height) && (batch.in_position - start < BOX_BATCH_MAX_COMMAND);
+
+        if (!valid) {
+
+            box_batch_flush(&batch);
+            fprintf(stderr, "Error: Invalid command at line %llu\n", batch.line);
+
+            break;
+        }
+
+        switch (command) {
+
+            case BOX_BATCH_INSERT:
+
+                running = box_batch_insert(&batch, side, height);
+                break;
+
+            case BOX_BATCH_REMOVE:
+
+                box_batch_remove(&batch, side, height);
+                break;
+
+            case BOX_BATCH_GET:
+
+                box_batch_get(&batch, side, height, &found_side, &found_height);
+                break;
+
+            case BOX_BATCH_CHECK:
+
+                box_batch_check(&batch, side, height);
+                break;
+
+            case BOX_BATCH_TAKE:
+
+                if (box_batch_get(&batch, side, height, &found_side, &found_height)) {
+
+                    box_batch_remove(&batch, found_side, found_height);
+                }
+
+                break;
+        }
+    }
+
+    box_batch_flush(&batch);
+
+    free(batch.in);
+    free(batch.out);
+
+    return running && valid && !batch.failed;
+}
@@ -0,0 +1,55 @@
+/* Box batch header file.
+ Contains the structures and functions' prototype declarations of the batch mode of the box factory - a non-interactive processor of a stream of
+ commands, for driving the box factory from scripts instead of the menu (box_menu.h.)
+ Every command is a word and two numbers - the side and the height - separated by any white space:
+   INSERT side height - insert a box (like the menu's insertion.)
+   REMOVE side height - remove a box (like the menu's removal.)
+   GET side height - find a suitable box of minimal volume (like the menu's search.)
+   CHECK side height - check whether there is a suitable box (like the menu's check.)
+   TAKE side height - GET, and then REMOVE of the box found - the same as those two options of the menu, one after the other.
+ A command word may be given by its first letter as well (I, R, G, C, T.)
+ The results are byte-identical to the output of the menu for the same operations, without its listing and its prompts - including the empty line
+ which follows every operation, and the stop after an insertion which failed.
+ The input is read in large blocks, and the numbers are parsed in place from the block; the output is collected in a buffer and written in large
+ blocks too - so a command costs its operation on the box factory, and a few bytes of copying. */
+
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include "box_factory.h"
+
+#ifndef BOX_BATCH_H_
+#define BOX_BATCH_H_
+
+
+#define BOX_BATCH_BUFFER_SIZE 65536			/* The size of the input buffer and of the output buffer. */
+
+#define BOX_BATCH_MAX_COMMAND 128			/* A command (with the white space inside it) must be shorter than this. */
+
+
+typedef struct box_batch_s {			/* Box batch structure - the state of a run of box_batch_run. */
+
+    box_factory *factory;
+    int input;			/* The file descriptors of the commands and of the results. */
+    int output;
+    char *in;			/* The input read so far, from in_position to in_size not parsed yet. */
+    size_t in_position;
+    size_t in_size;
+    bool end_of_input;
+    char *out;			/* The results which weren't written yet. */
+    size_t out_size;
+    unsigned long long line;			/* The line of the input being parsed (from 1), for the error message. */
+    bool failed;			/* TRUE once reading or writing has failed. */
+} box_batch;
+
+
+/* Run the commands read from the input file descriptor on the box factory until the input ends, and write their results to the output file
+ descriptor. An invalid command is reported with its line to stderr, and stops the run.
+ Returns FALSE if a command is invalid, on an allocation error or an I/O error, or if an insertion failed (the menu quits then too), TRUE otherwise. */
+
+bool box_batch_run(box_factory *factory, int input, int output);
+
+
+#endif /* BOX_BATCH_H_ */
@@ -0,0 +1,1299 @@
+/*
+ Box B+-tree source file.
+ Here we implement the disk-backed index of a box factory - the buffer pool of the pages of the file, the insertion and removal of the sizes with the
+ splits and the frees of the pages, and the queries, which skip the subtrees by their maximal heights.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* pread and pwrite. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <limits.h>
+
+#include <errno.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include "box_btree.h"
+
+
+typedef struct box_btree_path_s {			/* A page on the way from the root to a leaf. */
+
+    int frame;			/* The frame of the page, pinned while the path is used. */
+    unsigned int index;			/* An inner page - the child the key is under; a leaf - the position of the key (the first entry which isn't smaller.) */
+} box_btree_path;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Comparison function between two keys ((side * side) and then height.) Returns a negative number, 0 or a positive number if key a is smaller than,
+ equal to or larger than key b. */
+
+static int box_btree_compare(box_dim side_a, box_dim height_a, box_dim side_b, box_dim height_b);
+
+
+/* Return the header, the leaf entries and the inner entries of the page in the given frame. */
+
+static box_btree_page_header* box_btree_header(box_btree *tree, int frame);
+
+static box_snapshot_record* box_btree_records(box_btree *tree, int frame);
+
+static box_btree_child* box_btree_children(box_btree *tree, int frame);
+
+
+/* Read (or write, if writing is TRUE) the given page of the file. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_btree_io(box_btree *tree, unsigned int page, void *data, bool writing);
+
+
+/* Allocate a tree over the given file with a buffer pool of the given number of bytes. Returns NULL on an allocation error. */
+
+static box_btree* box_btree_alloc(int fd, size_t memory);
+
+
+/* Return a frame to read a page into - an unused frame, or the frame the clock picks, by two passes of the hand over the frames which aren't pinned:
+ the first pass passes over the inner pages, and only if no leaf can be replaced the second pass takes an inner page. Returns -1 if every frame is
+ pinned. */
+
+static int box_btree_victim(box_btree *tree);
+
+
+/* Pin the given page in the buffer pool - read it into a frame, unless it's there already. A fresh page isn't read, but zeroed (a page at the end of
+ the file.) Returns the frame, or -1 on an I/O error (the tree has failed then.) */
+
+static int box_btree_fetch(box_btree *tree, unsigned int page, bool fresh);
+
+
+/* Unpin the page of the given frame. */
+
+static void box_btree_unpin(box_btree *tree, int frame);
+
+
+/* Pin a new empty page of the given level - a freed page, or a page at the end of the file. Returns its frame, or -1 on an error. */
+
+static int box_btree_new_page(box_btree *tree, unsigned int level);
+
+
+/* Add the page of the given (pinned) frame to the free list. */
+
+static void box_btree_free_page(box_btree *tree, int frame);
+
+
+/* Return the position of the given key in the page of the given frame - the first entry which isn't smaller in a leaf, and the child the key is under
+ (the last child whose key isn't larger, or the first child) in an inner page. */
+
+static unsigned int box_btree_position(box_btree *tree, int frame, box_dim side_square, box_dim height);
+
+
+/* Return the maximal height of the entries of the page of the given frame. */
+
+static box_dim box_btree_page_max(box_btree *tree, int frame);
+
+
+/* Pin the pages of the way from the root to the leaf of the given key, and fill path with them (path[level] for every level.)
+ Returns FALSE on an I/O error or an invalid page (nothing is pinned then), TRUE otherwise. */
+
+static bool box_btree_descend(box_btree *tree, box_dim side_square, box_dim height, box_btree_path path[]);
+
+
+/* Unpin the pages of the path from the given level up to (and not including) the given end level. */
+
+static void box_btree_release(box_btree *tree, box_btree_path path[], unsigned int from, unsigned int to);
+
+
+/* Return TRUE if the pages of the path from the given level up are the last children of their parents - the path is the rightmost one of the tree. */
+
+static bool box_btree_rightmost(box_btree *tree, box_btree_path path[], unsigned int from, unsigned int levels);
+
+
+/* Insert a leaf entry (or an inner entry) at the given position of the page of the given frame, which has room for it. */
+
+static void box_btree_put_record(box_btree *tree, int frame, unsigned int position, box_dim side_square, box_dim height, unsigned int count);
+
+static void box_btree_put_child(box_btree *tree, int frame, unsigned int position, const box_btree_child *entry);
+
+
+/* Insert a new size at the position of the path in its leaf, and split the leaf if it's full. Returns FALSE on an error, TRUE otherwise. */
+
+static bool box_btree_insert_record(box_btree *tree, box_btree_path path[], box_dim side_square, box_dim height, unsigned int count);
+
+
+/* Insert the entry of a new page right after the child of the path in its page of the given level, and split that page if it's full (a new root is
+ created if the root was split.) Returns FALSE on an error, TRUE otherwise. */
+
+static bool box_btree_insert_child(box_btree *tree, box_btree_path path[], unsigned int level, const box_btree_child *entry);
+
+
+/* Visit the sizes of the subtree of the given page, as described in box_btree_scan. stopped would be TRUE once the visiting function returns FALSE.
+ Returns FALSE on an I/O error or an invalid page, TRUE otherwise. */
+
+static bool box_btree_scan_page(box_btree *tree, unsigned int page, unsigned int level, box_dim side_square, box_dim height, box_btree_visit visit,
+                                void *context, bool *stopped);
+
+
+/* Visiting function which copies the first size it gets into the context (a box_snapshot_record) and stops the scan. */
+
+static bool box_btree_take_first(void *context, const box_snapshot_record *record);
+
+
+/* Find the first size from the given key whose height is at least the given height. Returns FALSE if there's none, TRUE otherwise. */
+
+static bool box_btree_next(box_btree *tree, box_dim side_square, box_dim height, box_snapshot_record *record);
+
+
+/* The implementation: */
+
+
+static int box_btree_compare(box_dim side_a, box_dim height_a, box_dim side_b, box_dim height_b)
+{
+
+    if (side_a != side_b) {
+
+        return (side_a < side_b) ? -1 : 1;
+    }
+
+    if (height_a != height_b) {
+
+        return (height_a < height_b) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+static box_btree_page_header* box_btree_header(box_btree *tree, int frame)
+{
+
+    return (box_btree_page_header *) tree->frames[frame].data;
+}
+
+
+static box_snapshot_record* box_btree_records(box_btree *tree, int frame)
+{
+
+    return (box_snapshot_record *) (tree->frames[frame].data + sizeof(box_btree_page_header));
+}
+
+
+static box_btree_child* box_btree_children(box_btree *tree, int frame)
+{
+
+    return (box_btree_child *) (tree->frames[frame].data + sizeof(box_btree_page_header));
+}
+
+
+static bool box_btree_io(box_btree *tree, unsigned int page, void *data, bool writing)
+{
+
+    off_t offset = (off_t) page * BOX_BTREE_PAGE_SIZE;
+    size_t done = 0;
+    ssize_t result = 0;
+
+    while (done < BOX_BTREE_PAGE_SIZE) {
+
+        result = writing ? pwrite(tree->fd, (const char *) data + done, BOX_BTREE_PAGE_SIZE - done, offset + (off_t) done)
+                         : pread(tree->fd, (char *) data + done, BOX_BTREE_PAGE_SIZE - done, offset + (off_t) done);
+
+        if (result <= 0) {
+
+            if ((result < 0) && (errno == EINTR)) {
+
+                continue;
+            }
+
+            return false;			/* An error, or the file ended in the middle of a page. */
+        }
+
+        done += (size_t) result;
+    }
+
+    return true;
+}
+
+
+static box_btree* box_btree_alloc(int fd, size_t memory)
+{
+
+    box_btree *tree = calloc(sizeof(box_btree), 1);
+    unsigned int buckets = 1;
+    unsigned int i = 0;
+
+    if (tree == NULL) {
+
+        return NULL;
+    }
+
+    tree->fd = fd;
+    tree->frame_count = (memory / BOX_BTREE_PAGE_SIZE < BOX_BTREE_MIN_FRAMES) ? BOX_BTREE_MIN_FRAMES
+                        : (memory / BOX_BTREE_PAGE_SIZE > INT_MAX / 2) ? INT_MAX / 2 : (unsigned int) (memory / BOX_BTREE_PAGE_SIZE);
+
+    while (buckets < tree->frame_count * 2) {			/* At most half of the buckets are used. */
+
+        buckets *= 2;
+    }
+
+    tree->bucket_mask = buckets - 1;
+    tree->frames = calloc(sizeof(box_btree_frame), tree->frame_count);
+    tree->memory = malloc((size_t) tree->frame_count * BOX_BTREE_PAGE_SIZE);
+    tree->buckets = malloc(sizeof(int) * buckets);
+
+    if ((tree->frames == NULL) || (tree->memory == NULL) || (tree->buckets == NULL)) {
+
+        free(tree->frames);
+        free(tree->memory);
+        free(tree->buckets);
+        free(tree);
+
+        return NULL;
+    }
+
+    for (i = 0; i < tree->frame_count; ++i) {
+
+        tree->frames[i].data = tree->memory + (size_t) i * BOX_BTREE_PAGE_SIZE;
+        tree->frames[i].next = -1;
+    }
+
+    for (i = 0; i < buckets; ++i) {
+
+        tree->buckets[i] = -1;
+    }
+
+    return tree;
+}
+
+
+box_btree* box_btree_create(const char *path, size_t memory)
+{
+
+    box_btree *tree = NULL;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int root = -1;
+
+    if (fd < 0) {
+
+        return NULL;
+    }
+
+    tree = box_btree_alloc(fd, memory);
+
+    if (tree == NULL) {
+
+        close(fd);
+        return NULL;
+    }
+
+    tree->meta.magic = BOX_BTREE_MAGIC;
+    tree->meta.version = BOX_BTREE_VERSION;
+    tree->meta.dim_size = sizeof(box_dim);
+    tree->meta.page_size = BOX_BTREE_PAGE_SIZE;
+    tree->meta.page_count = 1;
+    tree->meta.levels = 1;
+
+    /* The root of an empty tree is an empty leaf. The file is marked open until it's closed. */
+
+    root = box_btree_new_page(tree, 0);
+
+    if (root >= 0) {
+
+        tree->meta.root = tree->frames[root].page;
+        box_btree_unpin(tree, root);
+    }
+
+    if ((root < 0) || !box_btree_flush(tree)) {
+
+        box_btree_close(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+
+box_btree* box_btree_open(const char *path, size_t memory)
+{
+
+    box_btree *tree = NULL;
+    unsigned char page[BOX_BTREE_PAGE_SIZE];
+    int fd = open(path, O_RDWR);
+
+    if (fd < 0) {
+
+        return NULL;
+    }
+
+    tree = box_btree_alloc(fd, memory);
+
+    if (tree == NULL) {
+
+        close(fd);
+        return NULL;
+    }
+
+    if (!box_btree_io(tree, 0, page, false)) {
+
+        tree->failed = true;
+    }
+
+    memcpy(&(tree->meta), page, sizeof(box_btree_meta));
+
+    if (tree->failed || (tree->meta.magic != BOX_BTREE_MAGIC) || (tree->meta.version != BOX_BTREE_VERSION) || (tree->meta.dim_size != sizeof(box_dim)) ||
+        (tree->meta.page_size != BOX_BTREE_PAGE_SIZE) || (tree->meta.clean != 1) || (tree->meta.levels == 0) ||
+        (tree->meta.levels > BOX_BTREE_MAX_LEVELS) || (tree->meta.root == 0) || (tree->meta.root >= tree->meta.page_count)) {
+
+        tree->failed = true;			/* The file is left as it is. */
+
+        box_btree_close(tree);
+        return NULL;
+    }
+
+    tree->meta.clean = 0;
+
+    if (!box_btree_flush(tree)) {
+
+        box_btree_close(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+
+bool box_btree_flush(box_btree *tree)
+{
+
+    unsigned char page[BOX_BTREE_PAGE_SIZE];
+    unsigned int i = 0;
+
+    if (tree->failed) {
+
+        return false;
+    }
+
+    for (i = 0; i < tree->frame_count; ++i) {
+
+        if ((tree->frames[i].page != 0) && tree->frames[i].dirty) {
+
+            if (!box_btree_io(tree, tree->frames[i].page, tree->frames[i].data, true)) {
+
+                tree->failed = true;
+                return false;
+            }
+
+            tree->frames[i].dirty = false;
+            tree->stats.writes++;
+        }
+    }
+
+    memset(page, 0, sizeof(page));
+    memcpy(page, &(tree->meta), sizeof(box_btree_meta));
+
+    if (!box_btree_io(tree, 0, page, true)) {
+
+        tree->failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+void box_btree_close(box_btree *tree)
+{
+
+    /* The pages are written before the first page marks the file closed - a crash in between leaves a file which isn't opened again. */
+
+    if (box_btree_flush(tree)) {
+
+        tree->meta.clean = 1;
+
+        box_btree_flush(tree);
+    }
+
+    close(tree->fd);
+
+    free(tree->frames);
+    free(tree->memory);
+    free(tree->buckets);
+    free(tree);
+}
+
+
+static int box_btree_victim(box_btree *tree)
+{
+
+    box_btree_frame *frame = NULL;
+    unsigned int pass = 0;
+    unsigned int step = 0;
+    int victim = -1;
+
+    /* Two turns of the hand clear the referenced bits of the frames of a pass, so a pass finds a frame if it has one. */
+
+    for (pass = 0; pass < 2; ++pass) {
+
+        for (step = 0; step < 2 * tree->frame_count; ++step) {
+
+            victim = (int) tree->hand;
+            frame = &(tree->frames[victim]);
+
+            tree->hand = (tree->hand + 1 == tree->frame_count) ? 0 : tree->hand + 1;
+
+            if (frame->pins > 0) {
+
+                continue;
+            }
+
+            if (frame->page == 0) {
+
+                return victim;
+            }
+
+            if ((pass == 0) && (box_btree_header(tree, victim)->level > 0)) {			/* The upper levels stay resident. */
+
+                continue;
+            }
+
+            if (frame->referenced) {
+
+                frame->referenced = false;
+                continue;
+            }
+
+            return victim;
+        }
+    }
+
+    return -1;
+}
+
+
+static int box_btree_fetch(box_btree *tree, unsigned int page, bool fresh)
+{
+
+    unsigned int bucket = (page * 2654435761U) & tree->bucket_mask;
+    box_btree_frame *frame = NULL;
+    int *link = NULL;
+    int i = 0;
+
+    if (tree->failed) {
+
+        return -1;
+    }
+
+    for (i = tree->buckets[bucket]; i >= 0; i = tree->frames[i].next) {
+
+        if (tree->frames[i].page == page) {
+
+            tree->frames[i].pins++;
+            tree->frames[i].referenced = true;
+            tree->stats.hits++;
+
+            return i;
+        }
+    }
+
+    i = box_btree_victim(tree);
+
+    if (i < 0) {
+
+        tree->failed = true;
+        return -1;
+    }
+
+    frame = &(tree->frames[i]);
+
+    /* Write the page the frame had if it was changed, and drop it from its bucket. */
+
+    if (frame->page != 0) {
+
+        if (frame->dirty) {
+
+            if (!box_btree_io(tree, frame->page, frame->data, true)) {
+
+                tree->failed = true;
+                return -1;
+            }
+
+            tree->stats.writes++;
+        }
+
+        for (link = &(tree->buckets[(frame->page * 2654435761U) & tree->bucket_mask]); *link != i; link = &(tree->frames[*link].next)) {
+
+        }
+
+        *link = frame->next;
+
+        frame->page = 0;
+        frame->dirty = false;
+        tree->stats.evictions++;
+    }
+
+    if (fresh) {
+
+        memset(frame->data, 0, BOX_BTREE_PAGE_SIZE);
+    }
+
+    else {
+
+        if (!box_btree_io(tree, page, frame->data, false)) {
+
+            tree->failed = true;
+            return -1;
+        }
+
+        tree->stats.reads++;
+    }
+
+    frame->page = page;
+    frame->pins = 1;
+    frame->dirty = fresh;
+    frame->referenced = true;
+    frame->next = tree->buckets[bucket];
+    tree->buckets[bucket] = i;
+
+    return i;
+}
+
+
+static void box_btree_unpin(box_btree *tree, int frame)
+{
+
+    tree->frames[frame].pins--;
+}
+
+
+static int box_btree_new_page(box_btree *tree, unsigned int level)
+{
+
+    box_btree_page_header *header = NULL;
+    unsigned int page = tree->meta.free_list;
+    int frame = -1;
+
+    if (page != 0) {
+
+        frame = box_btree_fetch(tree, page, false);
+
+        if (frame < 0) {
+
+            return -1;
+        }
+
+        tree->meta.free_list = box_btree_header(tree, frame)->next;
+        tree->frames[frame].dirty = true;
+
+        memset(tree->frames[frame].data, 0, BOX_BTREE_PAGE_SIZE);
+    }
+
+    else {
+
+        if (tree->meta.page_count == UINT_MAX) {
+
+            return -1;
+        }
+
+        frame = box_btree_fetch(tree, tree->meta.page_count, true);
+
+        if (frame < 0) {
+
+            return -1;
+        }
+
+        tree->meta.page_count++;
+    }
+
+    header = box_btree_header(tree, frame);
+    header->level = level;
+
+    return frame;
+}
+
+
+static void box_btree_free_page(box_btree *tree, int frame)
+{
+
+    box_btree_page_header *header = box_btree_header(tree, frame);
+
+    header->count = 0;
+    header->next = tree->meta.free_list;
+
+    tree->meta.free_list = tree->frames[frame].page;
+    tree->frames[frame].dirty = true;
+}
+
+
+static unsigned int box_btree_position(box_btree *tree, int frame, box_dim side_square, box_dim height)
+{
+
+    box_btree_page_header *header = box_btree_header(tree, frame);
+    box_snapshot_record *records = box_btree_records(tree, frame);
+    box_btree_child *children = box_btree_children(tree, frame);
+    unsigned int low = 0;
+    unsigned int high = header->count;
+    unsigned int middle = 0;
+
+    if (header->level == 0) {
+
+        while (low < high) {
+
+            middle = low + (high - low) / 2;
+
+            if (box_btree_compare(records[middle].side_square, records[middle].height, side_square, height) < 0) {
+
+                low = middle + 1;
+            }
+
+            else {
+
+                high = middle;
+            }
+        }
+
+        return low;
+    }
+
+    /* The key of the first child is never compared - a key smaller than all the keys goes under it too. */
+
+    low = 1;
+
+    while (low < high) {
+
+        middle = low + (high - low) / 2;
+
+        if (box_btree_compare(children[middle].side_square, children[middle].height, side_square, height) <= 0) {
+
+            low = middle + 1;
+        }
+
+        else {
+
+            high = middle;
+        }
+    }
+
+    return low - 1;
+}
+
+
+static box_dim box_btree_page_max(box_btree *tree, int frame)
+{
+
+    box_btree_page_header *header = box_btree_header(tree, frame);
+    box_snapshot_record *records = box_btree_records(tree, frame);
+    box_btree_child *children = box_btree_children(tree, frame);
+    box_dim max_height = 0;
+    unsigned int i = 0;
+
+    for (i = 0; i < header->count; ++i) {
+
+        if (header->level == 0) {
+
+            max_height = (records[i].height > max_height) ? records[i].height : max_height;
+        }
+
+        else {
+
+            max_height = (children[i].max_height > max_height) ? children[i].max_height : max_height;
+        }
+    }
+
+    return max_height;
+}
+
+
+static bool box_btree_descend(box_btree *tree, box_dim side_square, box_dim height, box_btree_path path[])
+{
+
+    box_btree_page_header *header = NULL;
+    unsigned int page = tree->meta.root;
+    unsigned int level = tree->meta.levels;
+    int frame = -1;
+
+    while (level > 0) {
+
+        level--;
+
+        frame = box_btree_fetch(tree, page, false);
+
+        if (frame < 0) {
+
+            box_btree_release(tree, path, level + 1, tree->meta.levels);
+            return false;
+        }
+
+        header = box_btree_header(tree, frame);
+        path[level].frame = frame;
+
+        /* A page of another level, or with more entries than a page holds, isn't a page of this tree. */
+
+        if ((header->level != level) || (header->count > ((level == 0) ? BOX_BTREE_LEAF_CAPACITY : BOX_BTREE_INNER_CAPACITY)) ||
+            ((level > 0) && (header->count == 0))) {
+
+            tree->failed = true;
+
+            box_btree_release(tree, path, level, tree->meta.levels);
+            return false;
+        }
+
+        path[level].index = box_btree_position(tree, frame, side_square, height);
+
+        if (level > 0) {
+
+            page = box_btree_children(tree, frame)[path[level].index].page;
+        }
+    }
+
+    return true;
+}
+
+
+static void box_btree_release(box_btree *tree, box_btree_path path[], unsigned int from, unsigned int to)
+{
+
+    unsigned int level = 0;
+
+    for (level = from; level < to; ++level) {
+
+        box_btree_unpin(tree, path[level].frame);
+    }
+}
+
+
+static bool box_btree_rightmost(box_btree *tree, box_btree_path path[], unsigned int from, unsigned int levels)
+{
+
+    unsigned int level = 0;
+
+    for (level = from; level < levels; ++level) {
+
+        if (path[level].index + 1 != box_btree_header(tree, path[level].frame)->count) {
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static void box_btree_put_record(box_btree *tree, int frame, unsigned int position, box_dim side_square, box_dim height, unsigned int count)
+{
+
+    box_btree_page_header *header = box_btree_header(tree, frame);
+    box_snapshot_record *records = box_btree_records(tree, frame);
+
+    memmove(&(records[position + 1]), &(records[position]), sizeof(box_snapshot_record) * (header->count - position));
+    memset(&(records[position]), 0, sizeof(box_snapshot_record));
+
+    records[position].side_square = side_square;
+    records[position].height = height;
+    records[position].count = count;
+
+    header->count++;
+    tree->frames[frame].dirty = true;
+}
+
+
+static void box_btree_put_child(box_btree *tree, int frame, unsigned int position, const box_btree_child *entry)
+{
+
+    box_btree_page_header *header = box_btree_header(tree, frame);
+    box_btree_child *children = box_btree_children(tree, frame);
+
+    memmove(&(children[position + 1]), &(children[position]), sizeof(box_btree_child) * (header->count - position));
+
+    children[position] = *entry;
+
+    header->count++;
+    tree->frames[frame].dirty = true;
+}
+
+
+bool box_btree_insert(box_btree *tree, box_dim side_square, box_dim height, unsigned int count)
+{
+
+    box_btree_path path[BOX_BTREE_MAX_LEVELS];
+    box_snapshot_record *record = NULL;
+    box_btree_child *child = NULL;
+    unsigned int levels = tree->meta.levels;
+    unsigned int level = 0;
+    bool inserted = false;
+
+    if (!box_btree_descend(tree, side_square, height, path)) {
+
+        return false;
+    }
+
+    record = &(box_btree_records(tree, path[0].frame)[path[0].index]);
+
+    if ((path[0].index < box_btree_header(tree, path[0].frame)->count) && (record->side_square == side_square) && (record->height == height)) {
+
+        inserted = (record->count <= UINT_MAX - count);
+
+        if (inserted) {
+
+            record->count += count;
+            tree->frames[path[0].frame].dirty = true;
+            tree->meta.box_count += count;
+        }
+
+        box_btree_release(tree, path, 0, levels);
+
+        return inserted;
+    }
+
+    /* A new size - it goes under every child of the path, so their maximal heights are raised first (a split computes the maximal heights of its
+     halves again.) */
+
+    for (level = 1; level < levels; ++level) {
+
+        child = &(box_btree_children(tree, path[level].frame)[path[level].index]);
+
+        if (child->max_height < height) {
+
+            child->max_height = height;
+            tree->frames[path[level].frame].dirty = true;
+        }
+    }
+
+    inserted = box_btree_insert_record(tree, path, side_square, height, count);
+
+    box_btree_release(tree, path, 0, levels);
+
+    if (inserted) {
+
+        tree->meta.record_count++;
+        tree->meta.box_count += count;
+    }
+
+    return inserted;
+}
+
+
+static bool box_btree_insert_record(box_btree *tree, box_btree_path path[], box_dim side_square, box_dim height, unsigned int count)
+{
+
+    int frame = path[0].frame;
+    box_btree_page_header *header = box_btree_header(tree, frame);
+    box_btree_child entry;
+    unsigned int position = path[0].index;
+    unsigned int split = 0;
+    int right = -1;
+    bool inserted = false;
+
+    if (header->count < BOX_BTREE_LEAF_CAPACITY) {
+
+        box_btree_put_record(tree, frame, position, side_square, height, count);
+
+        return true;
+    }
+
+    /* The leaf is full - its upper half moves to a new leaf. A size inserted at the end of the tree moves nothing, so the leaves of sizes inserted in
+     increasing order are full. */
+
+    right = box_btree_new_page(tree, 0);
+
+    if (right < 0) {
+
+        return false;
+    }
+
+    split = ((position == header->count) && box_btree_rightmost(tree, path, 1, tree->meta.levels)) ? header->count : header->count / 2;
+
+    memcpy(box_btree_records(tree, right), &(box_btree_records(tree, frame)[split]), sizeof(box_snapshot_record) * (header->count - split));
+
+    box_btree_header(tree, right)->count = header->count - split;
+    header->count = split;
+    tree->frames[frame].dirty = true;
+
+    if (position < split) {
+
+        box_btree_put_record(tree, frame, position, side_square, height, count);
+    }
+
+    else {
+
+        box_btree_put_record(tree, right, position - split, side_square, height, count);
+    }
+
+    memset(&entry, 0, sizeof(entry));
+
+    entry.side_square = box_btree_records(tree, right)[0].side_square;
+    entry.height = box_btree_records(tree, right)[0].height;
+    entry.max_height = box_btree_page_max(tree, right);
+    entry.page = tree->frames[right].page;
+
+    if (tree->meta.levels > 1) {
+
+        box_btree_children(tree, path[1].frame)[path[1].index].max_height = box_btree_page_max(tree, frame);
+        tree->frames[path[1].frame].dirty = true;
+    }
+
+    inserted = box_btree_insert_child(tree, path, 1, &entry);
+
+    box_btree_unpin(tree, right);
+
+    return inserted;
+}
+
+
+static bool box_btree_insert_child(box_btree *tree, box_btree_path path[], unsigned int level, const box_btree_child *entry)
+{
+
+    box_btree_page_header *header = NULL;
+    box_btree_child *children = NULL;
+    box_btree_child new_entry;
+    unsigned int position = 0;
+    unsigned int split = 0;
+    int frame = -1;
+    int right = -1;
+    bool inserted = false;
+
+    if (level == tree->meta.levels) {			/* The root was split - a new root gets the old one and the new page. */
+
+        frame = (level == BOX_BTREE_MAX_LEVELS) ? -1 : box_btree_new_page(tree, level);
+
+        if (frame < 0) {
+
+            return false;
+        }
+
+        children = box_btree_children(tree, frame);
+
+        memset(&(children[0]), 0, sizeof(box_btree_child));
+
+        children[0].max_height = box_btree_page_max(tree, path[level - 1].frame);
+        children[0].page = tree->frames[path[level - 1].frame].page;
+        children[1] = *entry;
+
+        box_btree_header(tree, frame)->count = 2;
+
+        tree->meta.root = tree->frames[frame].page;
+        tree->meta.levels++;
+
+        box_btree_unpin(tree, frame);
+
+        return true;
+    }
+
+    frame = path[level].frame;
+    header = box_btree_header(tree, frame);
+    position = path[level].index + 1;
+
+    if (header->count < BOX_BTREE_INNER_CAPACITY) {
+
+        box_btree_put_child(tree, frame, position, entry);
+
+        return true;
+    }
+
+    /* The page is full - split it like a leaf. */
+
+    right = box_btree_new_page(tree, level);
+
+    if (right < 0) {
+
+        return false;
+    }
+
+    split = ((position == header->count) && box_btree_rightmost(tree, path, level + 1, tree->meta.levels)) ? header->count : header->count / 2;
+
+    memcpy(box_btree_children(tree, right), &(box_btree_children(tree, frame)[split]), sizeof(box_btree_child) * (header->count - split));
+
+    box_btree_header(tree, right)->count = header->count - split;
+    header->count = split;
+    tree->frames[frame].dirty = true;
+
+    if (position < split) {
+
+        box_btree_put_child(tree, frame, position, entry);
+    }
+
+    else {
+
+        box_btree_put_child(tree, right, position - split, entry);
+    }
+
+    /* The first child of the new page wasn't the first child of the old one, so its key is the smallest key under the new page. */
+
+    new_entry = box_btree_children(tree, right)[0];
+    new_entry.max_height = box_btree_page_max(tree, right);
+    new_entry.page = tree->frames[right].page;
+
+    if (level + 1 < tree->meta.levels) {
+
+        box_btree_children(tree, path[level + 1].frame)[path[level + 1].index].max_height = box_btree_page_max(tree, frame);
+        tree->frames[path[level + 1].frame].dirty = true;
+    }
+
+    inserted = box_btree_insert_child(tree, path, level + 1, &new_entry);
+
+    box_btree_unpin(tree, right);
+
+    return inserted;
+}
+
+
+bool box_btree_remove(box_btree *tree, box_dim side_square, box_dim height, unsigned int count, bool *last_unit)
+{
+
+    box_btree_path path[BOX_BTREE_MAX_LEVELS];
+    box_btree_page_header *header = NULL;
+    box_snapshot_record *record = NULL;
+    box_btree_child *child = NULL;
+    unsigned int levels = tree->meta.levels;
+    unsigned int level = 0;
+    int root = -1;
+    box_dim max_height = 0;
+
+    *last_unit = false;
+
+    if (!box_btree_descend(tree, side_square, height, path)) {
+
+        return false;
+    }
+
+    header = box_btree_header(tree, path[0].frame);
+    record = &(box_btree_records(tree, path[0].frame)[path[0].index]);
+
+    if ((path[0].index == header->count) || (record->side_square != side_square) || (record->height != height) || (record->count < count)) {
+
+        box_btree_release(tree, path, 0, levels);
+        return false;
+    }
+
+    record->count -= count;
+    tree->frames[path[0].frame].dirty = true;
+    tree->meta.box_count -= count;
+
+    if (record->count > 0) {
+
+        box_btree_release(tree, path, 0, levels);
+        return true;
+    }
+
+    *last_unit = true;
+
+    memmove(record, record + 1, sizeof(box_snapshot_record) * (header->count - path[0].index - 1));
+    header->count--;
+    tree->meta.record_count--;
+
+    /* Free the pages which were emptied, up to the root (which is kept), and drop their entries from their parents. */
+
+    for (level = 0; (level + 1 < levels) && (box_btree_header(tree, path[level].frame)->count == 0); ++level) {
+
+        box_btree_free_page(tree, path[level].frame);
+
+        header = box_btree_header(tree, path[level + 1].frame);
+        child = box_btree_children(tree, path[level + 1].frame);
+
+        memmove(&(child[path[level + 1].index]), &(child[path[level + 1].index + 1]),
+                sizeof(box_btree_child) * (header->count - path[level + 1].index - 1));
+
+        header->count--;
+        tree->frames[path[level + 1].frame].dirty = true;
+    }
+
+    /* The maximal heights of the children of the path may have dropped - up to the first one which didn't change. */
+
+    for (; level + 1 < levels; ++level) {
+
+        child = &(box_btree_children(tree, path[level + 1].frame)[path[level + 1].index]);
+        max_height = box_btree_page_max(tree, path[level].frame);
+
+        if (child->max_height == max_height) {
+
+            break;
+        }
+
+        child->max_height = max_height;
+        tree->frames[path[level + 1].frame].dirty = true;
+    }
+
+    /* An inner root without children is an empty tree again, and an inner root with a single child is replaced by the child. */
+
+    root = path[tree->meta.levels - 1].frame;
+
+    if ((tree->meta.levels > 1) && (box_btree_header(tree, root)->count == 0)) {
+
+        box_btree_header(tree, root)->level = 0;
+        tree->meta.levels = 1;
+    }
+
+    while ((tree->meta.levels > 1) && (box_btree_header(tree, root)->count == 1)) {
+
+        tree->meta.root = box_btree_children(tree, root)[0].page;
+        tree->meta.levels--;
+
+        box_btree_free_page(tree, root);
+
+        root = path[tree->meta.levels - 1].frame;
+    }
+
+    box_btree_release(tree, path, 0, levels);
+
+    return true;
+}
+
+
+unsigned int box_btree_instances(box_btree *tree, box_dim side_square, box_dim height)
+{
+
+    box_btree_path path[BOX_BTREE_MAX_LEVELS];
+    box_snapshot_record *record = NULL;
+    unsigned int levels = tree->meta.levels;
+    unsigned int count = 0;
+
+    if (!box_btree_descend(tree, side_square, height, path)) {
+
+        return 0;
+    }
+
+    record = &(box_btree_records(tree, path[0].frame)[path[0].index]);
+
+    if ((path[0].index < box_btree_header(tree, path[0].frame)->count) && (record->side_square == side_square) && (record->height == height)) {
+
+        count = record->count;
+    }
+
+    box_btree_release(tree, path, 0, levels);
+
+    return count;
+}
+
+
+static bool box_btree_scan_page(box_btree *tree, unsigned int page, unsigned int level, box_dim side_square, box_dim height, box_btree_visit visit,
+                                void *context, bool *stopped)
+{
+
+    box_btree_page_header *header = NULL;
+    box_snapshot_record *records = NULL;
+    box_btree_child *children = NULL;
+    unsigned int i = 0;
+    bool scanned = true;
+    int frame = box_btree_fetch(tree, page, false);
+
+    if (frame < 0) {
+
+        return false;
+    }
+
+    header = box_btree_header(tree, frame);
+    records = box_btree_records(tree, frame);
+    children = box_btree_children(tree, frame);
+
+    if ((header->level != level) || (header->count > ((level == 0) ? BOX_BTREE_LEAF_CAPACITY : BOX_BTREE_INNER_CAPACITY))) {
+
+        tree->failed = true;
+
+        box_btree_unpin(tree, frame);
+        return false;
+    }
+
+    /* Only the first entry of a page may have keys smaller than the given one under it - the entries from then on are visited as they are. */
+
+    for (i = box_btree_position(tree, frame, side_square, height); (i < header->count) && scanned && !*stopped; ++i) {
+
+        if (level == 0) {
+
+            if (records[i].height >= height) {
+
+                *stopped = !visit(context, &(records[i]));
+            }
+        }
+
+        else {
+
+            if (children[i].max_height >= height) {			/* A subtree without a suitable height is skipped. */
+
+                scanned = box_btree_scan_page(tree, children[i].page, level - 1, side_square, height, visit, context, stopped);
+            }
+        }
+    }
+
+    box_btree_unpin(tree, frame);
+
+    return scanned;
+}
+
+
+bool box_btree_scan(box_btree *tree, box_dim side_square, box_dim height, box_btree_visit visit, void *context)
+{
+
+    bool stopped = false;
+
+    return !tree->failed && box_btree_scan_page(tree, tree->meta.root, tree->meta.levels - 1, side_square, height, visit, context, &stopped);
+}
+
+
+static bool box_btree_take_first(void *context, const box_snapshot_record *record)
+{
+
+    *((box_snapshot_record *) context) = *record;
+
+    return false;
+}
+
+
+static bool box_btree_next(box_btree *tree, box_dim side_square, box_dim height, box_snapshot_record *record)
+{
+
+    record->count = 0;			/* Every size in the tree has boxes - a count of 0 means none was visited. */
+
+    return box_btree_scan(tree, side_square, height, box_btree_take_first, record) && (record->count > 0);
+}
+
+
+bool box_btree_get(box_btree *tree, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    box_snapshot_record record;
+    box_volume volume = 0;
+    box_volume min_volume = 0;
+    bool found = false;
+
+    /* The first suitable size of a side is the smallest suitable volume of the side - so the scan jumps from side to side, like box_snapshot_get. It
+     stops once the volume of the side with the given height can't be smaller than the minimal volume found. */
+
+    while (box_btree_next(tree, side_square, height, &record)) {
+
+        if (found && (min_volume <= (box_volume) record.side_square * height)) {
+
+            break;
+        }
+
+        volume = (box_volume) record.side_square * record.height;
+
+        if (!found || (min_volume > volume)) {
+
+            found = true;
+            min_volume = volume;
+            *found_side_square = record.side_square;
+            *found_height = record.height;
+        }
+
+        if (record.side_square == (box_dim) -1) {			/* The last possible side. */
+
+            break;
+        }
+
+        side_square = record.side_square + 1;
+    }
+
+    return found && !tree->failed;
+}
+
+
+bool box_btree_check(box_btree *tree, box_dim side_square, box_dim height)
+{
+
+    box_snapshot_record record;
+
+    return box_btree_next(tree, side_square, height, &record);
+}
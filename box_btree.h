@@ -0,0 +1,176 @@
+/* Box B+-tree header file.
+ Contains the structures and functions' prototype declarations of the disk-backed index of a box factory - a B+-tree of the sizes of the boxes in a
+ file of fixed-size pages, for inventories larger than the memory the process may use.
+ The leaves hold the sizes ((side * side), height and the number of boxes of that size - box_snapshot_record) in the order of (side * side) and then
+ of the height, like tree_by_side of a box factory with its subtrees. Every entry of an inner page holds the smallest key of its child (the key of the
+ first entry of a page is never compared), and the maximal height of the sizes under it - so CHECKBOX and GETBOX skip the subtrees which have no
+ suitable height, like the maximal heights of the subtrees of tree_by_side.
+ The pages are read and written through a buffer pool of a fixed number of frames, set by a memory budget - the rest of the tree stays in the file.
+ The frames are replaced by the clock algorithm, which passes over the frames of the inner pages as long as a frame of a leaf may be replaced, so the
+ upper levels of the tree stay resident and a query reads at most the leaves it visits. Changed pages are written once they are replaced, or by
+ box_btree_flush.
+ An insertion splits the pages which overflow (a page which overflows at the end of the tree keeps all its entries, so sizes inserted in increasing
+ order fill the pages); a removal frees the pages it empties only, and the root which is left with a single child - the pages aren't merged.
+ The file isn't durable by itself - a box factory keeps its boxes durable by its snapshot and write-ahead log. A file closed by box_btree_close may be
+ opened again; a file of a process which didn't close it is refused. The numbers are in the byte order of the machine, and the files of the 32-bit
+ and of the 64-bit build aren't interchangeable (see box_types.h.) */
+
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include "box_types.h"
+
+#include "box_snapshot.h"
+
+#ifndef BOX_BTREE_H_
+#define BOX_BTREE_H_
+
+
+#define BOX_BTREE_MAGIC 0x0045455254425842ULL			/* "BXBTREE" */
+
+#define BOX_BTREE_VERSION 1
+
+#define BOX_BTREE_PAGE_SIZE 4096
+
+#define BOX_BTREE_MIN_FRAMES 32			/* The frames of the smallest buffer pool - an operation pins a page of every level, and two new pages. */
+
+#define BOX_BTREE_MAX_LEVELS 16
+
+
+typedef struct box_btree_meta_s {			/* The first page of the file. */
+
+    unsigned long long magic;
+    unsigned int version;
+    unsigned int dim_size;			/* sizeof(box_dim) of the writer. */
+    unsigned int page_size;
+    unsigned int clean;			/* 1 if the file was closed by box_btree_close, 0 while it's open. */
+    unsigned int root;
+    unsigned int levels;			/* The leaves are level 0 - the root is at level (levels - 1.) */
+    unsigned int page_count;			/* Number of the pages of the file, including this one. */
+    unsigned int free_list;			/* The freed pages, linked by next of their header (0 ends the list.) */
+    unsigned long long record_count;			/* Number of the different sizes. */
+    unsigned long long box_count;
+} box_btree_meta;
+
+
+typedef struct box_btree_page_header_s {			/* The start of every page but the first. */
+
+    unsigned int level;
+    unsigned int count;			/* Number of the entries of the page. */
+    unsigned int next;			/* A freed page - the next page of the free list. */
+    unsigned int reserved;
+} box_btree_page_header;
+
+
+typedef struct box_btree_child_s {			/* An entry of an inner page. */
+
+    box_dim side_square;			/* The smallest key of the child - every key under the child is at least this one. */
+    box_dim height;
+    box_dim max_height;			/* The maximal height of the sizes under the child. */
+    unsigned int page;
+} box_btree_child;
+
+
+#define BOX_BTREE_LEAF_CAPACITY ((unsigned int) ((BOX_BTREE_PAGE_SIZE - sizeof(box_btree_page_header)) / sizeof(box_snapshot_record)))
+
+#define BOX_BTREE_INNER_CAPACITY ((unsigned int) ((BOX_BTREE_PAGE_SIZE - sizeof(box_btree_page_header)) / sizeof(box_btree_child)))
+
+
+typedef struct box_btree_frame_s {			/* A frame of the buffer pool. */
+
+    unsigned int page;			/* The page in the frame, 0 for an unused frame (the first page is kept in meta of the tree.) */
+    unsigned int pins;			/* Number of the users of the page - a pinned frame isn't replaced. */
+    bool dirty;			/* TRUE if the page was changed since it was read. */
+    bool referenced;			/* The bit of the clock - TRUE if the page was used since the hand passed it. */
+    int next;			/* The next frame of the same bucket of the hash table of the pages, -1 at the end. */
+    unsigned char *data;
+} box_btree_frame;
+
+
+typedef struct box_btree_stats_s {			/* Counters of a tree since it was created or opened. */
+
+    unsigned long long hits;			/* Pages found in the buffer pool. */
+    unsigned long long reads;			/* Pages read from the file. */
+    unsigned long long writes;			/* Pages written to the file. */
+    unsigned long long evictions;			/* Pages replaced in the buffer pool. */
+} box_btree_stats;
+
+
+typedef struct box_btree_s {			/* Box B+-tree structure. */
+
+    int fd;
+    box_btree_meta meta;			/* The first page - written by box_btree_flush. */
+    box_btree_frame *frames;
+    unsigned int frame_count;
+    unsigned char *memory;			/* The pages of all the frames. */
+    int *buckets;			/* The hash table of the pages in the buffer pool - the first frame of every bucket, -1 for none. */
+    unsigned int bucket_mask;
+    unsigned int hand;			/* The hand of the clock. */
+    bool failed;			/* TRUE after an I/O error or an invalid page - every operation fails from then on. */
+    box_btree_stats stats;
+} box_btree;
+
+
+/* Visiting function of box_btree_scan. Returns FALSE to stop the scan, TRUE to go on. */
+
+typedef bool (*box_btree_visit)(void *context, const box_snapshot_record *record);
+
+
+/* Create an empty tree in the file of the given path (an existing file is replaced), with a buffer pool of the given number of bytes (at least
+ BOX_BTREE_MIN_FRAMES pages.) Returns NULL on an allocation error or an I/O error, otherwise returns a pointer to box_btree. */
+
+box_btree* box_btree_create(const char *path, size_t memory);
+
+
+/* Open the tree of the file of the given path, which was closed by box_btree_close, with a buffer pool of the given number of bytes.
+ Returns NULL on an allocation error, an I/O error, an invalid file or a file which wasn't closed, otherwise returns a pointer to box_btree. */
+
+box_btree* box_btree_open(const char *path, size_t memory);
+
+
+/* Write the changed pages and the first page of the tree. Returns FALSE on an I/O error, TRUE otherwise. */
+
+bool box_btree_flush(box_btree *tree);
+
+
+/* Flush the tree, mark its file as closed (unless the tree failed), close it and free the structure. */
+
+void box_btree_close(box_btree *tree);
+
+
+/* Add the given number of boxes of the given dimensions ((side * side) and height.)
+ Returns FALSE on an allocation error or an I/O error, TRUE otherwise. */
+
+bool box_btree_insert(box_btree *tree, box_dim side_square, box_dim height, unsigned int count);
+
+
+/* Remove the given number of boxes of the given dimensions. last_unit would be TRUE if no box of the dimensions is left.
+ Returns FALSE if there are less boxes of the given dimensions (nothing is removed then), or on an I/O error, TRUE otherwise. */
+
+bool box_btree_remove(box_btree *tree, box_dim side_square, box_dim height, unsigned int count, bool *last_unit);
+
+
+/* Return the number of boxes of the given dimensions (0 on an I/O error.) */
+
+unsigned int box_btree_instances(box_btree *tree, box_dim side_square, box_dim height);
+
+
+/* Visit the sizes whose (side * side) is at least the given one and whose height is at least the given height, in the order of the tree, until the
+ visiting function returns FALSE. Returns FALSE on an I/O error, TRUE otherwise. */
+
+bool box_btree_scan(box_btree *tree, box_dim side_square, box_dim height, box_btree_visit visit, void *context);
+
+
+/* GETBOX over the tree - the same as box_factory_get_box. Returns FALSE if there's no suitable box (or on an I/O error), TRUE otherwise. */
+
+bool box_btree_get(box_btree *tree, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height);
+
+
+/* CHECKBOX over the tree - the same as box_factory_check_box. */
+
+bool box_btree_check(box_btree *tree, box_dim side_square, box_dim height);
+
+
+#endif /* BOX_BTREE_H_ */
@@ -0,0 +1,142 @@
+/*
+ Box cache source file.
+ Here we implement the GETBOX result cache of the box factory.
+ */
+
+
+#include <stdbool.h>
+
+#include <string.h>
+
+#include "box_cache.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the index of the slot of the given query in the cache. */
+
+static unsigned int box_cache_slot(box_dim side_square, box_dim height);
+
+
+/* Invalidate the given entry and count the invalidation. */
+
+static void box_cache_invalidate(box_cache *cache, box_cache_entry *entry);
+
+
+/* The implementation: */
+
+
+static unsigned int box_cache_slot(box_dim side_square, box_dim height)
+{
+
+    box_dim hash = (side_square * 2654435761u) ^ (height * 2246822519u);			/* Multiplicative hashing of both dimensions. */
+
+    return (unsigned int) (hash ^ (hash >> 16)) & (BOX_CACHE_SIZE - 1);
+}
+
+
+static void box_cache_invalidate(box_cache *cache, box_cache_entry *entry)
+{
+
+    entry->valid = false;
+
+    cache->valid_count--;
+    cache->stats.invalidations++;
+}
+
+
+void box_cache_init(box_cache *cache)
+{
+
+    memset(cache, 0, sizeof(box_cache));
+}
+
+
+bool box_cache_lookup(box_cache *cache, box_dim side_square, box_dim height, bool *found, box_dim *found_side_square,
+                      box_dim *found_height)
+{
+
+    box_cache_entry *entry = &(cache->entries[box_cache_slot(side_square, height)]);
+
+    if (!entry->valid || (entry->side_square != side_square) || (entry->height != height)) {
+
+        cache->stats.misses++;
+
+        return false;
+    }
+
+    cache->stats.hits++;
+
+    *found = entry->found;
+    *found_side_square = entry->found_side_square;
+    *found_height = entry->found_height;
+
+    return true;
+}
+
+
+void box_cache_store(box_cache *cache, box_dim side_square, box_dim height, bool found, box_dim found_side_square,
+                     box_dim found_height)
+{
+
+    box_cache_entry *entry = &(cache->entries[box_cache_slot(side_square, height)]);
+
+    if (!entry->valid) {
+
+        cache->valid_count++;
+    }
+
+    entry->side_square = side_square;
+    entry->height = height;
+    entry->found = found;
+    entry->found_side_square = found_side_square;
+    entry->found_height = found_height;
+    entry->valid = true;
+}
+
+
+void box_cache_on_insert(box_cache *cache, box_dim side_square, box_dim height)
+{
+
+    box_cache_entry *entry = NULL;
+    box_volume volume = (box_volume) side_square * height;
+    unsigned int i = 0;
+
+    for (i = 0; (i < BOX_CACHE_SIZE) && (cache->valid_count > 0); ++i) {
+
+        entry = &(cache->entries[i]);
+
+        /* Skip the entries for which the new box isn't suitable (it doesn't dominate the query.) */
+
+        if (!entry->valid || (side_square < entry->side_square) || (height < entry->height)) {
+
+            continue;
+        }
+
+        /* A new box of the same volume also invalidates the entry, because GETBOX may now prefer it, depending on the traversed main tree. */
+
+        if (!entry->found || (volume <= (box_volume) entry->found_side_square * entry->found_height)) {
+
+            box_cache_invalidate(cache, entry);
+        }
+    }
+}
+
+
+void box_cache_on_remove(box_cache *cache, box_dim side_square, box_dim height)
+{
+
+    box_cache_entry *entry = NULL;
+    unsigned int i = 0;
+
+    for (i = 0; (i < BOX_CACHE_SIZE) && (cache->valid_count > 0); ++i) {
+
+        entry = &(cache->entries[i]);
+
+        if (entry->valid && entry->found && (entry->found_side_square == side_square) && (entry->found_height == height)) {
+
+            box_cache_invalidate(cache, entry);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/* Box cache header file.
+ Contains macro definitions and functions' prototype declarations for the GETBOX result cache of the box factory.
+ The cache remembers the answers of recent GETBOX queries, keyed by the query dimensions ((side * side) and height), and is told by the box factory
+ about every insertion and removal, so it can drop only the answers that the change could affect. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#ifndef BOX_CACHE_H_
+#define BOX_CACHE_H_
+
+
+#define BOX_CACHE_SIZE 64			/* Number of cached GETBOX answers. Must be a power of 2. */
+
+
+typedef struct box_cache_entry_s {			/* A single cached GETBOX answer. */
+
+    box_dim side_square;			/* The query - (side * side) and height of the present. */
+    box_dim height;
+    box_dim found_side_square;		/* The answer - (side * side) and height of the box of the minimal suitable volume (if found is TRUE.) */
+    box_dim found_height;
+    bool found;
+    bool valid;			/* FALSE if the entry is empty or was invalidated. */
+} box_cache_entry;
+
+
+typedef struct box_cache_stats_s {			/* Counters of the cache, exposed through box_factory_cache_stats. */
+
+    unsigned long long hits;			/* Number of queries answered from the cache. */
+    unsigned long long misses;			/* Number of queries that had to scan the trees. */
+    unsigned long long invalidations;		/* Number of cached answers dropped because of an insertion or a removal. */
+} box_cache_stats;
+
+
+typedef struct box_cache_s {			/* Box cache structure. A direct-mapped table of cached answers. */
+
+    box_cache_entry entries[BOX_CACHE_SIZE];
+    unsigned int valid_count;			/* Number of valid entries - lets insertions and removals skip the scan of an empty cache. */
+    box_cache_stats stats;
+} box_cache;
+
+
+/* Initialize an empty cache with zeroed counters. */
+
+void box_cache_init(box_cache *cache);
+
+
+/* Look up the cached answer for the given query. Returns FALSE on a miss, TRUE on a hit - in which case found tells whether a suitable box exists,
+ and found_side_square and found_height contain its dimensions. Hits and misses are counted. */
+
+bool box_cache_lookup(box_cache *cache, box_dim side_square, box_dim height, bool *found, box_dim *found_side_square,
+                      box_dim *found_height);
+
+
+/* Store the answer of a GETBOX query which was computed from the trees, replacing whatever entry occupied its slot. */
+
+void box_cache_store(box_cache *cache, box_dim side_square, box_dim height, bool found, box_dim found_side_square,
+                     box_dim found_height);
+
+
+/* Notify the cache that a box of the given dimensions was inserted. A cached answer is invalidated only if the new box is suitable for the cached query,
+ and either no suitable box was found before, or the volume of the new box is not larger than the cached volume. */
+
+void box_cache_on_insert(box_cache *cache, box_dim side_square, box_dim height);
+
+
+/* Notify the cache that the last unit of a box of the given dimensions was removed. Only the cached answers pointing at this box are invalidated -
+ removing a box that still has instances left, or a box that is not a cached answer, can't change any cached answer. */
+
+void box_cache_on_remove(box_cache *cache, box_dim side_square, box_dim height);
+
+
+#endif /* BOX_CACHE_H_ */
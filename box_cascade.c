@@ -0,0 +1,621 @@
+/*
+ Box cascade source file.
+ Here we implement building the cascaded index of a main tree of the box factory, and GETBOX over it.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "rb_tree.h"
+
+#include "box_factory.h"
+
+#include "box_cascade.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Make sure the arrays of the cascade can hold the given numbers of main values and catalog values - they grow at least twice as large, so the
+ catalogs may grow while they are copied. Unless keep is TRUE, the values of the arrays aren't needed, and an array which grows is allocated anew
+ instead of being copied. Returns FALSE on an allocation error. */
+
+static bool box_cascade_reserve(box_cascade *cascade, unsigned int main_count, unsigned int catalog_count, bool keep);
+
+
+/* Go on with the rebuild of the cascade from the given main tree, by up to the given work (see BOX_CASCADE_BUILD_BUDGET), through its phases (see
+ box_cascade_phase.) Returns FALSE on an allocation error. */
+
+static bool box_cascade_build(box_cascade *cascade, rb_tree *main_tree, unsigned long long budget);
+
+
+/* The phase COUNT of the rebuild - count the values of the catalogs, from the node of the main tree the last part stopped at, by up to *budget work
+ (*budget is decreased by BOX_CASCADE_COPY_COST for every main value counted), and allocate the arrays for all of them once they are counted.
+ Returns FALSE on an allocation error. */
+
+static bool box_cascade_count(box_cascade *cascade, rb_tree *main_tree, unsigned long long *budget);
+
+
+/* The phase COPY of the rebuild - copy the main values and their catalogs, from the node of the main tree the last part stopped at, by up to *budget
+ work (*budget is decreased by BOX_CASCADE_COPY_COST for every main value and every catalog value copied.) Returns FALSE on an allocation error. */
+
+static bool box_cascade_copy(box_cascade *cascade, rb_tree *main_tree, unsigned long long *budget);
+
+
+/* The phases LENGTHS and STARTS of the rebuild, by up to *budget main values. */
+
+static void box_cascade_lengths(box_cascade *cascade, unsigned long long *budget);
+
+static void box_cascade_starts(box_cascade *cascade, unsigned long long *budget);
+
+
+/* The phase MERGE of the rebuild - build the augmented catalogs from the last one, each from its catalog and the next augmented catalog (which is built
+ already), by up to *budget values. The cascade is current once the first one is built. */
+
+static void box_cascade_merge(box_cascade *cascade, unsigned long long *budget);
+
+
+/* Start the merge of the augmented catalog of the last main value left (the merge begins at its start.) */
+
+static void box_cascade_merge_start(box_cascade *cascade);
+
+
+/* Return the number of the values of the given array which are smaller than val (binary search.) */
+
+static unsigned int box_cascade_lower_bound(box_dim *vals, unsigned int count, box_dim val);
+
+
+/* The implementation: */
+
+
+void box_cascade_init(box_cascade *cascade)
+{
+
+    memset(cascade, 0, sizeof(box_cascade));
+}
+
+
+void box_cascade_destroy(box_cascade *cascade)
+{
+
+    free(cascade->main_vals);
+    free(cascade->catalog_start);
+    free(cascade->catalog_vals);
+    free(cascade->augmented_start);
+    free(cascade->augmented_vals);
+    free(cascade->augmented_own);
+    free(cascade->augmented_next);
+
+    box_cascade_init(cascade);
+}
+
+
+void box_cascade_invalidate(box_cascade *cascade)
+{
+
+    /* The nodes of a partial rebuild may be gone - the rebuild starts over, after a new quiet period. The values it copied show the rebuild is at
+     least that large, so a main tree which changes faster than it can be rebuilt soon stops starting rebuilds. */
+
+    if ((cascade->phase != BOX_CASCADE_IDLE) && (cascade->catalog_count > cascade->rebuild_size)) {
+
+        cascade->rebuild_size = cascade->catalog_count;
+    }
+
+    cascade->current = false;
+    cascade->quiet_work = 0;
+    cascade->phase = BOX_CASCADE_IDLE;
+    cascade->build_main_node = NULL;
+    cascade->build_sub_node = NULL;
+}
+
+
+static bool box_cascade_reserve(box_cascade *cascade, unsigned int main_count, unsigned int catalog_count, bool keep)
+{
+
+    box_dim **main_val_arrays[] = {&(cascade->main_vals)};
+    unsigned int **main_arrays[] = {&(cascade->catalog_start), &(cascade->augmented_start)};
+    box_dim **catalog_val_arrays[] = {&(cascade->catalog_vals), &(cascade->augmented_vals)};
+    unsigned int **catalog_arrays[] = {&(cascade->augmented_own), &(cascade->augmented_next)};
+    box_dim *val_array = NULL;
+    unsigned int *array = NULL;
+    unsigned int capacity = 0;
+    unsigned int i = 0;
+
+    /* The starts have an extra element (the end of the last catalog), and an augmented catalog is less than twice as long as the catalogs.
+     The arrays of values hold dimensions, and the others hold positions. Arrays which are freed have no capacity until all of them are allocated
+     again. */
+
+    if (main_count + 1 > cascade->main_capacity) {
+
+        cascade->main_capacity = keep ? cascade->main_capacity : 0;
+
+        for (i = 0; i < sizeof(main_val_arrays) / sizeof(main_val_arrays[0]); ++i) {
+
+            if (!keep) {
+
+                free(*(main_val_arrays[i]));
+                *(main_val_arrays[i]) = NULL;
+            }
+
+            val_array = realloc(*(main_val_arrays[i]), sizeof(box_dim) * (main_count + 1));
+
+            if (val_array == NULL) {
+
+                return false;
+            }
+
+            *(main_val_arrays[i]) = val_array;
+        }
+
+        for (i = 0; i < sizeof(main_arrays) / sizeof(main_arrays[0]); ++i) {
+
+            if (!keep) {
+
+                free(*(main_arrays[i]));
+                *(main_arrays[i]) = NULL;
+            }
+
+            array = realloc(*(main_arrays[i]), sizeof(unsigned int) * (main_count + 1));
+
+            if (array == NULL) {
+
+                return false;
+            }
+
+            *(main_arrays[i]) = array;
+        }
+
+        cascade->main_capacity = main_count + 1;
+    }
+
+    if (2 * catalog_count > cascade->capacity) {
+
+        capacity = (keep && (2 * cascade->capacity > 2 * catalog_count)) ? 2 * cascade->capacity : 2 * catalog_count;
+        cascade->capacity = keep ? cascade->capacity : 0;
+
+        for (i = 0; i < sizeof(catalog_val_arrays) / sizeof(catalog_val_arrays[0]); ++i) {
+
+            if (!keep) {
+
+                free(*(catalog_val_arrays[i]));
+                *(catalog_val_arrays[i]) = NULL;
+            }
+
+            val_array = realloc(*(catalog_val_arrays[i]), sizeof(box_dim) * capacity);
+
+            if (val_array == NULL) {
+
+                return false;
+            }
+
+            *(catalog_val_arrays[i]) = val_array;
+        }
+
+        for (i = 0; i < sizeof(catalog_arrays) / sizeof(catalog_arrays[0]); ++i) {
+
+            if (!keep) {
+
+                free(*(catalog_arrays[i]));
+                *(catalog_arrays[i]) = NULL;
+            }
+
+            array = realloc(*(catalog_arrays[i]), sizeof(unsigned int) * capacity);
+
+            if (array == NULL) {
+
+                return false;
+            }
+
+            *(catalog_arrays[i]) = array;
+        }
+
+        cascade->capacity = capacity;
+    }
+
+    return true;
+}
+
+
+static bool box_cascade_count(box_cascade *cascade, rb_tree *main_tree, unsigned long long *budget)
+{
+
+    main_tree_key smallest_main_key = {.val = 0, .subtree = NULL};
+
+    while ((cascade->build_main_node != NULL) && (*budget > 0)) {
+
+        cascade->build_index += ((main_tree_key *) cascade->build_main_node->key)->subtree->count;
+        cascade->build_main_node = rb_tree_successor(main_tree, cascade->build_main_node);
+        *budget = (*budget > BOX_CASCADE_COPY_COST) ? *budget - BOX_CASCADE_COPY_COST : 0;
+    }
+
+    if (cascade->build_main_node == NULL) {
+
+        /* Growing the arrays while they are copied would copy them again at once, in a single part - they are allocated for all the values now,
+         while they hold nothing that is needed. */
+
+        if (!box_cascade_reserve(cascade, main_tree->count, cascade->build_index, false)) {
+
+            return false;
+        }
+
+        cascade->rebuild_size = cascade->build_index;
+
+        cascade->phase = BOX_CASCADE_COPY;
+        cascade->main_count = 0;
+        cascade->catalog_count = 0;
+        cascade->build_main_node = rb_tree_search_smallest_from(main_tree, &smallest_main_key);
+        cascade->build_sub_node = NULL;
+    }
+
+    return true;
+}
+
+
+static bool box_cascade_copy(box_cascade *cascade, rb_tree *main_tree, unsigned long long *budget)
+{
+
+    subtree_key smallest_sub_key = {.val = 0};
+    main_tree_key *main_key = NULL;
+
+    while ((cascade->build_main_node != NULL) && (*budget > 0)) {
+
+        main_key = cascade->build_main_node->key;
+
+        if (cascade->build_sub_node == NULL) {			/* Start the catalog of the main node. */
+
+            cascade->main_vals[cascade->main_count] = main_key->val;
+            cascade->catalog_start[cascade->main_count] = cascade->catalog_count;
+            cascade->main_count++;
+            cascade->build_sub_node = rb_tree_search_smallest_from(main_key->subtree, &smallest_sub_key);
+            *budget = (*budget > BOX_CASCADE_COPY_COST) ? *budget - BOX_CASCADE_COPY_COST : 0;
+        }
+
+        if (cascade->build_sub_node != NULL) {
+
+            if (!box_cascade_reserve(cascade, main_tree->count, cascade->catalog_count + 1, true)) {
+
+                return false;
+            }
+
+            cascade->catalog_vals[cascade->catalog_count++] = ((subtree_key *) cascade->build_sub_node->key)->val;
+            cascade->build_sub_node = rb_tree_successor(main_key->subtree, cascade->build_sub_node);
+            *budget = (*budget > BOX_CASCADE_COPY_COST) ? *budget - BOX_CASCADE_COPY_COST : 0;
+        }
+
+        if (cascade->build_sub_node == NULL) {			/* The catalog is complete - go on to the next main node. */
+
+            cascade->build_main_node = rb_tree_successor(main_tree, cascade->build_main_node);
+        }
+    }
+
+    if (cascade->build_main_node == NULL) {
+
+        cascade->catalog_start[cascade->main_count] = cascade->catalog_count;
+
+        cascade->phase = BOX_CASCADE_LENGTHS;
+        cascade->build_index = cascade->main_count;
+        cascade->build_length = 0;
+    }
+
+    return true;
+}
+
+
+static void box_cascade_lengths(box_cascade *cascade, unsigned long long *budget)
+{
+
+    unsigned int i = 0;
+
+    /* The lengths of the augmented catalogs depend on the following ones - compute them from the last one, into the starts. */
+
+    while ((cascade->build_index > 0) && (*budget > 0)) {
+
+        i = --(cascade->build_index);
+
+        cascade->build_length = cascade->catalog_start[i + 1] - cascade->catalog_start[i] + cascade->build_length / 2;
+        cascade->augmented_start[i] = cascade->build_length;
+        (*budget)--;
+    }
+
+    if (cascade->build_index == 0) {
+
+        cascade->phase = BOX_CASCADE_STARTS;
+        cascade->augmented_count = 0;
+    }
+}
+
+
+static void box_cascade_starts(box_cascade *cascade, unsigned long long *budget)
+{
+
+    unsigned int length = 0;
+
+    while ((cascade->build_index < cascade->main_count) && (*budget > 0)) {
+
+        length = cascade->augmented_start[cascade->build_index];
+        cascade->augmented_start[cascade->build_index] = cascade->augmented_count;
+        cascade->augmented_count += length;
+        cascade->build_index++;
+        (*budget)--;
+    }
+
+    if (cascade->build_index == cascade->main_count) {
+
+        cascade->augmented_start[cascade->main_count] = cascade->augmented_count;
+
+        cascade->phase = BOX_CASCADE_MERGE;
+        box_cascade_merge_start(cascade);
+    }
+}
+
+
+static void box_cascade_merge_start(box_cascade *cascade)
+{
+
+    cascade->merge_catalog_pos = 0;
+    cascade->merge_promoted_pos = 1;			/* The values at the odd positions of the next augmented catalog are promoted to this one. */
+    cascade->merge_next_pos = 0;
+    cascade->merge_out = (cascade->build_index > 0) ? cascade->augmented_start[cascade->build_index - 1] : 0;
+}
+
+
+static void box_cascade_merge(box_cascade *cascade, unsigned long long *budget)
+{
+
+    unsigned int i = 0;
+    box_dim *catalog = NULL;
+    unsigned int catalog_length = 0;
+    box_dim *next = NULL;
+    unsigned int next_length = 0;
+    box_dim val = 0;
+    unsigned int own = 0;
+
+    while ((cascade->build_index > 0) && (*budget > 0)) {
+
+        i = cascade->build_index - 1;
+
+        catalog = &(cascade->catalog_vals[cascade->catalog_start[i]]);
+        catalog_length = cascade->catalog_start[i + 1] - cascade->catalog_start[i];
+        next = &(cascade->augmented_vals[cascade->augmented_start[i + 1]]);
+
+        /* The last augmented catalog has no next one - it is the last catalog itself. */
+
+        next_length = (i + 1 < cascade->main_count) ? cascade->augmented_start[i + 2] - cascade->augmented_start[i + 1] : 0;
+
+        /* Merge the catalog with the promoted values. On equal values the promoted one goes first, so the catalog values before any merged value are
+         always smaller than it, and its position in the catalog is simply the position of the merge in the catalog. */
+
+        while (((cascade->merge_catalog_pos < catalog_length) || (cascade->merge_promoted_pos < next_length)) && (*budget > 0)) {
+
+            if ((cascade->merge_catalog_pos == catalog_length) ||
+                ((cascade->merge_promoted_pos < next_length) && (next[cascade->merge_promoted_pos] <= catalog[cascade->merge_catalog_pos]))) {
+
+                val = next[cascade->merge_promoted_pos];
+                own = cascade->merge_catalog_pos;
+                cascade->merge_promoted_pos += 2;
+            }
+
+            else {
+
+                val = catalog[cascade->merge_catalog_pos];
+                own = cascade->merge_catalog_pos++;
+            }
+
+            /* The merged values are in order, so the position of the value in the next augmented catalog only moves forward. */
+
+            while ((cascade->merge_next_pos < next_length) && (next[cascade->merge_next_pos] < val)) {
+
+                cascade->merge_next_pos++;
+            }
+
+            cascade->augmented_vals[cascade->merge_out] = val;
+            cascade->augmented_own[cascade->merge_out] = own;
+            cascade->augmented_next[cascade->merge_out] = cascade->merge_next_pos;
+            cascade->merge_out++;
+            (*budget)--;
+        }
+
+        if ((cascade->merge_catalog_pos == catalog_length) && (cascade->merge_promoted_pos >= next_length)) {			/* Go on to the previous one. */
+
+            cascade->build_index--;
+            box_cascade_merge_start(cascade);
+        }
+    }
+
+    if (cascade->build_index == 0) {
+
+        cascade->phase = BOX_CASCADE_IDLE;
+        cascade->rebuild_size = cascade->catalog_count;
+        cascade->current = true;
+    }
+}
+
+
+static bool box_cascade_build(box_cascade *cascade, rb_tree *main_tree, unsigned long long budget)
+{
+
+    main_tree_key smallest_main_key = {.val = 0, .subtree = NULL};
+
+    if (cascade->phase == BOX_CASCADE_IDLE) {			/* Start the rebuild from the smallest main node. */
+
+        cascade->phase = BOX_CASCADE_COUNT;
+        cascade->build_index = 0;
+        cascade->build_main_node = rb_tree_search_smallest_from(main_tree, &smallest_main_key);
+    }
+
+    /* Every phase stops when the budget runs out, or goes on to the next one. */
+
+    if ((cascade->phase == BOX_CASCADE_COUNT) && !box_cascade_count(cascade, main_tree, &budget)) {
+
+        return false;
+    }
+
+    if ((cascade->phase == BOX_CASCADE_COPY) && !box_cascade_copy(cascade, main_tree, &budget)) {
+
+        return false;
+    }
+
+    if (cascade->phase == BOX_CASCADE_LENGTHS) {
+
+        box_cascade_lengths(cascade, &budget);
+    }
+
+    if (cascade->phase == BOX_CASCADE_STARTS) {
+
+        box_cascade_starts(cascade, &budget);
+    }
+
+    if (cascade->phase == BOX_CASCADE_MERGE) {
+
+        box_cascade_merge(cascade, &budget);
+    }
+
+    return true;
+}
+
+
+bool box_cascade_account(box_cascade *cascade, rb_tree *main_tree, unsigned int visited)
+{
+
+    unsigned int size = (cascade->rebuild_size > main_tree->count) ? cascade->rebuild_size : main_tree->count;
+
+    cascade->quiet_work += visited;
+
+    /* Rebuilding costs about as much as the number of values in the catalogs - don't start before the scans since the last change of the main tree
+     have done that much work. */
+
+    if ((cascade->phase == BOX_CASCADE_IDLE) && (cascade->quiet_work < size)) {
+
+        return true;
+    }
+
+    /* A short scan gains little from the cascade - it leaves the rebuild to the long ones, and keeps the tail of the short GETBOX queries short. */
+
+    if (visited < BOX_CASCADE_LONG_SCAN) {
+
+        return true;
+    }
+
+    /* The part of the rebuild doesn't grow with the scan - a long scan would pay for a long part on top of itself, and the tail of GETBOX with it. */
+
+    return box_cascade_build(cascade, main_tree, BOX_CASCADE_BUILD_BUDGET);
+}
+
+
+static unsigned int box_cascade_lower_bound(box_dim *vals, unsigned int count, box_dim val)
+{
+
+    unsigned int low = 0;
+    unsigned int high = count;
+    unsigned int middle = 0;
+
+    while (low < high) {
+
+        middle = low + (high - low) / 2;
+
+        if (vals[middle] < val) {
+
+            low = middle + 1;
+        }
+
+        else {
+
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+
+bool box_cascade_get(box_cascade *cascade, bool main_is_side, box_dim main_val, box_dim sub_val, box_dim *found_main_val, box_dim *found_sub_val)
+{
+
+    unsigned int i = box_cascade_lower_bound(cascade->main_vals, cascade->main_count, main_val);
+    unsigned int length = 0;
+    unsigned int next_length = 0;
+    unsigned int position = 0;
+    unsigned int own = 0;
+    unsigned int catalog_length = 0;
+
+    box_volume volume = 0;
+    box_volume min_volume = 0;
+    box_dim min_main_val = 0;
+    box_dim min_sub_val = 0;
+    bool found = false;
+
+    if (i == cascade->main_count) {
+
+        return false;
+    }
+
+    /* The only binary search for sub_val - in the augmented catalog of the first candidate main value. */
+
+    length = cascade->augmented_start[i + 1] - cascade->augmented_start[i];
+    position = box_cascade_lower_bound(&(cascade->augmented_vals[cascade->augmented_start[i]]), length, sub_val);
+
+    for (; i < cascade->main_count; ++i) {
+
+        /* The position of sub_val in the catalog of the current main value (the catalog's length if all its values are smaller.) */
+
+        catalog_length = cascade->catalog_start[i + 1] - cascade->catalog_start[i];
+        own = (position == length) ? catalog_length : cascade->augmented_own[cascade->augmented_start[i] + position];
+
+        if (own < catalog_length) {
+
+            volume = (box_volume) cascade->main_vals[i] * cascade->catalog_vals[cascade->catalog_start[i] + own];
+
+            /* Check whether we have found a new minimal volume - or, over the heights, the same volume with a smaller side. */
+
+            if (!found || (min_volume > volume) ||
+                (!main_is_side && (min_volume == volume) && (cascade->catalog_vals[cascade->catalog_start[i] + own] < min_sub_val))) {
+
+                min_volume = volume;
+                min_main_val = cascade->main_vals[i];
+                min_sub_val = cascade->catalog_vals[cascade->catalog_start[i] + own];
+                found = true;
+            }
+        }
+
+        /* Same stopping rule as the scan of the main tree - the following main values can't beat the minimal volume (over the heights, nor give it
+         with a smaller side.) */
+
+        if (found && ((min_volume < (box_volume) cascade->main_vals[i] * sub_val) ||
+                      ((min_volume == (box_volume) cascade->main_vals[i] * sub_val) && (main_is_side || (min_sub_val <= sub_val))))) {
+
+            break;
+        }
+
+        if (i + 1 == cascade->main_count) {
+
+            break;
+        }
+
+        /* Carry the position over to the next augmented catalog - it is at most one value before the bridge of the current position, because only
+         every second value of it is promoted to the current one. */
+
+        next_length = cascade->augmented_start[i + 2] - cascade->augmented_start[i + 1];
+        position = (position == length) ? next_length : cascade->augmented_next[cascade->augmented_start[i] + position];
+
+        while ((position > 0) && (cascade->augmented_vals[cascade->augmented_start[i + 1] + position - 1] >= sub_val)) {
+
+            position--;
+        }
+
+        length = next_length;
+    }
+
+    if (!found) {
+
+        return false;
+    }
+
+    *found_main_val = min_main_val;
+    *found_sub_val = min_sub_val;
+
+    return true;
+}
@@ -0,0 +1,108 @@
+/* Box cascade header file.
+ Contains the structure and functions' prototype declarations of the cascaded index of a main tree of the box factory.
+ The cascade is a flattened copy of a main tree: the values of its nodes in order, and for every node - the values of its subtree (its catalog.)
+ Using fractional cascading, every catalog is augmented with every second value of the next augmented catalog, and each augmented value remembers
+ where it falls in its own catalog and in the next augmented catalog. So, after a single binary search for sub_val in the first candidate's augmented
+ catalog, the position of sub_val in every following catalog is found in O(1) - GETBOX over m candidates costs O(m + log n) instead of O(m log n).
+ The cascade is a static structure: it is built from the main tree, becomes stale on every insertion or removal, and is rebuilt lazily and in parts.
+ The rebuild starts only once the GETBOX scans of the main tree since its last change have cost as much as a rebuild - so a main tree which keeps
+ changing is scanned, and never pays for rebuilds thrown away. From then on, every scan adds a fixed part of the rebuild (BOX_CASCADE_BUILD_BUDGET,
+ however many main tree nodes it visited), so no single GETBOX pays for more than that, until the cascade is current again. Only a long scan (of
+ BOX_CASCADE_LONG_SCAN main tree nodes or more) adds a part - a short scan, such as the query planner chooses, gains little from the cascade, so it
+ doesn't pay for it either (its work is still recorded.) A change of the main tree drops the partial rebuild. */
+
+
+#include <stdbool.h>
+
+#include "rb_tree.h"
+
+#include "box_types.h"
+
+#ifndef BOX_CASCADE_H_
+#define BOX_CASCADE_H_
+
+
+#define BOX_CASCADE_BUILD_BUDGET 128			/* The work a GETBOX scan adds to the rebuild, in values written to the arrays - a few microseconds. */
+
+#define BOX_CASCADE_COPY_COST 8			/* The work of a value copied from the main tree (COPY), which follows the pointers of the tree and of the key,
+                                 in values written to the arrays. */
+
+#define BOX_CASCADE_LONG_SCAN 16			/* The number of main tree nodes from which a GETBOX scan adds a part of the rebuild. */
+
+
+typedef enum box_cascade_phase_e {			/* The phase of the rebuild of a stale cascade. */
+
+    BOX_CASCADE_IDLE = 0,			/* Not rebuilding - the cascade is current, or the scans since the last change haven't cost a rebuild yet. */
+    BOX_CASCADE_COUNT = 1,			/* Counting the values of the catalogs, so the arrays are allocated once, before they are copied. */
+    BOX_CASCADE_COPY = 2,			/* Copying the main values and their catalogs from the main tree, in order. */
+    BOX_CASCADE_LENGTHS = 3,			/* Computing the lengths of the augmented catalogs, from the last one. */
+    BOX_CASCADE_STARTS = 4,			/* Turning the lengths into starts, from the first one. */
+    BOX_CASCADE_MERGE = 5			/* Building the augmented catalogs, from the last one. */
+} box_cascade_phase;
+
+
+typedef struct box_cascade_s {			/* Box cascade structure. */
+
+    bool current;			/* FALSE if the main tree has changed since the cascade was built. */
+    unsigned long long quiet_work;		/* Number of main tree nodes visited by GETBOX scans since the last change of the main tree. */
+    unsigned int rebuild_size;			/* The estimated work of a rebuild - the number of catalog values of the last complete one, or of a partial
+                                 one which copied more before it was dropped. */
+
+    box_cascade_phase phase;			/* The state of the rebuild. */
+    rb_tree_node *build_main_node;		/* COUNT - the main tree node to count (NULL once all are.) COPY - the main tree node being copied (NULL once
+                                     all are), and the next node of its subtree to copy (NULL if its catalog wasn't started yet.) */
+    rb_tree_node *build_sub_node;
+    unsigned int build_index;			/* COUNT - the number of catalog values counted, LENGTHS and MERGE - the number of main values left, STARTS - the
+                                 number of main values done. */
+    unsigned int build_length;			/* LENGTHS - the length of the augmented catalog after the current one. */
+    unsigned int merge_catalog_pos;		/* MERGE - the state of the merge of the current augmented catalog (see box_cascade_merge.) */
+    unsigned int merge_promoted_pos;
+    unsigned int merge_next_pos;
+    unsigned int merge_out;
+
+    unsigned int main_count;			/* Number of main values (nodes of the main tree.) */
+    unsigned int catalog_count;			/* Total number of values in the catalogs. */
+    unsigned int augmented_count;		/* Total number of values in the augmented catalogs. */
+    unsigned int capacity;			/* Number of allocated elements of the arrays of the catalogs (and of the augmented catalogs.) */
+    unsigned int main_capacity;			/* Number of allocated elements of the arrays of the main values. */
+
+    box_dim *main_vals;			/* main_vals[i] - the value of the i'th node of the main tree. */
+    unsigned int *catalog_start;		/* The catalog of the i'th main value is catalog_vals[catalog_start[i] .. catalog_start[i + 1]). */
+    box_dim *catalog_vals;
+    unsigned int *augmented_start;		/* The augmented catalog of the i'th main value is at [augmented_start[i] .. augmented_start[i + 1]). */
+    box_dim *augmented_vals;
+    unsigned int *augmented_own;		/* Position of the augmented value in the catalog - number of the catalog values smaller than it. */
+    unsigned int *augmented_next;		/* Position of the augmented value in the next augmented catalog (same meaning.) */
+} box_cascade;
+
+
+/* Initialize an empty (stale) cascade. */
+
+void box_cascade_init(box_cascade *cascade);
+
+
+/* Free the arrays of the cascade. The structure itself is a field of its owner, and isn't freed. */
+
+void box_cascade_destroy(box_cascade *cascade);
+
+
+/* Mark the cascade as stale - called on every insertion to or removal from its main tree. */
+
+void box_cascade_invalidate(box_cascade *cascade);
+
+
+/* Record the work of a GETBOX scan of the main tree (the number of main tree nodes it visited) while the cascade is stale. Once the work recorded since the
+ last change of the main tree has reached the size of the cascade, and the scan is long (BOX_CASCADE_LONG_SCAN) - go on with the rebuild from the
+ main tree, by BOX_CASCADE_BUILD_BUDGET.
+ Returns FALSE on an allocation error (the cascade stays stale, and the rebuild is tried again by the next scan), TRUE otherwise. */
+
+bool box_cascade_account(box_cascade *cascade, rb_tree *main_tree, unsigned int visited);
+
+
+/* GETBOX over the cascade, which must be current - same semantics (and same answers) as box_factory_get_by_input over its main tree. main_is_side tells
+ which dimension is the main one, for the choice between sizes of the same volume. */
+
+bool box_cascade_get(box_cascade *cascade, bool main_is_side, box_dim main_val, box_dim sub_val, box_dim *found_main_val, box_dim *found_sub_val);
+
+
+#endif /* BOX_CASCADE_H_ */
@@ -0,0 +1,186 @@
+/*
+ Box checkpoint source file.
+ Here we implement the background checkpoint - the fork of the child which writes the snapshot, and its reaping.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* fork, waitpid, clock_gettime and strdup. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <errno.h>
+
+#include <time.h>
+
+#include <sys/stat.h>
+
+#ifndef BOX_FACTORY_PORTABLE
+
+#include <unistd.h>
+
+#include <sys/wait.h>
+
+#endif
+
+#include "box_checkpoint.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the time of a monotonic clock, in seconds (the processor time of the process in the portable build.) */
+
+static double box_checkpoint_now(void);
+
+
+/* The implementation: */
+
+
+static double box_checkpoint_now(void)
+{
+
+#ifdef BOX_FACTORY_PORTABLE
+
+    return (double) clock() / CLOCKS_PER_SEC;
+
+#else
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+
+#endif
+}
+
+
+void box_checkpoint_init(box_checkpoint *checkpoint)
+{
+
+    memset(checkpoint, 0, sizeof(box_checkpoint));
+}
+
+
+void box_checkpoint_destroy(box_checkpoint *checkpoint)
+{
+
+    if (checkpoint->pid != 0) {
+
+        box_checkpoint_poll(checkpoint, true);
+    }
+
+    free(checkpoint->path);
+    checkpoint->path = NULL;
+}
+
+
+bool box_checkpoint_start(box_checkpoint *checkpoint, const char *path, box_checkpoint_write write, void *context, unsigned long long lsn,
+                          unsigned long long wal_end)
+{
+
+    char *new_path = NULL;
+#ifndef BOX_FACTORY_PORTABLE
+    pid_t pid = 0;
+#endif
+
+    if (checkpoint->pid != 0) {
+
+        return false;
+    }
+
+    new_path = strdup(path);
+
+    if (new_path == NULL) {
+
+        return false;
+    }
+
+    checkpoint->started = box_checkpoint_now();
+
+#ifdef BOX_FACTORY_PORTABLE
+
+    checkpoint->written = write(context, new_path);			/* No child - the snapshot is written now, and reported by the next poll. */
+
+    free(checkpoint->path);
+
+    checkpoint->pid = 1;
+
+#else
+
+    pid = fork();
+
+    if (pid < 0) {
+
+        free(new_path);
+        return false;
+    }
+
+    if (pid == 0) {			/* The child - _exit skips the handlers and the stdio buffers of the parent. */
+
+        _exit(write(context, new_path) ? 0 : 1);
+    }
+
+    free(checkpoint->path);
+
+    checkpoint->pid = pid;
+
+#endif
+    checkpoint->path = new_path;
+    checkpoint->pause_ms = (box_checkpoint_now() - checkpoint->started) * 1e3;
+    checkpoint->lsn = lsn;
+    checkpoint->wal_end = wal_end;
+
+    return true;
+}
+
+
+box_checkpoint_state box_checkpoint_poll(box_checkpoint *checkpoint, bool wait)
+{
+
+    struct stat status;
+#ifndef BOX_FACTORY_PORTABLE
+    int child_status = 0;
+    pid_t result = 0;
+#endif
+    bool done = false;
+
+    if (checkpoint->pid == 0) {
+
+        return BOX_CHECKPOINT_IDLE;
+    }
+
+#ifdef BOX_FACTORY_PORTABLE
+
+    (void) wait;			/* The snapshot was written by box_checkpoint_start. */
+
+    done = checkpoint->written;
+
+#else
+
+    do {
+
+        result = waitpid(checkpoint->pid, &child_status, wait ? 0 : WNOHANG);
+    } while ((result < 0) && (errno == EINTR));
+
+    if (result == 0) {
+
+        return BOX_CHECKPOINT_RUNNING;
+    }
+
+    done = (result == checkpoint->pid) && WIFEXITED(child_status) && (WEXITSTATUS(child_status) == 0);
+
+#endif
+
+    checkpoint->pid = 0;
+    checkpoint->stats.pause_ms = checkpoint->pause_ms;
+    checkpoint->stats.duration_ms = (box_checkpoint_now() - checkpoint->started) * 1e3;
+    checkpoint->stats.bytes = (done && (stat(checkpoint->path, &status) == 0)) ? (unsigned long long) status.st_size : 0;
+    checkpoint->stats.throughput = (checkpoint->stats.duration_ms > 0) ? checkpoint->stats.bytes / (checkpoint->stats.duration_ms * 1e3) : 0;
+
+    return done ? BOX_CHECKPOINT_DONE : BOX_CHECKPOINT_FAILED;
+}
@@ -0,0 +1,86 @@
+/* Box checkpoint header file.
+ Contains the structures and functions' prototype declarations of the background checkpoint of a box factory - a snapshot written by a child
+ process. fork() gives the child a copy-on-write image of the whole memory of the box factory as it was at that moment, so the child writes a
+ consistent snapshot while the parent goes on changing its boxes: the parent is stopped only for the fork itself (the copy of its page tables), and
+ then pays for the pages it changes while the child runs - not for the writing of the file.
+ The parent reaps the child by polling (box_checkpoint_poll), and then may drop the records of its write-ahead log which the snapshot includes.
+ The portable build (BOX_FACTORY_PORTABLE, see box_factory.h) has no fork - box_checkpoint_start writes the snapshot itself before it returns, and the
+ next poll reports the result, so the pause of the checkpoint is the whole writing. */
+
+
+#include <stdbool.h>
+
+#ifndef BOX_FACTORY_PORTABLE
+
+#include <sys/types.h>
+
+#endif
+
+#ifndef BOX_CHECKPOINT_H_
+#define BOX_CHECKPOINT_H_
+
+
+typedef enum box_checkpoint_state_e {			/* The state of a checkpoint, as returned by box_checkpoint_poll. */
+
+    BOX_CHECKPOINT_IDLE = 0,			/* No checkpoint was started since the last one ended. */
+    BOX_CHECKPOINT_RUNNING = 1,			/* The child is still writing the snapshot. */
+    BOX_CHECKPOINT_DONE = 2,			/* The child has written the snapshot - it just ended. */
+    BOX_CHECKPOINT_FAILED = 3			/* The child couldn't write the snapshot, or was killed - it just ended. */
+} box_checkpoint_state;
+
+
+/* The function the child calls - write the snapshot to the given path. Returns FALSE on an error, TRUE otherwise. */
+
+typedef bool (*box_checkpoint_write)(void *context, const char *path);
+
+
+typedef struct box_checkpoint_stats_s {			/* Measures of the last checkpoint which ended. */
+
+    double pause_ms;			/* The time the caller was stopped by box_checkpoint_start (the fork.) */
+    double duration_ms;			/* The time from the start of the checkpoint until the child was reaped. */
+    unsigned long long bytes;			/* The size of the snapshot (0 if it failed.) */
+    double throughput;			/* bytes / duration, in MB per second. */
+} box_checkpoint_stats;
+
+
+typedef struct box_checkpoint_s {			/* Box checkpoint structure. */
+
+#ifdef BOX_FACTORY_PORTABLE
+    int pid;			/* 1 while the result of the snapshot written by box_checkpoint_start wasn't polled, 0 otherwise. */
+    bool written;			/* That result. */
+#else
+    pid_t pid;			/* The child writing the snapshot, 0 if there's none. */
+#endif
+    char *path;			/* The path of the snapshot. */
+    double started;			/* The start time of the checkpoint (seconds, of a monotonic clock.) */
+    double pause_ms;			/* The pause of its start. */
+    unsigned long long lsn;			/* The LSN of the last change the snapshot includes, and the end of the log file at that moment - for the */
+    unsigned long long wal_end;			/* user, which drops the records of the log up to them once the checkpoint is done (see box_wal_truncate.) */
+    box_checkpoint_stats stats;
+} box_checkpoint;
+
+
+/* Initialize a checkpoint with no child. */
+
+void box_checkpoint_init(box_checkpoint *checkpoint);
+
+
+/* Wait for the child of the checkpoint, if there is one, and free the path. The structure itself is a field of its owner, and isn't freed. */
+
+void box_checkpoint_destroy(box_checkpoint *checkpoint);
+
+
+/* Start a checkpoint - fork a child which calls write with the given context and path, and exits. lsn and wal_end are kept for the user.
+ Returns FALSE if a checkpoint is running, on an allocation error, or if the fork failed, TRUE otherwise. */
+
+bool box_checkpoint_start(box_checkpoint *checkpoint, const char *path, box_checkpoint_write write, void *context, unsigned long long lsn,
+                          unsigned long long wal_end);
+
+
+/* Check whether the child of the checkpoint has ended (wait for it if wait is TRUE), and reap it. Once it has ended, stats has its measures, and the
+ next poll returns BOX_CHECKPOINT_IDLE. */
+
+box_checkpoint_state box_checkpoint_poll(box_checkpoint *checkpoint, bool wait);
+
+
+#endif /* BOX_CHECKPOINT_H_ */
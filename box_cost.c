@@ -0,0 +1,235 @@
+/*
+ Box cost source file.
+ Here we implement the cost model of the box factory - the cost function and the hash table of the per-size prices.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_cost.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the index of the home slot of the given size in a hash table of the given capacity. */
+
+static unsigned int box_cost_slot(box_dim side_square, box_dim height, unsigned int capacity);
+
+
+/* Return the slot of the given size in the hash table of the prices, or the empty slot where it would be added. The table must have an empty slot. */
+
+static box_cost_price* box_cost_find(box_cost *cost, box_dim side_square, box_dim height);
+
+
+/* Move the prices to a new hash table of twice the capacity. Returns FALSE on an allocation error, in which case the prices are left unchanged. */
+
+static bool box_cost_grow(box_cost *cost);
+
+
+/* The implementation: */
+
+
+void box_cost_init(box_cost *cost)
+{
+
+    memset(cost, 0, sizeof(box_cost));
+
+    cost->monotone = true;
+}
+
+
+void box_cost_destroy(box_cost *cost)
+{
+
+    free(cost->prices);
+
+    box_cost_init(cost);
+}
+
+
+void box_cost_set_function(box_cost *cost, box_cost_function function, void *context, bool monotone)
+{
+
+    cost->function = function;
+    cost->context = context;
+    cost->monotone = (function == NULL) || monotone;
+}
+
+
+static unsigned int box_cost_slot(box_dim side_square, box_dim height, unsigned int capacity)
+{
+
+    box_dim hash = (side_square * 2654435761u) ^ (height * 2246822519u);			/* The hashing of the GETBOX cache (box_cache.c). */
+
+    return (unsigned int) (hash ^ (hash >> 16)) & (capacity - 1);
+}
+
+
+static box_cost_price* box_cost_find(box_cost *cost, box_dim side_square, box_dim height)
+{
+
+    unsigned int i = box_cost_slot(side_square, height, cost->capacity);
+
+    while (cost->prices[i].used && ((cost->prices[i].side_square != side_square) || (cost->prices[i].height != height))) {
+
+        i = (i + 1) & (cost->capacity - 1);
+    }
+
+    return &(cost->prices[i]);
+}
+
+
+static bool box_cost_grow(box_cost *cost)
+{
+
+    box_cost_price *old_prices = cost->prices;
+    unsigned int old_capacity = cost->capacity;
+    unsigned int capacity = (cost->capacity == 0) ? BOX_COST_MIN_CAPACITY : 2 * cost->capacity;
+    unsigned int i = 0;
+
+    cost->prices = calloc(sizeof(box_cost_price), capacity);
+
+    if (cost->prices == NULL) {
+
+        cost->prices = old_prices;
+        return false;
+    }
+
+    cost->capacity = capacity;
+
+    for (i = 0; i < old_capacity; ++i) {
+
+        if (old_prices[i].used) {
+
+            *(box_cost_find(cost, old_prices[i].side_square, old_prices[i].height)) = old_prices[i];
+        }
+    }
+
+    free(old_prices);
+
+    return true;
+}
+
+
+bool box_cost_set_price(box_cost *cost, box_dim side_square, box_dim height, double price)
+{
+
+    box_cost_price *slot = NULL;
+
+    /* Keep the table at most half full, so the probes stay short. */
+
+    if ((2 * (cost->price_count + 1) > cost->capacity) && !box_cost_grow(cost)) {
+
+        return false;
+    }
+
+    slot = box_cost_find(cost, side_square, height);
+
+    if (!slot->used) {
+
+        slot->side_square = side_square;
+        slot->height = height;
+        slot->used = true;
+        cost->price_count++;
+    }
+
+    slot->price = price;
+
+    return true;
+}
+
+
+bool box_cost_remove_price(box_cost *cost, box_dim side_square, box_dim height)
+{
+
+    box_cost_price *slot = NULL;
+    unsigned int hole = 0;
+    unsigned int i = 0;
+    unsigned int home = 0;
+
+    if (cost->price_count == 0) {
+
+        return false;
+    }
+
+    slot = box_cost_find(cost, side_square, height);
+
+    if (!slot->used) {
+
+        return false;
+    }
+
+    /* Close the hole: move back every following price of the run whose home slot is not between the hole and its own slot (cyclically.) */
+
+    hole = slot - cost->prices;
+
+    for (i = (hole + 1) & (cost->capacity - 1); cost->prices[i].used; i = (i + 1) & (cost->capacity - 1)) {
+
+        home = box_cost_slot(cost->prices[i].side_square, cost->prices[i].height, cost->capacity);
+
+        if (((i - home) & (cost->capacity - 1)) >= ((i - hole) & (cost->capacity - 1))) {
+
+            cost->prices[hole] = cost->prices[i];
+            hole = i;
+        }
+    }
+
+    cost->prices[hole].used = false;
+    cost->price_count--;
+
+    return true;
+}
+
+
+bool box_cost_get_price(box_cost *cost, box_dim side_square, box_dim height, double *price)
+{
+
+    box_cost_price *slot = NULL;
+
+    if (cost->price_count == 0) {
+
+        return false;
+    }
+
+    slot = box_cost_find(cost, side_square, height);
+
+    if (!slot->used) {
+
+        return false;
+    }
+
+    *price = slot->price;
+
+    return true;
+}
+
+
+double box_cost_of_function(box_cost *cost, box_dim side_square, box_dim height)
+{
+
+    if (cost->function == NULL) {
+
+        return (double) side_square * height;
+    }
+
+    return cost->function(side_square, height, cost->context);
+}
+
+
+double box_cost_of(box_cost *cost, box_dim side_square, box_dim height)
+{
+
+    double price = 0;
+
+    if (box_cost_get_price(cost, side_square, height, &price)) {
+
+        return price;
+    }
+
+    return box_cost_of_function(cost, side_square, height);
+}
@@ -0,0 +1,87 @@
+/* Box cost header file.
+ Contains the structures and functions' prototype declarations of the cost model of the box factory, which box_factory_get_cheapest minimizes instead
+ of the volume. The cost of a size of boxes is its own price, if one was set for it (per-size prices are kept in a hash table), otherwise the value of
+ the cost function, if one was set, otherwise the volume of the box.
+ A cost function which is monotone (never decreases when the side or the height grows) lets the query prune like GETBOX does - the cost of the smallest
+ suitable box of a main tree node bounds the costs of all the suitable boxes of the following nodes. The per-size prices are arbitrary, so the sizes
+ which have them are checked one by one, and an arbitrary cost function makes the query visit every suitable size. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#ifndef BOX_COST_H_
+#define BOX_COST_H_
+
+
+#define BOX_COST_MIN_CAPACITY 16			/* Initial number of slots of the hash table of the prices. Must be a power of 2. */
+
+
+/* Cost function of a size of boxes - (side * side) and height of the box, and the context given with the function. */
+
+typedef double (*box_cost_function)(box_dim side_square, box_dim height, void *context);
+
+
+typedef struct box_cost_price_s {			/* A slot of the hash table of the prices. */
+
+    box_dim side_square;
+    box_dim height;
+    double price;
+    bool used;			/* FALSE if the slot is empty. */
+} box_cost_price;
+
+
+typedef struct box_cost_s {			/* Box cost structure. */
+
+    box_cost_function function;			/* The cost function, NULL for the volume. */
+    void *context;
+    bool monotone;			/* TRUE if the cost function never decreases when one of the dimensions grows (the volume always does.) */
+
+    box_cost_price *prices;			/* Hash table of the prices, with linear probing. */
+    unsigned int price_count;			/* Number of used slots. */
+    unsigned int capacity;			/* Number of slots (a power of 2, or 0 before the first price is set.) */
+} box_cost;
+
+
+/* Initialize a cost model of the volume, without prices. */
+
+void box_cost_init(box_cost *cost);
+
+
+/* Free the prices of the cost model. The structure itself is a field of its owner, and isn't freed. */
+
+void box_cost_destroy(box_cost *cost);
+
+
+/* Set the cost function (NULL for the volume) and its context. monotone tells whether it never decreases when the side or the height grows. */
+
+void box_cost_set_function(box_cost *cost, box_cost_function function, void *context, bool monotone);
+
+
+/* Set the price of the given size, replacing its previous price. Returns FALSE on an allocation error, TRUE otherwise. */
+
+bool box_cost_set_price(box_cost *cost, box_dim side_square, box_dim height, double price);
+
+
+/* Remove the price of the given size, so its cost is given by the cost function again. Returns FALSE if the size has no price, TRUE otherwise. */
+
+bool box_cost_remove_price(box_cost *cost, box_dim side_square, box_dim height);
+
+
+/* Return TRUE if the given size has a price, in which case price contains it. */
+
+bool box_cost_get_price(box_cost *cost, box_dim side_square, box_dim height, double *price);
+
+
+/* Return the cost of the given size. */
+
+double box_cost_of(box_cost *cost, box_dim side_square, box_dim height);
+
+
+/* Return the cost of the given size by the cost function (or the volume), ignoring its price. */
+
+double box_cost_of_function(box_cost *cost, box_dim side_square, box_dim height);
+
+
+#endif /* BOX_COST_H_ */
@@ -0,0 +1,368 @@
+/*
+ Box cursor source file.
+ Here we implement the cursor over the suitable boxes - the lazy merge of the candidate subtrees of tree_by_side (or of the secondary sets of set_by_side,
+ over a box index) with a binary heap.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include "rb_tree.h"
+
+#include "box_factory.h"
+
+#include "box_cursor.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the volume of the boxes of the given main value and height. */
+
+static box_volume box_cursor_volume(box_cursor *cursor, box_dim main_val, box_dim height);
+
+
+/* Return TRUE if entry a should be taken before entry b - it has a smaller volume, or the same volume and a smaller side. */
+
+static bool box_cursor_less(box_cursor_entry *a, box_cursor_entry *b);
+
+
+/* Add an entry to the heap. Returns FALSE on an allocation error, TRUE otherwise. */
+
+static bool box_cursor_push(box_cursor *cursor, box_cursor_entry *entry);
+
+
+/* Remove the first entry of the heap (which must not be empty) into entry. */
+
+static void box_cursor_pop(box_cursor *cursor, box_cursor_entry *entry);
+
+
+/* Set the next main value of the cursor to the given main tree node / the smallest value of set_by_side from the given one.
+ found tells whether there is such a main value, the node is used over the main trees and the value over a box index. */
+
+static void box_cursor_set_next_main(box_cursor *cursor, rb_tree_node *main_node, bool found, box_dim main_val);
+
+
+/* Add the subtree of the next main value to the heap, with its first suitable height (if it has one), and move to the following main value.
+ Returns FALSE on an allocation error, TRUE otherwise. */
+
+static bool box_cursor_add_main(box_cursor *cursor);
+
+
+/* Move the given entry to the next height of its subtree. Returns FALSE if there are no more heights in the subtree. */
+
+static bool box_cursor_advance(box_cursor *cursor, box_cursor_entry *entry);
+
+
+/* The implementation: */
+
+
+static box_volume box_cursor_volume(box_cursor *cursor, box_dim main_val, box_dim height)
+{
+
+    box_index *index = cursor->factory->index;
+    box_volume side = 0;
+
+    if (index != NULL) {			/* A box index keeps the keys of the side itself and of the height. */
+
+        side = box_index_value(index->sides, (unsigned int) main_val);
+
+        return side * side * box_index_value(index->heights, (unsigned int) height);
+    }
+
+    return (box_volume) main_val * height;
+}
+
+
+static bool box_cursor_less(box_cursor_entry *a, box_cursor_entry *b)
+{
+
+    return (a->volume < b->volume) || ((a->volume == b->volume) && (a->main_val < b->main_val));
+}
+
+
+static bool box_cursor_push(box_cursor *cursor, box_cursor_entry *entry)
+{
+
+    box_cursor_entry *heap = NULL;
+    unsigned int capacity = 0;
+    unsigned int i = cursor->heap_count;
+
+    if (cursor->heap_count == cursor->heap_capacity) {
+
+        capacity = (cursor->heap_capacity == 0) ? 16 : 2 * cursor->heap_capacity;
+        heap = realloc(cursor->heap, sizeof(box_cursor_entry) * capacity);
+
+        if (heap == NULL) {
+
+            return false;
+        }
+
+        cursor->heap = heap;
+        cursor->heap_capacity = capacity;
+    }
+
+    /* Sift up - move the parents which should be taken after the new entry down, until its place is found. */
+
+    while ((i > 0) && box_cursor_less(entry, &(cursor->heap[(i - 1) / 2]))) {
+
+        cursor->heap[i] = cursor->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    cursor->heap[i] = *entry;
+    cursor->heap_count++;
+
+    return true;
+}
+
+
+static void box_cursor_pop(box_cursor *cursor, box_cursor_entry *entry)
+{
+
+    box_cursor_entry last = cursor->heap[--cursor->heap_count];
+    unsigned int i = 0;
+    unsigned int child = 0;
+
+    *entry = cursor->heap[0];
+
+    /* Sift down the last entry from the root - move the children which should be taken before it up, until its place is found. */
+
+    while ((child = 2 * i + 1) < cursor->heap_count) {
+
+        if ((child + 1 < cursor->heap_count) && box_cursor_less(&(cursor->heap[child + 1]), &(cursor->heap[child]))) {
+
+            child++;
+        }
+
+        if (!box_cursor_less(&(cursor->heap[child]), &last)) {
+
+            break;
+        }
+
+        cursor->heap[i] = cursor->heap[child];
+        i = child;
+    }
+
+    cursor->heap[i] = last;
+}
+
+
+static void box_cursor_set_next_main(box_cursor *cursor, rb_tree_node *main_node, bool found, box_dim main_val)
+{
+
+    if (cursor->factory->index == NULL) {
+
+        cursor->has_next_main = (main_node != NULL);
+        cursor->next_main_node = main_node;
+        cursor->next_main_val = (main_node != NULL) ? ((main_tree_key *) main_node->key)->val : 0;
+    }
+
+    else {
+
+        cursor->has_next_main = found;
+        cursor->next_main_val = main_val;
+    }
+}
+
+
+void box_factory_suitable_begin(box_factory *factory, box_dim side, box_dim height, box_cursor *cursor)
+{
+
+    main_tree_key target_main_key = {.val = side * side, .subtree = NULL};
+    box_index *index = factory->index;
+    unsigned int main_val = 0;
+    unsigned int height_key = 0;
+    bool found = false;
+
+    cursor->factory = factory;
+    cursor->height = height;
+    cursor->heap = NULL;
+    cursor->heap_count = 0;
+    cursor->heap_capacity = 0;
+    cursor->failed = false;
+
+    if (!box_factory_load_snapshot(factory)) {			/* The cursor walks the main trees - the boxes of a snapshot are copied first. */
+
+        cursor->failed = true;
+        box_cursor_set_next_main(cursor, NULL, false, 0);
+        return;
+    }
+
+    if (factory->disk != NULL) {			/* The pages of a B+-tree aren't pinned for the lifetime of a cursor - it has no cursor. */
+
+        cursor->failed = true;
+        box_cursor_set_next_main(cursor, NULL, false, 0);
+        return;
+    }
+
+    /* The candidate main values are the ones from the given side - none of them is added to the heap yet. No box has a side larger than
+     BOX_DIM_MAX_SIDE (and its square doesn't fit in a box_dim.) */
+
+    if (side > BOX_DIM_MAX_SIDE) {
+
+        box_cursor_set_next_main(cursor, NULL, false, 0);
+    }
+
+    else {
+
+        if (index == NULL) {
+
+            box_cursor_set_next_main(cursor, rb_tree_search_smallest_from(factory->tree_by_side, &target_main_key), false, 0);
+        }
+
+        else {
+
+            found = box_index_key_from(index->sides, side, &main_val) && box_index_key_from(index->heights, height, &height_key) &&
+                    index->ops->lower_bound(index->set_by_side, main_val, &main_val);
+
+            cursor->height = height_key;
+            box_cursor_set_next_main(cursor, NULL, found, main_val);
+        }
+    }
+}
+
+
+static bool box_cursor_add_main(box_cursor *cursor)
+{
+
+    box_index *index = cursor->factory->index;
+    subtree_key target_sub_key = {.val = cursor->height};
+    rb_tree_node *main_node = cursor->next_main_node;
+    box_cursor_entry entry = {.volume = 0, .main_val = cursor->next_main_val, .height = 0, .subtree = NULL, .sub_node = NULL};
+    unsigned int main_val = 0;			/* The values of the box index are unsigned int. */
+    unsigned int height = 0;
+    bool found = false;
+    bool found_main = false;
+
+    if (index == NULL) {
+
+        entry.subtree = ((main_tree_key *) main_node->key)->subtree;
+        entry.sub_node = rb_tree_search_smallest_from(entry.subtree, &target_sub_key);
+        found = (entry.sub_node != NULL);
+
+        if (found) {
+
+            entry.height = ((subtree_key *) entry.sub_node->key)->val;
+        }
+
+        box_cursor_set_next_main(cursor, rb_tree_successor(cursor->factory->tree_by_side, main_node), false, 0);
+    }
+
+    else {
+
+        found = index->ops->lower_bound(*(index->ops->payload(index->set_by_side, entry.main_val)), cursor->height, &height);
+        entry.height = height;
+
+        found_main = index->ops->successor(index->set_by_side, entry.main_val, &main_val);
+        box_cursor_set_next_main(cursor, NULL, found_main, main_val);
+    }
+
+    if (!found) {			/* All the heights of the subtree are smaller than the height of the present. */
+
+        return true;
+    }
+
+    entry.volume = box_cursor_volume(cursor, entry.main_val, entry.height);
+
+    return box_cursor_push(cursor, &entry);
+}
+
+
+static bool box_cursor_advance(box_cursor *cursor, box_cursor_entry *entry)
+{
+
+    box_index *index = cursor->factory->index;
+    unsigned int height = 0;
+    bool found = false;
+
+    if (index == NULL) {
+
+        entry->sub_node = rb_tree_successor(entry->subtree, entry->sub_node);
+
+        if (entry->sub_node == NULL) {
+
+            return false;
+        }
+
+        entry->height = ((subtree_key *) entry->sub_node->key)->val;
+
+        return true;
+    }
+
+    found = index->ops->successor(*(index->ops->payload(index->set_by_side, entry->main_val)), entry->height, &height);
+    entry->height = height;
+
+    return found;
+}
+
+
+bool box_factory_suitable_next(box_cursor *cursor, box_factory_box *box)
+{
+
+    box_index *index = cursor->factory->index;
+    box_cursor_entry entry;
+
+    if (cursor->failed) {
+
+        return false;
+    }
+
+    /* Add the candidate subtrees until the first entry of the heap can't be beaten by the next one - its volume is at most the smallest volume the
+     next main value may give. */
+
+    while (cursor->has_next_main && ((cursor->heap_count == 0) ||
+           (cursor->heap[0].volume > box_cursor_volume(cursor, cursor->next_main_val, cursor->height)))) {
+
+        if (!box_cursor_add_main(cursor)) {
+
+            cursor->failed = true;
+            return false;
+        }
+    }
+
+    if (cursor->heap_count == 0) {
+
+        return false;
+    }
+
+    box_cursor_pop(cursor, &entry);
+
+    if (index == NULL) {
+
+        box->side_square = entry.main_val;
+        box->height = entry.height;
+        box->count = entry.sub_node->count;
+    }
+
+    else {
+
+        box->side_square = box_index_value(index->sides, (unsigned int) entry.main_val);
+        box->side_square *= box->side_square;
+        box->height = box_index_value(index->heights, (unsigned int) entry.height);
+        box->count = index->ops->instances(*(index->ops->payload(index->set_by_side, entry.main_val)), entry.height);
+    }
+
+    /* The next height of the same subtree gives the next volume of this stream. The heap has room for it, since we have just taken an entry. */
+
+    if (box_cursor_advance(cursor, &entry)) {
+
+        entry.volume = box_cursor_volume(cursor, entry.main_val, entry.height);
+        box_cursor_push(cursor, &entry);
+    }
+
+    return true;
+}
+
+
+void box_factory_suitable_end(box_cursor *cursor)
+{
+
+    free(cursor->heap);
+
+    cursor->heap = NULL;
+    cursor->heap_count = 0;
+    cursor->heap_capacity = 0;
+}
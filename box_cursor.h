@@ -0,0 +1,66 @@
+/* Box cursor header file.
+ Contains the structures and functions' prototype declarations of the cursor over the boxes suitable for a present - it yields the suitable sizes of
+ the box factory one by one, in increasing order of volume, without changing the box factory.
+ Within a subtree of tree_by_side the volume of the suitable boxes grows with their height, so every candidate subtree is a sorted stream, and the cursor
+ merges these streams with a priority queue (a binary heap.) The candidate subtrees are added to the queue lazily - a subtree of (side * side) can't
+ give a volume smaller than (side * side) * height, so it is added only once the volumes taken from the queue reach that bound. So taking the first
+ k sizes costs O(k log m) steps (plus the subtrees skipped for not having a suitable height, like GETBOX), and not a scan of all the candidates.
+ The box factory must not be changed between box_factory_suitable_begin and box_factory_suitable_end. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#include "rb_tree.h"
+
+#include "box_factory.h"
+
+#ifndef BOX_CURSOR_H_
+#define BOX_CURSOR_H_
+
+
+typedef struct box_cursor_entry_s {			/* Entry of the priority queue - the next suitable size of a candidate subtree. */
+
+    box_volume volume;
+    box_dim main_val;			/* The value of the main tree - (side * side), or the key of the side over a box index. */
+    box_dim height;			/* The height, or its key over a box index. */
+    rb_tree *subtree;			/* The subtree of the main value, and the node of the height in it (NULL over a box index.) */
+    rb_tree_node *sub_node;
+} box_cursor_entry;
+
+
+typedef struct box_cursor_s {			/* Box cursor structure. */
+
+    box_factory *factory;
+    box_dim height;			/* The height of the present - over a box index, the key of the smallest height from it. */
+
+    bool has_next_main;			/* TRUE if there are main values which weren't added to the queue yet. */
+    box_dim next_main_val;			/* The smallest of them (same meaning as main_val of an entry.) */
+    rb_tree_node *next_main_node;		/* Its node in tree_by_side (NULL over a box index.) */
+
+    box_cursor_entry *heap;			/* The priority queue, ordered by volume and then by side. */
+    unsigned int heap_count;
+    unsigned int heap_capacity;
+
+    bool failed;			/* TRUE if the cursor stopped because of an allocation error, or over a box factory on disk (which has no cursor.) */
+} box_cursor;
+
+
+/* Start a cursor over the sizes of the box factory suitable for a present of the given dimensions. */
+
+void box_factory_suitable_begin(box_factory *factory, box_dim side, box_dim height, box_cursor *cursor);
+
+
+/* Take the next suitable size (the one with the smallest volume among the sizes which weren't taken yet; equal volumes are taken by increasing side.)
+ Returns FALSE if there are no more suitable sizes (or on an allocation error - in which case 'failed' of the cursor is TRUE), TRUE otherwise. */
+
+bool box_factory_suitable_next(box_cursor *cursor, box_factory_box *box);
+
+
+/* Free the memory of the cursor. */
+
+void box_factory_suitable_end(box_cursor *cursor);
+
+
+#endif /* BOX_CURSOR_H_ */
@@ -0,0 +1,366 @@
+/*
+ Box dictionary source file.
+ Here we implement the dictionary of a dimension - a sorted array of the distinct values with their ids, and a table of the values by their ids.
+ A new value is rare (the number of distinct values is small), so it is inserted into the sorted array, while the lookups are binary searches.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_dictionary.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the position of the smallest value of the dictionary that is larger than or equal to the given value (size if there's no such value.) */
+
+static unsigned int box_dictionary_position(box_dictionary *dictionary, box_dim val);
+
+
+/* Add a new value at the given position, with an id between the ids of its neighbours. There must be such an id.
+ Returns FALSE on an allocation error, in which case the dictionary is left unchanged. */
+
+static bool box_dictionary_insert(box_dictionary *dictionary, unsigned int position, box_dim val, unsigned int id);
+
+
+/* Add a new value at the given position and relabel all the values, keeping the previous entries and values for box_dictionary_end_relabel.
+ Returns FALSE on an allocation error, in which case the dictionary is left unchanged. */
+
+static bool box_dictionary_relabel(box_dictionary *dictionary, unsigned int position, box_dim val, unsigned int **remap);
+
+
+/* The implementation: */
+
+
+box_dictionary* box_dictionary_create(void)
+{
+
+    box_dictionary *dictionary = calloc(sizeof(box_dictionary), 1);
+
+    if (dictionary == NULL) {
+
+        return NULL;
+    }
+
+    dictionary->universe = BOX_DICTIONARY_MIN_UNIVERSE;
+    dictionary->values = calloc(sizeof(box_dim), dictionary->universe);
+
+    if (dictionary->values == NULL) {
+
+        free(dictionary);
+        return NULL;
+    }
+
+    return dictionary;
+}
+
+
+void box_dictionary_destroy(box_dictionary *dictionary)
+{
+
+    free(dictionary->entries);
+    free(dictionary->values);
+    free(dictionary->previous_entries);
+    free(dictionary->previous_values);
+    free(dictionary);
+}
+
+
+static unsigned int box_dictionary_position(box_dictionary *dictionary, box_dim val)
+{
+
+    unsigned int low = 0;
+    unsigned int high = dictionary->size;
+    unsigned int middle = 0;
+
+    while (low < high) {
+
+        middle = low + (high - low) / 2;
+
+        if (dictionary->entries[middle].val < val) {
+
+            low = middle + 1;
+        }
+
+        else {
+
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+
+static bool box_dictionary_insert(box_dictionary *dictionary, unsigned int position, box_dim val, unsigned int id)
+{
+
+    box_dictionary_entry *entries = NULL;
+    unsigned int capacity = 0;
+
+    if (dictionary->size == dictionary->capacity) {
+
+        capacity = (dictionary->capacity == 0) ? 16 : 2 * dictionary->capacity;
+        entries = realloc(dictionary->entries, sizeof(box_dictionary_entry) * capacity);
+
+        if (entries == NULL) {
+
+            return false;
+        }
+
+        dictionary->entries = entries;
+        dictionary->capacity = capacity;
+    }
+
+    memmove(&(dictionary->entries[position + 1]), &(dictionary->entries[position]), sizeof(box_dictionary_entry) * (dictionary->size - position));
+
+    dictionary->entries[position].val = val;
+    dictionary->entries[position].id = id;
+    dictionary->entries[position].count = 1;
+    dictionary->values[id] = val;
+    dictionary->size++;
+
+    return true;
+}
+
+
+static bool box_dictionary_relabel(box_dictionary *dictionary, unsigned int position, box_dim val, unsigned int **remap)
+{
+
+    unsigned int size = dictionary->size + 1;
+    unsigned int universe = dictionary->universe;
+    unsigned int capacity = (size > dictionary->capacity) ? 2 * size : dictionary->capacity;
+    unsigned int margin = 0;
+    unsigned int rank = 0;
+    unsigned int id = 0;
+
+    box_dictionary_entry *entries = NULL;
+    box_dictionary_entry *entry = NULL;
+    box_dim *values = NULL;
+
+    /* Keep the dictionary at most a quarter full, so the gaps between the values take a few new values each. */
+
+    while ((4ULL * size > universe) && (universe < BOX_DICTIONARY_MAX_UNIVERSE)) {
+
+        universe *= 2;
+    }
+
+    entries = malloc(sizeof(box_dictionary_entry) * capacity);
+    values = malloc(sizeof(box_dim) * universe);
+    *remap = malloc(sizeof(unsigned int) * dictionary->universe);
+
+    if ((entries == NULL) || (values == NULL) || (*remap == NULL)) {
+
+        free(entries);
+        free(values);
+        free(*remap);
+        *remap = NULL;
+
+        return false;
+    }
+
+    memset(*remap, 0xFF, sizeof(unsigned int) * dictionary->universe);			/* BOX_DICTIONARY_NO_ID */
+
+    memcpy(entries, dictionary->entries, sizeof(box_dictionary_entry) * position);
+    memcpy(&(entries[position + 1]), &(dictionary->entries[position]), sizeof(box_dictionary_entry) * (dictionary->size - position));
+
+    entries[position].val = val;
+    entries[position].count = 1;
+
+    /* Spread the ids evenly over the universe without its margins - the value of the given rank gets the middle id of the rank-th of 'size' equal
+     parts of it. The margins are left for the values which are added below or above all the others. */
+
+    margin = universe / BOX_DICTIONARY_MARGIN;
+
+    if (universe - 2 * margin < size) {			/* A nearly full dictionary of the largest universe - the margins make room for the values. */
+
+        margin = (universe - size) / 2;
+    }
+
+    for (rank = 0; rank < size; ++rank) {
+
+        entry = &(entries[rank]);
+        id = margin + (unsigned int) (((2ULL * rank + 1) * (universe - 2 * margin)) / (2ULL * size));
+
+        if (rank != position) {
+
+            (*remap)[entry->id] = id;
+        }
+
+        entry->id = id;
+        values[id] = entry->val;
+    }
+
+    dictionary->previous_entries = dictionary->entries;
+    dictionary->previous_values = dictionary->values;
+    dictionary->previous_size = dictionary->size;
+    dictionary->previous_capacity = dictionary->capacity;
+    dictionary->previous_universe = dictionary->universe;
+
+    dictionary->entries = entries;
+    dictionary->values = values;
+    dictionary->size = size;
+    dictionary->capacity = capacity;
+    dictionary->universe = universe;
+
+    return true;
+}
+
+
+bool box_dictionary_add(box_dictionary *dictionary, box_dim val, unsigned int *id, unsigned int **remap)
+{
+
+    unsigned int position = box_dictionary_position(dictionary, val);
+    long long low = 0;
+    long long high = 0;
+    long long step = 0;
+
+    *remap = NULL;
+
+    if ((position < dictionary->size) && (dictionary->entries[position].val == val)) {			/* A known value. */
+
+        dictionary->entries[position].count++;
+        *id = dictionary->entries[position].id;
+
+        return true;
+    }
+
+    if (dictionary->size == BOX_DICTIONARY_MAX_UNIVERSE) {
+
+        return false;
+    }
+
+    /* The free ids of the new value are between the ids of its neighbours (or the ends of the universe.) */
+
+    low = (position == 0) ? -1 : (long long) dictionary->entries[position - 1].id;
+    high = (position == dictionary->size) ? dictionary->universe : dictionary->entries[position].id;
+
+    if (high - low >= 2) {
+
+        /* Between two values - the middle free id. Below or above all the values - a step of about a BOX_DICTIONARY_MARGIN-th of the space a value
+         takes, so the values which arrive sorted (the common case of a growing dimension) fill the margin one step at a time instead of halving it. */
+
+        *id = (unsigned int) ((low + high) / 2);
+        step = dictionary->universe / (BOX_DICTIONARY_MARGIN * (dictionary->size + 1ULL));
+        step = (step < 1) ? 1 : step;
+
+        if ((dictionary->size > 0) && (step < (high - low) / 2)) {
+
+            if (position == dictionary->size) {
+
+                *id = (unsigned int) (low + step);
+            }
+
+            else {
+
+                if (position == 0) {
+
+                    *id = (unsigned int) (high - step);
+                }
+            }
+        }
+
+        return box_dictionary_insert(dictionary, position, val, *id);
+    }
+
+    if (!box_dictionary_relabel(dictionary, position, val, remap)) {
+
+        return false;
+    }
+
+    *id = dictionary->entries[position].id;
+
+    return true;
+}
+
+
+void box_dictionary_end_relabel(box_dictionary *dictionary, unsigned int *remap, bool keep)
+{
+
+    free(remap);
+
+    if (keep) {
+
+        free(dictionary->previous_entries);
+        free(dictionary->previous_values);
+    }
+
+    else {
+
+        free(dictionary->entries);
+        free(dictionary->values);
+
+        dictionary->entries = dictionary->previous_entries;
+        dictionary->values = dictionary->previous_values;
+        dictionary->size = dictionary->previous_size;
+        dictionary->capacity = dictionary->previous_capacity;
+        dictionary->universe = dictionary->previous_universe;
+    }
+
+    dictionary->previous_entries = NULL;
+    dictionary->previous_values = NULL;
+}
+
+
+bool box_dictionary_remove(box_dictionary *dictionary, box_dim val)
+{
+
+    unsigned int position = box_dictionary_position(dictionary, val);
+
+    if ((position == dictionary->size) || (dictionary->entries[position].val != val)) {
+
+        return false;
+    }
+
+    if (--dictionary->entries[position].count == 0) {			/* The last reference - drop the value, its id is free again. */
+
+        memmove(&(dictionary->entries[position]), &(dictionary->entries[position + 1]), sizeof(box_dictionary_entry) * (dictionary->size - position - 1));
+        dictionary->size--;
+    }
+
+    return true;
+}
+
+
+bool box_dictionary_id(box_dictionary *dictionary, box_dim val, unsigned int *id)
+{
+
+    unsigned int position = box_dictionary_position(dictionary, val);
+
+    if ((position == dictionary->size) || (dictionary->entries[position].val != val)) {
+
+        return false;
+    }
+
+    *id = dictionary->entries[position].id;
+
+    return true;
+}
+
+
+bool box_dictionary_id_from(box_dictionary *dictionary, box_dim val, unsigned int *id)
+{
+
+    unsigned int position = box_dictionary_position(dictionary, val);
+
+    if (position == dictionary->size) {
+
+        return false;
+    }
+
+    *id = dictionary->entries[position].id;
+
+    return true;
+}
+
+
+box_dim box_dictionary_value(box_dictionary *dictionary, unsigned int id)
+{
+
+    return dictionary->values[id];
+}
@@ -0,0 +1,101 @@
+/* Box dictionary header file.
+ Contains the structures and functions' prototype declarations of the dictionary of a dimension - an order preserving encoding of the distinct values
+ of a dimension as small ids. The box index (box_index.h) may keep the ids in its ordered sets instead of the values: up to a thousand distinct sides
+ and heights take ids below the universe of the bit set, so the adaptive sets stay bit sets however large the values themselves are, and the van Emde
+ Boas trees of larger dictionaries are over 16-bit values instead of 32-bit ones, as long as the universe of the ids is at most 65536 (a dictionary
+ of up to 16384 values.)
+ The ids are spread over the universe [0, universe) with gaps between them, so a new value usually gets a free id between the ids of its neighbours.
+ When there's no free id between them, all the values are relabeled - spread evenly again, over a universe twice as large if the dictionary is more
+ than a quarter full - and the user must move its structures to the new ids. The relabeling leaves a margin of free ids at both ends of the universe, so a
+ dimension whose new values arrive sorted is relabeled once in a number of new values proportional to its size.
+ A larger dictionary keeps doubling its universe, so its ids take more bits - up to BOX_DICTIONARY_MAX_UNIVERSE, which is more distinct values than
+ a box factory may hold, so a new value is refused on an allocation error only. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#ifndef BOX_DICTIONARY_H_
+#define BOX_DICTIONARY_H_
+
+
+#define BOX_DICTIONARY_MIN_UNIVERSE 4096			/* The universe of a new dictionary - the universe of the bit set (bit_set.h.) */
+
+#define BOX_DICTIONARY_MAX_UNIVERSE (1U << 31)			/* The ids are below 2^31, so the universe doubles without overflowing. */
+
+#define BOX_DICTIONARY_MARGIN 8			/* The relabeling leaves a BOX_DICTIONARY_MARGIN-th of the universe free at each end. */
+
+#define BOX_DICTIONARY_NO_ID 0xFFFFFFFFU			/* The id of no value. */
+
+
+typedef struct box_dictionary_entry_s {			/* A distinct value of the dictionary. */
+
+    box_dim val;
+    unsigned int id;
+    unsigned int count;			/* Number of references to the value (boxes with it.) The value is dropped when it has none. */
+} box_dictionary_entry;
+
+
+typedef struct box_dictionary_s {			/* Box dictionary structure. */
+
+    box_dictionary_entry *entries;			/* The distinct values, sorted - their ids are sorted the same way. */
+    unsigned int size;			/* Number of distinct values. */
+    unsigned int capacity;			/* Number of allocated entries. */
+    unsigned int universe;			/* The ids are in [0, universe). */
+    box_dim *values;			/* values[id] - the value of the given id (the ids which aren't used hold garbage.) */
+
+    box_dictionary_entry *previous_entries;			/* The entries and the values before the last relabeling, until it is ended. */
+    box_dim *previous_values;
+    unsigned int previous_size;
+    unsigned int previous_capacity;
+    unsigned int previous_universe;
+} box_dictionary;
+
+
+/* Create a box dictionary instance - allocates and initializes an empty dictionary.
+ Returns NULL on an allocation error, otherwise returns a pointer to box_dictionary. */
+
+box_dictionary* box_dictionary_create(void);
+
+
+/* Free the dictionary. */
+
+void box_dictionary_destroy(box_dictionary *dictionary);
+
+
+/* Add a reference to the given value, and get its id. remap would be NULL, unless the value is new and the values were relabeled - then it is an
+ array of the size of the previous universe, which maps every previous id to its new id (BOX_DICTIONARY_NO_ID for the ids which weren't used.)
+ The user must move its structures to the new ids and call box_dictionary_end_relabel.
+ Returns FALSE on an allocation error, or if the dictionary has BOX_DICTIONARY_MAX_UNIVERSE values, in which case the dictionary is left unchanged. */
+
+bool box_dictionary_add(box_dictionary *dictionary, box_dim val, unsigned int *id, unsigned int **remap);
+
+
+/* End the relabeling of the last box_dictionary_add and free remap. If keep is FALSE the relabeling is undone - the previous ids are restored, and the
+ value of the last box_dictionary_add is dropped (for the user which failed to move its structures to the new ids.) */
+
+void box_dictionary_end_relabel(box_dictionary *dictionary, unsigned int *remap, bool keep);
+
+
+/* Remove a reference to the given value - the value is dropped with its last reference. Returns FALSE if the value is not in the dictionary. */
+
+bool box_dictionary_remove(box_dictionary *dictionary, box_dim val);
+
+
+/* Find the id of the given value. Returns FALSE if the value is not in the dictionary. */
+
+bool box_dictionary_id(box_dictionary *dictionary, box_dim val, unsigned int *id);
+
+
+/* Find the id of the smallest value that is larger than or equal to the given value. Returns FALSE if there's no such value. */
+
+bool box_dictionary_id_from(box_dictionary *dictionary, box_dim val, unsigned int *id);
+
+
+/* Return the value of the given id. The id must be used. */
+
+box_dim box_dictionary_value(box_dictionary *dictionary, unsigned int id);
+
+
+#endif /* BOX_DICTIONARY_H_ */
@@ -0,0 +1,233 @@
+/*
+ Box dominance source file.
+ Here we implement the trie of the dominance index. The keys of the trees of the heights are the heights themselves, stored in the key pointers (so no
+ memory is allocated for them) - there's a tree in every node on the path of a box, and a box is on BOX_DOMINANCE_BITS paths' nodes.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdint.h>
+
+#include <stdlib.h>
+
+#include "rb_tree.h"
+
+#include "box_dominance.h"
+
+
+/* Convert a height to a key of a tree of the heights, and back. */
+
+#define HEIGHT_KEY(height) ((void *) (uintptr_t) (height))
+
+#define KEY_HEIGHT(key) ((box_dim) (uintptr_t) (key))
+
+
+/* Return the bit of the side which selects the child of a node at the given depth of the trie (the most significant bit first.) */
+
+#define SIDE_BIT(side, depth) (((side) >> (BOX_DOMINANCE_BITS - 1 - (depth))) & 1)
+
+
+/* Functions' prototype declarations: */
+
+
+/* Comparison function between two keys of a tree of the heights. Return 0 if two keys are equal, 1 if a > b, and -1 if a < b. */
+
+static int compare_height_keys(void *a, void *b);
+
+
+/* Remove a box of the given dimensions from the trees of the first 'levels' nodes of its path (below the root), and free the nodes left without boxes.
+ Used by box_dominance_remove (all the levels), and to undo a failed insertion (the levels inserted so far.) */
+
+static void box_dominance_remove_levels(box_dominance *dominance, box_dim side, box_dim height, unsigned int levels);
+
+
+/* Return the number of the boxes of the given node with a height of at least the given height. */
+
+static unsigned long long box_dominance_count_node(box_dominance_node *node, box_dim height);
+
+
+/* Free the children of the given node of the trie, with their trees and the nodes below them. */
+
+static void box_dominance_destroy_children(box_dominance_node *node);
+
+
+/* The implementation: */
+
+
+static int compare_height_keys(void *a, void *b)
+{
+
+    if (KEY_HEIGHT(a) < KEY_HEIGHT(b)) {
+
+        return -1;
+    }
+
+    if (KEY_HEIGHT(a) > KEY_HEIGHT(b)) {
+
+        return 1;
+    }
+
+    return 0;
+}
+
+
+box_dominance* box_dominance_create(void)
+{
+
+    return calloc(sizeof(box_dominance), 1);
+}
+
+
+static void box_dominance_destroy_children(box_dominance_node *node)
+{
+
+    unsigned int bit = 0;
+
+    for (bit = 0; bit < 2; ++bit) {
+
+        if (node->children[bit] != NULL) {
+
+            box_dominance_destroy_children(node->children[bit]);
+
+            rb_tree_destroy(node->children[bit]->heights, NULL, NULL);			/* The keys are the heights themselves - nothing to free. */
+            free(node->children[bit]);
+        }
+    }
+}
+
+
+void box_dominance_destroy(box_dominance *dominance)
+{
+
+    box_dominance_destroy_children(&(dominance->root));
+
+    free(dominance);
+}
+
+
+bool box_dominance_insert(box_dominance *dominance, box_dim side, box_dim height)
+{
+
+    box_dominance_node *node = &(dominance->root);
+    box_dominance_node *child = NULL;
+    unsigned int depth = 0;
+    bool exists = false;
+
+    for (depth = 0; depth < BOX_DOMINANCE_BITS; ++depth) {
+
+        child = node->children[SIDE_BIT(side, depth)];
+
+        if (child == NULL) {			/* The first box with the bits of the side up to this depth - create the node. */
+
+            child = calloc(sizeof(box_dominance_node), 1);
+
+            if (child != NULL) {
+
+                child->heights = rb_tree_create((rb_tree_compare) compare_height_keys);
+            }
+
+            if ((child == NULL) || (child->heights == NULL)) {
+
+                free(child);
+                box_dominance_remove_levels(dominance, side, height, depth);
+
+                return false;
+            }
+
+            node->children[SIDE_BIT(side, depth)] = child;
+        }
+
+        if (!rb_tree_insert(child->heights, HEIGHT_KEY(height), &exists)) {
+
+            box_dominance_remove_levels(dominance, side, height, depth);			/* Also frees the node, if it was just created. */
+
+            return false;
+        }
+
+        node = child;
+    }
+
+    return true;
+}
+
+
+static void box_dominance_remove_levels(box_dominance *dominance, box_dim side, box_dim height, unsigned int levels)
+{
+
+    box_dominance_node *path[BOX_DOMINANCE_BITS + 1];
+    unsigned int depth = 0;
+    unsigned int length = 0;
+    void *deleted = NULL;
+
+    path[0] = &(dominance->root);
+
+    /* Collect the existing nodes of the path (one more than 'levels' may exist - a node just created for a failed insertion.) */
+
+    for (length = 1; (length <= BOX_DOMINANCE_BITS) && (path[length - 1]->children[SIDE_BIT(side, length - 1)] != NULL); ++length) {
+
+        path[length] = path[length - 1]->children[SIDE_BIT(side, length - 1)];
+    }
+
+    for (depth = 1; (depth <= levels) && (depth < length); ++depth) {
+
+        rb_tree_remove(path[depth]->heights, HEIGHT_KEY(height), &deleted);
+    }
+
+    /* A node without boxes has no boxes below it either - free the empty nodes from the bottom of the path up. */
+
+    for (depth = length - 1; (depth > 0) && (path[depth]->heights->count == 0); --depth) {
+
+        path[depth - 1]->children[SIDE_BIT(side, depth - 1)] = NULL;
+
+        free(path[depth]->heights);
+        free(path[depth]);
+    }
+}
+
+
+void box_dominance_remove(box_dominance *dominance, box_dim side, box_dim height)
+{
+
+    box_dominance_remove_levels(dominance, side, height, BOX_DOMINANCE_BITS);
+}
+
+
+static unsigned long long box_dominance_count_node(box_dominance_node *node, box_dim height)
+{
+
+    unsigned int unique = 0;
+    unsigned long long instances = 0;
+
+    rb_tree_count_range(node->heights, HEIGHT_KEY(height), NULL, &unique, &instances);
+
+    return instances;
+}
+
+
+unsigned long long box_dominance_count(box_dominance *dominance, box_dim side, box_dim height)
+{
+
+    box_dominance_node *node = &(dominance->root);
+    unsigned long long count = 0;
+    unsigned int depth = 0;
+
+    /* Follow the path of the side. Wherever the side has a 0 bit, all the sides under the 1 child are larger than it. */
+
+    for (depth = 0; depth < BOX_DOMINANCE_BITS; ++depth) {
+
+        if ((SIDE_BIT(side, depth) == 0) && (node->children[1] != NULL)) {
+
+            count += box_dominance_count_node(node->children[1], height);
+        }
+
+        node = node->children[SIDE_BIT(side, depth)];
+
+        if (node == NULL) {
+
+            return count;
+        }
+    }
+
+    return count + box_dominance_count_node(node, height);			/* The boxes with exactly the given side. */
+}
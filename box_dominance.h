@@ -0,0 +1,63 @@
+/* Box dominance header file.
+ Contains the structures and functions' prototype declarations of the dominance index of the box factory - it counts the boxes whose side is at least
+ a given side and whose height is at least a given height, in O(log^2 n) steps instead of a scan of all the sides.
+ The index is a binary trie over the bits of the side. Every node of the trie keeps a red-black tree of the heights of the boxes whose side starts with
+ the bits of the node, where the count of a height is the number of such boxes - so the subtree totals of the tree (see rb_tree.h) count the boxes with
+ a height in a range. The sides larger than a given one are covered by at most BOX_DOMINANCE_BITS nodes of the trie, next to its path. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#include "rb_tree.h"
+
+#ifndef BOX_DOMINANCE_H_
+#define BOX_DOMINANCE_H_
+
+
+#define BOX_DOMINANCE_BITS BOX_SIDE_BITS			/* Number of bits of the side - the depth of the trie. */
+
+
+typedef struct box_dominance_node_s box_dominance_node;
+
+
+struct box_dominance_node_s {			/* Node of the trie. */
+
+    box_dominance_node *children[2];			/* The nodes of the sides with the next bit 0 / 1, NULL if there are no such boxes. */
+    rb_tree *heights;			/* Tree of the heights of the boxes of the node (NULL for the root, which is never counted.) */
+};
+
+
+typedef struct box_dominance_s {			/* Box dominance structure. */
+
+    box_dominance_node root;
+} box_dominance;
+
+
+/* Create an empty dominance index. Returns NULL on an allocation error, otherwise returns a pointer to box_dominance. */
+
+box_dominance* box_dominance_create(void);
+
+
+/* Free the dominance index with all of its nodes. */
+
+void box_dominance_destroy(box_dominance *dominance);
+
+
+/* Add a box of the given dimensions. Returns FALSE on an allocation error (the index is left unchanged), TRUE otherwise. */
+
+bool box_dominance_insert(box_dominance *dominance, box_dim side, box_dim height);
+
+
+/* Remove a box of the given dimensions, which must be in the index. */
+
+void box_dominance_remove(box_dominance *dominance, box_dim side, box_dim height);
+
+
+/* Return the number of the boxes whose side is at least the given side and whose height is at least the given height. */
+
+unsigned long long box_dominance_count(box_dominance *dominance, box_dim side, box_dim height);
+
+
+#endif /* BOX_DOMINANCE_H_ */
@@ -0,0 +1,347 @@
+/*
+ Box export source file.
+ Here we implement the export file of a box factory - its delta and varint encoding, and its streaming decoder.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* fileno and fsync. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <limits.h>
+
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "box_file.h"
+
+#include "box_export.h"
+
+
+#define BOX_EXPORT_MAX_RUN (4 * BOX_FILE_MAX_VARINT)			/* The most bytes of a record - with the two varints of the group it starts. */
+
+
+/* Functions' prototype declarations: */
+
+
+/* Add the given bytes of the buffer to the hash, write them to the file and empty the buffer. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_export_flush(FILE *file, unsigned char *buffer, size_t *size, unsigned long long *hash);
+
+
+/* Make sure the buffer of the reader has the bytes of a whole record, unless the file ends before them - the bytes which weren't decoded yet are
+ moved to the start of the buffer, and followed by the next bytes of the file. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_export_fill(box_export_reader *reader);
+
+
+/* Check the end of the file, once all the records were decoded - the numbers of the header, the checksum, and that nothing follows it.
+ Returns FALSE if the file is invalid, TRUE otherwise. */
+
+static bool box_export_verify_end(box_export_reader *reader);
+
+
+/* The implementation: */
+
+
+static bool box_export_flush(FILE *file, unsigned char *buffer, size_t *size, unsigned long long *hash)
+{
+
+    bool written = (fwrite(buffer, 1, *size, file) == *size);
+
+    *hash = box_file_hash(*hash, buffer, *size);
+    *size = 0;
+
+    return written;
+}
+
+
+bool box_export_write(const char *path, const box_snapshot_record *records, unsigned int record_count)
+{
+
+    box_export_header header;
+    unsigned char *buffer = NULL;
+    size_t size = 0;
+    unsigned long long hash = BOX_FILE_HASH_INIT;
+    unsigned int i = 0;
+    unsigned int group_end = 0;
+    box_dim side_square = 0;
+    box_dim height = 0;
+    char *temporary_path = NULL;
+    FILE *file = NULL;
+    bool written = true;
+
+    memset(&header, 0, sizeof(box_export_header));
+
+    for (i = 0; i < record_count; ++i) {
+
+        header.box_count += records[i].count;
+
+        if ((i == 0) || (records[i].side_square != records[i - 1].side_square)) {
+
+            header.side_count++;
+        }
+    }
+
+    header.magic = BOX_EXPORT_MAGIC;
+    header.version = BOX_EXPORT_VERSION;
+    header.dim_size = sizeof(box_dim);
+    header.record_count = record_count;
+
+    buffer = malloc(BOX_EXPORT_BUFFER_SIZE);
+    temporary_path = malloc(strlen(path) + sizeof(".tmp"));
+
+    if ((buffer == NULL) || (temporary_path == NULL)) {
+
+        free(buffer);
+        free(temporary_path);
+
+        return false;
+    }
+
+    sprintf(temporary_path, "%s.tmp", path);
+    file = fopen(temporary_path, "wb");
+
+    written = (file != NULL) && (fwrite(&header, sizeof(box_export_header), 1, file) == 1);
+    hash = box_file_hash(hash, &header, sizeof(box_export_header));
+
+    /* The records are encoded into the buffer, which is written whenever it may not have room for one more record. */
+
+    for (i = 0; (i < record_count) && written; ++i) {
+
+        if ((size + BOX_EXPORT_MAX_RUN > BOX_EXPORT_BUFFER_SIZE) && !box_export_flush(file, buffer, &size, &hash)) {
+
+            written = false;
+            break;
+        }
+
+        if (i == group_end) {			/* The first record of a side - start its group, which ends at the next side. */
+
+            group_end = i + 1;
+
+            while ((group_end < record_count) && (records[group_end].side_square == records[i].side_square)) {
+
+                group_end++;
+            }
+
+            size += box_file_put_varint(buffer + size, records[i].side_square - side_square);
+            size += box_file_put_varint(buffer + size, group_end - i);
+
+            side_square = records[i].side_square;
+            height = 0;
+        }
+
+        size += box_file_put_varint(buffer + size, records[i].height - height);
+        size += box_file_put_varint(buffer + size, records[i].count);
+
+        height = records[i].height;
+    }
+
+    written = written && box_export_flush(file, buffer, &size, &hash) && (fwrite(&hash, sizeof(hash), 1, file) == 1);
+
+    if (file != NULL) {
+
+        written = written && (fflush(file) == 0) && (fsync(fileno(file)) == 0);
+        written = (fclose(file) == 0) && written;
+    }
+
+    written = written && (rename(temporary_path, path) == 0) && box_file_sync_directory(path);
+
+    if (!written) {
+
+        remove(temporary_path);
+    }
+
+    free(buffer);
+    free(temporary_path);
+
+    return written;
+}
+
+
+box_export_reader* box_export_open(const char *path)
+{
+
+    box_export_reader *reader = calloc(sizeof(box_export_reader), 1);
+    struct stat status;
+    unsigned long long body_size = 0;
+
+    if (reader == NULL) {
+
+        return NULL;
+    }
+
+    reader->file = fopen(path, "rb");
+    reader->buffer = malloc(BOX_EXPORT_BUFFER_SIZE);
+
+    if ((reader->file == NULL) || (reader->buffer == NULL) || (fread(&(reader->header), sizeof(box_export_header), 1, reader->file) != 1) ||
+        (fstat(fileno(reader->file), &status) != 0) || ((unsigned long long) status.st_size < sizeof(box_export_header) + sizeof(reader->hash))) {
+
+        box_export_close(reader);
+        return NULL;
+    }
+
+    /* Every record takes two bytes at least, and so does every group - so the numbers of the header are checked against the size of the file before
+     anyone allocates by them. */
+
+    body_size = (unsigned long long) status.st_size - sizeof(box_export_header) - sizeof(reader->hash);
+
+    if ((reader->header.record_count > body_size / 2) || (reader->header.side_count > body_size / 2 - reader->header.record_count) ||
+        (reader->header.magic != BOX_EXPORT_MAGIC) || (reader->header.version != BOX_EXPORT_VERSION) || (reader->header.dim_size != sizeof(box_dim)) ||
+        (reader->header.record_count > UINT_MAX) || (reader->header.side_count > reader->header.record_count) ||
+        ((reader->header.side_count == 0) != (reader->header.record_count == 0))) {
+
+        box_export_close(reader);
+        return NULL;
+    }
+
+    reader->hash = box_file_hash(BOX_FILE_HASH_INIT, &(reader->header), sizeof(box_export_header));
+
+    if ((reader->header.record_count == 0) && !box_export_verify_end(reader)) {			/* Only the checksum follows the header. */
+
+        box_export_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+
+static bool box_export_fill(box_export_reader *reader)
+{
+
+    size_t wanted = 0;
+
+    if (reader->end_of_file || (reader->size - reader->position >= BOX_EXPORT_MAX_RUN)) {
+
+        return true;
+    }
+
+    memmove(reader->buffer, reader->buffer + reader->position, reader->size - reader->position);
+    reader->size -= reader->position;
+    reader->position = 0;
+
+    wanted = BOX_EXPORT_BUFFER_SIZE - reader->size;
+    reader->size += fread(reader->buffer + reader->size, 1, wanted, reader->file);
+
+    if (reader->size < BOX_EXPORT_BUFFER_SIZE) {			/* fread returns less than it was asked for only at the end of the file or on an error. */
+
+        reader->end_of_file = true;
+    }
+
+    return !ferror(reader->file);
+}
+
+
+static bool box_export_verify_end(box_export_reader *reader)
+{
+
+    unsigned long long checksum = 0;
+
+    if ((reader->side != reader->header.side_count) || (reader->box_count != reader->header.box_count) || !box_export_fill(reader) ||
+        !reader->end_of_file || (reader->size - reader->position != sizeof(checksum))) {
+
+        return false;
+    }
+
+    memcpy(&checksum, reader->buffer + reader->position, sizeof(checksum));
+    reader->position += sizeof(checksum);
+
+    return (checksum == reader->hash);
+}
+
+
+bool box_export_next(box_export_reader *reader, box_snapshot_record *record)
+{
+
+    unsigned long long side_delta = 0;
+    unsigned long long group_records = 0;
+    unsigned long long height_delta = 0;
+    unsigned long long count = 0;
+    size_t start = 0;
+    bool first = false;			/* TRUE for the first record of a group. */
+    bool decoded = true;
+
+    if (reader->failed || (reader->record == reader->header.record_count)) {
+
+        return false;
+    }
+
+    if (!box_export_fill(reader)) {
+
+        reader->failed = true;
+        return false;
+    }
+
+    start = reader->position;
+
+    /* The values are checked as they are decoded - the sides and the heights of a group must increase, and no value may overflow a box_dim - so an
+     invalid file is found before its records are used, even though its checksum is only verified at its end. */
+
+    if (reader->group_records == 0) {
+
+        decoded = box_file_get_varint(reader->buffer, reader->size, &(reader->position), &side_delta) &&
+                  box_file_get_varint(reader->buffer, reader->size, &(reader->position), &group_records) &&
+                  (reader->side < reader->header.side_count) && ((reader->side == 0) || (side_delta > 0)) &&
+                  (side_delta <= (box_dim) ~(reader->side_square)) && (group_records > 0) &&
+                  (group_records <= reader->header.record_count - reader->record);
+
+        if (decoded) {
+
+            reader->side++;
+            reader->side_square += (box_dim) side_delta;
+            reader->group_records = group_records;
+            reader->height = 0;
+
+            first = true;
+        }
+    }
+
+    decoded = decoded && box_file_get_varint(reader->buffer, reader->size, &(reader->position), &height_delta) &&
+              box_file_get_varint(reader->buffer, reader->size, &(reader->position), &count) && (first || (height_delta > 0)) &&
+              (height_delta <= (box_dim) ~(reader->height)) && (count > 0) && (count <= UINT_MAX);
+
+    if (!decoded) {
+
+        reader->failed = true;
+        return false;
+    }
+
+    reader->hash = box_file_hash(reader->hash, reader->buffer + start, reader->position - start);
+    reader->height += (box_dim) height_delta;
+    reader->group_records--;
+    reader->record++;
+    reader->box_count += count;
+
+    record->side_square = reader->side_square;
+    record->height = reader->height;
+    record->count = (unsigned int) count;
+
+    if ((reader->record == reader->header.record_count) && !box_export_verify_end(reader)) {
+
+        reader->failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+void box_export_close(box_export_reader *reader)
+{
+
+    if (reader->file != NULL) {
+
+        fclose(reader->file);
+    }
+
+    free(reader->buffer);
+    free(reader);
+}
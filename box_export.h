@@ -0,0 +1,87 @@
+/* Box export header file.
+ Contains the structures and functions' prototype declarations of the export of a box factory - a compact file of its inventory for archiving and
+ for shipping between sites, as opposed to the snapshot (box_snapshot.h), which is larger but used directly from memory.
+ The file is a header followed by the sizes of the boxes in the order of tree_by_side, in groups of a single (side * side): a group is the difference of
+ its (side * side) from the one of the previous group and its number of records, followed by its records - the difference of every height from the
+ previous height of the group, and the number of boxes of that size. All of them are varints (see box_file.h) - the sorted values have small
+ differences, so most of them take a byte or two instead of the 12 bytes of a record of the snapshot. The first (side * side) of the file and the first
+ height of every group are differences from 0. The file ends with a checksum of the header and the groups.
+ The file is read by a streaming decoder (box_export_reader), one record at a time in the order of the snapshot records, with a small buffer - so the
+ records go directly to the bulk build of a box factory (box_factory_import) without an intermediate file. */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include "box_types.h"
+
+#include "box_snapshot.h"
+
+#ifndef BOX_EXPORT_H_
+#define BOX_EXPORT_H_
+
+
+#define BOX_EXPORT_MAGIC 0x0000505845584F42ULL			/* "BOXEXP" */
+
+#define BOX_EXPORT_VERSION 1
+
+#define BOX_EXPORT_BUFFER_SIZE 65536			/* The size of the buffer of the writer and of the reader. */
+
+
+typedef struct box_export_header_s {			/* The header of an export file. */
+
+    unsigned long long magic;
+    unsigned int version;
+    unsigned int dim_size;			/* sizeof(box_dim) of the writer (see box_types.h.) */
+    unsigned long long record_count;
+    unsigned long long side_count;
+    unsigned long long box_count;			/* The sum of the counts of the records. */
+} box_export_header;
+
+
+typedef struct box_export_reader_s {			/* Box export reader structure - an export file open for decoding. */
+
+    FILE *file;
+    box_export_header header;
+    unsigned char *buffer;			/* The bytes read from the file, from position to size not decoded yet. */
+    size_t position;
+    size_t size;
+    bool end_of_file;
+    unsigned long long hash;			/* The checksum of the bytes decoded so far. */
+    unsigned long long record;			/* Number of records decoded. */
+    unsigned long long side;			/* Number of groups started. */
+    unsigned long long box_count;			/* The sum of the counts of the records decoded. */
+    unsigned long long group_records;			/* Number of records of the current group which weren't decoded yet. */
+    box_dim side_square;			/* The (side * side) of the current group, and its last height. */
+    box_dim height;
+    bool failed;			/* TRUE once the file was found invalid, or on an I/O error. */
+} box_export_reader;
+
+
+/* Write an export of the given records (sorted by (side * side) and then by height, every size once) to the given path. The file is written under a
+ temporary name, synced and renamed over the path, so a crash leaves either the previous file or the new one.
+ Returns FALSE on an allocation error or an I/O error, TRUE otherwise. */
+
+bool box_export_write(const char *path, const box_snapshot_record *records, unsigned int record_count);
+
+
+/* Open the export file of the given path for decoding, and verify its header.
+ Returns NULL on an allocation error, an I/O error or an invalid header, otherwise returns a pointer to box_export_reader. */
+
+box_export_reader* box_export_open(const char *path);
+
+
+/* Decode the next record of the file into record, in the order of the records of box_export_write. Once the last record was decoded, the checksum is
+ verified and the end of the file is expected.
+ Returns FALSE at the end of the records or on an error - the field failed of the reader tells them apart - TRUE otherwise. */
+
+bool box_export_next(box_export_reader *reader, box_snapshot_record *record);
+
+
+/* Close the file and free the reader. */
+
+void box_export_close(box_export_reader *reader);
+
+
+#endif /* BOX_EXPORT_H_ */
@@ -4,14 +4,32 @@
  */
 
 
+#define _POSIX_C_SOURCE 200809L			/* access. */
+
 #include <stdbool.h>
 
 #include <stdlib.h>
 
+#include <string.h>
+
+#include <limits.h>
+
+#include <math.h>
+
+#include <unistd.h>
+
 #include "rb_tree.h"
 
 #include "box_factory.h"
 
+#include "veb_tree.h"
+
+#include "adaptive_set.h"
+
+#include "box_planner.h"
+
+#include "box_cursor.h"
+
 
 /* Functions' prototype declarations: */
 
@@ -34,773 +52,3650 @@ static int compare_subtree_keys(void *a, void *b);
  Returns NULL on an allocation error, otherwise returns a pointer to the key.
  The parameter is: either height or (side * side) value of the box, which will be assigned to val field of the created key of the main tree. */
 
-static main_tree_key* create_main_tree_key(unsigned int main_val);
+static main_tree_key* create_main_tree_key(box_factory *factory, box_dim main_val);
 
 
 /* Free an allocated given main tree key, assuming that it's subtree is empty. */
 
-static void free_main_tree_key(main_tree_key *main_key);
+static void free_main_tree_key(box_factory *factory, main_tree_key *main_key);
 
 
 /* Create a key of the subtree (of the key of a main tree of the box factory.)
  Returns NULL on an allocation error, otherwise returns a pointer to the key.
  The parameter is: either height or (side * side) value of the box, which will be assigned to val field of the created key of the subtree. */
 
-static subtree_key* create_subtree_key(unsigned int sub_val);
+static subtree_key* create_subtree_key(box_factory *factory, box_dim sub_val);
 
 
-/* Insertion function to tree_by_side. Returns FALSE if we fail to insert the keys of the given dimensions, TRUE otherwise.
- The function will be called by box_factory_insert. */
+/* Allocate a zeroed object of the given size for the main trees of the box factory - from its arena, if it has one. Returns NULL on an allocation error. */
 
-static bool box_factory_insert_tree_by_side(box_factory *factory, unsigned int side, unsigned int height);
+static void* box_factory_alloc(box_factory *factory, size_t size);
 
 
-/* Insertion function to tree_by_height. Returns FALSE if we fail to insert the keys of the given dimensions, TRUE otherwise.
- The function will be called by box_factory_insert. */
+/* Free an object of the given size, allocated by box_factory_alloc. Nothing is done for NULL. */
 
-static bool box_factory_insert_tree_by_height(box_factory *factory, unsigned int side, unsigned int height);
+static void box_factory_free(box_factory *factory, void *object, size_t size);
 
 
-/* Removal function from tree_by_side. Returns FALSE if we fail to remove the keys of the given dimensions, TRUE otherwise.
- The function will be called by box_factory_remove. */
+/* Free a key of a main tree with its subtree and the keys of the subtree - the free_key function of rb_tree_destroy (the context is the box factory.) */
 
-static bool box_factory_remove_tree_by_side(box_factory *factory, unsigned int side, unsigned int height);
+static void destroy_main_tree_key(void *key, void *context);
 
 
-/* Removal function from tree_by_height. Returns FALSE if we fail to remove the keys of the given dimensions, TRUE otherwise.
- The function will be called by box_factory_remove. */
+/* Free a key of a subtree - the free_key function of rb_tree_destroy (the context is the box factory.) */
 
-static bool box_factory_remove_tree_by_height(box_factory *factory, unsigned int side, unsigned int height);
+static void destroy_subtree_key(void *key, void *context);
 
 
-/* A function implementing GETBOX - it is general and can receive as a parameter either one of the box factory's main trees (tree_by_side / tree_by_height.)
- Will be called by box_factory_get_box, passing to it the main tree which is smaller (we compare m and n, which represent the number of unique
- keys in the main trees - tree_by_side and tree_by_height accordingly.) */
+/* Build a main tree of the box factory (tree_by_side if by_side is TRUE, otherwise tree_by_height) from the records of the snapshot, in O(n) steps.
+ main_keys, sub_keys and counts are arrays of at least record_count elements for the keys and the counts of the trees being built.
+ Returns NULL on an allocation error (nothing is left allocated then), otherwise returns a pointer to the tree. */
 
-static bool box_factory_get_by_input(rb_tree *tree, unsigned int main_val, unsigned int sub_val, unsigned int *found_main_val, unsigned int *found_sub_val);
+static rb_tree* box_factory_build_main_tree(box_factory *factory, box_snapshot *snapshot, bool by_side, void **main_keys, void **sub_keys,
+                                            unsigned int *counts);
 
 
-/* A function implementing CHECKBOX - it is general and can receive as a parameter either one of the box factory's main trees
- (tree_by_side / tree_by_height.) Will be called by box_factory_check_box, passing to it the main tree which is smaller (we compare m and n, which represent
- the number of unique keys in the main trees - tree_by_side and tree_by_height accordingly.) */
+/* Add a box of the given dimensions to the box index (if there is one) and to the optional indexes, but not to the main trees.
+ Returns FALSE on an allocation error, in which case the box is in none of them, TRUE otherwise. */
 
-static bool box_factory_check_by_input(rb_tree *tree, unsigned int main_val, unsigned int sub_val);
+static bool box_factory_insert_indexes(box_factory *factory, box_dim side, box_dim height);
 
 
-/* Return val of the key of a given main tree node. */
+/* Remove the boxes added by box_factory_load_snapshot to the box index and to the optional indexes before it failed - all the boxes of the records of the
+ snapshot before the given record, and the given number of boxes of that record. */
 
-static unsigned int get_main_tree_node_val(rb_tree_node *main_tree_node);
+static void box_factory_unload_indexes(box_factory *factory, unsigned int record, unsigned int units);
 
 
-/* Return val of the key of a given subtree node. */
+/* Collect the sizes of the boxes of the box factory for a snapshot - records would contain a new array of them, sorted by (side * side) and then by
+ height, and record_count the number of the sizes. Returns FALSE on an allocation error, TRUE otherwise. */
 
-static unsigned int get_subtree_node_val(rb_tree_node *sub_tree_node);
+static bool box_factory_collect(box_factory *factory, box_snapshot_record **records, unsigned int *record_count);
 
 
-/* Return val of the key of a maximum node in the subtree of the key of a given main tree node. */
+/* Insert a box of the given dimensions to the structures of the box factory, without logging it - box_factory_insert after its checks.
+ Returns FALSE on an allocation error, TRUE otherwise. */
 
-static unsigned int get_subtree_max_node_val(rb_tree_node *main_tree_node);
+static bool box_factory_insert_box(box_factory *factory, box_dim side, box_dim height);
 
 
-/* Return a pointer to the subtree of a given main tree node. */
+/* Remove a box of the given dimensions from the structures of the box factory, without logging it - box_factory_remove after its checks.
+ Returns FALSE if there's no box of the given dimensions, TRUE otherwise. */
 
-static rb_tree* get_subtree(rb_tree_node *main_tree_node);
+static bool box_factory_remove_box(box_factory *factory, box_dim side, box_dim height);
 
 
-/* The implementation: */
+/* End a change of the box factory in its write-ahead log (see box_wal_commit.) If the log can't be written, the change stays in memory, but the box
+ factory becomes read-only, since its changes can't be made durable anymore. Returns FALSE then, TRUE otherwise (also without a log.) */
 
+static bool box_factory_commit_log(box_factory *factory);
 
-static int compare_main_tree_keys(void *a, void *b)
-{
 
-	main_tree_key *key_a = a;
-	main_tree_key *key_b = b;
+/* The public functions of the same names without the trace - the public ones record every call in the trace of the box factory, if it has one (see
+ box_factory_trace_begin), and call these. */
 
-    if (key_a->val < key_b->val) {
+static bool box_factory_run_insert(box_factory *factory, box_dim side, box_dim height);
 
-        return -1;
-    }
+static bool box_factory_run_remove(box_factory *factory, box_dim side, box_dim height);
 
-    if (key_a->val > key_b->val) {
+static bool box_factory_run_get_box(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height);
 
-        return 1;
-    }
+static bool box_factory_run_get_box_approx(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height);
 
-    return 0;			/* If val contents of two keys of the main tree are equal. */
-}
+static bool box_factory_run_check_box(box_factory *factory, box_dim side, box_dim height);
 
+static unsigned int box_factory_run_get_top_k(box_factory *factory, box_dim side, box_dim height, unsigned int k, box_factory_box out[]);
 
-static int compare_subtree_keys(void *a, void *b)
-{
+static bool box_factory_run_set_price(box_factory *factory, box_dim side, box_dim height, double price);
 
-	subtree_key *key_a = a;
-	subtree_key *key_b = b;
+static bool box_factory_run_remove_price(box_factory *factory, box_dim side, box_dim height);
 
-    if (key_a->val < key_b->val) {
+static bool box_factory_run_get_cheapest(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height,
+                                         double *found_cost);
 
-        return -1;
-    }
+static bool box_factory_run_assign_batch(box_factory *factory, box_factory_present presents[], unsigned int count, unsigned int *unassigned);
 
-    if (key_a->val > key_b->val) {
+static unsigned long long box_factory_run_count_suitable(box_factory *factory, box_dim side, box_dim height);
 
-        return 1;
-    }
+static unsigned int box_factory_run_count_sides(box_factory *factory, box_dim min_side, box_dim max_side);
 
-    return 0;			/* If val contents of two keys of the subtree are equal. */
-}
 
+/* Apply a record of the write-ahead log to the box factory - the box_wal_apply function of box_factory_recover (the context is the box factory.) */
 
-box_factory* box_factory_create()
-{
+static bool box_factory_apply_record(void *context, box_wal_op op, box_dim side, box_dim height, unsigned int count);
 
-    box_factory *factory = NULL;
-    rb_tree *rb_tree = NULL;
 
-    factory = calloc(sizeof(box_factory), 1);
+/* Write the snapshot of a background checkpoint in the child process - the box_checkpoint_write function (the context is the box factory.) */
 
-    if (factory == NULL) {
+static bool box_factory_checkpoint_write(void *context, const char *path);
 
-        return NULL;
-    }
 
-    rb_tree = rb_tree_create((rb_tree_compare) compare_main_tree_keys);
+/* Insertion function to tree_by_side. Returns FALSE if we fail to insert the keys of the given dimensions, TRUE otherwise.
+ The function will be called by box_factory_insert. */
 
-    if (rb_tree == NULL) {
+static bool box_factory_insert_tree_by_side(box_factory *factory, box_dim side, box_dim height);
 
-        free(factory);
-        return NULL;
-    }
 
-    factory->tree_by_side = rb_tree;
+/* Insertion function to tree_by_height. Returns FALSE if we fail to insert the keys of the given dimensions, TRUE otherwise.
+ The function will be called by box_factory_insert. */
 
-    rb_tree = rb_tree_create((rb_tree_compare) compare_main_tree_keys);
+static bool box_factory_insert_tree_by_height(box_factory *factory, box_dim side, box_dim height);
 
-    if (rb_tree == NULL) {	/* If we failed to create the second main tree - free all other fields of the box factory structure and the factory itself. */
 
-        free(factory->tree_by_side);
-        free(factory);
-        return NULL;
-    }
+/* Removal function from tree_by_side. Returns FALSE if we fail to remove the keys of the given dimensions, TRUE otherwise.
+ last_unit would be TRUE if the removed box was the last one of the given dimensions. The function will be called by box_factory_remove. */
 
-    factory->tree_by_height = rb_tree;
+static bool box_factory_remove_tree_by_side(box_factory *factory, box_dim side, box_dim height, bool *last_unit);
 
-    return factory;
-}
 
+/* Removal function from tree_by_height. Returns FALSE if we fail to remove the keys of the given dimensions, TRUE otherwise.
+ The function will be called by box_factory_remove. */
 
-static main_tree_key* create_main_tree_key(unsigned int main_val)
-{
+static bool box_factory_remove_tree_by_height(box_factory *factory, box_dim side, box_dim height);
 
-	main_tree_key *main_key = calloc(sizeof(main_tree_key), 1);
 
-    rb_tree *subtree = NULL;
+/* A function implementing GETBOX - it is general and can receive as a parameter either one of the box factory's main trees (tree_by_side / tree_by_height.)
+ Will be called by box_factory_get_box, passing to it the main tree chosen by the planner (the one expected to have less keys larger than or equal
+ to the given value), and the cascaded index of that main tree. main_is_side tells which dimension is the main one - of the sizes of the minimal
+ volume, the one of the smallest side is returned, whichever main tree is scanned (the order of box_factory_get_top_k.) */
 
-    if (main_key == NULL) {
+static bool box_factory_get_by_input(rb_tree *tree, box_cascade *cascade, bool main_is_side, box_dim main_val, box_dim sub_val,
+                                     box_dim *found_main_val, box_dim *found_sub_val);
 
-        return NULL;
-    }
 
-    main_key->val = main_val;
+/* A function implementing CHECKBOX - it is general and can receive as a parameter either one of the box factory's main trees
+ (tree_by_side / tree_by_height.) Will be called by box_factory_check_box, passing to it the main tree chosen by the planner. */
 
-    subtree = rb_tree_create((rb_tree_compare) compare_subtree_keys);
+static bool box_factory_check_by_input(rb_tree *tree, box_dim main_val, box_dim sub_val);
 
-    if (subtree == NULL) {
 
-        free(main_key);
-        return NULL;
-    }
+/* Return val of the key of a given main tree node. */
 
-    main_key->subtree = subtree;
+static box_dim get_main_tree_node_val(rb_tree_node *main_tree_node);
 
-    return main_key;
-}
 
+/* Return TRUE if the size a comes before the size b in the order of box_factory_get_top_k - a smaller volume, then a smaller side, then a smaller
+ height (sizes with a zero side have equal volumes and equal sides.) */
 
-static void free_main_tree_key(main_tree_key *main_key)
-{
+static bool box_factory_box_less(box_factory_box *a, box_factory_box *b);
 
-    free(main_key->subtree);
-    free(main_key);
-}
 
+/* Offer a size to the bounded heap of box_factory_get_top_k - a max-heap of at most k sizes, whose first element is the worst of them.
+ The size is added if the heap isn't full, or replaces the worst size if it comes before it. */
 
-static subtree_key* create_subtree_key(unsigned int sub_val)
-{
+static void box_factory_top_k_offer(box_factory_box heap[], unsigned int k, unsigned int *count, box_factory_box *box);
 
-	subtree_key *sub_key = calloc(sizeof(subtree_key), 1);
 
-    if (sub_key == NULL) {
+/* Move the element i of the bounded heap of count elements down to its place. */
 
-        return NULL;
-    }
+static void box_factory_top_k_sift_down(box_factory_box heap[], unsigned int count, unsigned int i);
 
-    sub_key->val = sub_val;
 
-    return sub_key;
-}
+/* A function implementing box_factory_get_top_k over either one of the main trees - the scan of box_factory_get_by_input, which offers every suitable
+ size of every candidate subtree that may still enter the heap. main_is_side tells which dimension is the main one. */
 
+static void box_factory_top_k_by_input(rb_tree *tree, bool main_is_side, box_dim main_val, box_dim sub_val, unsigned int k,
+                                       box_factory_box heap[], unsigned int *count);
 
-static bool box_factory_insert_tree_by_side(box_factory *factory, unsigned int side, unsigned int height)
-{
 
-	main_tree_key *new_main_key = NULL;
-	main_tree_key *tree_by_side_key = NULL;
+typedef struct box_factory_candidate_s {			/* The cheapest suitable size found so far by box_factory_get_cheapest. */
 
-    subtree_key *new_sub_key = NULL;
+    bool found;
+    double cost;
+    box_dim side_square;
+    box_dim height;
+} box_factory_candidate;
 
-    bool exists_in_tree_by_side = false;
-    bool exists_in_subtree = false;
 
-    /* Before trying to insert a new key to this main tree (tree_by_side), one of the following cases is true:
+/* Replace the candidate by the given size if it comes before it - a smaller cost, or the same cost and a smaller volume, or the same volume and a smaller
+ side (or the same side and a smaller height - only a zero volume may have several sizes of the same side.) */
 
-     1) There's no box with the given side in the box factory - meaning the key with val = (side * side) wouldn't be found in tree_by_side.
-     2) There is a box with the given side, but not with the given height - meaning the key with val = (side * side) would be found in tree_by_side,
-        but the key with val = height wouldn't be found in the corresponding subtree.
-     3) There is a box with the given side and with the given height - meaning the key with val = (side * side) would be found in tree_by_side and the
-        key with val = height would be found in the corresponding subtree. */
+static void box_factory_offer_candidate(box_factory_candidate *best, double cost, box_dim side_square, box_dim height);
 
-    new_main_key = create_main_tree_key(side * side);			/* Create a key of tree_by_side with val = (side * side). */
 
-    if (new_main_key == NULL) {
+/* Return TRUE if no size whose cost is at least the given cost, and whose volume is at least the given volume, can replace the candidate. */
 
-        return false;
-    }
+static bool box_factory_candidate_beats(box_factory_candidate *best, double cost, box_volume volume);
 
-    new_sub_key = create_subtree_key(height);			/* Create a key of the subtree (of the key of tree_by_side) with val = height. */
 
-    if (create_subtree_key == NULL) {
+/* A function implementing box_factory_get_cheapest over either one of the main trees. With a monotone cost it is the scan of box_factory_get_by_input:
+ every candidate subtree offers its first suitable size without a price, and the scan stops once the cost of the smallest suitable size of a main node
+ can't beat the candidate (the sizes with prices are offered by box_factory_cheapest_by_price.) Otherwise every suitable size is offered. */
 
-        return false;
-    }
+static void box_factory_cheapest_by_input(box_factory *factory, rb_tree *tree, bool main_is_side, box_dim main_val, box_dim sub_val,
+                                          box_factory_candidate *best);
 
-    /* First, we would search in the main tree (tree_by_side) in order to check whether the box of the given side already exists in the box factory. */
 
-    tree_by_side_key = rb_tree_search_exact(factory->tree_by_side, new_main_key);
+/* The same as box_factory_cheapest_by_input, over the sides of the box index. */
 
-    if (tree_by_side_key == NULL) {			/* Case 1 - there's no box with the given side in the box factory. */
+static void box_factory_cheapest_by_index(box_factory *factory, box_dim side, box_dim height, box_factory_candidate *best);
 
-        /* So we insert new_main_key to tree_by_side - this must be a new key in the tree. */
 
-        if (rb_tree_insert(factory->tree_by_side, new_main_key, &exists_in_tree_by_side) == false) {
+/* Offer every size with a price which is suitable for the given dimensions, and has boxes in the box factory. */
 
-            free(new_main_key);			/* Free an allocated memory in case of insertion failure. */
-            free(new_sub_key);
+static void box_factory_cheapest_by_price(box_factory *factory, box_dim side_square, box_dim height, box_factory_candidate *best);
 
-            return false;
-        }
 
-        /* Insert new_sub_key to the subtree of new_main_key - this must be a new key in the tree. */
+/* Return the number of boxes of the given dimensions ((side * side) and height) in the box factory. */
 
-        if (rb_tree_insert(new_main_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+static unsigned int box_factory_instances(box_factory *factory, box_dim side_square, box_dim height);
 
-            rb_tree_remove(factory->tree_by_side, new_main_key, (void **) &tree_by_side_key);	/* If failed to insert to subtree - remove new_main_key. */
 
-            free_main_tree_key(new_main_key);
-            free(new_sub_key);
+typedef struct box_factory_batch_item_s {			/* A present of box_factory_assign_batch, in the order of processing. */
 
-            return false;
-        }
+    box_volume volume;
+    box_dim side;
+    box_dim height;
+    unsigned int index;			/* The index of the present in the array of the presents. */
+} box_factory_batch_item;
 
-        return true;
-    }
 
-    /* Now, if there is a box with the given side in the box factory (tree_by_side_key != NULL): */
+/* Comparison function between two items of box_factory_assign_batch, for qsort - the item which is processed first is the smaller one. */
 
-    free_main_tree_key(new_main_key);			/* Free the memory allocated for new_main_key, because we found that it already exists in tree_by_side. */
+static int compare_batch_items(const void *a, const void *b);
 
-    /* Now we take care of cases 2 and 3.
 
-    Insert new_sub_key to the subtree of found tree_by_side_key. */
+/* Remove up to 'wanted' boxes of the given dimensions ((side * side) and height), which must exist in the box factory, with a single search in each
+ structure. Returns the number of boxes removed - all the boxes of these dimensions, if there are less than 'wanted' of them.
+ Unlike box_factory_remove, the cascaded indexes are kept as long as the dimensions don't run out. */
 
-    if (rb_tree_insert(tree_by_side_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+static unsigned int box_factory_take_boxes(box_factory *factory, box_dim side_square, box_dim height, unsigned int wanted);
 
-        free(new_sub_key);
 
-        return false;
-    }
+/* box_factory_count_suitable without a dominance index, over the main trees - sum the counts of the suitable heights of every side from the given one. */
 
-    /* Case 3 - there's a box in the box factory with the given side and with the given height. */
+static unsigned long long box_factory_count_by_side(box_factory *factory, box_dim side, box_dim height);
 
-    if (exists_in_subtree) {
 
-        free(new_sub_key);			/* Free the memory allocated for new_sub_key, because we found that it already exists in the corresponding subtree. */
-    }
+typedef struct box_factory_disk_scan_s {			/* The state of a scan of the B+-tree of a box factory on disk, by one of the visiting functions below. */
 
-    return true;
-}
+    box_factory *factory;
+    box_dim height;			/* The height of the query. */
+    box_dim side_square;			/* The side of the last size visited, if has_side is TRUE. */
+    box_dim max_side_square;			/* box_factory_count_sides - the last side of the range. */
+    bool has_side;
+    bool failed;			/* box_factory_open_disk - TRUE if an optional index couldn't get a box. */
+    unsigned long long count;			/* The number of boxes, sides or records found so far. */
+    box_snapshot_record *records;			/* box_factory_collect - the array of the records. */
+    box_factory_box *heap;			/* box_factory_get_top_k - the bounded heap, of at most k sizes. */
+    unsigned int k;
+    unsigned int heap_count;
+    box_factory_candidate *best;			/* box_factory_get_cheapest - the candidate. */
+} box_factory_disk_scan;
 
 
-static bool box_factory_insert_tree_by_height(box_factory *factory, unsigned int side, unsigned int height)
-{
+/* Visiting functions of the B+-tree (see box_btree_scan) - copy every size to the records (collect), offer the sizes to the heap of top-k until none
+ may enter it (top_k), offer the sizes like box_factory_cheapest_by_input (cheapest), sum the boxes (count), count the different sides up to the last
+ side of the range (sides), and insert the boxes into the optional indexes (load). */
 
-	main_tree_key *new_main_key = NULL;
-	main_tree_key *tree_by_height_key = NULL;
+static bool box_factory_collect_visit(void *context, const box_snapshot_record *record);
 
-    subtree_key *new_sub_key = NULL;
+static bool box_factory_top_k_visit(void *context, const box_snapshot_record *record);
 
-    bool exists_in_tree_by_height = false;
-    bool exists_in_subtree = false;
+static bool box_factory_cheapest_visit(void *context, const box_snapshot_record *record);
 
-    /* Before trying to insert a new key to this main tree (tree_by_height), one of the following cases is true:
+static bool box_factory_count_visit(void *context, const box_snapshot_record *record);
 
-     1) There's no box with the given height in the box factory - meaning the key with val = height wouldn't be found in tree_by_height.
-     2) There is a box with the given height, but not with the given side - meaning the key with val = height would be found in tree_by_height,
-        but the key with val = (side * side) wouldn't be found in the corresponding subtree.
-     3) There is a box with the given height and with the given side - meaning the key with val = height would be found in tree_by_height and the
-        key with val = (side * side) would be found in the corresponding subtree. */
+static bool box_factory_sides_visit(void *context, const box_snapshot_record *record);
 
-    new_main_key = create_main_tree_key(height);			/* Create a key of tree_by_height with val = height. */
+static bool box_factory_load_visit(void *context, const box_snapshot_record *record);
 
-    if (new_main_key == NULL) {
 
-        return false;
-    }
+/* box_factory_create_with_options, and box_factory_open_disk if existing_disk is TRUE - the B+-tree file of disk_path of the options is opened then,
+ instead of created. */
 
-    new_sub_key = create_subtree_key(side * side);			/* Create a key of the subtree (of the key of tree_by_height) with val = (side * side). */
+static box_factory* box_factory_create_structures(const box_factory_options *options, bool existing_disk);
 
-    if (create_subtree_key == NULL) {
 
-        return false;
-    }
+/* Remove a box of the given dimensions from the main trees, or from the box index - used to undo an insertion which failed after them. */
 
-    /* First, we would search in the main tree (tree_by_height) in order to check whether the box of the given height already exists in the box factory. */
+static void box_factory_undo_insert(box_factory *factory, box_dim side, box_dim height);
 
-    tree_by_height_key = rb_tree_search_exact(factory->tree_by_height, new_main_key);
 
-    if (tree_by_height_key == NULL) {			/* Case 1 - there's no box with the given height in the box factory. */
+/* Return the side of the boxes of the given (side * side). */
 
-        /* So we insert new_main_key to tree_by_height - this must be a new key in the tree. */
+static box_dim box_factory_side_of(box_dim side_square);
 
-        if (rb_tree_insert(factory->tree_by_height, new_main_key, &exists_in_tree_by_height) == false) {
 
-            free(new_main_key);			/* Free an allocated memory in case of insertion failure. */
-            free(new_sub_key);
+/* Return val of the key of a given subtree node. */
 
-            return false;
-        }
+static box_dim get_subtree_node_val(rb_tree_node *sub_tree_node);
 
-        /* Insert new_sub_key to the subtree of new_main_key - this must be a new key in the tree. */
 
-        if (rb_tree_insert(new_main_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+/* Return val of the key of a maximum node in the subtree of the key of a given main tree node. */
 
-            rb_tree_remove(factory->tree_by_side, new_main_key, (void **) &tree_by_height_key);	/* If failed to insert to subtree - remove new_main_key. */
+static box_dim get_subtree_max_node_val(rb_tree_node *main_tree_node);
 
-            free_main_tree_key(new_main_key);
-            free(new_sub_key);
 
-            return false;
-        }
+/* Return a pointer to the subtree of a given main tree node. */
 
-        return true;
-    }
+static rb_tree* get_subtree(rb_tree_node *main_tree_node);
 
-    /* Now, if there is a box with the given height in the box factory (tree_by_height_key != NULL): */
 
-    free_main_tree_key(new_main_key);			/* Free the memory allocated for new_main_key, because we found that it already exists in tree_by_height. */
+/* The implementation: */
 
-    /* Now we take care of cases 2 and 3.
 
-    Insert new_sub_key to the subtree of found tree_by_height_key. */
+static int compare_main_tree_keys(void *a, void *b)
+{
 
-    if (rb_tree_insert(tree_by_height_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+	main_tree_key *key_a = a;
+	main_tree_key *key_b = b;
 
-        free(new_sub_key);
+    if (key_a->val < key_b->val) {
 
-        return false;
+        return -1;
     }
 
-    /* Case 3 - there's a box in the box factory with the given height and with the given side. */
-
-    if (exists_in_subtree) {
+    if (key_a->val > key_b->val) {
 
-        free(new_sub_key);			/* Free the memory allocated for new_sub_key, because we found that it already exists in the corresponding subtree. */
+        return 1;
     }
 
-    return true;
+    return 0;			/* If val contents of two keys of the main tree are equal. */
 }
 
 
-bool box_factory_insert(box_factory *factory, unsigned int side, unsigned int height)
+static int compare_subtree_keys(void *a, void *b)
 {
 
-	if (box_factory_insert_tree_by_side(factory, side, height) == false) {
+	subtree_key *key_a = a;
+	subtree_key *key_b = b;
 
-        return false;
-    }
+    if (key_a->val < key_b->val) {
 
-    if (box_factory_insert_tree_by_height(factory, side, height) == false) {
+        return -1;
+    }
 
-        box_factory_remove_tree_by_side(factory, side, height);			/* If failed to insert to tree_by_height - remove from tree_by side. */
+    if (key_a->val > key_b->val) {
 
-        return false;
+        return 1;
     }
 
-    return true;
+    return 0;			/* If val contents of two keys of the subtree are equal. */
 }
 
 
-static bool box_factory_remove_tree_by_side(box_factory *factory, unsigned int side, unsigned int height)
+box_factory* box_factory_create()
 {
-	main_tree_key *new_main_key = NULL;
-	main_tree_key *tree_by_side_key = NULL;
-	main_tree_key *tree_by_side_deleted_key = NULL;
-
-	subtree_key *new_sub_key = NULL;
-	subtree_key *sub_key = NULL;
 
-    /* Before trying to remove a key from this main tree (tree_by_side), one of the following cases is true:
+    return box_factory_create_with_options(NULL);
+}
 
-     1) There's no box of the given dimensions in the box factory, which means one of the following:
-        1.1) The key with val = (side * side) wouldn't be found in tree_by_side.
-        1.2) The key with val = (side * side) would be found in tree_by_side, but the key with val = height wouldn't be found in the corresponding subtree.
-     2) There is a box of the given dimensions in the box factory - meaning the key with val = (side * side) would be found in tree_by_side and the
-        key with val = height would be found in the corresponding subtree. */
 
-	new_main_key = create_main_tree_key(side * side);			/* Create a key of tree_by_side with val = (side * side). */
+box_factory* box_factory_create_with_options(const box_factory_options *options)
+{
 
-    if (new_main_key == NULL) {
+    return box_factory_create_structures(options, false);
+}
 
-        return false;
-    }
 
-    /* First, we would search in the main tree (tree_by_side) in order to check whether the box of the given side exists in the box factory. */
+box_factory* box_factory_open_disk(const char *path, const box_factory_options *options)
+{
 
-    tree_by_side_key = rb_tree_search_exact(factory->tree_by_side, new_main_key);
+    box_factory_options disk_options;
+    box_factory_disk_scan scan;
+    box_factory *factory = NULL;
 
-    if (tree_by_side_key == NULL) {			/* Case 1.1 - the box with the given side doesn't exist in the box factory. */
+    memset(&disk_options, 0, sizeof(disk_options));
+    memset(&scan, 0, sizeof(scan));
 
-        free_main_tree_key(new_main_key);			/* Free the memory allocated for new_main_key, because there's nothing to remove. */
+    if (options != NULL) {
 
-        return false;
+        disk_options = *options;
     }
 
-    /* Free the memory allocated for new_main_key, because we found that it exists in tree_by_side. (tree_by_side_key != NULL). */
+    disk_options.disk_path = path;
 
-    free_main_tree_key(new_main_key);
+    factory = box_factory_create_structures(&disk_options, true);
 
-    new_sub_key = create_subtree_key(height);			/* Create a key of the subtree (of the key of tree_by_side) with val = height. */
-
-    if (new_sub_key == NULL) {
+    if (factory == NULL) {
 
-        return false;
+        return NULL;
     }
 
-    /* Search the subtree of found tree_by_side_key in order to check whether the box of the given dimensions exists in the box factory. */
-
-    sub_key = rb_tree_search_exact(tree_by_side_key->subtree, new_sub_key);
+    /* The optional indexes are kept in memory - they get the boxes of the file. */
 
-    if (sub_key == NULL) {			/* Case 1.2 - there is a box in the box factory with the given side, but not with the given height. */
+    scan.factory = factory;
 
-        free(new_sub_key);			/* Free the memory allocated for new_sub_key, because there's nothing to remove. */
+    if (((factory->dominance != NULL) || (factory->approx != NULL)) &&
+        (!box_btree_scan(factory->disk, 0, 0, box_factory_load_visit, &scan) || scan.failed)) {
 
-        return false;
+        box_factory_destroy(factory);
+        return NULL;
     }
 
-    /* Case 2 - there is a box of the given dimensions in the box factory. (sub_key != NULL). */
+    return factory;
+}
 
-    /* Remove the key with val = height from the subtree of the found tree_by_side_key. */
 
-    rb_tree_remove(tree_by_side_key->subtree, new_sub_key, (void **) &sub_key);
+static box_factory* box_factory_create_structures(const box_factory_options *options, bool existing_disk)
+{
 
-    if (sub_key) {			/* There are no more keys with val = height in the subtree of tree_by_side_key. */
+    box_factory *factory = NULL;
 
-        free(sub_key);			/* Free the memory allocated for the key with val = height, which was removed from the subtree of tree_by_side_key. */
-    }
+#ifdef BOX_FACTORY_64BIT
 
-    /* In case the subtree of tree_by_side_key has been emptied, tree_by_side_key should be removed from tree_by_side. */
+    /* The box index holds unsigned int values only (a B+-tree replaces it.) */
 
-    if (tree_by_side_key->subtree->count == 0) {
+    if ((options != NULL) && (options->index_type != BOX_FACTORY_INDEX_RB_TREE) && (options->disk_path == NULL)) {
 
-        rb_tree_remove(factory->tree_by_side, tree_by_side_key, (void **) &tree_by_side_deleted_key);
+        return NULL;
+    }
 
-        /* Free the memory allocated for the key with val = (side * side), which was removed from tree_by_side. */
+#endif
 
-        free_main_tree_key(tree_by_side_deleted_key);
+    factory = calloc(sizeof(box_factory), 1);
+
+    if (factory == NULL) {
+
+        return NULL;
     }
 
-    free(new_sub_key);			/* Free the memory we allocated for new_sub_key. */
+    box_cache_init(&(factory->cache));
+    box_cascade_init(&(factory->cascade_by_side));
+    box_cascade_init(&(factory->cascade_by_height));
+    box_planner_init(&(factory->planner));
+    box_cost_init(&(factory->cost));
+    box_checkpoint_init(&(factory->checkpoint));
 
-    return true;
-}
+    /* Whatever fails below - box_factory_destroy frees the fields created so far (the others are still NULL.) */
 
+    if ((options != NULL) && options->count_index) {
+
+        factory->dominance = box_dominance_create();
+
+        if (factory->dominance == NULL) {
+
+            box_factory_destroy(factory);
+            return NULL;
+        }
+    }
+
+    if ((options != NULL) && (options->approx_epsilon != 0)) {
+
+        factory->approx = box_approx_create(options->approx_epsilon);
+
+        if (factory->approx == NULL) {
+
+            box_factory_destroy(factory);
+            return NULL;
+        }
+    }
+
+    /* If asked for a B+-tree or a box index - it replaces the main trees. */
+
+    if ((options != NULL) && (options->disk_path != NULL)) {
+
+        factory->disk = existing_disk ? box_btree_open(options->disk_path, options->disk_memory)
+                                      : box_btree_create(options->disk_path, options->disk_memory);
+
+        if (factory->disk == NULL) {
+
+            box_factory_destroy(factory);
+            return NULL;
+        }
+
+        return factory;
+    }
+
+    if ((options != NULL) && (options->index_type != BOX_FACTORY_INDEX_RB_TREE)) {
+
+        factory->index = box_index_create((options->index_type == BOX_FACTORY_INDEX_VEB) ? &veb_tree_ops : &adaptive_set_ops, options->dictionary);
+
+        if (factory->index == NULL) {
+
+            box_factory_destroy(factory);
+            return NULL;
+        }
+
+        return factory;
+    }
+
+    if ((options != NULL) && options->arena) {
+
+        factory->arena = arena_create();
+
+        if (factory->arena == NULL) {
+
+            box_factory_destroy(factory);
+            return NULL;
+        }
+    }
+
+    factory->tree_by_side = rb_tree_create_in_arena((rb_tree_compare) compare_main_tree_keys, factory->arena);
+    factory->tree_by_height = rb_tree_create_in_arena((rb_tree_compare) compare_main_tree_keys, factory->arena);
+
+    if ((factory->tree_by_side == NULL) || (factory->tree_by_height == NULL)) {
+
+        box_factory_destroy(factory);
+        return NULL;
+    }
+
+    return factory;
+}
+
+
+void box_factory_destroy(box_factory *factory)
+{
+
+    box_factory_checkpoint_poll(factory, true);			/* Wait for the checkpoint, and drop the records it includes from the log. */
+    box_checkpoint_destroy(&(factory->checkpoint));
+
+    if (factory->index != NULL) {
+
+        box_index_destroy(factory->index);
+    }
+
+    if (factory->disk != NULL) {
+
+        box_btree_close(factory->disk);
+    }
+
+    if (factory->arena != NULL) {			/* The main trees, their subtrees, nodes and keys are all in the arena - free its blocks. */
+
+        arena_destroy(factory->arena);
+    }
+
+    else {
+
+        if (factory->tree_by_side != NULL) {
+
+            rb_tree_destroy(factory->tree_by_side, destroy_main_tree_key, factory);
+        }
+
+        if (factory->tree_by_height != NULL) {
+
+            rb_tree_destroy(factory->tree_by_height, destroy_main_tree_key, factory);
+        }
+    }
+
+    if (factory->dominance != NULL) {
+
+        box_dominance_destroy(factory->dominance);
+    }
+
+    if (factory->approx != NULL) {
+
+        box_approx_destroy(factory->approx);
+    }
+
+    if (factory->snapshot != NULL) {
+
+        box_snapshot_close(factory->snapshot);
+    }
+
+    if (factory->wal != NULL) {			/* The open group is written before the log is closed. */
+
+        box_wal_close(factory->wal);
+    }
+
+    if (factory->shared != NULL) {
+
+        box_shared_close(factory->shared);
+    }
+
+    box_factory_trace_end(factory);
+
+    box_cascade_destroy(&(factory->cascade_by_side));
+    box_cascade_destroy(&(factory->cascade_by_height));
+    box_cost_destroy(&(factory->cost));
+
+    free(factory);
+}
+
+
+static bool box_factory_collect(box_factory *factory, box_snapshot_record **records, unsigned int *record_count)
+{
+
+    const ordered_set_ops *ops = (factory->index == NULL) ? NULL : factory->index->ops;
+    rb_tree_node *main_node = NULL;
+    rb_tree_node *sub_node = NULL;
+    void *heights = NULL;
+    unsigned int side_key = 0;
+    unsigned int height_key = 0;
+    unsigned int count = 0;
+    box_dim side = 0;
+    bool has_side = false;
+    bool has_height = false;
+    box_factory_disk_scan scan;
+
+    /* The B+-tree knows the number of its sizes, and visits them in the order of the records. */
+
+    if (factory->disk != NULL) {
+
+        *record_count = 0;
+        *records = (factory->disk->meta.record_count > UINT_MAX) ? NULL
+                   : calloc(sizeof(box_snapshot_record), (factory->disk->meta.record_count == 0) ? 1 : factory->disk->meta.record_count);
+
+        if (*records == NULL) {
+
+            return false;
+        }
+
+        memset(&scan, 0, sizeof(scan));
+        scan.records = *records;
+
+        if (!box_btree_scan(factory->disk, 0, 0, box_factory_collect_visit, &scan)) {
+
+            free(*records);
+            *records = NULL;
+
+            return false;
+        }
+
+        *record_count = (unsigned int) scan.count;
+
+        return true;
+    }
+
+    /* First count the sizes - the number of keys of all the subtrees of tree_by_side (or of the secondary sets of the sides.) */
+
+    if (factory->index == NULL) {
+
+        for (main_node = rb_tree_select(factory->tree_by_side, 0); main_node != NULL; main_node = rb_tree_successor(factory->tree_by_side, main_node)) {
+
+            count += get_subtree(main_node)->count;
+        }
+    }
+
+    else {
+
+        for (has_side = ops->lower_bound(factory->index->set_by_side, 0, &side_key); has_side;
+             has_side = ops->successor(factory->index->set_by_side, side_key, &side_key)) {
+
+            count += ops->size(*(ops->payload(factory->index->set_by_side, side_key)));
+        }
+    }
+
+    /* calloc zeroes the padding of the records too, so the same inventory always gives the same file. */
+
+    *records = calloc(sizeof(box_snapshot_record), (count == 0) ? 1 : count);
+    *record_count = 0;
+
+    if (*records == NULL) {
+
+        return false;
+    }
+
+    if (factory->index == NULL) {
+
+        for (main_node = rb_tree_select(factory->tree_by_side, 0); main_node != NULL; main_node = rb_tree_successor(factory->tree_by_side, main_node)) {
+
+            for (sub_node = rb_tree_select(get_subtree(main_node), 0); sub_node != NULL; sub_node = rb_tree_successor(get_subtree(main_node), sub_node)) {
+
+                (*records)[*record_count].side_square = get_main_tree_node_val(main_node);
+                (*records)[*record_count].height = get_subtree_node_val(sub_node);
+                (*records)[*record_count].count = sub_node->count;
+                (*record_count)++;
+            }
+        }
+
+        return true;
+    }
+
+    /* The keys of the box index are in the order of the values, also when they are ids of a dictionary. */
+
+    for (has_side = ops->lower_bound(factory->index->set_by_side, 0, &side_key); has_side;
+         has_side = ops->successor(factory->index->set_by_side, side_key, &side_key)) {
+
+        side = box_index_value(factory->index->sides, side_key);
+        heights = *(ops->payload(factory->index->set_by_side, side_key));
+
+        for (has_height = ops->lower_bound(heights, 0, &height_key); has_height; has_height = ops->successor(heights, height_key, &height_key)) {
+
+            (*records)[*record_count].side_square = side * side;
+            (*records)[*record_count].height = box_index_value(factory->index->heights, height_key);
+            (*records)[*record_count].count = ops->instances(heights, height_key);
+            (*record_count)++;
+        }
+    }
+
+    return true;
+}
+
+
+bool box_factory_save(box_factory *factory, const char *path)
+{
+
+    box_snapshot_record *records = NULL;
+    unsigned int record_count = 0;
+    unsigned long long lsn = (factory->wal == NULL) ? 0 : factory->wal->next_lsn - 1;			/* The last change the snapshot includes. */
+    bool saved = false;
+
+    if (factory->snapshot != NULL) {			/* The boxes weren't copied from the snapshot yet - it has the records already. */
+
+        return box_snapshot_write(path, factory->snapshot->records, factory->snapshot->record_count, lsn);
+    }
+
+    if (!box_factory_collect(factory, &records, &record_count)) {
+
+        return false;
+    }
+
+    saved = box_snapshot_write(path, records, record_count, lsn);
+
+    free(records);
+
+    return saved;
+}
+
+
+box_factory* box_factory_open_snapshot(const char *path, const box_factory_options *options, bool writable)
+{
+
+    box_factory *factory = box_factory_create_with_options(options);
+
+    if (factory == NULL) {
+
+        return NULL;
+    }
+
+    factory->snapshot = box_snapshot_open(path);
+
+    if (factory->snapshot == NULL) {
+
+        box_factory_destroy(factory);
+        return NULL;
+    }
+
+    factory->read_only = !writable;
+
+    return factory;
+}
+
+
+static rb_tree* box_factory_build_main_tree(box_factory *factory, box_snapshot *snapshot, bool by_side, void **main_keys, void **sub_keys,
+                                            unsigned int *counts)
+{
+
+    const box_snapshot_record *record = NULL;
+    const box_snapshot_record *next = NULL;
+    main_tree_key *main_key = NULL;
+    subtree_key *sub_key = NULL;
+    rb_tree *tree = rb_tree_create_in_arena((rb_tree_compare) compare_main_tree_keys, factory->arena);
+    unsigned int main_count = 0;
+    unsigned int sub_count = 0;
+    unsigned int i = 0;
+    bool failed = (tree == NULL);
+
+    /* Visit the records in the order of the main tree - the records of a main value are next to each other, sorted by the other dimension. The subtree
+     of a main value is built once its last record is reached, and the main tree once all the subtrees are built. */
+
+    for (i = 0; (i < snapshot->record_count) && !failed; ++i) {
+
+        record = &(snapshot->records[by_side ? i : snapshot->by_height[i]]);
+        next = (i + 1 == snapshot->record_count) ? NULL : &(snapshot->records[by_side ? (i + 1) : snapshot->by_height[i + 1]]);
+
+        sub_key = create_subtree_key(factory, by_side ? record->height : record->side_square);
+
+        if (sub_key == NULL) {
+
+            failed = true;
+            break;
+        }
+
+        sub_keys[sub_count] = sub_key;
+        counts[sub_count] = record->count;
+        sub_count++;
+
+        if ((next != NULL) && (by_side ? (next->side_square == record->side_square) : (next->height == record->height))) {
+
+            continue;
+        }
+
+        main_key = create_main_tree_key(factory, by_side ? record->side_square : record->height);
+
+        if ((main_key == NULL) || !rb_tree_build_sorted(main_key->subtree, sub_keys, counts, sub_count)) {
+
+            if (main_key != NULL) {
+
+                free_main_tree_key(factory, main_key);
+            }
+
+            failed = true;
+            break;
+        }
+
+        main_keys[main_count++] = main_key;
+        sub_count = 0;			/* The keys are in the subtree now. */
+    }
+
+    if (!failed && rb_tree_build_sorted(tree, main_keys, NULL, main_count)) {
+
+        return tree;
+    }
+
+    /* Free the keys of the subtree being built, the main keys built so far with their subtrees, and the (empty) main tree. */
+
+    for (i = 0; i < sub_count; ++i) {
+
+        destroy_subtree_key(sub_keys[i], factory);
+    }
+
+    for (i = 0; i < main_count; ++i) {
+
+        destroy_main_tree_key(main_keys[i], factory);
+    }
+
+    if (tree != NULL) {
+
+        rb_tree_destroy(tree, NULL, NULL);
+    }
+
+    return NULL;
+}
+
+
+static bool box_factory_insert_indexes(box_factory *factory, box_dim side, box_dim height)
+{
+
+    bool last_unit = false;
+
+    if ((factory->index != NULL) && !box_index_insert(factory->index, side, height)) {
+
+        return false;
+    }
+
+    if ((factory->dominance != NULL) && !box_dominance_insert(factory->dominance, side, height)) {
+
+        if (factory->index != NULL) {
+
+            box_index_remove(factory->index, side, height, &last_unit);
+        }
+
+        return false;
+    }
+
+    if ((factory->approx != NULL) && !box_approx_insert(factory->approx, side, height)) {
+
+        if (factory->dominance != NULL) {
+
+            box_dominance_remove(factory->dominance, side, height);
+        }
+
+        if (factory->index != NULL) {
+
+            box_index_remove(factory->index, side, height, &last_unit);
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+
+static void box_factory_unload_indexes(box_factory *factory, unsigned int record, unsigned int units)
+{
+
+    const box_snapshot_record *records = factory->snapshot->records;
+    box_dim side = 0;
+    unsigned int i = 0;
+    unsigned int unit = 0;
+    bool last_unit = false;
+
+    for (i = 0; i <= record; ++i) {
+
+        side = box_factory_side_of(records[i].side_square);
+
+        for (unit = 0; unit < ((i == record) ? units : records[i].count); ++unit) {
+
+            if (factory->index != NULL) {
+
+                box_index_remove(factory->index, side, records[i].height, &last_unit);
+            }
+
+            if (factory->dominance != NULL) {
+
+                box_dominance_remove(factory->dominance, side, records[i].height);
+            }
+
+            if (factory->approx != NULL) {
+
+                box_approx_remove(factory->approx, side, records[i].height);
+            }
+        }
+    }
+}
+
+
+bool box_factory_load_snapshot(box_factory *factory)
+{
+
+    box_snapshot *snapshot = factory->snapshot;
+    rb_tree *tree_by_side = NULL;
+    rb_tree *tree_by_height = NULL;
+    void **main_keys = NULL;
+    void **sub_keys = NULL;
+    unsigned int *counts = NULL;
+    unsigned int record = 0;
+    unsigned int unit = 0;
+    unsigned int loaded = 0;			/* Number of the records inserted into the B+-tree. */
+    unsigned int i = 0;
+    bool failed = false;
+    bool last_unit = false;
+
+    if (snapshot == NULL) {
+
+        return true;
+    }
+
+    /* The main trees are built aside, and replace the empty main trees of the box factory only once everything is copied. The B+-tree gets the
+     records in their order, so its leaves are full. */
+
+    if (factory->disk != NULL) {
+
+        while ((loaded < snapshot->record_count) && box_btree_insert(factory->disk, snapshot->records[loaded].side_square,
+                                                                     snapshot->records[loaded].height, snapshot->records[loaded].count)) {
+
+            loaded++;
+        }
+
+        failed = (loaded < snapshot->record_count);
+    }
+
+    if ((factory->index == NULL) && (factory->disk == NULL)) {
+
+        main_keys = malloc(sizeof(void *) * ((snapshot->record_count == 0) ? 1 : snapshot->record_count));
+        sub_keys = malloc(sizeof(void *) * ((snapshot->record_count == 0) ? 1 : snapshot->record_count));
+        counts = malloc(sizeof(unsigned int) * ((snapshot->record_count == 0) ? 1 : snapshot->record_count));
+
+        if ((main_keys != NULL) && (sub_keys != NULL) && (counts != NULL)) {
+
+            tree_by_side = box_factory_build_main_tree(factory, snapshot, true, main_keys, sub_keys, counts);
+            tree_by_height = (tree_by_side == NULL) ? NULL : box_factory_build_main_tree(factory, snapshot, false, main_keys, sub_keys, counts);
+        }
+
+        failed = (tree_by_height == NULL);
+
+        free(main_keys);
+        free(sub_keys);
+        free(counts);
+    }
+
+    /* The box index and the optional indexes get the boxes one by one. */
+
+    if ((factory->index != NULL) || (factory->dominance != NULL) || (factory->approx != NULL)) {
+
+        for (record = 0; (record < snapshot->record_count) && !failed; ++record) {
+
+            for (unit = 0; (unit < snapshot->records[record].count) && !failed; ++unit) {
+
+                if (!box_factory_insert_indexes(factory, box_factory_side_of(snapshot->records[record].side_square), snapshot->records[record].height)) {
+
+                    box_factory_unload_indexes(factory, record, unit);
+
+                    failed = true;
+                }
+            }
+        }
+    }
+
+    if (failed) {
+
+        for (i = 0; i < loaded; ++i) {
+
+            box_btree_remove(factory->disk, snapshot->records[i].side_square, snapshot->records[i].height, snapshot->records[i].count, &last_unit);
+        }
+
+        if (tree_by_side != NULL) {
+
+            rb_tree_destroy(tree_by_side, destroy_main_tree_key, factory);
+        }
+
+        if (tree_by_height != NULL) {
+
+            rb_tree_destroy(tree_by_height, destroy_main_tree_key, factory);
+        }
+
+        return false;
+    }
+
+    if ((factory->index == NULL) && (factory->disk == NULL)) {
+
+        rb_tree_destroy(factory->tree_by_side, NULL, NULL);
+        rb_tree_destroy(factory->tree_by_height, NULL, NULL);
+
+        factory->tree_by_side = tree_by_side;
+        factory->tree_by_height = tree_by_height;
+
+        for (i = 0; i < snapshot->side_count; ++i) {
+
+            box_histogram_add(&(factory->planner.by_side), snapshot->sides[i].side_square);
+        }
+
+        for (i = 0; i < snapshot->record_count; ++i) {
+
+            if ((i == 0) || (snapshot->records[snapshot->by_height[i]].height != snapshot->records[snapshot->by_height[i - 1]].height)) {
+
+                box_histogram_add(&(factory->planner.by_height), snapshot->records[snapshot->by_height[i]].height);
+            }
+        }
+
+        box_cascade_invalidate(&(factory->cascade_by_side));
+        box_cascade_invalidate(&(factory->cascade_by_height));
+    }
+
+    box_snapshot_close(snapshot);
+    factory->snapshot = NULL;
+
+    return true;
+}
+
+
+bool box_factory_export(box_factory *factory, const char *path)
+{
+
+    box_snapshot_record *records = NULL;
+    unsigned int record_count = 0;
+    bool exported = false;
+
+    if (factory->snapshot != NULL) {			/* The boxes weren't copied from the snapshot yet - it has the records already. */
+
+        return box_export_write(path, factory->snapshot->records, factory->snapshot->record_count);
+    }
+
+    if (!box_factory_collect(factory, &records, &record_count)) {
+
+        return false;
+    }
+
+    exported = box_export_write(path, records, record_count);
+
+    free(records);
+
+    return exported;
+}
+
+
+bool box_factory_share(box_factory *factory, const char *name)
+{
+
+    box_snapshot_record *records = NULL;
+    unsigned int record_count = 0;
+
+    if (factory->shared != NULL) {
+
+        return false;
+    }
+
+    if (factory->snapshot != NULL) {			/* The boxes weren't copied from the snapshot yet - it has the records already. */
+
+        factory->shared = box_shared_create(name, factory->snapshot->records, factory->snapshot->record_count);
+
+        return (factory->shared != NULL);
+    }
+
+    if (!box_factory_collect(factory, &records, &record_count)) {
+
+        return false;
+    }
+
+    factory->shared = box_shared_create(name, records, record_count);
+
+    free(records);
+
+    return (factory->shared != NULL);
+}
+
+
+bool box_factory_trace_begin(box_factory *factory, const char *path)
+{
+
+    box_snapshot_record *records = NULL;
+    unsigned int record_count = 0;
+
+    if ((factory->trace != NULL) || ((factory->shared != NULL) && !factory->shared->writer)) {
+
+        return false;
+    }
+
+    if (factory->snapshot != NULL) {			/* The boxes weren't copied from the snapshot yet - it has the records already. */
+
+        factory->trace = box_trace_create(path, factory->snapshot->records, factory->snapshot->record_count);
+    }
+
+    else {
+
+        if (!box_factory_collect(factory, &records, &record_count)) {
+
+            return false;
+        }
+
+        factory->trace = box_trace_create(path, records, record_count);
+
+        free(records);
+    }
+
+    if (factory->trace == NULL) {
+
+        return false;
+    }
+
+    /* A replay starts from the inventory alone, with an empty cache - so the traced calls start from an empty cache too, and a cached answer of a
+     call before the trace can't make the traced answers or durations differ from the replayed ones. */
+
+    box_cache_init(&(factory->cache));
+
+    return true;
+}
+
+
+bool box_factory_trace_end(box_factory *factory)
+{
+
+    bool written = true;
+
+    if (factory->trace != NULL) {
+
+        written = box_trace_close(factory->trace);
+        factory->trace = NULL;
+    }
+
+    return written;
+}
+
+
+box_factory* box_factory_open_shared(const char *name)
+{
+
+    box_factory *factory = box_factory_create();
+
+    if (factory == NULL) {
+
+        return NULL;
+    }
+
+    factory->shared = box_shared_open(name);
+
+    if (factory->shared == NULL) {
+
+        box_factory_destroy(factory);
+        return NULL;
+    }
+
+    factory->read_only = true;
+
+    return factory;
+}
+
+
+box_factory* box_factory_import(const char *path, const box_factory_options *options)
+{
+
+    box_factory *factory = NULL;
+    box_export_reader *reader = box_export_open(path);
+    box_snapshot_record *records = NULL;
+    box_snapshot *snapshot = NULL;
+    unsigned int record_count = 0;
+    box_dim side = 0;
+    bool failed = false;
+
+    if (reader == NULL) {
+
+        return NULL;
+    }
+
+    /* The records are decoded straight into the array of a snapshot in memory, which the main trees are then built from like from a snapshot file.
+     The reader checks their order; the (side * side) of every record must be a square too, since the sides are computed back from it. */
+
+    records = malloc(sizeof(box_snapshot_record) * ((reader->header.record_count == 0) ? 1 : reader->header.record_count));
+    failed = (records == NULL);
+
+    while (!failed && box_export_next(reader, &(records[record_count]))) {
+
+        side = box_factory_side_of(records[record_count].side_square);
+        failed = (side * side != records[record_count].side_square);
+
+        record_count++;
+    }
+
+    failed = failed || reader->failed;
+
+    box_export_close(reader);
+
+    snapshot = failed ? NULL : box_snapshot_create(records, record_count, 0);
+
+    if (snapshot == NULL) {
+
+        free(records);
+        return NULL;
+    }
+
+    factory = box_factory_create_with_options(options);
+
+    if (factory == NULL) {
+
+        box_snapshot_close(snapshot);
+        return NULL;
+    }
+
+    factory->snapshot = snapshot;
+
+    if (!box_factory_load_snapshot(factory)) {
+
+        box_factory_destroy(factory);
+        return NULL;
+    }
+
+    return factory;
+}
+
+
+static bool box_factory_apply_record(void *context, box_wal_op op, box_dim side, box_dim height, unsigned int count)
+{
+
+    box_factory *factory = context;
+    unsigned int unit = 0;
+
+    if ((side > BOX_DIM_MAX_SIDE) || !box_factory_load_snapshot(factory)) {
+
+        return false;
+    }
+
+    for (unit = 0; unit < count; ++unit) {
+
+        if (!((op == BOX_WAL_INSERT) ? box_factory_insert_box(factory, side, height) : box_factory_remove_box(factory, side, height))) {
+
+            return false;			/* An allocation error, or a removal of a box which isn't there - the log doesn't follow the snapshot. */
+        }
+    }
+
+    return true;
+}
+
+
+box_factory* box_factory_recover(const char *snapshot_path, const char *wal_path, const box_factory_options *options, box_wal_sync sync,
+                                 unsigned int group_size)
+{
+
+    box_factory *factory = NULL;
+    unsigned long long snapshot_lsn = 0;
+    unsigned long long last_lsn = 0;
+
+    /* Start from the latest snapshot if there is one, replay the records of the log which follow it, and go on appending to the log. */
+
+    if ((snapshot_path != NULL) && (access(snapshot_path, F_OK) == 0)) {
+
+        factory = box_factory_open_snapshot(snapshot_path, options, true);
+        snapshot_lsn = (factory == NULL) ? 0 : factory->snapshot->lsn;
+    }
+
+    else {
+
+        factory = box_factory_create_with_options(options);
+    }
+
+    if (factory == NULL) {
+
+        return NULL;
+    }
+
+    if (!box_wal_replay(wal_path, snapshot_lsn, box_factory_apply_record, factory, &last_lsn)) {
+
+        box_factory_destroy(factory);
+        return NULL;
+    }
+
+    factory->wal = box_wal_open(wal_path, sync, group_size, last_lsn);
+
+    if (factory->wal == NULL) {
+
+        box_factory_destroy(factory);
+        return NULL;
+    }
+
+    return factory;
+}
+
+
+static bool box_factory_commit_log(box_factory *factory)
+{
+
+    if ((factory->wal != NULL) && !box_wal_commit(factory->wal)) {
+
+        factory->read_only = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool box_factory_sync(box_factory *factory)
+{
+
+    if ((factory->wal != NULL) && !box_wal_flush(factory->wal)) {
+
+        factory->read_only = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool box_factory_checkpoint_write(void *context, const char *path)
+{
+
+    return box_factory_save(context, path);
+}
+
+
+bool box_factory_checkpoint_begin(box_factory *factory, const char *path)
+{
+
+    unsigned long long lsn = 0;
+    unsigned long long wal_end = 0;
+
+    if ((factory->checkpoint.pid != 0) || (factory->disk != NULL)) {
+
+        return false;
+    }
+
+    /* After the sync, the log file ends with the last record the snapshot includes - the log may be cut at that offset once the snapshot is written. */
+
+    if (factory->wal != NULL) {
+
+        if (!box_factory_sync(factory)) {
+
+            return false;
+        }
+
+        lsn = factory->wal->durable_lsn;
+        wal_end = factory->wal->end;
+    }
+
+    return box_checkpoint_start(&(factory->checkpoint), path, box_factory_checkpoint_write, factory, lsn, wal_end);
+}
+
+
+box_checkpoint_state box_factory_checkpoint_poll(box_factory *factory, bool wait)
+{
+
+    box_checkpoint_state state = box_checkpoint_poll(&(factory->checkpoint), wait);
+
+    if ((state == BOX_CHECKPOINT_DONE) && (factory->wal != NULL)) {
+
+        box_wal_truncate(factory->wal, factory->checkpoint.lsn, factory->checkpoint.wal_end);
+    }
+
+    return state;
+}
+
+
+static void* box_factory_alloc(box_factory *factory, size_t size)
+{
+
+    if (factory->arena != NULL) {
+
+        return arena_alloc(factory->arena, size);
+    }
+
+    return calloc(size, 1);
+}
+
+
+static void box_factory_free(box_factory *factory, void *object, size_t size)
+{
+
+    if (factory->arena != NULL) {
+
+        arena_free(factory->arena, object, size);
+    }
+
+    else {
+
+        free(object);
+    }
+}
+
+
+static void destroy_main_tree_key(void *key, void *context)
+{
+
+    main_tree_key *main_key = key;
+
+    rb_tree_destroy(main_key->subtree, destroy_subtree_key, context);
+
+    box_factory_free(context, main_key, sizeof(main_tree_key));
+}
+
+
+static void destroy_subtree_key(void *key, void *context)
+{
+
+    box_factory_free(context, key, sizeof(subtree_key));
+}
+
+
+static main_tree_key* create_main_tree_key(box_factory *factory, box_dim main_val)
+{
+
+	main_tree_key *main_key = box_factory_alloc(factory, sizeof(main_tree_key));
+
+    rb_tree *subtree = NULL;
+
+    if (main_key == NULL) {
+
+        return NULL;
+    }
+
+    main_key->val = main_val;
+
+    subtree = rb_tree_create_in_arena((rb_tree_compare) compare_subtree_keys, factory->arena);
+
+    if (subtree == NULL) {
+
+        box_factory_free(factory, main_key, sizeof(main_tree_key));
+        return NULL;
+    }
+
+    main_key->subtree = subtree;
+
+    return main_key;
+}
+
+
+static void free_main_tree_key(box_factory *factory, main_tree_key *main_key)
+{
+
+    rb_tree_destroy(main_key->subtree, NULL, NULL);
+    box_factory_free(factory, main_key, sizeof(main_tree_key));
+}
+
+
+static subtree_key* create_subtree_key(box_factory *factory, box_dim sub_val)
+{
+
+	subtree_key *sub_key = box_factory_alloc(factory, sizeof(subtree_key));
+
+    if (sub_key == NULL) {
+
+        return NULL;
+    }
+
+    sub_key->val = sub_val;
+
+    return sub_key;
+}
+
+
+static bool box_factory_insert_tree_by_side(box_factory *factory, box_dim side, box_dim height)
+{
+
+	main_tree_key *new_main_key = NULL;
+	main_tree_key *tree_by_side_key = NULL;
+
+    subtree_key *new_sub_key = NULL;
+
+    bool exists_in_tree_by_side = false;
+    bool exists_in_subtree = false;
+
+    /* Before trying to insert a new key to this main tree (tree_by_side), one of the following cases is true:
+
+     1) There's no box with the given side in the box factory - meaning the key with val = (side * side) wouldn't be found in tree_by_side.
+     2) There is a box with the given side, but not with the given height - meaning the key with val = (side * side) would be found in tree_by_side,
+        but the key with val = height wouldn't be found in the corresponding subtree.
+     3) There is a box with the given side and with the given height - meaning the key with val = (side * side) would be found in tree_by_side and the
+        key with val = height would be found in the corresponding subtree. */
+
+    new_main_key = create_main_tree_key(factory, side * side);			/* Create a key of tree_by_side with val = (side * side). */
+
+    if (new_main_key == NULL) {
+
+        return false;
+    }
+
+    new_sub_key = create_subtree_key(factory, height);			/* Create a key of the subtree (of the key of tree_by_side) with val = height. */
+
+    if (new_sub_key == NULL) {
+
+        free_main_tree_key(factory, new_main_key);
+
+        return false;
+    }
+
+    /* First, we would search in the main tree (tree_by_side) in order to check whether the box of the given side already exists in the box factory. */
+
+    tree_by_side_key = rb_tree_search_exact(factory->tree_by_side, new_main_key);
+
+    if (tree_by_side_key == NULL) {			/* Case 1 - there's no box with the given side in the box factory. */
+
+        /* So we insert new_main_key to tree_by_side - this must be a new key in the tree. */
+
+        if (rb_tree_insert(factory->tree_by_side, new_main_key, &exists_in_tree_by_side) == false) {
+
+            free_main_tree_key(factory, new_main_key);			/* Free an allocated memory in case of insertion failure. */
+            box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+
+            return false;
+        }
+
+        /* Insert new_sub_key to the subtree of new_main_key - this must be a new key in the tree. */
+
+        if (rb_tree_insert(new_main_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+
+            rb_tree_remove(factory->tree_by_side, new_main_key, (void **) &tree_by_side_key);	/* If failed to insert to subtree - remove new_main_key. */
+
+            free_main_tree_key(factory, new_main_key);
+            box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+
+            return false;
+        }
+
+        box_histogram_add(&(factory->planner.by_side), new_main_key->val);			/* A new key of tree_by_side. */
+
+        return true;
+    }
+
+    /* Now, if there is a box with the given side in the box factory (tree_by_side_key != NULL): */
+
+    free_main_tree_key(factory, new_main_key);			/* Free the memory allocated for new_main_key, because we found that it already exists in tree_by_side. */
+
+    /* Now we take care of cases 2 and 3.
+
+    Insert new_sub_key to the subtree of found tree_by_side_key. */
+
+    if (rb_tree_insert(tree_by_side_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+
+        box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+
+        return false;
+    }
+
+    /* Case 3 - there's a box in the box factory with the given side and with the given height. */
+
+    if (exists_in_subtree) {
+
+        /* Free the memory allocated for new_sub_key, because we found that it already exists in the corresponding subtree. */
+
+        box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+    }
+
+    return true;
+}
+
+
+static bool box_factory_insert_tree_by_height(box_factory *factory, box_dim side, box_dim height)
+{
 
-static bool box_factory_remove_tree_by_height(box_factory *factory, unsigned int side, unsigned int height)
-{
 	main_tree_key *new_main_key = NULL;
 	main_tree_key *tree_by_height_key = NULL;
+
+    subtree_key *new_sub_key = NULL;
+
+    bool exists_in_tree_by_height = false;
+    bool exists_in_subtree = false;
+
+    /* Before trying to insert a new key to this main tree (tree_by_height), one of the following cases is true:
+
+     1) There's no box with the given height in the box factory - meaning the key with val = height wouldn't be found in tree_by_height.
+     2) There is a box with the given height, but not with the given side - meaning the key with val = height would be found in tree_by_height,
+        but the key with val = (side * side) wouldn't be found in the corresponding subtree.
+     3) There is a box with the given height and with the given side - meaning the key with val = height would be found in tree_by_height and the
+        key with val = (side * side) would be found in the corresponding subtree. */
+
+    new_main_key = create_main_tree_key(factory, height);			/* Create a key of tree_by_height with val = height. */
+
+    if (new_main_key == NULL) {
+
+        return false;
+    }
+
+    new_sub_key = create_subtree_key(factory, side * side);			/* Create a key of the subtree (of the key of tree_by_height) with val = (side * side). */
+
+    if (new_sub_key == NULL) {
+
+        free_main_tree_key(factory, new_main_key);
+
+        return false;
+    }
+
+    /* First, we would search in the main tree (tree_by_height) in order to check whether the box of the given height already exists in the box factory. */
+
+    tree_by_height_key = rb_tree_search_exact(factory->tree_by_height, new_main_key);
+
+    if (tree_by_height_key == NULL) {			/* Case 1 - there's no box with the given height in the box factory. */
+
+        /* So we insert new_main_key to tree_by_height - this must be a new key in the tree. */
+
+        if (rb_tree_insert(factory->tree_by_height, new_main_key, &exists_in_tree_by_height) == false) {
+
+            free_main_tree_key(factory, new_main_key);			/* Free an allocated memory in case of insertion failure. */
+            box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+
+            return false;
+        }
+
+        /* Insert new_sub_key to the subtree of new_main_key - this must be a new key in the tree. */
+
+        if (rb_tree_insert(new_main_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+
+            rb_tree_remove(factory->tree_by_height, new_main_key, (void **) &tree_by_height_key);	/* If failed to insert to subtree - remove new_main_key. */
+
+            free_main_tree_key(factory, new_main_key);
+            box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+
+            return false;
+        }
+
+        box_histogram_add(&(factory->planner.by_height), new_main_key->val);			/* A new key of tree_by_height. */
+
+        return true;
+    }
+
+    /* Now, if there is a box with the given height in the box factory (tree_by_height_key != NULL): */
+
+    free_main_tree_key(factory, new_main_key);			/* Free the memory allocated for new_main_key, because we found that it already exists in tree_by_height. */
+
+    /* Now we take care of cases 2 and 3.
+
+    Insert new_sub_key to the subtree of found tree_by_height_key. */
+
+    if (rb_tree_insert(tree_by_height_key->subtree, new_sub_key, &exists_in_subtree) == false) {
+
+        box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+
+        return false;
+    }
+
+    /* Case 3 - there's a box in the box factory with the given height and with the given side. */
+
+    if (exists_in_subtree) {
+
+        /* Free the memory allocated for new_sub_key, because we found that it already exists in the corresponding subtree. */
+
+        box_factory_free(factory, new_sub_key, sizeof(subtree_key));
+    }
+
+    return true;
+}
+
+
+bool box_factory_insert(box_factory *factory, box_dim side, box_dim height)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_insert(factory, side, height);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_INSERT, side, height);
+
+    record.result = box_factory_run_insert(factory, side, height);
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_insert(box_factory *factory, box_dim side, box_dim height)
+{
+
+    if (side > BOX_DIM_MAX_SIDE) {			/* (side * side) of a larger side doesn't fit in a box_dim (see box_types.h.) */
+
+        return false;
+    }
+
+    if (factory->read_only || !box_factory_load_snapshot(factory)) {			/* The boxes of a snapshot are copied before the first change. */
+
+        return false;
+    }
+
+    /* The record is appended to the open group of the log first, and dropped again if the insertion fails - so only the changes which were made are
+     logged, and a change which was made always has its record. */
+
+    if ((factory->wal != NULL) && !box_wal_append(factory->wal, BOX_WAL_INSERT, side, height, 1)) {
+
+        return false;
+    }
+
+    if (!box_factory_insert_box(factory, side, height)) {
+
+        if (factory->wal != NULL) {
+
+            box_wal_cancel(factory->wal);
+        }
+
+        return false;
+    }
+
+    return box_factory_commit_log(factory);
+}
+
+
+static bool box_factory_insert_box(box_factory *factory, box_dim side, box_dim height)
+{
+
+    bool last_unit = false;
+
+    if (factory->disk != NULL) {
+
+        if (box_btree_insert(factory->disk, side * side, height, 1) == false) {
+
+            return false;
+        }
+    }
+
+    else {
+
+        if (factory->index != NULL) {
+
+            if (box_index_insert(factory->index, side, height) == false) {
+
+                return false;
+            }
+        }
+
+        else {
+
+            if (box_factory_insert_tree_by_side(factory, side, height) == false) {
+
+                return false;
+            }
+
+            if (box_factory_insert_tree_by_height(factory, side, height) == false) {
+
+                box_factory_remove_tree_by_side(factory, side, height, &last_unit);	/* If failed to insert to tree_by_height - remove from tree_by side. */
+
+                return false;
+            }
+
+            box_cascade_invalidate(&(factory->cascade_by_side));
+            box_cascade_invalidate(&(factory->cascade_by_height));
+        }
+    }
+
+    /* The box is added to the optional indexes last - if that fails, it is removed from the other structures again. */
+
+    if ((factory->dominance != NULL) && !box_dominance_insert(factory->dominance, side, height)) {
+
+        box_factory_undo_insert(factory, side, height);
+
+        return false;
+    }
+
+    if ((factory->approx != NULL) && !box_approx_insert(factory->approx, side, height)) {
+
+        if (factory->dominance != NULL) {
+
+            box_dominance_remove(factory->dominance, side, height);
+        }
+
+        box_factory_undo_insert(factory, side, height);
+
+        return false;
+    }
+
+    /* The shared segment is changed last (a box factory over the segment of another process is read-only, so this is the writer.) */
+
+    if ((factory->shared != NULL) && !box_shared_insert(factory->shared, side * side, height, 1)) {
+
+        if (factory->approx != NULL) {
+
+            box_approx_remove(factory->approx, side, height);
+        }
+
+        if (factory->dominance != NULL) {
+
+            box_dominance_remove(factory->dominance, side, height);
+        }
+
+        box_factory_undo_insert(factory, side, height);
+
+        return false;
+    }
+
+    box_cache_on_insert(&(factory->cache), side * side, height);			/* Drop the cached answers which the new box may improve. */
+
+    return true;
+}
+
+
+static void box_factory_undo_insert(box_factory *factory, box_dim side, box_dim height)
+{
+
+    bool last_unit = false;
+
+    if (factory->disk != NULL) {
+
+        box_btree_remove(factory->disk, side * side, height, 1, &last_unit);
+    }
+
+    else {
+
+        if (factory->index != NULL) {
+
+            box_index_remove(factory->index, side, height, &last_unit);
+        }
+
+        else {
+
+            box_factory_remove_tree_by_side(factory, side, height, &last_unit);
+            box_factory_remove_tree_by_height(factory, side, height);
+        }
+    }
+}
+
+
+static bool box_factory_remove_tree_by_side(box_factory *factory, box_dim side, box_dim height, bool *last_unit)
+{
+	main_tree_key target_main_key = {.val = side * side, .subtree = NULL};
+	main_tree_key *tree_by_side_key = NULL;
+	main_tree_key *tree_by_side_deleted_key = NULL;
+
+	subtree_key target_sub_key = {.val = height};
+	subtree_key *sub_key = NULL;
+
+    /* Before trying to remove a key from this main tree (tree_by_side), one of the following cases is true:
+
+     1) There's no box of the given dimensions in the box factory, which means one of the following:
+        1.1) The key with val = (side * side) wouldn't be found in tree_by_side.
+        1.2) The key with val = (side * side) would be found in tree_by_side, but the key with val = height wouldn't be found in the corresponding subtree.
+     2) There is a box of the given dimensions in the box factory - meaning the key with val = (side * side) would be found in tree_by_side and the
+        key with val = height would be found in the corresponding subtree. */
+
+    /* The keys we search for are on the stack - a removal allocates nothing, so it can undo an insertion which failed on an allocation error.
+
+     First, we would search in the main tree (tree_by_side) in order to check whether the box of the given side exists in the box factory. */
+
+    tree_by_side_key = rb_tree_search_exact(factory->tree_by_side, &target_main_key);
+
+    if (tree_by_side_key == NULL) {			/* Case 1.1 - the box with the given side doesn't exist in the box factory. */
+
+        return false;
+    }
+
+    /* Search the subtree of found tree_by_side_key in order to check whether the box of the given dimensions exists in the box factory. */
+
+    sub_key = rb_tree_search_exact(tree_by_side_key->subtree, &target_sub_key);
+
+    if (sub_key == NULL) {			/* Case 1.2 - there is a box in the box factory with the given side, but not with the given height. */
+
+        return false;
+    }
+
+    /* Case 2 - there is a box of the given dimensions in the box factory. (sub_key != NULL). */
+
+    /* Remove the key with val = height from the subtree of the found tree_by_side_key. */
+
+    rb_tree_remove(tree_by_side_key->subtree, &target_sub_key, (void **) &sub_key);
+
+    *last_unit = (sub_key != NULL);
+
+    if (sub_key) {			/* There are no more keys with val = height in the subtree of tree_by_side_key. */
+
+        /* Free the memory allocated for the key with val = height, which was removed from the subtree of tree_by_side_key. */
+
+        box_factory_free(factory, sub_key, sizeof(subtree_key));
+    }
+
+    /* In case the subtree of tree_by_side_key has been emptied, tree_by_side_key should be removed from tree_by_side. */
+
+    if (tree_by_side_key->subtree->count == 0) {
+
+        rb_tree_remove(factory->tree_by_side, tree_by_side_key, (void **) &tree_by_side_deleted_key);
+
+        box_histogram_remove(&(factory->planner.by_side), tree_by_side_deleted_key->val);
+
+        /* Free the memory allocated for the key with val = (side * side), which was removed from tree_by_side. */
+
+        free_main_tree_key(factory, tree_by_side_deleted_key);
+    }
+
+    return true;
+}
+
+
+static bool box_factory_remove_tree_by_height(box_factory *factory, box_dim side, box_dim height)
+{
+	main_tree_key target_main_key = {.val = height, .subtree = NULL};
+	main_tree_key *tree_by_height_key = NULL;
 	main_tree_key *tree_by_height_deleted_key = NULL;
 
-	subtree_key *new_sub_key = NULL;
-	subtree_key *sub_key = NULL;
+	subtree_key target_sub_key = {.val = side * side};
+	subtree_key *sub_key = NULL;
+
+    /* Before trying to remove a key from this main tree (tree_by_height), one of the following cases is true:
+
+     1) There's no box of the given dimensions in the box factory, which means one of the following:
+        1.1) The key with val = height wouldn't be found in tree_by_height.
+        1.2) The key with val = height would be found in tree_by_height, but the key with val = (side * side) wouldn't be found in the corresponding subtree.
+     2) There is a box of the given dimensions in the box factory - meaning the key with val = height would be found in tree_by_height and the
+        key with val = (side * side) would be found in the corresponding subtree. */
+
+    /* The keys we search for are on the stack - a removal allocates nothing, so it can undo an insertion which failed on an allocation error.
+
+     First, we would search in the main tree (tree_by_height) in order to check whether the box of the given height exists in the box factory. */
+
+    tree_by_height_key = rb_tree_search_exact(factory->tree_by_height, &target_main_key);
+
+    if (tree_by_height_key == NULL) {			/* Case 1.1 - the box with the given height doesn't exist in the box factory. */
+
+        return false;
+    }
+
+    /* Search the subtree of found tree_by_height_key in order to check whether the box of the given dimensions exists in the box factory. */
+
+    sub_key = rb_tree_search_exact(tree_by_height_key->subtree, &target_sub_key);
+
+    if (sub_key == NULL) {			/* Case 1.2 - there is a box in the box factory with the given height, but not with the given side. */
+
+        return false;
+    }
+
+    /* Case 2 - there is a box of the given dimensions in the box factory. (sub_key != NULL). */
+
+    /* Remove the key with val = (side * side) from the subtree of the found tree_by_height_key. */
+
+    rb_tree_remove(tree_by_height_key->subtree, &target_sub_key, (void **) &sub_key);
+
+    if (sub_key) {			/* There are no more keys with val = (side * side) in the subtree of tree_by_height_key. */
+
+        /* Free the memory allocated for the key with val = (side * side), which was removed from the subtree of tree_by_height_key. */
+
+        box_factory_free(factory, sub_key, sizeof(subtree_key));
+    }
+
+    /* In case the subtree of tree_by_height_key has been emptied, tree_by_height_key should be removed from tree_by_height. */
+
+    if (tree_by_height_key->subtree->count == 0) {
+
+        rb_tree_remove(factory->tree_by_height, tree_by_height_key, (void **) &tree_by_height_deleted_key);
+
+        box_histogram_remove(&(factory->planner.by_height), tree_by_height_deleted_key->val);
+
+        /* Free the memory allocated for the key with val = height, which was removed from tree_by_height. */
+
+        free_main_tree_key(factory, tree_by_height_deleted_key);
+    }
+
+    return true;
+}
+
+
+bool box_factory_remove(box_factory *factory, box_dim side, box_dim height)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_remove(factory, side, height);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_REMOVE, side, height);
+
+    record.result = box_factory_run_remove(factory, side, height);
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_remove(box_factory *factory, box_dim side, box_dim height)
+{
+
+    if (side > BOX_DIM_MAX_SIDE) {			/* No box has a larger side. */
+
+        return false;
+    }
+
+    if (factory->read_only || !box_factory_load_snapshot(factory)) {			/* The boxes of a snapshot are copied before the first change. */
+
+        return false;
+    }
+
+    if ((factory->wal != NULL) && !box_wal_append(factory->wal, BOX_WAL_REMOVE, side, height, 1)) {
+
+        return false;
+    }
+
+    if (!box_factory_remove_box(factory, side, height)) {			/* There's no box of the given dimensions - nothing to log. */
+
+        if (factory->wal != NULL) {
+
+            box_wal_cancel(factory->wal);
+        }
+
+        return false;
+    }
+
+    return box_factory_commit_log(factory);
+}
+
+
+static bool box_factory_remove_box(box_factory *factory, box_dim side, box_dim height)
+{
+    bool last_unit = false;
+
+    if (factory->disk != NULL) {
+
+        if (box_btree_remove(factory->disk, side * side, height, 1, &last_unit) == false) {
+
+            return false;
+        }
+    }
+
+    else {
+
+        if (factory->index != NULL) {
+
+            if (box_index_remove(factory->index, side, height, &last_unit) == false) {
+
+                return false;
+            }
+        }
+
+        else {
+
+            if (box_factory_remove_tree_by_side(factory, side, height, &last_unit) == false) {
+
+                return false;
+            }
+
+            /* If we were able to remove from tree_by_side, this means the box of the given dimensions exists in the box factory, so we should be
+             able to remove from tree_by_height. */
+
+            box_factory_remove_tree_by_height(factory, side, height);
+
+            box_cascade_invalidate(&(factory->cascade_by_side));
+            box_cascade_invalidate(&(factory->cascade_by_height));
+        }
+    }
+
+    if (factory->dominance != NULL) {
+
+        box_dominance_remove(factory->dominance, side, height);
+    }
+
+    if (factory->approx != NULL) {
+
+        box_approx_remove(factory->approx, side, height);
+    }
+
+    if (factory->shared != NULL) {
+
+        box_shared_remove(factory->shared, side * side, height, 1);
+    }
+
+    /* Only the removal of the last box of the given dimensions may change a cached answer. */
+
+    if (last_unit) {
+
+        box_cache_on_remove(&(factory->cache), side * side, height);
+    }
+
+    return true;
+}
+
+
+static bool box_factory_get_by_input(rb_tree *tree, box_cascade *cascade, bool main_is_side, box_dim main_val, box_dim sub_val,
+                                     box_dim *found_main_val, box_dim *found_sub_val)
+{
+    rb_tree_node *main_node = NULL;
+    rb_tree_node *sub_node = NULL;
+
+    rb_tree_node *min_main_node = NULL;
+    rb_tree_node *min_sub_node = NULL;
+
+    main_tree_key target_main_key = {.val = main_val, .subtree = NULL};
+    subtree_key target_sub_key = {.val = sub_val};
+
+    box_volume volume = 0;
+    box_volume min_volume = 0;
+    unsigned int visited = 1;
+
+    /* If the cascaded index of the main tree is current - it gives the same answer without a search in every candidate subtree. */
+
+    if (cascade->current) {
+
+        return box_cascade_get(cascade, main_is_side, main_val, sub_val, found_main_val, found_sub_val);
+    }
+
+    /* Search the given main tree for a node with the smallest key that is larger than or equal to the given key (target_main_key). */
+
+    main_node = rb_tree_search_smallest_from(tree, &target_main_key);
+
+    /* If val of the key of a maximum node in the subtree of the key of the found main tree node (main_node), is smaller than the given sub_val - then
+     main_node can't be the node we're looking for, therefore we proceed to check the next node of the main tree (successor of the current main_node.) */
+
+    while (main_node && (get_subtree_max_node_val(main_node) < sub_val)) {
+
+    	main_node = rb_tree_successor(tree, main_node);
+    	visited++;
+    }
+
+    if (main_node == NULL) {
+
+        box_cascade_account(cascade, tree, visited);
+
+        return false;
+    }
+
+    /* Search the subtree of the key of the found suitable main_node, for a node with the smallest key that is larger than or equal to the given key
+     (target_sub_key). */
+
+    sub_node = rb_tree_search_smallest_from(get_subtree(main_node), &target_sub_key);
+
+    /* Now, when the suitable (according to the given dimensions) main_node and sub_node are found - calculate the minimal volume to start with. */
+
+    min_volume = (box_volume) get_main_tree_node_val(main_node) * get_subtree_node_val(sub_node);
+
+    min_main_node = main_node;
+    min_sub_node = sub_node;
+
+    /* We compare the current minimal volume with the product of val of the key of the current main_node and the given sub_val.
+     We do this in order to check whether we need to continue looking for the minimal possible volume by checking the next node in the tree (successor
+     of the current main_node.)
+     Every successor has a larger val, so its suitable volume is at least this product. If we find that the current minimal volume is less than or equal
+     to the product - this means there's no point to continue, because there's no way we will receive a suitable volume which is less than the minimal
+     volume that we've already found, by checking the successors. (The product is computed in 64 bits, so it can't overflow, and a zero val can't
+     cause a division by zero.)
+     When the main tree is tree_by_height, a successor whose product equals the minimal volume may still give the same volume with a smaller side -
+     so the scan of tree_by_height goes on over an equal product, unless the side found is the given one already. */
+
+    while (main_node && ((min_volume > (box_volume) get_main_tree_node_val(main_node) * sub_val) ||
+                         (!main_is_side && (min_volume == (box_volume) get_main_tree_node_val(main_node) * sub_val) &&
+                          (get_subtree_node_val(min_sub_node) > sub_val)))) {
+
+    	main_node = rb_tree_successor(tree, main_node);
+    	visited++;
+
+    	/* Check whether the subtree of the key of the currently checked main_node meets the requirements of containing the suitable dimensions.
+    	 If it doesn't - go back to the while condition. */
+
+        if ((main_node == NULL) || (get_subtree_max_node_val(main_node) < sub_val)) {
+
+            continue;
+        }
+
+        /* Search the subtree of the key of the found suitable main_node, for a node with the smallest key that is larger than or equal to the given key
+         (target_sub_key). */
+
+        sub_node = rb_tree_search_smallest_from(get_subtree(main_node), &target_sub_key);
+
+        volume = (box_volume) get_main_tree_node_val(main_node) * get_subtree_node_val(sub_node);
+
+        /* Check whether we have found a new minimal volume - or, over tree_by_height, the same volume with a smaller side. */
+
+        if ((min_volume > volume) ||
+            (!main_is_side && (min_volume == volume) && (get_subtree_node_val(sub_node) < get_subtree_node_val(min_sub_node)))) {
+
+            min_volume = volume;
+            min_main_node = main_node;
+            min_sub_node = sub_node;
+        }
+    }
+
+    /* At the end, found_main_val and found_sub_val would contain val of the key of the main tree node and val of the key of the corresponding subtree node,
+     which we found to give the minimal suitable volume. */
+
+    *found_main_val = get_main_tree_node_val(min_main_node);
+
+    *found_sub_val = get_subtree_node_val(min_sub_node);
+
+    /* The scan of a stale cascade's main tree is counted - once the scans since the last change have done as much work as a rebuild, every scan goes on
+     with a part of the rebuild. */
+
+    box_cascade_account(cascade, tree, visited);
+
+    return true;
+}
+
+
+bool box_factory_get_box(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_get_box(factory, side, height, found_side_square, found_height);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_GET, side, height);
+
+    record.result = box_factory_run_get_box(factory, side, height, found_side_square, found_height);
+
+    if (record.result) {
+
+        record.found_side_square = *found_side_square;
+        record.found_height = *found_height;
+    }
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_get_box(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+    bool found = false;
+    unsigned int index_side_square = 0;			/* The answer of the box index, which holds unsigned int values. */
+    unsigned int index_height = 0;
+
+    if (side > BOX_DIM_MAX_SIDE) {			/* No box has a larger side. */
+
+        return false;
+    }
+
+    if (factory->snapshot != NULL) {			/* The boxes of a snapshot weren't copied yet - it answers from its arrays. */
+
+        return box_snapshot_get(factory->snapshot, side * side, height, found_side_square, found_height);
+    }
+
+    if ((factory->shared != NULL) && !factory->shared->writer) {			/* The boxes are in the segment of another process. */
+
+        return box_shared_get(factory->shared, side * side, height, found_side_square, found_height);
+    }
+
+    /* If one of the main trees is empty - there're no boxes in the factory. */
+
+    if ((factory->index == NULL) && (factory->disk == NULL) && (factory->tree_by_height->count == 0)) {
+
+        return false;
+    }
+
+    /* First, check whether the answer for the given dimensions is already cached. */
+
+    if (box_cache_lookup(&(factory->cache), side * side, height, &found, found_side_square, found_height)) {
+
+        return found;
+    }
+
+    if (factory->disk != NULL) {			/* The cache saves the reads of the pages too. */
+
+        found = box_btree_get(factory->disk, side * side, height, found_side_square, found_height);
+
+        box_cache_store(&(factory->cache), side * side, height, found, *found_side_square, *found_height);
+
+        return found;
+    }
+
+    if (factory->index != NULL) {
+
+        found = box_index_get(factory->index, side, height, &index_side_square, &index_height);
+
+        *found_side_square = index_side_square;
+        *found_height = index_height;
+    }
+
+    else {
+
+        /* Check the main tree which the planner expects to have less candidates for the given dimensions (the number of keys of the main tree which
+         are larger than or equal to the given one.) */
+
+        if (box_planner_side_first(&(factory->planner), side * side, height)) {
+
+            found = box_factory_get_by_input(factory->tree_by_side, &(factory->cascade_by_side), true, side * side, height, found_side_square,
+                                                 found_height);
+        }
+
+        else {
+
+            found = box_factory_get_by_input(factory->tree_by_height, &(factory->cascade_by_height), false, height, side * side, found_height,
+                                                 found_side_square);
+        }
+    }
+
+    box_cache_store(&(factory->cache), side * side, height, found, *found_side_square, *found_height);
+
+    return found;
+
+    /* At the end, found_side_square and found_height would contain dimensions ((side * side) and height) of the box, which we found to have the minimal
+     suitable volume (minimal volume when the side of the box is at least the given side, and the height of the box is at least the given height.) */
+}
+
+
+static bool box_factory_check_by_input(rb_tree *tree, box_dim main_val, box_dim sub_val)
+{
+    rb_tree_node *main_node = NULL;
+    main_tree_key *main_key = NULL;
+
+    main_tree_key target_main_key;
+    subtree_key target_sub_key;
+
+    target_main_key.val = main_val;
+    target_sub_key.val = sub_val;
+
+    /* Search the given main tree for a node with the smallest key that is larger than or equal to the given key (target_main_key). */
+
+    main_node = rb_tree_search_smallest_from(tree, &target_main_key);
+
+    /* If we didn't find such a node - it means there's no box in the box factory suitable for the present of the given dimensions. */
+
+    if (main_node == NULL){
+
+        return false;
+    }
+
+    main_key = (main_tree_key*) main_node->key;
+
+    /* We compare between two keys:
+     1. The key of the maximum node in the subtree of the key (main_key) of the found suitable main tree node (main_node).
+     2. The given key (target_sub_key).
+     In case the key of the maximum node is smaller than the given key - then main_node can't be the node we're looking for, therefore we proceed to check
+     the next node of the main tree (successor of the current main_node.) */
+
+    while ((main_node != NULL) && (main_key->subtree->cmp(main_key->subtree->max->key, &target_sub_key) == -1)){
+
+        main_node = rb_tree_successor(tree, main_node);
+
+        if (main_node != NULL){
+
+            main_key = (main_tree_key*) main_node->key;
+        }
+    }
+
+    if (main_node == NULL){
+
+        return false;
+    }
+
+    /* If in the end main_node != NULL - it means there is a box in the box factory suitable for the present of the given dimensions  */
+
+    return true;
+}
+
+
+bool box_factory_get_box_approx(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_get_box_approx(factory, side, height, found_side_square, found_height);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_GET_APPROX, side, height);
+
+    record.result = box_factory_run_get_box_approx(factory, side, height, found_side_square, found_height);
+
+    if (record.result) {
+
+        record.found_side_square = *found_side_square;
+        record.found_height = *found_height;
+    }
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_get_box_approx(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    box_dim found_side = 0;
+
+    if (side > BOX_DIM_MAX_SIDE) {			/* No box has a larger side. */
+
+        return false;
+    }
+
+    if (factory->approx == NULL) {
+
+        return box_factory_run_get_box(factory, side, height, found_side_square, found_height);
+    }
+
+    if (!box_factory_load_snapshot(factory)) {
+
+        return false;
+    }
+
+    if (!box_approx_get(factory->approx, side, height, &found_side, found_height)) {
+
+        return false;
+    }
+
+    *found_side_square = found_side * found_side;
+
+    return true;
+}
+
+
+bool box_factory_check_box(box_factory *factory, box_dim side, box_dim height)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_check_box(factory, side, height);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_CHECK, side, height);
+
+    record.result = box_factory_run_check_box(factory, side, height);
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_check_box(box_factory *factory, box_dim side, box_dim height)
+{
+
+    bool found = false;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+
+    if (side > BOX_DIM_MAX_SIDE) {			/* No box has a larger side. */
+
+        return false;
+    }
+
+    if (factory->snapshot != NULL) {
+
+        return box_snapshot_check(factory->snapshot, side * side, height);
+    }
+
+    if ((factory->shared != NULL) && !factory->shared->writer) {
+
+        return box_shared_check(factory->shared, side * side, height);
+    }
+
+    /* A cached GETBOX answer for the same dimensions also answers CHECKBOX. */
+
+    if (box_cache_lookup(&(factory->cache), side * side, height, &found, &found_side_square, &found_height)) {
+
+        return found;
+    }
+
+    if (factory->disk != NULL) {
+
+        return box_btree_check(factory->disk, side * side, height);
+    }
+
+    if (factory->index != NULL) {
+
+        return box_index_check(factory->index, side, height);
+    }
+
+    /* Check the main tree which the planner expects to have less candidates for the given dimensions. */
+
+    if (box_planner_side_first(&(factory->planner), side * side, height)) {
+
+        return box_factory_check_by_input(factory->tree_by_side, side * side, height);
+    }
+
+    return box_factory_check_by_input(factory->tree_by_height, height, side * side);
+}
+
+
+void box_factory_cache_stats(box_factory *factory, box_cache_stats *stats)
+{
+
+    *stats = factory->cache.stats;
+}
+
+
+static bool box_factory_box_less(box_factory_box *a, box_factory_box *b)
+{
+
+    box_volume volume_a = (box_volume) a->side_square * a->height;
+    box_volume volume_b = (box_volume) b->side_square * b->height;
+
+    return (volume_a < volume_b) || ((volume_a == volume_b) && (a->side_square < b->side_square)) ||
+           ((volume_a == volume_b) && (a->side_square == b->side_square) && (a->height < b->height));
+}
+
+
+static void box_factory_top_k_sift_down(box_factory_box heap[], unsigned int count, unsigned int i)
+{
+
+    box_factory_box box = heap[i];
+    unsigned int child = 0;
+
+    while ((child = 2 * i + 1) < count) {
+
+        if ((child + 1 < count) && box_factory_box_less(&(heap[child]), &(heap[child + 1]))) {			/* The worse child. */
+
+            child++;
+        }
+
+        if (!box_factory_box_less(&box, &(heap[child]))) {
+
+            break;
+        }
+
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = box;
+}
+
+
+static void box_factory_top_k_offer(box_factory_box heap[], unsigned int k, unsigned int *count, box_factory_box *box)
+{
+
+    unsigned int i = *count;
+
+    if (*count < k) {			/* The heap isn't full - sift the new size up from the end. */
+
+        while ((i > 0) && box_factory_box_less(&(heap[(i - 1) / 2]), box)) {
+
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+
+        heap[i] = *box;
+        (*count)++;
+
+        return;
+    }
+
+    if (box_factory_box_less(box, &(heap[0]))) {			/* Replace the worst size. */
+
+        heap[0] = *box;
+        box_factory_top_k_sift_down(heap, *count, 0);
+    }
+}
+
+
+static void box_factory_top_k_by_input(rb_tree *tree, bool main_is_side, box_dim main_val, box_dim sub_val, unsigned int k,
+                                       box_factory_box heap[], unsigned int *count)
+{
+
+    main_tree_key target_main_key = {.val = main_val, .subtree = NULL};
+    subtree_key target_sub_key = {.val = sub_val};
+
+    rb_tree_node *main_node = NULL;
+    rb_tree_node *sub_node = NULL;
+    box_factory_box box;
+
+    for (main_node = rb_tree_search_smallest_from(tree, &target_main_key); main_node != NULL; main_node = rb_tree_successor(tree, main_node)) {
+
+        /* Same pruning as GETBOX - this main node and its successors give volumes of at least (val * sub_val), so once the worst size of a full heap
+         has a smaller volume, none of them can enter the heap. */
+
+        if ((*count == k) && ((box_volume) heap[0].side_square * heap[0].height < (box_volume) get_main_tree_node_val(main_node) * sub_val)) {
+
+            break;
+        }
+
+        if (get_subtree_max_node_val(main_node) < sub_val) {
+
+            continue;
+        }
+
+        /* The suitable sizes of the subtree come in increasing order of volume - stop at the first one which doesn't enter the heap. */
+
+        for (sub_node = rb_tree_search_smallest_from(get_subtree(main_node), &target_sub_key); sub_node != NULL;
+             sub_node = rb_tree_successor(get_subtree(main_node), sub_node)) {
+
+            box.side_square = main_is_side ? get_main_tree_node_val(main_node) : get_subtree_node_val(sub_node);
+            box.height = main_is_side ? get_subtree_node_val(sub_node) : get_main_tree_node_val(main_node);
+            box.count = sub_node->count;
+
+            if ((*count == k) && !box_factory_box_less(&box, &(heap[0]))) {
+
+                break;
+            }
+
+            box_factory_top_k_offer(heap, k, count, &box);
+        }
+    }
+}
+
+
+unsigned int box_factory_get_top_k(box_factory *factory, box_dim side, box_dim height, unsigned int k, box_factory_box out[])
+{
+
+    box_trace_record record;
+    box_trace_item item = {.side = 0, .height = 0, .count = 0, .box_side_square = 0, .box_height = 0};
+    unsigned int i = 0;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_get_top_k(factory, side, height, k, out);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_TOP_K, side, height);
+
+    record.k = k;
+    record.item_count = box_factory_run_get_top_k(factory, side, height, k, out);
+
+    box_trace_write(factory->trace, &record);
+
+    for (i = 0; i < record.item_count; ++i) {
+
+        item.side = out[i].side_square;
+        item.height = out[i].height;
+        item.count = out[i].count;
+
+        box_trace_write_item(factory->trace, BOX_TRACE_TOP_K, &item);
+    }
+
+    return record.item_count;
+}
+
+
+static unsigned int box_factory_run_get_top_k(box_factory *factory, box_dim side, box_dim height, unsigned int k, box_factory_box out[])
+{
+
+    box_cursor cursor;
+    box_factory_box box;
+    box_factory_disk_scan scan;
+    unsigned int count = 0;
+    unsigned int i = 0;
+
+    if ((k == 0) || (side > BOX_DIM_MAX_SIDE)) {			/* No box has a side larger than BOX_DIM_MAX_SIDE. */
+
+        return 0;
+    }
+
+    if (!box_factory_load_snapshot(factory)) {
+
+        return 0;
+    }
+
+    /* Over a box index - the first k sizes of the cursor are the answer. */
+
+    if (factory->index != NULL) {
+
+        box_factory_suitable_begin(factory, side, height, &cursor);
+
+        while ((count < k) && box_factory_suitable_next(&cursor, &(out[count]))) {
+
+            count++;
+        }
+
+        box_factory_suitable_end(&cursor);
+
+        return count;
+    }
+
+    /* out is the bounded heap. Scan the main tree which the planner chooses, like GETBOX does (or the B+-tree, which is ordered by side.) */
+
+    if (factory->disk != NULL) {
+
+        memset(&scan, 0, sizeof(scan));
+
+        scan.height = height;
+        scan.heap = out;
+        scan.k = k;
+
+        box_btree_scan(factory->disk, side * side, height, box_factory_top_k_visit, &scan);
+
+        count = scan.heap_count;
+    }
+
+    else {
+
+        if (box_planner_side_first(&(factory->planner), side * side, height)) {
+
+            box_factory_top_k_by_input(factory->tree_by_side, true, side * side, height, k, out, &count);
+        }
+
+        else {
+
+            box_factory_top_k_by_input(factory->tree_by_height, false, height, side * side, k, out, &count);
+        }
+    }
+
+    /* Sort the heap - move the worst size to the end, one at a time. */
+
+    for (i = count; i > 1; --i) {
+
+        box = out[0];
+        out[0] = out[i - 1];
+        out[i - 1] = box;
+
+        box_factory_top_k_sift_down(out, i - 1, 0);
+    }
+
+    return count;
+}
+
+
+void box_factory_set_cost_function(box_factory *factory, box_cost_function function, void *context, bool monotone)
+{
+
+    box_cost_set_function(&(factory->cost), function, context, monotone);
+}
+
+
+bool box_factory_set_price(box_factory *factory, box_dim side, box_dim height, double price)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_set_price(factory, side, height, price);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_SET_PRICE, side, height);
+
+    record.price = price;
+    record.result = box_factory_run_set_price(factory, side, height, price);
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_set_price(box_factory *factory, box_dim side, box_dim height, double price)
+{
+
+    if (side > BOX_DIM_MAX_SIDE) {
+
+        return false;
+    }
+
+    return box_cost_set_price(&(factory->cost), side * side, height, price);
+}
+
+
+bool box_factory_remove_price(box_factory *factory, box_dim side, box_dim height)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_remove_price(factory, side, height);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_REMOVE_PRICE, side, height);
+
+    record.result = box_factory_run_remove_price(factory, side, height);
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_remove_price(box_factory *factory, box_dim side, box_dim height)
+{
+
+    if (side > BOX_DIM_MAX_SIDE) {
+
+        return false;
+    }
+
+    return box_cost_remove_price(&(factory->cost), side * side, height);
+}
+
+
+static void box_factory_offer_candidate(box_factory_candidate *best, double cost, box_dim side_square, box_dim height)
+{
+
+    box_volume volume = (box_volume) side_square * height;
+    box_volume best_volume = (box_volume) best->side_square * best->height;
+
+    if (best->found && (cost != best->cost)) {
+
+        if (cost > best->cost) {
+
+            return;
+        }
+    }
+
+    else {
+
+        if (best->found && ((volume > best_volume) || ((volume == best_volume) &&
+                                                       ((side_square > best->side_square) || ((side_square == best->side_square) && (height >= best->height)))))) {
+
+            return;
+        }
+    }
+
+    best->found = true;
+    best->cost = cost;
+    best->side_square = side_square;
+    best->height = height;
+}
+
+
+static bool box_factory_candidate_beats(box_factory_candidate *best, double cost, box_volume volume)
+{
+
+    return best->found && ((best->cost < cost) || ((best->cost == cost) && ((box_volume) best->side_square * best->height < volume)));
+}
+
+
+static void box_factory_cheapest_by_input(box_factory *factory, rb_tree *tree, bool main_is_side, box_dim main_val, box_dim sub_val,
+                                          box_factory_candidate *best)
+{
+
+    main_tree_key target_main_key = {.val = main_val, .subtree = NULL};
+    subtree_key target_sub_key = {.val = sub_val};
+
+    rb_tree_node *main_node = NULL;
+    rb_tree_node *sub_node = NULL;
+    box_dim side_square = 0;
+    box_dim height = 0;
+    double price = 0;
+
+    for (main_node = rb_tree_search_smallest_from(tree, &target_main_key); main_node != NULL; main_node = rb_tree_successor(tree, main_node)) {
+
+        side_square = main_is_side ? get_main_tree_node_val(main_node) : sub_val;
+        height = main_is_side ? sub_val : get_main_tree_node_val(main_node);
+
+        /* This main node and its successors only have suitable sizes whose cost and volume are at least those of (val, sub_val). */
+
+        if (factory->cost.monotone &&
+            box_factory_candidate_beats(best, box_cost_of_function(&(factory->cost), side_square, height), (box_volume) side_square * height)) {
+
+            break;
+        }
+
+        if (get_subtree_max_node_val(main_node) < sub_val) {
+
+            continue;
+        }
+
+        for (sub_node = rb_tree_search_smallest_from(get_subtree(main_node), &target_sub_key); sub_node != NULL;
+             sub_node = rb_tree_successor(get_subtree(main_node), sub_node)) {
+
+            side_square = main_is_side ? get_main_tree_node_val(main_node) : get_subtree_node_val(sub_node);
+            height = main_is_side ? get_subtree_node_val(sub_node) : get_main_tree_node_val(main_node);
+
+            if (!factory->cost.monotone) {
+
+                box_factory_offer_candidate(best, box_cost_of(&(factory->cost), side_square, height), side_square, height);
+                continue;
+            }
+
+            /* With a monotone cost, the first size without a price is the cheapest one of the subtree. */
+
+            if (!box_cost_get_price(&(factory->cost), side_square, height, &price)) {
+
+                box_factory_offer_candidate(best, box_cost_of_function(&(factory->cost), side_square, height), side_square, height);
+                break;
+            }
+        }
+    }
+}
+
+
+static void box_factory_cheapest_by_index(box_factory *factory, box_dim side, box_dim height, box_factory_candidate *best)
+{
+
+    box_index *index = factory->index;
+    void *heights = NULL;
+    unsigned int main_key = 0;			/* The keys of the sets of the box index, and their values. */
+    unsigned int sub_key = 0;
+    unsigned int height_key = 0;
+    box_dim main_val = 0;
+    box_dim sub_val = 0;
+    bool has_main = false;
+    bool has_sub = false;
+    double price = 0;
+
+    if (!box_index_key_from(index->sides, side, &main_key) || !box_index_key_from(index->heights, height, &height_key)) {
+
+        return;
+    }
+
+    for (has_main = index->ops->lower_bound(index->set_by_side, main_key, &main_key); has_main;
+         has_main = index->ops->successor(index->set_by_side, main_key, &main_key)) {
+
+        main_val = box_index_value(index->sides, main_key);
+
+        if (factory->cost.monotone && box_factory_candidate_beats(best, box_cost_of_function(&(factory->cost), main_val * main_val, height),
+                                                                  (box_volume) main_val * main_val * height)) {
+
+            break;
+        }
+
+        heights = *(index->ops->payload(index->set_by_side, main_key));
+
+        for (has_sub = index->ops->lower_bound(heights, height_key, &sub_key); has_sub; has_sub = index->ops->successor(heights, sub_key, &sub_key)) {
+
+            sub_val = box_index_value(index->heights, sub_key);
+
+            if (!factory->cost.monotone) {
+
+                box_factory_offer_candidate(best, box_cost_of(&(factory->cost), main_val * main_val, sub_val), main_val * main_val, sub_val);
+                continue;
+            }
+
+            if (!box_cost_get_price(&(factory->cost), main_val * main_val, sub_val, &price)) {
+
+                box_factory_offer_candidate(best, box_cost_of_function(&(factory->cost), main_val * main_val, sub_val), main_val * main_val, sub_val);
+                break;
+            }
+        }
+    }
+}
+
+
+static unsigned int box_factory_instances(box_factory *factory, box_dim side_square, box_dim height)
+{
+
+    main_tree_key target_main_key = {.val = side_square, .subtree = NULL};
+    subtree_key target_sub_key = {.val = height};
+
+    main_tree_key *main_key = NULL;
+    rb_tree_node *sub_node = NULL;
+    void **heights = NULL;
+    unsigned int side_key = 0;
+    unsigned int height_key = 0;
+
+    if (factory->disk != NULL) {
+
+        return box_btree_instances(factory->disk, side_square, height);
+    }
+
+    if (factory->index != NULL) {
+
+        if (!box_index_key(factory->index->sides, box_factory_side_of(side_square), &side_key) ||
+            !box_index_key(factory->index->heights, height, &height_key)) {
+
+            return 0;
+        }
+
+        heights = factory->index->ops->payload(factory->index->set_by_side, side_key);
+
+        return (heights == NULL) ? 0 : factory->index->ops->instances(*heights, height_key);
+    }
+
+    main_key = rb_tree_search_exact(factory->tree_by_side, &target_main_key);
+
+    if (main_key == NULL) {
+
+        return 0;
+    }
+
+    sub_node = rb_tree_search_smallest_from(main_key->subtree, &target_sub_key);
+
+    return ((sub_node == NULL) || (get_subtree_node_val(sub_node) != height)) ? 0 : sub_node->count;
+}
+
+
+static void box_factory_cheapest_by_price(box_factory *factory, box_dim side_square, box_dim height, box_factory_candidate *best)
+{
+
+    box_cost_price *price = NULL;
+    unsigned int i = 0;
+
+    for (i = 0; (i < factory->cost.capacity) && (factory->cost.price_count > 0); ++i) {
+
+        price = &(factory->cost.prices[i]);
+
+        if (price->used && (price->side_square >= side_square) && (price->height >= height) &&
+            (box_factory_instances(factory, price->side_square, price->height) > 0)) {
+
+            box_factory_offer_candidate(best, price->price, price->side_square, price->height);
+        }
+    }
+}
+
+
+bool box_factory_get_cheapest(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height,
+                              double *found_cost)
+{
+
+    box_trace_record record;
+
+    if (factory->trace == NULL) {
+
+        return box_factory_run_get_cheapest(factory, side, height, found_side_square, found_height, found_cost);
+    }
+
+    box_trace_begin(factory->trace, &record, BOX_TRACE_CHEAPEST, side, height);
+
+    record.result = box_factory_run_get_cheapest(factory, side, height, found_side_square, found_height, found_cost);
+
+    if (record.result) {
+
+        record.found_side_square = *found_side_square;
+        record.found_height = *found_height;
+        record.price = *found_cost;
+    }
+
+    box_trace_write(factory->trace, &record);
+
+    return record.result;
+}
+
+
+static bool box_factory_run_get_cheapest(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height,
+                                         double *found_cost)
+{
+
+    box_factory_candidate best = {.found = false, .cost = 0, .side_square = 0, .height = 0};
+    box_factory_disk_scan scan;
+
+    if (side > BOX_DIM_MAX_SIDE) {			/* No box has a larger side. */
+
+        return false;
+    }
+
+    if (!box_factory_load_snapshot(factory)) {
+
+        return false;
+    }
+
+    /* If one of the main trees is empty - there're no boxes in the factory. */
+
+    if ((factory->index == NULL) && (factory->disk == NULL) && (factory->tree_by_height->count == 0)) {
+
+        return false;
+    }
+
+    /* With a monotone cost, the sizes with prices are offered first - their costs may let the scan stop earlier. */
+
+    if (factory->cost.monotone) {
+
+        box_factory_cheapest_by_price(factory, side * side, height, &best);
+    }
+
+    if (factory->disk != NULL) {
+
+        memset(&scan, 0, sizeof(scan));
+
+        scan.factory = factory;
+        scan.height = height;
+        scan.best = &best;
+
+        box_btree_scan(factory->disk, side * side, height, box_factory_cheapest_visit, &scan);
+    }
+
+    else {
+
+        if (factory->index != NULL) {
+
+            box_factory_cheapest_by_index(factory, side, height, &best);
+        }
+
+        else {
+
+            if (box_planner_side_first(&(factory->planner), side * side, height)) {
+
+                box_factory_cheapest_by_input(factory, factory->tree_by_side, true, side * side, height, &best);
+            }
+
+            else {
+
+                box_factory_cheapest_by_input(factory, factory->tree_by_height, false, height, side * side, &best);
+            }
+        }
+    }
+
+    if (!best.found) {
+
+        return false;
+    }
+
+    *found_side_square = best.side_square;
+    *found_height = best.height;
+    *found_cost = best.cost;
+
+    return true;
+}
+
+
+static int compare_batch_items(const void *a, const void *b)
+{
+
+    const box_factory_batch_item *item_a = a;
+    const box_factory_batch_item *item_b = b;
 
-    /* Before trying to remove a key from this main tree (tree_by_height), one of the following cases is true:
+    if (item_a->volume != item_b->volume) {			/* Larger volumes first. */
 
-     1) There's no box of the given dimensions in the box factory, which means one of the following:
-        1.1) The key with val = height wouldn't be found in tree_by_height.
-        1.2) The key with val = height would be found in tree_by_height, but the key with val = (side * side) wouldn't be found in the corresponding subtree.
-     2) There is a box of the given dimensions in the box factory - meaning the key with val = height would be found in tree_by_height and the
-        key with val = (side * side) would be found in the corresponding subtree. */
+        return (item_a->volume > item_b->volume) ? -1 : 1;
+    }
 
-	new_main_key = create_main_tree_key(height);			/* Create a key of tree_by_height with val = height. */
+    if (item_a->side != item_b->side) {
 
-    if (new_main_key == NULL) {
+        return (item_a->side > item_b->side) ? -1 : 1;
+    }
 
-        return false;
+    if (item_a->height != item_b->height) {
+
+        return (item_a->height > item_b->height) ? -1 : 1;
     }
 
-    /* First, we would search in the main tree (tree_by_height) in order to check whether the box of the given height exists in the box factory. */
+    return (item_a->index < item_b->index) ? -1 : 1;			/* Equal presents keep their order. */
+}
 
-    tree_by_height_key = rb_tree_search_exact(factory->tree_by_height, new_main_key);
 
-    if (tree_by_height_key == NULL) {			/* Case 1.1 - the box with the given height doesn't exist in the box factory. */
+static unsigned int box_factory_take_boxes(box_factory *factory, box_dim side_square, box_dim height, unsigned int wanted)
+{
 
-        free_main_tree_key(new_main_key);			/* Free the memory allocated for new_main_key, because there's nothing to remove. */
+    main_tree_key target_side_key = {.val = side_square, .subtree = NULL};
+    main_tree_key target_height_key = {.val = height, .subtree = NULL};
+    subtree_key target_height_sub_key = {.val = height};
+    subtree_key target_side_sub_key = {.val = side_square};
 
-        return false;
+    main_tree_key *tree_by_side_key = NULL;
+    main_tree_key *tree_by_height_key = NULL;
+    main_tree_key *deleted_main_key = NULL;
+    subtree_key *deleted_sub_key = NULL;
+
+    box_dim side = box_factory_side_of(side_square);
+    unsigned int available = 0;
+    unsigned int taken = 0;
+    unsigned int unit = 0;
+    bool last_unit = false;
+
+    if (factory->disk != NULL) {			/* The count of the size is decreased in place. */
+
+        available = box_btree_instances(factory->disk, side_square, height);
+        taken = (available < wanted) ? available : wanted;
+
+        box_btree_remove(factory->disk, side_square, height, taken, &last_unit);
     }
 
-    /* Free the memory allocated for new_main_key, because we found that it exists in tree_by_height. (tree_by_height_key != NULL). */
+    else {
 
-    free_main_tree_key(new_main_key);
+        if (factory->index != NULL) {
 
-    new_sub_key = create_subtree_key(side * side);			/* Create a key of the subtree (of the key of tree_by_height) with val = (side * side). */
+            available = box_factory_instances(factory, side_square, height);
+            taken = (available < wanted) ? available : wanted;
 
-    if (new_sub_key == NULL) {
+            for (unit = 0; unit < taken; ++unit) {
 
-        return false;
+                box_index_remove(factory->index, side, height, &last_unit);
+            }
+        }
+
+        else {
+
+            tree_by_side_key = rb_tree_search_exact(factory->tree_by_side, &target_side_key);
+            tree_by_height_key = rb_tree_search_exact(factory->tree_by_height, &target_height_key);
+
+            available = rb_tree_search_smallest_from(tree_by_side_key->subtree, &target_height_sub_key)->count;
+            taken = (available < wanted) ? available : wanted;
+
+            /* Decrease the counts of the dimensions in both subtrees in place. Only if they run out the keys are deleted, like in
+             box_factory_remove. */
+
+            rb_tree_remove_instances(tree_by_side_key->subtree, &target_height_sub_key, taken, (void **) &deleted_sub_key);
+            box_factory_free(factory, deleted_sub_key, sizeof(subtree_key));
+
+            rb_tree_remove_instances(tree_by_height_key->subtree, &target_side_sub_key, taken, (void **) &deleted_sub_key);
+            box_factory_free(factory, deleted_sub_key, sizeof(subtree_key));
+
+            last_unit = (taken == available);
+
+            if (tree_by_side_key->subtree->count == 0) {
+
+                rb_tree_remove(factory->tree_by_side, tree_by_side_key, (void **) &deleted_main_key);
+                box_histogram_remove(&(factory->planner.by_side), side_square);
+                free_main_tree_key(factory, deleted_main_key);
+            }
+
+            if (tree_by_height_key->subtree->count == 0) {
+
+                rb_tree_remove(factory->tree_by_height, tree_by_height_key, (void **) &deleted_main_key);
+                box_histogram_remove(&(factory->planner.by_height), height);
+                free_main_tree_key(factory, deleted_main_key);
+            }
+
+            /* The cascades hold the values of the keys only - a change of a count doesn't make them stale. */
+
+            if (last_unit) {
+
+                box_cascade_invalidate(&(factory->cascade_by_side));
+                box_cascade_invalidate(&(factory->cascade_by_height));
+            }
+        }
     }
 
-    /* Search the subtree of found tree_by_height_key in order to check whether the box of the given dimensions exists in the box factory. */
+    for (unit = 0; unit < taken; ++unit) {
 
-    sub_key = rb_tree_search_exact(tree_by_height_key->subtree, new_sub_key);
+        if (factory->dominance != NULL) {
 
-    if (sub_key == NULL) {			/* Case 1.2 - there is a box in the box factory with the given height, but not with the given side. */
+            box_dominance_remove(factory->dominance, side, height);
+        }
 
-        free(new_sub_key);			/* Free the memory allocated for new_sub_key, because there's nothing to remove. */
+        if (factory->approx != NULL) {
 
-        return false;
+            box_approx_remove(factory->approx, side, height);
+        }
     }
 
-    /* Case 2 - there is a box of the given dimensions in the box factory. (sub_key != NULL). */
+    if (factory->shared != NULL) {
 
-    /* Remove the key with val = (side * side) from the subtree of the found tree_by_height_key. */
+        box_shared_remove(factory->shared, side_square, height, taken);
+    }
 
-    rb_tree_remove(tree_by_height_key->subtree, new_sub_key, (void **) &sub_key);
+    if (last_unit) {			/* Same as in box_factory_remove - only the removal of the last box of the dimensions may change a cached answer. */
 
-    if (sub_key) {			/* There are no more keys with val = (side * side) in the subtree of tree_by_height_key. */
+        box_cache_on_remove(&(factory->cache), side_square, height);
+    }
+
+    if ((factory->wal != NULL) && (taken > 0)) {			/* The room was reserved by box_factory_assign_batch. */
 
-        free(sub_key);		/* Free the memory allocated for the key with val = (side * side), which was removed from the subtree of tree_by_height_key. */
+        box_wal_append(factory->wal, BOX_WAL_REMOVE, side, height, taken);
     }
 
-    /* In case the subtree of tree_by_height_key has been emptied, tree_by_height_key should be removed from tree_by_height. */
+    return taken;
+}
 
-    if (tree_by_height_key->subtree->count == 0) {
 
-        rb_tree_remove(factory->tree_by_height, tree_by_height_key, (void **) &tree_by_height_deleted_key);
+bool box_factory_assign_batch(box_factory *factory, box_factory_present presents[], unsigned int count, unsigned int *unassigned)
+{
 
-        /* Free the memory allocated for the key with val = height, which was removed from tree_by_height. */
+    box_trace_record record;
+    box_trace_item item = {.side = 0, .height = 0, .count = 0, .box_side_square = 0, .box_height = 0};
+    unsigned int i = 0;
 
-        free_main_tree_key(tree_by_height_deleted_key);
+    if (factory->trace == NULL) {
+
+        return box_factory_run_assign_batch(factory, presents, count, unassigned);
     }
 
-    free(new_sub_key);			/* Free the memory we allocated for new_sub_key. */
+    box_trace_begin(factory->trace, &record, BOX_TRACE_ASSIGN, 0, 0);
 
-    return true;
+    record.item_count = count;
+    record.result = box_factory_run_assign_batch(factory, presents, count, unassigned);
+    record.value = *unassigned;
+
+    box_trace_write(factory->trace, &record);
+
+    /* The presents are the arguments and the results together - the side and the height of every present, and the box assigned to it. */
+
+    for (i = 0; i < count; ++i) {
+
+        item.side = presents[i].side;
+        item.height = presents[i].height;
+        item.count = presents[i].assigned ? 1 : 0;
+        item.box_side_square = presents[i].assigned ? presents[i].box_side_square : 0;
+        item.box_height = presents[i].assigned ? presents[i].box_height : 0;
+
+        box_trace_write_item(factory->trace, BOX_TRACE_ASSIGN, &item);
+    }
+
+    return record.result;
 }
 
 
-bool box_factory_remove(box_factory *factory, unsigned int side, unsigned int height)
+static bool box_factory_run_assign_batch(box_factory *factory, box_factory_present presents[], unsigned int count, unsigned int *unassigned)
 {
-    if (box_factory_remove_tree_by_side(factory, side, height) == false) {
+
+    box_factory_batch_item *items = NULL;
+    box_factory_present *present = NULL;
+
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    unsigned int run_end = 0;
+    unsigned int taken = 0;
+    unsigned int i = 0;
+
+    *unassigned = 0;
+
+    if (factory->read_only || !box_factory_load_snapshot(factory)) {			/* The boxes of a snapshot are copied before the first change. */
 
         return false;
     }
 
-    /* If we were able to remove from tree_by_side, this means the box of the given dimensions exists in the box factory, so we should be able to remove
-     from tree_by_height. */
+    /* Every group of boxes taken for a run of presents is a record of the log - at most one for every present. The room for them is reserved first, so
+     appending them can't fail in the middle of the batch, and they are written together by its end. */
 
-    box_factory_remove_tree_by_height(factory, side, height);
+    if ((factory->wal != NULL) && !box_wal_reserve(factory->wal, count)) {
 
-    return true;
+        return false;
+    }
+
+    items = malloc(sizeof(box_factory_batch_item) * ((count > 0) ? count : 1));
+
+    if (items == NULL) {
+
+        return false;
+    }
+
+    for (i = 0; i < count; ++i) {
+
+        items[i].volume = (box_volume) presents[i].side * presents[i].side * presents[i].height;
+        items[i].side = presents[i].side;
+        items[i].height = presents[i].height;
+        items[i].index = i;
+
+        presents[i].assigned = false;
+    }
+
+    qsort(items, count, sizeof(box_factory_batch_item), compare_batch_items);
+
+    /* Equal presents are next to each other now. The GETBOX answer of a present stays the answer for the following equal presents as long as there are
+     boxes of its dimensions left (the removals of these boxes are the only changes in between) - so a run of equal presents is served by one GETBOX
+     for every dimensions it uses up, and the boxes are removed in groups. */
+
+    for (i = 0; i < count; i = run_end) {
+
+        run_end = i + 1;
+
+        while ((run_end < count) && (items[run_end].side == items[i].side) && (items[run_end].height == items[i].height)) {
+
+            run_end++;
+        }
+
+        while (i < run_end) {
+
+            if (!box_factory_run_get_box(factory, items[i].side, items[i].height, &found_side_square, &found_height)) {
+
+                *unassigned += run_end - i;			/* No suitable box now means none later in the batch - boxes are only removed. */
+                break;
+            }
+
+            for (taken = box_factory_take_boxes(factory, found_side_square, found_height, run_end - i); taken > 0; --taken, ++i) {
+
+                present = &(presents[items[i].index]);
+
+                present->assigned = true;
+                present->box_side_square = found_side_square;
+                present->box_height = found_height;
+            }
+        }
+    }
+
+    free(items);
+
+    return box_factory_commit_log(factory);
 }
 
 
-static bool box_factory_get_by_input(rb_tree *tree, unsigned int main_val, unsigned int sub_val, unsigned int *found_main_val, unsigned int *found_sub_val)
+static unsigned long long box_factory_count_by_side(box_factory *factory, box_dim side, box_dim height)
 {
+
+    main_tree_key target_main_key = {.val = side * side, .subtree = NULL};
+    subtree_key target_sub_key = {.val = height};
+
     rb_tree_node *main_node = NULL;
-    rb_tree_node *sub_node = NULL;
+    unsigned long long count = 0;
+    unsigned long long instances = 0;
+    unsigned int unique = 0;
 
-    rb_tree_node *min_main_node = NULL;
-    rb_tree_node *min_sub_node = NULL;
+    for (main_node = rb_tree_search_smallest_from(factory->tree_by_side, &target_main_key); main_node != NULL;
+         main_node = rb_tree_successor(factory->tree_by_side, main_node)) {
 
-    main_tree_key target_main_key = {.val = main_val, .subtree = NULL};
-    subtree_key target_sub_key = {.val = sub_val};
+        rb_tree_count_range(get_subtree(main_node), &target_sub_key, NULL, &unique, &instances);			/* The heights from the given one. */
 
-    unsigned int volume = 0;
-    unsigned int min_volume = 0;
+        count += instances;
+    }
 
-    /* Search the given main tree for a node with the smallest key that is larger than or equal to the given key (target_main_key). */
+    return count;
+}
 
-    main_node = rb_tree_search_smallest_from(tree, &target_main_key);
 
-    /* If val of the key of a maximum node in the subtree of the key of the found main tree node (main_node), is smaller than the given sub_val - then
-     main_node can't be the node we're looking for, therefore we proceed to check the next node of the main tree (successor of the current main_node.) */
+unsigned long long box_factory_count_suitable(box_factory *factory, box_dim side, box_dim height)
+{
 
-    while (main_node && (get_subtree_max_node_val(main_node) < sub_val)) {
+    box_trace_record record;
 
-    	main_node = rb_tree_successor(tree, main_node);
+    if (factory->trace == NULL) {
+
+        return box_factory_run_count_suitable(factory, side, height);
     }
 
-    if (main_node == NULL) {
+    box_trace_begin(factory->trace, &record, BOX_TRACE_COUNT_SUITABLE, side, height);
 
-        return false;
+    record.value = box_factory_run_count_suitable(factory, side, height);
+
+    box_trace_write(factory->trace, &record);
+
+    return record.value;
+}
+
+
+static unsigned long long box_factory_run_count_suitable(box_factory *factory, box_dim side, box_dim height)
+{
+
+    box_factory_disk_scan scan;
+
+    if (side > BOX_DIM_MAX_SIDE) {			/* No box has a larger side. */
+
+        return 0;
     }
 
-    /* Search the subtree of the key of the found suitable main_node, for a node with the smallest key that is larger than or equal to the given key
-     (target_sub_key). */
+    if (!box_factory_load_snapshot(factory)) {
 
-    sub_node = rb_tree_search_smallest_from(get_subtree(main_node), &target_sub_key);
+        return 0;
+    }
 
-    /* Now, when the suitable (according to the given dimensions) main_node and sub_node are found - calculate the minimal volume to start with. */
+    if (factory->dominance != NULL) {
 
-    min_volume = get_main_tree_node_val(main_node) * get_subtree_node_val(sub_node);
+        return box_dominance_count(factory->dominance, side, height);
+    }
 
-    min_main_node = main_node;
-    min_sub_node = sub_node;
+    if (factory->disk != NULL) {
 
-    /* We divide the current minimal volume by val of the key of the current main_node.
-     We do this in order to check whether we need to continue looking for the minimal possible volume by checking the next node in the tree (successor
-     of the current main_node.)
-     If we find that the result of described division is less than or equal to the given sub_val - this means there's no point to continue, because
-     there's no way we will receive a suitable volume which is less than the minimal volume that we've already found, by checking the successors. */
+        memset(&scan, 0, sizeof(scan));
 
-    while (main_node && (min_volume / get_main_tree_node_val(main_node) > sub_val)) {
+        box_btree_scan(factory->disk, side * side, height, box_factory_count_visit, &scan);
 
-    	main_node = rb_tree_successor(tree, main_node);
+        return scan.count;
+    }
 
-    	/* Check whether the subtree of the key of the currently checked main_node meets the requirements of containing the suitable dimensions.
-    	 If it doesn't - go back to the while condition. */
+    if (factory->index != NULL) {
 
-        if ((main_node == NULL) || (get_subtree_max_node_val(main_node) < sub_val)) {
+        return box_index_count_suitable(factory->index, side, height);
+    }
 
-            continue;
-        }
+    return box_factory_count_by_side(factory, side, height);
+}
 
-        /* Search the subtree of the key of the found suitable main_node, for a node with the smallest key that is larger than or equal to the given key
-         (target_sub_key). */
 
-        sub_node = rb_tree_search_smallest_from(get_subtree(main_node), &target_sub_key);
+unsigned int box_factory_count_sides(box_factory *factory, box_dim min_side, box_dim max_side)
+{
 
-        volume = get_main_tree_node_val(main_node) * get_subtree_node_val(sub_node);
+    box_trace_record record;
 
-        if (min_volume > volume) {			/* Check whether we have found a new minimal volume. */
+    if (factory->trace == NULL) {
 
-            min_volume = volume;
-            min_main_node = main_node;
-            min_sub_node = sub_node;
-        }
+        return box_factory_run_count_sides(factory, min_side, max_side);
     }
 
-    /* At the end, found_main_val and found_sub_val would contain val of the key of the main tree node and val of the key of the corresponding subtree node,
-     which we found to give the minimal suitable volume. */
+    box_trace_begin(factory->trace, &record, BOX_TRACE_COUNT_SIDES, min_side, max_side);
 
-    *found_main_val = get_main_tree_node_val(min_main_node);
+    record.value = box_factory_run_count_sides(factory, min_side, max_side);
 
-    *found_sub_val = get_subtree_node_val(min_sub_node);
+    box_trace_write(factory->trace, &record);
 
-    return true;
+    return (unsigned int) record.value;
 }
 
 
-bool box_factory_get_box(box_factory *factory, unsigned int side, unsigned int height, unsigned int *found_side_square, unsigned int *found_height)
+static unsigned int box_factory_run_count_sides(box_factory *factory, box_dim min_side, box_dim max_side)
 {
-    if (factory->tree_by_height->count == 0) {			/* If one of the main trees is empty - there're no boxes in the factory. */
 
-        return false;
+    main_tree_key low_key = {.val = 0, .subtree = NULL};
+    main_tree_key high_key = {.val = 0, .subtree = NULL};
+    unsigned int unique = 0;
+    box_factory_disk_scan scan;
+
+    if (max_side > BOX_DIM_MAX_SIDE) {			/* No box has a larger side. */
+
+        max_side = BOX_DIM_MAX_SIDE;
+    }
+
+    if ((min_side > max_side) || !box_factory_load_snapshot(factory)) {
+
+        return 0;
     }
 
-    /* Check the main tree which is smaller (we compare m and n, which represent the number of unique keys in the main trees - tree_by_side and
-     tree_by_height accordingly.) */
+    low_key.val = min_side * min_side;
+    high_key.val = max_side * max_side;
 
-    if (factory->tree_by_height->count > factory->tree_by_side->count){
+    if (factory->index != NULL) {
 
-        return box_factory_get_by_input(factory->tree_by_side, side * side, height, found_side_square, found_height);
+        return box_index_count_sides(factory->index, min_side, max_side);
     }
 
-    return box_factory_get_by_input(factory->tree_by_height, height, side * side, found_height, found_side_square);
+    if (factory->disk != NULL) {			/* The sides of the range are visited - the B+-tree doesn't count its keys. */
 
-    /* At the end, found_side_square and found_height would contain dimensions ((side * side) and height) of the box, which we found to have the minimal
-     suitable volume (minimal volume when the side of the box is at least the given side, and the height of the box is at least the given height.) */
+        memset(&scan, 0, sizeof(scan));
+
+        scan.max_side_square = high_key.val;
+
+        box_btree_scan(factory->disk, low_key.val, 0, box_factory_sides_visit, &scan);
+
+        return (unsigned int) scan.count;
+    }
+
+    /* tree_by_side is sorted by (side * side), which has the same order as the side - so the range of the sides is a range of its keys. */
+
+    rb_tree_count_range(factory->tree_by_side, &low_key, &high_key, &unique, NULL);
+
+    return unique;
 }
 
 
-static bool box_factory_check_by_input(rb_tree *tree, unsigned int main_val, unsigned int sub_val)
+static bool box_factory_collect_visit(void *context, const box_snapshot_record *record)
 {
-    rb_tree_node *main_node = NULL;
-    main_tree_key *main_key = NULL;
 
-    main_tree_key target_main_key;
-    subtree_key target_sub_key;
+    box_factory_disk_scan *scan = context;
 
-    target_main_key.val = main_val;
-    target_sub_key.val = sub_val;
+    scan->records[scan->count++] = *record;
 
-    /* Search the given main tree for a node with the smallest key that is larger than or equal to the given key (target_main_key). */
+    return true;
+}
 
-    main_node = rb_tree_search_smallest_from(tree, &target_main_key);
 
-    /* If we didn't find such a node - it means there's no box in the box factory suitable for the present of the given dimensions. */
+static bool box_factory_top_k_visit(void *context, const box_snapshot_record *record)
+{
 
-    if (main_node == NULL){
+    box_factory_disk_scan *scan = context;
+    box_factory_box box;
+
+    /* Same pruning as box_factory_top_k_by_input - the sizes from this side on give volumes of at least (side_square * height). */
+
+    if ((scan->heap_count == scan->k) &&
+        ((box_volume) scan->heap[0].side_square * scan->heap[0].height < (box_volume) record->side_square * scan->height)) {
 
         return false;
     }
 
-    main_key = (main_tree_key*) main_node->key;
+    box.side_square = record->side_square;
+    box.height = record->height;
+    box.count = record->count;
 
-    /* We compare between two keys:
-     1. The key of the maximum node in the subtree of the key (main_key) of the found suitable main tree node (main_node).
-     2. The given key (target_sub_key).
-     In case the key of the maximum node is smaller than the given key - then main_node can't be the node we're looking for, therefore we proceed to check
-     the next node of the main tree (successor of the current main_node.) */
+    box_factory_top_k_offer(scan->heap, scan->k, &(scan->heap_count), &box);
 
-    while ((main_node != NULL) && (main_key->subtree->cmp(main_key->subtree->max->key, &target_sub_key) == -1)){
+    return true;
+}
 
-        main_node = rb_tree_successor(tree, main_node);
 
-        if (main_node != NULL){
+static bool box_factory_cheapest_visit(void *context, const box_snapshot_record *record)
+{
 
-            main_key = (main_tree_key*) main_node->key;
-        }
+    box_factory_disk_scan *scan = context;
+    box_cost *cost = &(scan->factory->cost);
+    double price = 0;
+
+    if (!cost->monotone) {
+
+        box_factory_offer_candidate(scan->best, box_cost_of(cost, record->side_square, record->height), record->side_square, record->height);
+
+        return true;
     }
 
-    if (main_node == NULL){
+    /* The side which offered its first size without a price is done - its other sizes cost at least as much. */
+
+    if (scan->has_side && (scan->side_square == record->side_square)) {
+
+        return true;
+    }
+
+    if (box_factory_candidate_beats(scan->best, box_cost_of_function(cost, record->side_square, scan->height),
+                                    (box_volume) record->side_square * scan->height)) {
 
         return false;
     }
 
-    /* If in the end main_node != NULL - it means there is a box in the box factory suitable for the present of the given dimensions  */
+    if (!box_cost_get_price(cost, record->side_square, record->height, &price)) {			/* The sizes with prices were offered already. */
+
+        box_factory_offer_candidate(scan->best, box_cost_of_function(cost, record->side_square, record->height), record->side_square, record->height);
+
+        scan->has_side = true;
+        scan->side_square = record->side_square;
+    }
 
     return true;
 }
 
 
-bool box_factory_check_box(box_factory *factory, unsigned int side, unsigned int height)
+static bool box_factory_count_visit(void *context, const box_snapshot_record *record)
 {
 
-    /* Check the main tree which is smaller (we compare m and n, which represent the number of unique keys in the main trees - tree_by_side and
-     tree_by_height accordingly.) */
+    box_factory_disk_scan *scan = context;
 
-    if (factory->tree_by_height->count > factory->tree_by_side->count){
+    scan->count += record->count;
 
-        return box_factory_check_by_input(factory->tree_by_side, side * side, height);
+    return true;
+}
+
+
+static bool box_factory_sides_visit(void *context, const box_snapshot_record *record)
+{
+
+    box_factory_disk_scan *scan = context;
+
+    if (record->side_square > scan->max_side_square) {
+
+        return false;
     }
 
-    return box_factory_check_by_input(factory->tree_by_height, height, side * side);
+    if (!scan->has_side || (scan->side_square != record->side_square)) {
+
+        scan->count++;
+        scan->has_side = true;
+        scan->side_square = record->side_square;
+    }
+
+    return true;
+}
+
+
+static bool box_factory_load_visit(void *context, const box_snapshot_record *record)
+{
+
+    box_factory_disk_scan *scan = context;
+    unsigned int unit = 0;
+
+    for (unit = 0; (unit < record->count) && !scan->failed; ++unit) {
+
+        scan->failed = !box_factory_insert_indexes(scan->factory, box_factory_side_of(record->side_square), record->height);
+    }
+
+    return !scan->failed;
+}
+
+
+static box_dim box_factory_side_of(box_dim side_square)
+{
+
+    box_dim side = (box_dim) sqrt((double) side_square);
+
+    /* A double has 53 bits of precision, so the root of a 64-bit square may be off by one - fix it. */
+
+    if (side > BOX_DIM_MAX_SIDE) {
+
+        side = BOX_DIM_MAX_SIDE;
+    }
+
+    while (side * side > side_square) {
+
+        side--;
+    }
+
+    while ((side < BOX_DIM_MAX_SIDE) && ((side + 1) * (side + 1) <= side_square)) {
+
+        side++;
+    }
+
+    return side;
 }
 
 
-static unsigned int get_main_tree_node_val(rb_tree_node *main_tree_node)
+static box_dim get_main_tree_node_val(rb_tree_node *main_tree_node)
 {
 	main_tree_key *main_key = (main_tree_key*)main_tree_node->key;
 
@@ -808,7 +3703,7 @@ static unsigned int get_main_tree_node_val(rb_tree_node *main_tree_node)
 }
 
 
-static unsigned int get_subtree_node_val(rb_tree_node *sub_tree_node)
+static box_dim get_subtree_node_val(rb_tree_node *sub_tree_node)
 {
 	subtree_key *sub_tree_key = (subtree_key*) sub_tree_node->key;
 
@@ -816,7 +3711,7 @@ static unsigned int get_subtree_node_val(rb_tree_node *sub_tree_node)
 }
 
 
-static unsigned int get_subtree_max_node_val(rb_tree_node *main_tree_node)
+static box_dim get_subtree_max_node_val(rb_tree_node *main_tree_node)
 {
 	main_tree_key *main_key = NULL;
 	rb_tree *sub_tree = NULL;
@@ -1,33 +1,124 @@
 /* Box factory header file.
  Contains macro definitions and functions' prototype declarations for interfaces between source files of the box factory program.
- The functions in this file represent the login operations of the box - a main logic module of the exercise. */
+ The functions in this file represent the login operations of the box - a main logic module of the exercise.
+ Defining BOX_FACTORY_PORTABLE (e.g. -DBOX_FACTORY_PORTABLE) builds the box factory without mmap, fork, shared memory or epoll, for the menu and the
+ batch mode on any system with a C99 library: a snapshot is read into memory whole (see box_file_map), a checkpoint is written before
+ box_factory_checkpoint_begin returns (see box_checkpoint.h), box_factory_share and box_factory_open_shared always fail, and the server
+ (box_server.h) isn't built. */
 
 
 #include <stdbool.h>
 
 #include "rb_tree.h"
 
+#include "box_types.h"
+
+#include "box_cache.h"
+
+#include "box_index.h"
+
+#include "box_cascade.h"
+
+#include "box_planner.h"
+
+#include "box_dominance.h"
+
+#include "box_approx.h"
+
+#include "box_cost.h"
+
+#include "box_snapshot.h"
+
+#include "box_wal.h"
+
+#include "box_checkpoint.h"
+
+#include "box_export.h"
+
+#include "box_shared.h"
+
+#include "box_btree.h"
+
+#include "box_trace.h"
+
 #ifndef BOX_FACTORY_H_
 #define BOX_FACTORY_H_
 
 
+typedef enum box_factory_index_type_e {			/* The structure holding the boxes of the box factory. */
+
+    BOX_FACTORY_INDEX_RB_TREE = 0,			/* The main trees and their subtrees are red-black trees (the default.) */
+    BOX_FACTORY_INDEX_VEB = 1,			/* A box index of van Emde Boas trees (veb_tree.h) - O(log log U) successor and predecessor. */
+    BOX_FACTORY_INDEX_AUTO = 2,			/* A box index of adaptive sets (adaptive_set.h) - every set is a bit set while its values are small, and
+                                     is moved to a van Emde Boas tree once a larger value is inserted. */
+} box_factory_index_type;
+
+
+typedef struct box_factory_options_s {			/* Options of box_factory_create_with_options. A zeroed structure means the defaults. */
+
+    box_factory_index_type index_type;
+    bool count_index;			/* Keep a dominance index (box_dominance.h), so box_factory_count_suitable takes O(log^2 n) steps instead of a scan. */
+    double approx_epsilon;			/* If not 0 - keep an approximate index (box_approx.h) with this epsilon, for box_factory_get_box_approx. */
+    bool dictionary;			/* Keep the sides and the heights of the box index as small ids (box_dictionary.h.) Ignored without a box index. */
+    bool arena;			/* Allocate the main trees, their subtrees, nodes and keys from an arena (arena.h), so box_factory_destroy releases them
+                         all at once instead of visiting them. Ignored with a box index. */
+    const char *disk_path;			/* If not NULL - keep the boxes in a disk-backed B+-tree (box_btree.h) in a new file of this path, instead of
+                                 the main trees (index_type, dictionary and arena are ignored then.) */
+    size_t disk_memory;			/* The memory budget of the buffer pool of the B+-tree, in bytes. */
+} box_factory_options;
+
+
 typedef struct box_factory_s {		/* Box factory structure. Has two main trees - tree_by_side and tree_by_height. */
 
     rb_tree *tree_by_side;			/* Tree sorted by (side * side). */
     rb_tree *tree_by_height;		/* Tree sorted by height. */
+    box_index *index;				/* The box index used instead of the main trees (which are NULL then), NULL when the main trees are used. */
+    box_btree *disk;			/* The disk-backed B+-tree used instead of the main trees (which are NULL then), NULL without one. */
+    box_cache cache;				/* Cache of recent GETBOX answers, kept up to date by insertions and removals. */
+    box_cascade cascade_by_side;		/* Cascaded indexes of the main trees, used by GETBOX while they are current. */
+    box_cascade cascade_by_height;
+    box_planner planner;			/* Statistics of the keys of the main trees, which pick the main tree to scan for every query. */
+    box_dominance *dominance;			/* The dominance index, NULL unless asked for at creation time. */
+    box_approx *approx;			/* The approximate index, NULL unless asked for at creation time. */
+    box_cost cost;			/* The cost model of box_factory_get_cheapest. */
+    arena *arena;			/* The arena of the main trees, NULL unless asked for at creation time. */
+    box_snapshot *snapshot;			/* The snapshot the boxes are still read from (see box_factory_open_snapshot), NULL once they are copied. */
+    bool read_only;			/* TRUE if the box factory refuses insertions and removals. */
+    box_wal *wal;			/* The write-ahead log of the changes (see box_factory_recover), NULL without a log. */
+    box_checkpoint checkpoint;			/* The background checkpoint (see box_factory_checkpoint_begin.) */
+    box_shared *shared;			/* The shared segment of the boxes - written by box_factory_share, read by box_factory_open_shared - NULL without one. */
+    box_trace *trace;			/* The trace of the calls (see box_factory_trace_begin), NULL without one. */
 } box_factory;
 
 
+typedef struct box_factory_box_s {			/* A size of the boxes of the box factory, as returned by the queries which return several sizes. */
+
+    box_dim side_square;			/* (side * side) and height of the boxes - the same form as the answer of box_factory_get_box. */
+    box_dim height;
+    unsigned int count;			/* Number of boxes of this size in the box factory. */
+} box_factory_box;
+
+
+typedef struct box_factory_present_s {			/* A present of box_factory_assign_batch. */
+
+    box_dim side;			/* The dimensions of the present. */
+    box_dim height;
+    bool assigned;			/* Output - TRUE if a box was assigned to the present. */
+    box_dim box_side_square;		/* Output - (side * side) and height of the assigned box. */
+    box_dim box_height;
+} box_factory_present;
+
+
 typedef struct main_tree_key_s {			/* Main tree key structure. */
 
-    unsigned int val;			/* Holds the value of either height or (side * side) of the box. */
+    box_dim val;			/* Holds the value of either height or (side * side) of the box. */
     rb_tree *subtree;			/* A pointer to the subtree, appropriate to the content of val.  */
 } main_tree_key;
 
 
 typedef struct subtree_key_s {			/* Subtree key structure. */
 
-    unsigned int val;			/* Holds the value of either height or (side * side) of the box. */
+    box_dim val;			/* Holds the value of either height or (side * side) of the box. */
 } subtree_key;
 
 
@@ -37,27 +128,223 @@ typedef struct subtree_key_s {			/* Subtree key structure. */
 box_factory* box_factory_create();
 
 
-/* INSERTBOX of the exercise. Adds a box of the given dimensions to the box factory data structure. Returns FALSE on an allocation error, TRUE otherwise. */
+/* Create a box factory instance with the given options (NULL means the defaults, same as box_factory_create.)
+ Returns NULL on an allocation error, an I/O error of the file of a B+-tree (or if a box index is asked for in the 64-bit build - see box_types.h),
+ otherwise returns a pointer to box_factory. */
+
+box_factory* box_factory_create_with_options(const box_factory_options *options);
+
+
+/* Free the box factory with all of its boxes and indexes - after the background checkpoint ends, if one is running. The main trees are visited key by
+ key, unless they are in an arena - then its blocks are freed at once, in O(log n) steps for n keys. The file of a B+-tree is written and closed, so
+ box_factory_open_disk may open it again, and so is a trace. */
+
+void box_factory_destroy(box_factory *factory);
+
+
+/* Write a snapshot of the boxes of the box factory to the given path (see box_snapshot.h.) With a write-ahead log, the snapshot holds the LSN of the
+ last change, so box_factory_recover replays only the records which follow it. Returns FALSE on an allocation error or an I/O error, TRUE otherwise. */
+
+bool box_factory_save(box_factory *factory, const char *path);
+
+
+/* Create a box factory with the given options (see box_factory_create_with_options) over the snapshot file of the given path, without inserting its
+ boxes: the file is mapped to memory, and GETBOX and CHECKBOX are answered from its arrays directly. The boxes are copied into the structures of the
+ box factory lazily (see box_factory_load_snapshot) - by the first insertion or removal, or by the first of the other queries.
+ A read-only box factory (writable is FALSE) refuses insertions, removals and batch assignments.
+ Returns NULL on an allocation error, an I/O error or an invalid snapshot file, otherwise returns a pointer to box_factory. */
+
+box_factory* box_factory_open_snapshot(const char *path, const box_factory_options *options, bool writable);
+
+
+/* Copy the boxes of the snapshot of the box factory into its structures, and release the snapshot file. The main trees are built in O(n) steps for n
+ sizes of boxes, and a B+-tree gets the sizes in their order; a box index and the optional indexes get the boxes one by one. Nothing is done without
+ a snapshot.
+ Returns FALSE on an allocation error, in which case the box factory keeps reading from the snapshot, TRUE otherwise. The queries which need the copy
+ answer as if the box factory were empty if it fails. */
+
+bool box_factory_load_snapshot(box_factory *factory);
+
+
+/* Write an export of the boxes of the box factory to the given path - the compact file for archiving and shipping (see box_export.h.)
+ Returns FALSE on an allocation error or an I/O error, TRUE otherwise. */
+
+bool box_factory_export(box_factory *factory, const char *path);
+
+
+/* Create a box factory with the given options (see box_factory_create_with_options) from the export file of the given path. The file is decoded once,
+ as a stream, into the records the main trees are built from in O(n) steps (see box_factory_load_snapshot.)
+ Returns NULL on an allocation error, an I/O error or an invalid export file, otherwise returns a pointer to box_factory. */
+
+box_factory* box_factory_import(const char *path, const box_factory_options *options);
+
+
+/* Create a box factory with the given options (see box_factory_create_with_options) over the B+-tree file of the given path, which a box factory on
+ disk left when it was destroyed - disk_path of the options is ignored, and disk_memory is the memory budget. The boxes stay in the file; only the
+ optional indexes get them one by one.
+ Returns NULL on an allocation error, an I/O error, or an invalid file or a file which wasn't closed, otherwise returns a pointer to box_factory. */
+
+box_factory* box_factory_open_disk(const char *path, const box_factory_options *options);
+
+
+/* Publish the boxes of the box factory in a shared-memory segment of the given name (see box_shared.h), which is kept up to date by every change of
+ the box factory from then on, until it is destroyed - other processes open it with box_factory_open_shared, and query the boxes directly. A change
+ is in the segment once it's made, so with a write-ahead log the readers may see it before it's durable (see box_factory_sync.)
+ Returns FALSE if the box factory has a segment already, on an allocation error or an error of the segment (always in the portable build), TRUE
+ otherwise. */
+
+bool box_factory_share(box_factory *factory, const char *name);
+
 
-bool box_factory_insert(box_factory *factory, unsigned int side, unsigned int height);
+/* Create a read-only box factory over the shared-memory segment of the given name, published by box_factory_share in another process. GETBOX and
+ CHECKBOX (and the approximate GETBOX, which is GETBOX without an approximate index) are answered from the segment, so they see every change of the
+ publishing box factory once it's made; the other queries answer as if the box factory were empty.
+ Returns NULL on an allocation error, or if the segment couldn't be opened (always in the portable build), otherwise returns a pointer to box_factory. */
 
+box_factory* box_factory_open_shared(const char *name);
 
-/* REMOVEBOX of the exercise. Removes a box of the given dimensions from the box factory data structure.
- Returns FALSE if there's no box of the given dimensions, TRUE otherwise. */
 
-bool box_factory_remove(box_factory *factory, unsigned int side, unsigned int height);
+/* Begin a trace of the calls of the box factory in a new file of the given path (see box_trace.h) - the trace starts with the boxes of the box factory,
+ and every call on the boxes is recorded with its arguments, its results and its times from then on, until box_factory_trace_end or
+ box_factory_destroy. The GETBOX cache is emptied (and its counters zeroed), so the traced calls start from the state a replay starts from.
+ A box factory over the shared segment of another process can't be traced, since its boxes change under it.
+ Returns FALSE if the box factory is traced already or can't be traced, on an allocation error or an I/O error, TRUE otherwise. */
+
+bool box_factory_trace_begin(box_factory *factory, const char *path);
+
+
+/* End the trace of the box factory - write the rest of its records and close its file. Nothing is done without a trace.
+ Returns FALSE if a record of the trace couldn't be written, TRUE otherwise. */
+
+bool box_factory_trace_end(box_factory *factory);
+
+
+/* Recover a box factory after a crash or a shutdown - open the snapshot of the given path (if snapshot_path isn't NULL and the file exists, otherwise
+ start from an empty box factory), replay the records of the write-ahead log of wal_path which follow the snapshot, and go on logging every change
+ to that log with the given sync policy and group size (see box_wal.h.) A missing log is created.
+ While the log is open, the changes are logged once they are made - a change which fails isn't logged. If the log can't be written, the box factory
+ becomes read-only (its changes can't be made durable anymore.)
+ Returns NULL on an allocation error, an I/O error, an invalid snapshot or log, or a log which doesn't follow the snapshot, otherwise returns a pointer
+ to box_factory. */
+
+box_factory* box_factory_recover(const char *snapshot_path, const char *wal_path, const box_factory_options *options, box_wal_sync sync,
+                                 unsigned int group_size);
+
+
+/* Write the open group of the write-ahead log and sync it (unless the sync policy is BOX_WAL_SYNC_NONE) - every change made so far is durable once it
+ returns. This is the group commit of a user which makes many changes (of many clients) before it answers them. Nothing is done without a log.
+ Returns FALSE on an I/O error (the box factory becomes read-only then), TRUE otherwise. */
+
+bool box_factory_sync(box_factory *factory);
+
+
+/* Start a background checkpoint - a snapshot of the box factory, written to the given path by a child process (see box_checkpoint.h) while the box
+ factory goes on serving queries and changes. The write-ahead log is synced first, so the snapshot includes exactly the records written to it.
+ The boxes of a box factory on disk are in a file the parent goes on changing, not in the image of the child - its checkpoint is refused
+ (box_factory_save writes its snapshot instead.) The portable build has no child process - the snapshot is written before the function returns.
+ Returns FALSE if a checkpoint is running, on an allocation error or an I/O error, if the fork failed, or on disk, TRUE otherwise. */
+
+bool box_factory_checkpoint_begin(box_factory *factory, const char *path);
+
+
+/* Check whether the background checkpoint has ended (wait for it if wait is TRUE.) Once it is done, the records of the write-ahead log which the
+ snapshot includes are dropped (if that fails, the log is left whole - it is still valid.) The measures of the checkpoint - its pause time and
+ throughput - are in the stats of the checkpoint of the box factory then. Returns the state of the checkpoint (see box_checkpoint_state.) */
+
+box_checkpoint_state box_factory_checkpoint_poll(box_factory *factory, bool wait);
+
+
+/* INSERTBOX of the exercise. Adds a box of the given dimensions to the box factory data structure. Returns FALSE on an allocation error, if the side
+ is larger than BOX_DIM_MAX_SIDE, if a dictionary of the box index is full, if the box factory is read-only, or if its write-ahead log couldn't be
+ written (the box is inserted then), TRUE otherwise. */
+
+bool box_factory_insert(box_factory *factory, box_dim side, box_dim height);
+
+
+/* REMOVEBOX of the exercise. Removes a box of the given dimensions from the box factory data structure. Returns FALSE if there's no box of the
+ given dimensions, if the box factory is read-only, or if its write-ahead log couldn't be written (the box is removed then), TRUE otherwise. */
+
+bool box_factory_remove(box_factory *factory, box_dim side, box_dim height);
 
 
 /* GETBOX of the exercise. Returns FALSE if a box suitable for the given dimensions is not found, TRUE otherwise.
  found_side_square and found_height would contain dimensions ((side * side) and height) of the box, which we found to have the minimal suitable volume
- (minimal volume when the side of the box is at least the given side, and the height of the box is at least the given height.) */
+ (minimal volume when the side of the box is at least the given side, and the height of the box is at least the given height.) Of several suitable sizes
+ of the minimal volume, the one of the smallest side is found - whichever structure answers, and whatever the planner chose. */
+
+bool box_factory_get_box(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height);
 
-bool box_factory_get_box(box_factory *factory, unsigned int side, unsigned int height, unsigned int *found_side_square, unsigned int *found_height);
+
+/* Approximate GETBOX - same as box_factory_get_box, except that the volume of the returned box is only guaranteed to be less than (1 + epsilon) times the
+ minimal suitable volume, where epsilon is approx_epsilon of the options of the box factory. Takes O(1) steps for a given epsilon (a bounded number of
+ buckets, each checked in a bounded number of steps.) A box factory without an approximate index answers with box_factory_get_box. */
+
+bool box_factory_get_box_approx(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height);
 
 
 /* CHECKBOX of the exercise. Returns TRUE if in our box factory exists a box suitable for the present of the given dimensions, FALSE otherwise. */
 
-bool box_factory_check_box(box_factory *factory, unsigned int side, unsigned int height);
+bool box_factory_check_box(box_factory *factory, box_dim side, box_dim height);
+
+
+/* Copy the counters of the GETBOX result cache (hits, misses and invalidations) of the box factory into stats. */
+
+void box_factory_cache_stats(box_factory *factory, box_cache_stats *stats);
+
+
+/* Return the k sizes of the boxes suitable for a present of the given dimensions with the smallest volumes (equal volumes are ordered by side, then by
+ height), or all the suitable sizes if there are less than k of them. out (of at least k elements) would contain the sizes in increasing order of
+ volume, with their numbers of boxes. Returns the number of sizes written to out. */
+
+unsigned int box_factory_get_top_k(box_factory *factory, box_dim side, box_dim height, unsigned int k, box_factory_box out[]);
+
+
+/* Set the cost function of box_factory_get_cheapest (NULL for the volume, the default) and its context, which is passed to it on every call.
+ monotone tells whether the function never decreases when the side or the height of the box grows - then the query prunes the candidates like GETBOX,
+ otherwise it visits every suitable size. */
+
+void box_factory_set_cost_function(box_factory *factory, box_cost_function function, void *context, bool monotone);
+
+
+/* Set the price of the boxes of the given dimensions for box_factory_get_cheapest - it replaces their cost by the cost function. The sizes with prices
+ are checked one by one by every query, so prices should be set for a limited number of sizes. Returns FALSE on an allocation error, or if the side is
+ larger than BOX_DIM_MAX_SIDE, TRUE otherwise. */
+
+bool box_factory_set_price(box_factory *factory, box_dim side, box_dim height, double price);
+
+
+/* Remove the price of the boxes of the given dimensions. Returns FALSE if they have no price, TRUE otherwise. */
+
+bool box_factory_remove_price(box_factory *factory, box_dim side, box_dim height);
+
+
+/* GETBOX by cost - same as box_factory_get_box, except that the suitable box of the minimal cost (see box_cost.h) is returned instead of the one of the
+ minimal volume. Equal costs are ordered by volume, then by side, and then by height. found_cost would contain the cost of the returned box. */
+
+bool box_factory_get_cheapest(box_factory *factory, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height,
+                              double *found_cost);
+
+
+/* Assign boxes to the given presents, and remove the assigned boxes from the box factory. The presents are processed from the largest volume down (equal
+ volumes by larger side, then larger height, then by their order in the array), and every present gets the box which GETBOX returns at its turn - the
+ result is the same as calling box_factory_get_box and box_factory_remove for each present in that order.
+ unassigned would contain the number of presents which got no box. Returns FALSE on an allocation error, or if the box factory is read-only (nothing is
+ assigned then), or if its write-ahead log couldn't be written (the presents are assigned then), TRUE otherwise. The removals of a batch are logged
+ together, as one group. */
+
+bool box_factory_assign_batch(box_factory *factory, box_factory_present presents[], unsigned int count, unsigned int *unassigned);
+
+
+/* Return the number of the boxes in the box factory which are suitable for a present of the given dimensions (the boxes whose side is at least the given
+ side and whose height is at least the given height.) Uses the dominance index if the box factory has one, otherwise scans the sides from the given one
+ and counts the heights of each of them using the subtree totals of its subtree. */
+
+unsigned long long box_factory_count_suitable(box_factory *factory, box_dim side, box_dim height);
+
+
+/* Return the number of the different sides of the boxes in the box factory in the range [min_side, max_side]. */
+
+unsigned int box_factory_count_sides(box_factory *factory, box_dim min_side, box_dim max_side);
 
 
 #endif /* BOX_FACTORY_H_ */
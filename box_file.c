@@ -0,0 +1,207 @@
+/*
+ Box file source file.
+ Here we implement the helpers shared by the files of the box factory.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* strdup, fsync and mmap. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#ifndef BOX_FACTORY_PORTABLE
+
+#include <sys/mman.h>
+
+#endif
+
+#include "box_file.h"
+
+
+#define FNV_PRIME 0x100000001B3ULL			/* The prime of the 64-bit FNV-1a hash. */
+
+
+/* The implementation: */
+
+
+unsigned long long box_file_hash(unsigned long long hash, const void *data, size_t size)
+{
+
+    const unsigned char *bytes = data;
+    size_t i = 0;
+
+    for (i = 0; i < size; ++i) {
+
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+size_t box_file_put_varint(unsigned char *data, unsigned long long val)
+{
+
+    size_t size = 0;
+
+    while (val >= 0x80) {
+
+        data[size++] = (unsigned char) (val | 0x80);
+        val >>= 7;
+    }
+
+    data[size++] = (unsigned char) val;
+
+    return size;
+}
+
+
+bool box_file_get_varint(const unsigned char *data, size_t size, size_t *position, unsigned long long *val)
+{
+
+    unsigned int shift = 0;
+
+    *val = 0;
+
+    for (shift = 0; (shift < 7 * BOX_FILE_MAX_VARINT) && (*position < size); shift += 7) {
+
+        *val |= (unsigned long long) (data[*position] & 0x7F) << shift;
+
+        if ((data[(*position)++] & 0x80) == 0) {
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool box_file_sync_directory(const char *path)
+{
+
+#ifdef BOX_FACTORY_PORTABLE
+
+    return (path != NULL);
+
+#else
+
+    const char *slash = strrchr(path, '/');
+    char *directory = NULL;
+    int fd = -1;
+    bool synced = false;
+
+    if (slash == NULL) {
+
+        directory = strdup(".");
+    }
+
+    else {
+
+        directory = strdup(path);
+
+        if (directory != NULL) {
+
+            directory[(slash == path) ? 1 : (slash - path)] = '\0';			/* The root directory keeps its slash. */
+        }
+    }
+
+    if (directory == NULL) {
+
+        return false;
+    }
+
+    fd = open(directory, O_RDONLY);
+
+    if (fd >= 0) {
+
+        synced = (fsync(fd) == 0);
+        close(fd);
+    }
+
+    free(directory);
+
+    return synced;
+
+#endif
+}
+
+
+void* box_file_map(const char *path, size_t min_size, size_t *size)
+{
+
+    struct stat status;
+    void *map = NULL;
+
+#ifdef BOX_FACTORY_PORTABLE
+
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) {
+
+        return NULL;
+    }
+
+    if ((stat(path, &status) == 0) && ((size_t) status.st_size >= min_size)) {
+
+        map = malloc(((size_t) status.st_size == 0) ? 1 : (size_t) status.st_size);
+
+        if ((map != NULL) && (fread(map, 1, (size_t) status.st_size, file) != (size_t) status.st_size)) {
+
+            free(map);
+            map = NULL;
+        }
+    }
+
+    fclose(file);
+
+#else
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+
+        return NULL;
+    }
+
+    if ((fstat(fd, &status) == 0) && ((size_t) status.st_size >= min_size) && (status.st_size > 0)) {
+
+        map = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        map = (map == MAP_FAILED) ? NULL : map;
+    }
+
+    close(fd);			/* The mapping stays valid without the descriptor. */
+
+#endif
+
+    *size = (map == NULL) ? 0 : (size_t) status.st_size;
+
+    return map;
+}
+
+
+void box_file_unmap(void *map, size_t size)
+{
+
+#ifdef BOX_FACTORY_PORTABLE
+
+    (void) size;
+    free(map);
+
+#else
+
+    munmap(map, size);
+
+#endif
+}
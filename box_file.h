@@ -0,0 +1,54 @@
+/* Box file header file.
+ Contains the functions' prototype declarations of the helpers shared by the files of the box factory - the snapshot (box_snapshot.h), the
+ write-ahead log (box_wal.h) and the export (box_export.h): their checksum, their varints, and the durability of the files created in a directory. */
+
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#ifndef BOX_FILE_H_
+#define BOX_FILE_H_
+
+
+#define BOX_FILE_HASH_INIT 0xCBF29CE484222325ULL			/* The first value of a hash - the offset basis of the 64-bit FNV-1a hash. */
+
+#define BOX_FILE_MAX_VARINT 10			/* The longest varint - 64 bits in groups of 7. */
+
+
+/* Continue the FNV-1a hash of the given value with the given bytes, and return the new value. */
+
+unsigned long long box_file_hash(unsigned long long hash, const void *data, size_t size);
+
+
+/* Write val to the given bytes as a varint - 7 bits in every byte, the lowest first, and the highest bit set in every byte but the last. There must
+ be room for BOX_FILE_MAX_VARINT bytes. Returns the number of bytes written. */
+
+size_t box_file_put_varint(unsigned char *data, unsigned long long val);
+
+
+/* Read a varint of the given bytes from the given position, and advance the position past it. Returns FALSE if the bytes end in the middle of the
+ varint, or if it is longer than BOX_FILE_MAX_VARINT bytes, TRUE otherwise. */
+
+bool box_file_get_varint(const unsigned char *data, size_t size, size_t *position, unsigned long long *val);
+
+
+/* Sync the directory of the given path, so a file created or renamed into it survives a crash. Returns FALSE on an I/O error, TRUE otherwise.
+ The portable build (BOX_FACTORY_PORTABLE, see box_factory.h) can't open a directory, and doesn't sync it. */
+
+bool box_file_sync_directory(const char *path);
+
+
+/* Map the whole file of the given path to memory for reading, and set size to its size - the portable build reads the file into an allocated
+ buffer instead. Returns NULL on an allocation error, an I/O error, or if the file is smaller than min_size, otherwise returns the memory of the file,
+ which box_file_unmap releases. */
+
+void* box_file_map(const char *path, size_t min_size, size_t *size);
+
+
+/* Release the memory of a file returned by box_file_map, with its size. */
+
+void box_file_unmap(void *map, size_t size);
+
+
+#endif /* BOX_FILE_H_ */
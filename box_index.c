@@ -0,0 +1,714 @@
+/*
+ Box index source file.
+ Here we implement the operations of the box factory over the ordered sets of the box index. The algorithms are the same as the ones over the main
+ trees in box_factory.c, only written in terms of the values of the sets instead of the nodes of the trees.
+ With dictionaries the algorithms run over the ids, which have the order of the values - a query translates its dimensions to the ids of the smallest
+ values from them, and the volumes are computed from the values of the ids.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include "box_index.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Insertion function to one of the main sets (set_by_side / set_by_height.) Returns FALSE on an allocation error, TRUE otherwise. */
+
+static bool box_index_insert_set(box_index *index, void *main_set, unsigned int main_val, unsigned int sub_val);
+
+
+/* Removal function from one of the main sets. Returns FALSE if there's no box of the given dimensions, TRUE otherwise.
+ last_unit would be TRUE if the removed box was the last one of the given dimensions. */
+
+static bool box_index_remove_set(box_index *index, void *main_set, unsigned int main_val, unsigned int sub_val, bool *last_unit);
+
+
+/* Return the volume of the box with the given keys of the main set and of the secondary set. main_is_side tells which dimension is the main one. */
+
+static unsigned long long box_index_volume(box_index *index, bool main_is_side, unsigned int main_val, unsigned int sub_val);
+
+
+/* A function implementing GETBOX over either one of the main sets - see box_factory_get_by_input. */
+
+static bool box_index_get_by_input(box_index *index, void *main_set, bool main_is_side, unsigned int main_val, unsigned int sub_val,
+                                   unsigned int *found_main_val, unsigned int *found_sub_val);
+
+
+/* A function implementing CHECKBOX over either one of the main sets - see box_factory_check_by_input. */
+
+static bool box_index_check_by_input(box_index *index, void *main_set, unsigned int main_val, unsigned int sub_val);
+
+
+/* Return the secondary set of the given value of a main set. The value must be in the main set. */
+
+static void* box_index_subset(box_index *index, void *main_set, unsigned int main_val);
+
+
+/* Free one of the main sets with all of its secondary sets. */
+
+static void box_index_destroy_set(box_index *index, void *main_set);
+
+
+/* Return a copy of one of the main sets with its secondary sets, whose keys are mapped by main_remap and sub_remap (NULL for the same keys.)
+ Without sub_remap the copy shares the secondary sets of the main set. Returns NULL on an allocation error. */
+
+static void* box_index_copy_set(box_index *index, void *main_set, unsigned int *main_remap, unsigned int *sub_remap);
+
+
+/* Add a reference to the given value to the dictionary of its dimension, and get its key. If the dictionary relabels its values, the sets are moved to
+ the new keys. Returns FALSE on an allocation error (or if the dictionary is full), in which case the index is left unchanged. */
+
+static bool box_index_encode(box_index *index, bool side_dimension, unsigned int val, unsigned int *key);
+
+
+/* The implementation: */
+
+
+box_index* box_index_create(const ordered_set_ops *ops, bool dictionary)
+{
+
+    box_index *index = calloc(sizeof(box_index), 1);
+
+    if (index == NULL) {
+
+        return NULL;
+    }
+
+    index->ops = ops;
+    index->set_by_side = ops->create();
+
+    if (index->set_by_side == NULL) {
+
+        free(index);
+        return NULL;
+    }
+
+    index->set_by_height = ops->create();
+
+    if (index->set_by_height == NULL) {
+
+        ops->destroy(index->set_by_side);
+        free(index);
+        return NULL;
+    }
+
+    if (dictionary) {
+
+        index->sides = box_dictionary_create();
+        index->heights = box_dictionary_create();
+
+        if ((index->sides == NULL) || (index->heights == NULL)) {
+
+            if (index->sides != NULL) {
+
+                box_dictionary_destroy(index->sides);
+            }
+
+            if (index->heights != NULL) {
+
+                box_dictionary_destroy(index->heights);
+            }
+
+            ops->destroy(index->set_by_height);
+            ops->destroy(index->set_by_side);
+            free(index);
+            return NULL;
+        }
+    }
+
+    return index;
+}
+
+
+void box_index_destroy(box_index *index)
+{
+
+    box_index_destroy_set(index, index->set_by_side);
+    box_index_destroy_set(index, index->set_by_height);
+
+    if (index->sides != NULL) {
+
+        box_dictionary_destroy(index->sides);
+        box_dictionary_destroy(index->heights);
+    }
+
+    free(index);
+}
+
+
+bool box_index_key(box_dictionary *dictionary, unsigned int val, unsigned int *key)
+{
+
+    if (dictionary == NULL) {
+
+        *key = val;
+        return true;
+    }
+
+    return box_dictionary_id(dictionary, val, key);
+}
+
+
+bool box_index_key_from(box_dictionary *dictionary, unsigned int val, unsigned int *key)
+{
+
+    if (dictionary == NULL) {
+
+        *key = val;
+        return true;
+    }
+
+    return box_dictionary_id_from(dictionary, val, key);
+}
+
+
+unsigned int box_index_value(box_dictionary *dictionary, unsigned int key)
+{
+
+    return (dictionary == NULL) ? key : (unsigned int) box_dictionary_value(dictionary, key);
+}
+
+
+static void box_index_destroy_set(box_index *index, void *main_set)
+{
+
+    unsigned int main_val = 0;
+    bool has_main = false;
+
+    for (has_main = index->ops->lower_bound(main_set, 0, &main_val); has_main; has_main = index->ops->successor(main_set, main_val, &main_val)) {
+
+        index->ops->destroy(box_index_subset(index, main_set, main_val));
+    }
+
+    index->ops->destroy(main_set);
+}
+
+
+static void* box_index_copy_set(box_index *index, void *main_set, unsigned int *main_remap, unsigned int *sub_remap)
+{
+
+    const ordered_set_ops *ops = index->ops;
+    void *copy = ops->create();
+    void *subset = NULL;
+    void *subset_copy = NULL;
+    unsigned int main_val = 0;
+    unsigned int sub_val = 0;
+    unsigned int main_key = 0;
+    bool has_main = false;
+    bool has_sub = false;
+    bool exists = false;
+    bool failed = false;
+
+    if (copy == NULL) {
+
+        return NULL;
+    }
+
+    for (has_main = ops->lower_bound(main_set, 0, &main_val); has_main && !failed; has_main = ops->successor(main_set, main_val, &main_val)) {
+
+        subset = box_index_subset(index, main_set, main_val);
+        subset_copy = subset;			/* The secondary sets whose keys stay are shared with the copy. */
+
+        if (sub_remap != NULL) {
+
+            subset_copy = ops->create();
+            failed = (subset_copy == NULL);
+
+            for (has_sub = !failed && ops->lower_bound(subset, 0, &sub_val); has_sub && !failed; has_sub = ops->successor(subset, sub_val, &sub_val)) {
+
+                failed = !ops->insert(subset_copy, sub_remap[sub_val], ops->instances(subset, sub_val), &exists);
+            }
+        }
+
+        main_key = (main_remap == NULL) ? main_val : main_remap[main_val];
+
+        if (!failed && ops->insert(copy, main_key, ops->instances(main_set, main_val), &exists)) {
+
+            *(ops->payload(copy, main_key)) = subset_copy;
+            continue;
+        }
+
+        failed = true;
+
+        if ((sub_remap != NULL) && (subset_copy != NULL)) {
+
+            ops->destroy(subset_copy);
+        }
+    }
+
+    if (failed) {
+
+        if (sub_remap == NULL) {
+
+            ops->destroy(copy);
+        }
+
+        else {
+
+            box_index_destroy_set(index, copy);
+        }
+
+        return NULL;
+    }
+
+    return copy;
+}
+
+
+static bool box_index_encode(box_index *index, bool side_dimension, unsigned int val, unsigned int *key)
+{
+
+    box_dictionary *dictionary = side_dimension ? index->sides : index->heights;
+    void **relabeled_set = side_dimension ? &(index->set_by_side) : &(index->set_by_height);
+    void **other_set = side_dimension ? &(index->set_by_height) : &(index->set_by_side);
+    void *relabeled_copy = NULL;
+    void *other_copy = NULL;
+    unsigned int *remap = NULL;
+
+    if (!box_dictionary_add(dictionary, val, key, &remap)) {
+
+        return false;
+    }
+
+    if (remap == NULL) {
+
+        return true;
+    }
+
+    /* The values were relabeled - build the sets over the new keys aside, so a failure leaves the index over the previous keys. The keys of the main
+     set of the relabeled dimension change, but not its secondary sets (which the copy shares), while the keys of all the secondary sets of the other
+     main set change. */
+
+    other_copy = box_index_copy_set(index, *other_set, NULL, remap);
+
+    if (other_copy != NULL) {
+
+        relabeled_copy = box_index_copy_set(index, *relabeled_set, remap, NULL);
+    }
+
+    if (relabeled_copy == NULL) {
+
+        if (other_copy != NULL) {
+
+            box_index_destroy_set(index, other_copy);
+        }
+
+        box_dictionary_end_relabel(dictionary, remap, false);
+
+        return false;
+    }
+
+    index->ops->destroy(*relabeled_set);
+    box_index_destroy_set(index, *other_set);
+
+    *relabeled_set = relabeled_copy;
+    *other_set = other_copy;
+
+    box_dictionary_end_relabel(dictionary, remap, true);
+
+    return true;
+}
+
+
+static void* box_index_subset(box_index *index, void *main_set, unsigned int main_val)
+{
+
+    return *(index->ops->payload(main_set, main_val));
+}
+
+
+static bool box_index_insert_set(box_index *index, void *main_set, unsigned int main_val, unsigned int sub_val)
+{
+
+    const ordered_set_ops *ops = index->ops;
+    void **payload = ops->payload(main_set, main_val);
+    void *subset = NULL;
+    bool exists = false;
+
+    if (payload != NULL) {			/* There is a box with the given main value - insert sub_val to its secondary set. */
+
+        return ops->insert(*payload, sub_val, 1, &exists);
+    }
+
+    /* There's no box with the given main value - create its secondary set, and only then add the main value, so a failure leaves the index unchanged. */
+
+    subset = ops->create();
+
+    if (subset == NULL) {
+
+        return false;
+    }
+
+    if (!ops->insert(subset, sub_val, 1, &exists) || !ops->insert(main_set, main_val, 1, &exists)) {
+
+        ops->destroy(subset);
+        return false;
+    }
+
+    payload = ops->payload(main_set, main_val);
+
+    if (payload == NULL) {			/* A bit set allocates its payloads by their first use - which may fail. */
+
+        ops->remove(main_set, main_val, &exists);
+        ops->destroy(subset);
+        return false;
+    }
+
+    *payload = subset;
+
+    return true;
+}
+
+
+bool box_index_insert(box_index *index, unsigned int side, unsigned int height)
+{
+
+    unsigned int side_key = side;
+    unsigned int height_key = height;
+    bool last_unit = false;
+
+    if (index->sides != NULL) {
+
+        if (!box_index_encode(index, true, side, &side_key)) {
+
+            return false;
+        }
+
+        if (!box_index_encode(index, false, height, &height_key)) {
+
+            box_dictionary_remove(index->sides, side);
+            return false;
+        }
+    }
+
+    if (!box_index_insert_set(index, index->set_by_side, side_key, height_key)) {
+
+        if (index->sides != NULL) {
+
+            box_dictionary_remove(index->sides, side);
+            box_dictionary_remove(index->heights, height);
+        }
+
+        return false;
+    }
+
+    if (!box_index_insert_set(index, index->set_by_height, height_key, side_key)) {
+
+        box_index_remove_set(index, index->set_by_side, side_key, height_key, &last_unit);			/* If failed to insert to set_by_height. */
+
+        if (index->sides != NULL) {
+
+            box_dictionary_remove(index->sides, side);
+            box_dictionary_remove(index->heights, height);
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool box_index_remove_set(box_index *index, void *main_set, unsigned int main_val, unsigned int sub_val, bool *last_unit)
+{
+
+    const ordered_set_ops *ops = index->ops;
+    void **payload = ops->payload(main_set, main_val);
+    void *subset = NULL;
+    bool deleted = false;
+
+    *last_unit = false;
+
+    if (payload == NULL) {
+
+        return false;
+    }
+
+    subset = *payload;
+
+    if (!ops->remove(subset, sub_val, last_unit)) {
+
+        return false;
+    }
+
+    /* In case the secondary set has been emptied, the main value should be removed from the main set. */
+
+    if (ops->size(subset) == 0) {
+
+        ops->remove(main_set, main_val, &deleted);
+        ops->destroy(subset);
+    }
+
+    return true;
+}
+
+
+bool box_index_remove(box_index *index, unsigned int side, unsigned int height, bool *last_unit)
+{
+
+    unsigned int side_key = 0;
+    unsigned int height_key = 0;
+    bool last_height_unit = false;
+
+    *last_unit = false;
+
+    if (!box_index_key(index->sides, side, &side_key) || !box_index_key(index->heights, height, &height_key)) {
+
+        return false;
+    }
+
+    if (!box_index_remove_set(index, index->set_by_side, side_key, height_key, last_unit)) {
+
+        return false;
+    }
+
+    box_index_remove_set(index, index->set_by_height, height_key, side_key, &last_height_unit);
+
+    if (index->sides != NULL) {
+
+        box_dictionary_remove(index->sides, side);
+        box_dictionary_remove(index->heights, height);
+    }
+
+    return true;
+}
+
+
+static unsigned long long box_index_volume(box_index *index, bool main_is_side, unsigned int main_val, unsigned int sub_val)
+{
+
+    unsigned long long side = 0;
+
+    if (main_is_side) {
+
+        side = box_index_value(index->sides, main_val);
+
+        return side * side * box_index_value(index->heights, sub_val);
+    }
+
+    side = box_index_value(index->sides, sub_val);
+
+    return side * side * box_index_value(index->heights, main_val);
+}
+
+
+static bool box_index_get_by_input(box_index *index, void *main_set, bool main_is_side, unsigned int main_val, unsigned int sub_val,
+                                   unsigned int *found_main_val, unsigned int *found_sub_val)
+{
+
+    const ordered_set_ops *ops = index->ops;
+    void *subset = NULL;
+
+    unsigned int main_found = 0;
+    unsigned int sub_found = 0;
+    unsigned int sub_max = 0;
+    unsigned int min_main_val = 0;
+    unsigned int min_sub_val = 0;
+
+    unsigned long long volume = 0;
+    unsigned long long min_volume = 0;
+
+    bool has_main = ops->lower_bound(main_set, main_val, &main_found);
+
+    /* Skip the main values whose secondary sets don't contain a suitable value. */
+
+    while (has_main && ops->max(box_index_subset(index, main_set, main_found), &sub_max) && (sub_max < sub_val)) {
+
+        has_main = ops->successor(main_set, main_found, &main_found);
+    }
+
+    if (!has_main) {
+
+        return false;
+    }
+
+    ops->lower_bound(box_index_subset(index, main_set, main_found), sub_val, &sub_found);
+
+    min_volume = box_index_volume(index, main_is_side, main_found, sub_found);
+    min_main_val = main_found;
+    min_sub_val = sub_found;
+
+    /* Every following main value gives a suitable volume of at least the volume of (main value, sub_val) - stop when it can't beat the minimum. */
+
+    /* Over the heights, an equal volume may still come with a smaller side, unless the side found is the given one already. */
+
+    while (has_main && ((min_volume > box_index_volume(index, main_is_side, main_found, sub_val)) ||
+                        (!main_is_side && (min_volume == box_index_volume(index, main_is_side, main_found, sub_val)) && (min_sub_val > sub_val)))) {
+
+        has_main = ops->successor(main_set, main_found, &main_found);
+
+        if (!has_main) {
+
+            continue;
+        }
+
+        subset = box_index_subset(index, main_set, main_found);
+
+        if (!ops->max(subset, &sub_max) || (sub_max < sub_val)) {
+
+            continue;
+        }
+
+        ops->lower_bound(subset, sub_val, &sub_found);
+
+        volume = box_index_volume(index, main_is_side, main_found, sub_found);
+
+        /* Check whether we have found a new minimal volume - or, over the heights, the same volume with a smaller side (the keys of the sides are
+         in the order of the sides.) */
+
+        if ((min_volume > volume) || (!main_is_side && (min_volume == volume) && (sub_found < min_sub_val))) {
+
+            min_volume = volume;
+            min_main_val = main_found;
+            min_sub_val = sub_found;
+        }
+    }
+
+    *found_main_val = min_main_val;
+    *found_sub_val = min_sub_val;
+
+    return true;
+}
+
+
+bool box_index_get(box_index *index, unsigned int side, unsigned int height, unsigned int *found_side_square, unsigned int *found_height)
+{
+
+    unsigned int side_key = 0;
+    unsigned int height_key = 0;
+    unsigned int found_side = 0;
+    bool found = false;
+
+    if (index->ops->size(index->set_by_height) == 0) {
+
+        return false;
+    }
+
+    /* The keys of the smallest sides and heights from the given ones - the suitable boxes are the ones from these keys. */
+
+    if (!box_index_key_from(index->sides, side, &side_key) || !box_index_key_from(index->heights, height, &height_key)) {
+
+        return false;
+    }
+
+    /* Check the main set which is smaller, like box_factory_get_box does with the main trees. */
+
+    if (index->ops->size(index->set_by_height) > index->ops->size(index->set_by_side)) {
+
+        found = box_index_get_by_input(index, index->set_by_side, true, side_key, height_key, &found_side, found_height);
+    }
+
+    else {
+
+        found = box_index_get_by_input(index, index->set_by_height, false, height_key, side_key, found_height, &found_side);
+    }
+
+    if (found) {
+
+        found_side = box_index_value(index->sides, found_side);
+        *found_side_square = found_side * found_side;
+        *found_height = box_index_value(index->heights, *found_height);
+    }
+
+    return found;
+}
+
+
+static bool box_index_check_by_input(box_index *index, void *main_set, unsigned int main_val, unsigned int sub_val)
+{
+
+    const ordered_set_ops *ops = index->ops;
+    unsigned int main_found = 0;
+    unsigned int sub_max = 0;
+
+    bool has_main = ops->lower_bound(main_set, main_val, &main_found);
+
+    while (has_main && ops->max(box_index_subset(index, main_set, main_found), &sub_max) && (sub_max < sub_val)) {
+
+        has_main = ops->successor(main_set, main_found, &main_found);
+    }
+
+    return has_main;
+}
+
+
+bool box_index_check(box_index *index, unsigned int side, unsigned int height)
+{
+
+    unsigned int side_key = 0;
+    unsigned int height_key = 0;
+
+    if (!box_index_key_from(index->sides, side, &side_key) || !box_index_key_from(index->heights, height, &height_key)) {
+
+        return false;
+    }
+
+    if (index->ops->size(index->set_by_height) > index->ops->size(index->set_by_side)) {
+
+        return box_index_check_by_input(index, index->set_by_side, side_key, height_key);
+    }
+
+    return box_index_check_by_input(index, index->set_by_height, height_key, side_key);
+}
+
+
+unsigned long long box_index_count_suitable(box_index *index, unsigned int side, unsigned int height)
+{
+
+    const ordered_set_ops *ops = index->ops;
+    void *subset = NULL;
+    unsigned int side_found = 0;
+    unsigned int height_found = 0;
+    unsigned int side_key = 0;
+    unsigned int height_key = 0;
+    unsigned long long count = 0;
+    bool has_side = false;
+    bool has_height = false;
+
+    if (!box_index_key_from(index->sides, side, &side_key) || !box_index_key_from(index->heights, height, &height_key)) {
+
+        return 0;
+    }
+
+    for (has_side = ops->lower_bound(index->set_by_side, side_key, &side_found); has_side;
+         has_side = ops->successor(index->set_by_side, side_found, &side_found)) {
+
+        subset = box_index_subset(index, index->set_by_side, side_found);
+
+        for (has_height = ops->lower_bound(subset, height_key, &height_found); has_height; has_height = ops->successor(subset, height_found, &height_found)) {
+
+            count += ops->instances(subset, height_found);
+        }
+    }
+
+    return count;
+}
+
+
+unsigned int box_index_count_sides(box_index *index, unsigned int min_side, unsigned int max_side)
+{
+
+    const ordered_set_ops *ops = index->ops;
+    unsigned int side_key = 0;
+    unsigned int side_found = 0;
+    unsigned int count = 0;
+    bool has_side = false;
+
+    if (!box_index_key_from(index->sides, min_side, &side_key)) {
+
+        return 0;
+    }
+
+    for (has_side = ops->lower_bound(index->set_by_side, side_key, &side_found); has_side && (box_index_value(index->sides, side_found) <= max_side);
+         has_side = ops->successor(index->set_by_side, side_found, &side_found)) {
+
+        count++;
+    }
+
+    return count;
+}
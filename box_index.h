@@ -0,0 +1,89 @@
+/* Box index header file.
+ Contains the structure and functions' prototype declarations of the box index - the same two-level structure as the main trees of the box factory
+ (a main set of one dimension, and for every value of it a secondary set of the other dimension), built of ordered sets of a chosen implementation
+ (see ordered_set.h.) The box factory uses the box index instead of its red-black trees when asked to at box_factory_create_with_options time.
+ Unlike the main trees, the box index keeps the side of the box itself (and not side * side) - the order is the same, and the values are smaller.
+ The box index may also keep the ids of the sides and of the heights in its sets instead of the values (see box_dictionary.h) - the keys of the sets
+ are then the ids, whose order is the order of the values. */
+
+
+#include <stdbool.h>
+
+#include "ordered_set.h"
+
+#include "box_dictionary.h"
+
+#ifndef BOX_INDEX_H_
+#define BOX_INDEX_H_
+
+
+typedef struct box_index_s {			/* Box index structure. */
+
+    const ordered_set_ops *ops;			/* The implementation of the ordered sets. */
+    void *set_by_side;			/* Set of the sides. The payload of every side is the set of the heights of the boxes with that side. */
+    void *set_by_height;			/* Set of the heights. The payload of every height is the set of the sides of the boxes with that height. */
+    box_dictionary *sides;			/* The dictionaries of the sides and of the heights, NULL if the sets keep the values themselves. */
+    box_dictionary *heights;
+} box_index;
+
+
+/* Create a box index instance with the ordered sets of the given implementation. If dictionary is TRUE, the sets keep the ids of the values.
+ Returns NULL on an allocation error, otherwise returns a pointer to box_index. */
+
+box_index* box_index_create(const ordered_set_ops *ops, bool dictionary);
+
+
+/* Free the box index with all of its sets and dictionaries. */
+
+void box_index_destroy(box_index *index);
+
+
+/* Add a box of the given dimensions. Returns FALSE on an allocation error (or if a dictionary is full), TRUE otherwise. */
+
+bool box_index_insert(box_index *index, unsigned int side, unsigned int height);
+
+
+/* Remove a box of the given dimensions. Returns FALSE if there's no box of the given dimensions, TRUE otherwise.
+ last_unit would be TRUE if the removed box was the last one of the given dimensions. */
+
+bool box_index_remove(box_index *index, unsigned int side, unsigned int height, bool *last_unit);
+
+
+/* GETBOX over the box index - same semantics as box_factory_get_box. */
+
+bool box_index_get(box_index *index, unsigned int side, unsigned int height, unsigned int *found_side_square, unsigned int *found_height);
+
+
+/* CHECKBOX over the box index - same semantics as box_factory_check_box. */
+
+bool box_index_check(box_index *index, unsigned int side, unsigned int height);
+
+
+/* Return the number of the boxes whose side is at least the given side and whose height is at least the given height (a scan of the sides.) */
+
+unsigned long long box_index_count_suitable(box_index *index, unsigned int side, unsigned int height);
+
+
+/* Return the number of the different sides in the range [min_side, max_side] (a scan of the range.) */
+
+unsigned int box_index_count_sides(box_index *index, unsigned int min_side, unsigned int max_side);
+
+
+/* Find the key of the sets of the given value of a dimension - dictionary is the dictionary of the dimension (sides or heights of the index), which
+ is NULL when the keys are the values themselves. Returns FALSE if the value is not in the dictionary. */
+
+bool box_index_key(box_dictionary *dictionary, unsigned int val, unsigned int *key);
+
+
+/* Find the key of the smallest value of a dimension that is larger than or equal to the given value (the given value itself without a dictionary.)
+ Returns FALSE if there's no such value. */
+
+bool box_index_key_from(box_dictionary *dictionary, unsigned int val, unsigned int *key);
+
+
+/* Return the value of the given key of the sets. */
+
+unsigned int box_index_value(box_dictionary *dictionary, unsigned int key);
+
+
+#endif /* BOX_INDEX_H_ */
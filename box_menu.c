@@ -9,14 +9,14 @@
 #include "box_menu.h"
 
 
-static void get_dimensions(unsigned int *side, unsigned int *height)
+static void get_dimensions(box_dim *side, box_dim *height)
 {
 
     printf("Enter the side of the box: ");
-    scanf("%u", side);
+    scanf(BOX_DIM_FORMAT, side);
 
     printf("Enter the height of the box: ");
-    scanf("%u", height);
+    scanf(BOX_DIM_FORMAT, height);
 }
 
 
@@ -25,12 +25,12 @@ bool box_menu_insert(void *the_box_factory)
 
     box_factory *factory = the_box_factory;
 
-    unsigned int side = 0;
-    unsigned int height = 0;
+    box_dim side = 0;
+    box_dim height = 0;
 
     get_dimensions(&side, &height);
 
-    printf("Requesting to insert a box with side=%d and height=%d\n", side, height);
+    printf("Requesting to insert a box with side=" BOX_DIM_FORMAT " and height=" BOX_DIM_FORMAT "\n", side, height);
 
     if (!box_factory_insert(factory, side, height)) {
 
@@ -41,7 +41,7 @@ bool box_menu_insert(void *the_box_factory)
 
     else {
 
-        printf("Inserted a box with side=%d and height=%d\n", side, height);
+        printf("Inserted a box with side=" BOX_DIM_FORMAT " and height=" BOX_DIM_FORMAT "\n", side, height);
     }
 
     return true;
@@ -53,12 +53,12 @@ bool box_menu_remove(void *the_box_factory)
 
     box_factory *factory = the_box_factory;
 
-    unsigned int side = 0;
-    unsigned int height = 0;
+    box_dim side = 0;
+    box_dim height = 0;
 
     get_dimensions(&side, &height);
 
-    printf("Requesting to remove a box with side=%d and height=%d\n", side, height);
+    printf("Requesting to remove a box with side=" BOX_DIM_FORMAT " and height=" BOX_DIM_FORMAT "\n", side, height);
 
     if (!box_factory_remove(factory, side, height)) {
 
@@ -67,7 +67,7 @@ bool box_menu_remove(void *the_box_factory)
 
     else {
 
-        printf("Removed a box with side=%d and height=%d\n", side, height);
+        printf("Removed a box with side=" BOX_DIM_FORMAT " and height=" BOX_DIM_FORMAT "\n", side, height);
     }
 
     return true;
@@ -79,22 +79,23 @@ bool box_menu_get(void *the_box_factory)
 
     box_factory *factory = the_box_factory;
 
-    unsigned int side = 0;
-    unsigned int height = 0;
-    unsigned int found_side_square = 0;
-    unsigned int found_height = 0;
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
 
     bool found = false;
 
     get_dimensions(&side, &height);
 
-    printf("Searching for a box of minimal volume with minimum side=%d and height=%d\n", side, height);
+    printf("Searching for a box of minimal volume with minimum side=" BOX_DIM_FORMAT " and height=" BOX_DIM_FORMAT "\n", side, height);
 
     found = box_factory_get_box(factory, side, height, &found_side_square, &found_height);
 
     if (found) {
 
-        printf("Found a box with side=%d and height=%d\n", (unsigned int) sqrt((double) found_side_square), found_height);
+        printf("Found a box with side=" BOX_DIM_FORMAT " and height=" BOX_DIM_FORMAT "\n", (box_dim) (sqrt((double) found_side_square) + 0.5),
+               found_height);
     }
 
     else {
@@ -111,12 +112,12 @@ bool box_menu_check(void *the_box_factory)
 
     box_factory *factory = the_box_factory;
 
-    unsigned int side = 0;
-    unsigned int height = 0;
+    box_dim side = 0;
+    box_dim height = 0;
 
     get_dimensions(&side, &height);
 
-    printf("Checking whether a box with minimum side=%d and height=%d exists\n", side, height);
+    printf("Checking whether a box with minimum side=" BOX_DIM_FORMAT " and height=" BOX_DIM_FORMAT " exists\n", side, height);
 
     if (!box_factory_check_box(factory, side, height)) {
 
@@ -0,0 +1,160 @@
+/*
+ Box planner source file.
+ Here we implement the histograms of the main trees and the choice of the main tree to scan.
+ The counts of the buckets are also kept in a Fenwick (binary indexed) tree, so the number of keys in all the buckets above a given one is found in
+ O(log BOX_PLANNER_BUCKETS) steps.
+ */
+
+
+#include <stdbool.h>
+
+#include <string.h>
+
+#include "box_planner.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the bucket of the given value, and the range [low, high) of the values of the bucket (as real numbers.) */
+
+static unsigned int box_histogram_bucket(box_dim val, double *low, double *high);
+
+
+/* Add delta to the count of the given bucket. */
+
+static void box_histogram_update(box_histogram *histogram, unsigned int bucket, int delta);
+
+
+/* Return the number of keys in the buckets below the given bucket. */
+
+static unsigned int box_histogram_prefix(box_histogram *histogram, unsigned int bucket);
+
+
+/* The implementation: */
+
+
+void box_planner_init(box_planner *planner)
+{
+
+    memset(planner, 0, sizeof(box_planner));
+}
+
+
+static unsigned int box_histogram_bucket(box_dim val, double *low, double *high)
+{
+
+    unsigned int bits = BOX_DIM_BIT_LENGTH(val);
+    unsigned int sub_bucket = 0;
+    double base = 0;
+    double width = 0;
+
+    if (bits == 0) {
+
+        *low = 0;
+        *high = 1;
+
+        return 0;
+    }
+
+    /* The values of bit length 'bits' are [2^(bits - 1), 2^bits) - split into BOX_PLANNER_SUB_BUCKETS equal parts by the bits following the top one. */
+
+    if (bits - 1 >= BOX_PLANNER_SUB_BITS) {
+
+        sub_bucket = (unsigned int) (val >> (bits - 1 - BOX_PLANNER_SUB_BITS)) & (BOX_PLANNER_SUB_BUCKETS - 1);
+    }
+
+    else {
+
+        sub_bucket = (unsigned int) (val - (1U << (bits - 1))) << (BOX_PLANNER_SUB_BITS - (bits - 1));
+    }
+
+    base = (double) (1ULL << (bits - 1));
+    width = base / BOX_PLANNER_SUB_BUCKETS;
+
+    *low = base + sub_bucket * width;
+    *high = *low + ((width < 1) ? 1 : width);
+
+    return bits * BOX_PLANNER_SUB_BUCKETS + sub_bucket;
+}
+
+
+static void box_histogram_update(box_histogram *histogram, unsigned int bucket, int delta)
+{
+
+    unsigned int i = 0;
+
+    for (i = bucket + 1; i <= BOX_PLANNER_BUCKETS; i += i & (~i + 1)) {			/* Fenwick tree update (1-based.) */
+
+        histogram->buckets[i - 1] += delta;
+    }
+
+    histogram->total += delta;
+}
+
+
+static unsigned int box_histogram_prefix(box_histogram *histogram, unsigned int bucket)
+{
+
+    unsigned int sum = 0;
+    unsigned int i = 0;
+
+    for (i = bucket; i > 0; i -= i & (~i + 1)) {
+
+        sum += histogram->buckets[i - 1];
+    }
+
+    return sum;
+}
+
+
+void box_histogram_add(box_histogram *histogram, box_dim val)
+{
+
+    double low = 0;
+    double high = 0;
+
+    box_histogram_update(histogram, box_histogram_bucket(val, &low, &high), 1);
+}
+
+
+void box_histogram_remove(box_histogram *histogram, box_dim val)
+{
+
+    double low = 0;
+    double high = 0;
+
+    box_histogram_update(histogram, box_histogram_bucket(val, &low, &high), -1);
+}
+
+
+unsigned int box_histogram_estimate_from(box_histogram *histogram, box_dim val)
+{
+
+    double low = 0;
+    double high = 0;
+    unsigned int bucket = box_histogram_bucket(val, &low, &high);
+    unsigned int below = box_histogram_prefix(histogram, bucket);
+    unsigned int in_bucket = box_histogram_prefix(histogram, bucket + 1) - below;
+
+    /* All the keys of the following buckets, and the part of the keys of the bucket of val which are assumed to be larger than or equal to it. */
+
+    return histogram->total - below - in_bucket + (unsigned int) (in_bucket * (high - val) / (high - low) + 0.5);
+}
+
+
+bool box_planner_side_first(box_planner *planner, box_dim side_square, box_dim height)
+{
+
+    unsigned int side_candidates = box_histogram_estimate_from(&(planner->by_side), side_square);
+    unsigned int height_candidates = box_histogram_estimate_from(&(planner->by_height), height);
+
+    if (side_candidates != height_candidates) {
+
+        return side_candidates < height_candidates;
+    }
+
+    /* Equal estimates - fall back to the main tree which is smaller. */
+
+    return planner->by_height.total > planner->by_side.total;
+}
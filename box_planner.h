@@ -0,0 +1,60 @@
+/* Box planner header file.
+ Contains the structures and functions' prototype declarations of the query planner of the box factory.
+ GETBOX and CHECKBOX scan the main tree starting from the given value, so their cost is about the number of the keys of the main tree which are larger
+ than or equal to it. The planner keeps a histogram of the keys of each main tree, estimates this number for both main trees, and picks the main
+ tree with the smaller estimate for every query - instead of comparing only the total numbers of keys of the main trees.
+ The histogram has a bucket for every bit length of the keys, split into BOX_PLANNER_SUB_BUCKETS equal parts, so its relative error is bounded. */
+
+
+#include <stdbool.h>
+
+#include "box_types.h"
+
+#ifndef BOX_PLANNER_H_
+#define BOX_PLANNER_H_
+
+
+#define BOX_PLANNER_SUB_BITS 3			/* Each power of 2 is split into 2^BOX_PLANNER_SUB_BITS buckets. */
+
+#define BOX_PLANNER_SUB_BUCKETS (1U << BOX_PLANNER_SUB_BITS)
+
+#define BOX_PLANNER_BUCKETS ((BOX_DIM_BITS + 1) * BOX_PLANNER_SUB_BUCKETS)			/* Bit lengths 0 to BOX_DIM_BITS. */
+
+
+typedef struct box_histogram_s {			/* Histogram of the keys of a main tree. */
+
+    unsigned int buckets[BOX_PLANNER_BUCKETS];
+    unsigned int total;
+} box_histogram;
+
+
+typedef struct box_planner_s {			/* Box planner structure. */
+
+    box_histogram by_side;			/* Histogram of the keys of tree_by_side ((side * side) values.) */
+    box_histogram by_height;			/* Histogram of the keys of tree_by_height. */
+} box_planner;
+
+
+/* Initialize a planner with empty histograms. */
+
+void box_planner_init(box_planner *planner);
+
+
+/* Add a key to the histogram / remove a key from the histogram - called when a key is added to / deleted from the corresponding main tree. */
+
+void box_histogram_add(box_histogram *histogram, box_dim val);
+
+void box_histogram_remove(box_histogram *histogram, box_dim val);
+
+
+/* Return the estimated number of the keys of the histogram which are larger than or equal to the given value. */
+
+unsigned int box_histogram_estimate_from(box_histogram *histogram, box_dim val);
+
+
+/* Return TRUE if a query of the given dimensions should scan tree_by_side, FALSE if it should scan tree_by_height. */
+
+bool box_planner_side_first(box_planner *planner, box_dim side_square, box_dim height);
+
+
+#endif /* BOX_PLANNER_H_ */
@@ -0,0 +1,478 @@
+/*
+ Box server source file.
+ Here we implement the server of a box factory - the event loop, the connections with their buffers, and the serving of the requests.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* The sockets, and strdup. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <errno.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include <sys/epoll.h>
+
+#include <sys/socket.h>
+
+#include <sys/un.h>
+
+#include "box_factory.h"
+
+#include "box_server.h"
+
+
+/* Functions' prototype declarations: */
+
+
+/* Accept the pending connections of the listening socket. */
+
+static void box_server_accept(box_server *server);
+
+
+/* Close the connection and free it. */
+
+static void box_server_close(box_server *server, box_server_connection *connection);
+
+
+/* Read what the client has written, and serve the whole requests of the read buffer for which there is room in the write buffer. */
+
+static void box_server_read(box_server *server, box_server_connection *connection);
+
+
+/* Serve a single request. */
+
+static void box_server_handle(box_server *server, box_server_connection *connection, const box_server_request *request, box_server_response *response);
+
+
+/* Write what the socket takes of the write buffer (without SIGPIPE if the client is gone.) */
+
+static void box_server_write(box_server_connection *connection);
+
+
+/* Set the events epoll waits for on the connection - reading while the read buffer has room, and writing while responses are waiting, or requests
+ are waiting for room for their responses (so they're served once the socket takes the responses.) Returns FALSE on an error of epoll, TRUE
+ otherwise. */
+
+static bool box_server_update_events(box_server *server, box_server_connection *connection);
+
+
+/* The implementation: */
+
+
+box_server* box_server_create(box_factory *factory, const char *path)
+{
+
+    box_server *server = calloc(sizeof(box_server), 1);
+    struct sockaddr_un address;
+    struct epoll_event event;
+
+    if (server == NULL) {
+
+        return NULL;
+    }
+
+    server->factory = factory;
+    server->listen_fd = -1;
+    server->epoll_fd = -1;
+    server->path = strdup(path);
+
+    memset(&address, 0, sizeof(address));
+    memset(&event, 0, sizeof(event));
+
+    if ((server->path == NULL) || (strlen(path) >= sizeof(address.sun_path))) {
+
+        box_server_destroy(server);
+        return NULL;
+    }
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    unlink(path);			/* The socket file of a previous server. */
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;			/* The listening socket - every connection has its own pointer. */
+
+    if ((server->listen_fd < 0) || (server->epoll_fd < 0) || (bind(server->listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0) ||
+        (listen(server->listen_fd, BOX_SERVER_BACKLOG) != 0) || (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) != 0)) {
+
+        box_server_destroy(server);
+        return NULL;
+    }
+
+    return server;
+}
+
+
+void box_server_destroy(box_server *server)
+{
+
+    while (server->connections != NULL) {
+
+        box_server_close(server, server->connections);
+    }
+
+    if (server->listen_fd >= 0) {
+
+        close(server->listen_fd);
+        unlink(server->path);
+    }
+
+    if (server->epoll_fd >= 0) {
+
+        close(server->epoll_fd);
+    }
+
+    free(server->path);
+    free(server);
+}
+
+
+void box_server_stop(box_server *server)
+{
+
+    server->stopping = 1;
+}
+
+
+static void box_server_accept(box_server *server)
+{
+
+    box_server_connection *connection = NULL;
+    struct epoll_event event;
+    int fd = -1;
+
+    memset(&event, 0, sizeof(event));
+
+    while (true) {
+
+        fd = accept(server->listen_fd, NULL, NULL);
+
+        if (fd < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            return;			/* No more pending connections (EAGAIN), or an error of a single connection which was dropped. */
+        }
+
+        connection = calloc(sizeof(box_server_connection), 1);
+        event.events = EPOLLIN;
+        event.data.ptr = connection;
+
+        if ((connection == NULL) || (fcntl(fd, F_SETFL, O_NONBLOCK) != 0) || (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) ||
+            (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)) {
+
+            free(connection);
+            close(fd);
+
+            continue;
+        }
+
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        connection->next = server->connections;
+
+        if (server->connections != NULL) {
+
+            server->connections->prev = connection;
+        }
+
+        server->connections = connection;
+        server->stats.connections++;
+    }
+}
+
+
+static void box_server_close(box_server *server, box_server_connection *connection)
+{
+
+    if (connection->prev != NULL) {
+
+        connection->prev->next = connection->next;
+    }
+
+    else {
+
+        server->connections = connection->next;
+    }
+
+    if (connection->next != NULL) {
+
+        connection->next->prev = connection->prev;
+    }
+
+    close(connection->fd);			/* Removes it from the epoll set too. */
+    free(connection);
+}
+
+
+static void box_server_handle(box_server *server, box_server_connection *connection, const box_server_request *request, box_server_response *response)
+{
+
+    box_factory *factory = server->factory;
+    box_dim side = (box_dim) request->side;
+    box_dim height = (box_dim) request->height;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    bool result = false;
+
+    memset(response, 0, sizeof(box_server_response));
+
+    response->id = request->id;
+    response->status = BOX_SERVER_INVALID;
+
+    if ((side != request->side) || (height != request->height)) {
+
+        return;
+    }
+
+    switch (request->op) {
+
+        case BOX_SERVER_INSERT:
+
+            result = box_factory_insert(factory, side, height);
+            connection->changed = connection->changed || result;
+            break;
+
+        case BOX_SERVER_REMOVE:
+
+            result = box_factory_remove(factory, side, height);
+            connection->changed = connection->changed || result;
+            break;
+
+        case BOX_SERVER_GET:
+
+            result = box_factory_get_box(factory, side, height, &found_side_square, &found_height);
+
+            response->side_square = found_side_square;
+            response->height = found_height;
+            break;
+
+        case BOX_SERVER_CHECK:
+
+            result = box_factory_check_box(factory, side, height);
+            break;
+
+        default:
+
+            return;
+    }
+
+    response->status = result ? BOX_SERVER_TRUE : BOX_SERVER_FALSE;
+}
+
+
+static void box_server_read(box_server *server, box_server_connection *connection)
+{
+
+    box_server_request request;
+    box_server_response response;
+    size_t position = 0;
+    ssize_t result = 0;
+
+    if (connection->in_size < BOX_SERVER_BUFFER_SIZE) {
+
+        do {
+
+            result = read(connection->fd, connection->in + connection->in_size, BOX_SERVER_BUFFER_SIZE - connection->in_size);
+        } while ((result < 0) && (errno == EINTR));
+
+        if (result > 0) {
+
+            connection->in_size += (size_t) result;
+        }
+
+        else {
+
+            if ((result == 0) || (errno != EAGAIN)) {			/* The client closed its side, or an error. */
+
+                connection->closing = true;
+            }
+        }
+    }
+
+    /* Make room for the responses at the start of the write buffer, and serve the requests which have room there. The buffers aren't aligned for
+     the structures, so every request and response is copied. */
+
+    memmove(connection->out, connection->out + connection->out_position, connection->out_size - connection->out_position);
+    connection->out_size -= connection->out_position;
+    connection->out_position = 0;
+
+    while ((connection->in_size - position >= sizeof(box_server_request)) &&
+           (BOX_SERVER_BUFFER_SIZE - connection->out_size >= sizeof(box_server_response))) {
+
+        memcpy(&request, connection->in + position, sizeof(box_server_request));
+
+        box_server_handle(server, connection, &request, &response);
+
+        memcpy(connection->out + connection->out_size, &response, sizeof(box_server_response));
+        connection->out_size += sizeof(box_server_response);
+
+        position += sizeof(box_server_request);
+        server->stats.requests++;
+    }
+
+    memmove(connection->in, connection->in + position, connection->in_size - position);
+    connection->in_size -= position;
+}
+
+
+static void box_server_write(box_server_connection *connection)
+{
+
+    ssize_t result = 0;
+
+    while (connection->out_position < connection->out_size) {
+
+        result = send(connection->fd, connection->out + connection->out_position, connection->out_size - connection->out_position, MSG_NOSIGNAL);
+
+        if (result < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            if (errno != EAGAIN) {			/* The client is gone - its requests and responses are dropped. */
+
+                connection->closing = true;
+                connection->out_position = connection->out_size;
+                connection->in_size = 0;
+            }
+
+            return;
+        }
+
+        connection->out_position += (size_t) result;
+    }
+}
+
+
+static bool box_server_update_events(box_server *server, box_server_connection *connection)
+{
+
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+
+    event.events = ((!connection->closing && (connection->in_size < BOX_SERVER_BUFFER_SIZE)) ? EPOLLIN : 0) |
+                   (((connection->out_position < connection->out_size) || (connection->in_size >= sizeof(box_server_request))) ? EPOLLOUT : 0);
+    event.data.ptr = connection;
+
+    if (event.events == connection->events) {
+
+        return true;
+    }
+
+    connection->events = event.events;
+
+    return (epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event) == 0);
+}
+
+
+bool box_server_run(box_server *server)
+{
+
+    struct epoll_event events[BOX_SERVER_MAX_EVENTS];
+    box_server_connection *connection = NULL;
+    bool changed = false;
+    bool synced = true;
+    int count = 0;
+    int i = 0;
+
+    while (!server->stopping) {
+
+        count = epoll_wait(server->epoll_fd, events, BOX_SERVER_MAX_EVENTS, -1);
+
+        if (count < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            return false;
+        }
+
+        /* Serve the requests of all the connections which are ready. */
+
+        changed = false;
+
+        for (i = 0; i < count; ++i) {
+
+            connection = events[i].data.ptr;
+
+            if (connection == NULL) {
+
+                box_server_accept(server);
+                continue;
+            }
+
+            /* The responses of the previous rounds are durable already - they are written first, to make room for the new ones. */
+
+            if ((events[i].events & EPOLLOUT) != 0) {
+
+                box_server_write(connection);
+            }
+
+            box_server_read(server, connection);
+
+            changed = changed || connection->changed;
+        }
+
+        /* The group commit of the round - the responses of the changes are written only once they are durable. */
+
+        synced = true;
+
+        if (changed) {
+
+            synced = box_factory_sync(server->factory);
+            server->stats.syncs++;
+        }
+
+        server->stats.rounds++;
+
+        for (i = 0; i < count; ++i) {
+
+            connection = events[i].data.ptr;
+
+            if (connection == NULL) {
+
+                continue;
+            }
+
+            if (connection->changed && !synced) {
+
+                connection->closing = true;
+                connection->out_position = connection->out_size;
+                connection->in_size = 0;
+            }
+
+            connection->changed = false;
+
+            box_server_write(connection);
+
+            if ((connection->closing && (connection->out_position == connection->out_size) && (connection->in_size < sizeof(box_server_request))) ||
+                !box_server_update_events(server, connection)) {
+
+                box_server_close(server, connection);
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,125 @@
+/* Box server header file.
+ Contains the structures and functions' prototype declarations of the server of a box factory - a single authoritative box factory served to other
+ processes over a Unix domain socket.
+ The protocol is binary and fixed-width: a client writes requests (box_server_request) and reads a response (box_server_response) for every request,
+ in the order of the requests. The id of a request is returned in its response, so a client may pipeline requests - write many of them without
+ waiting for their responses - and write and read many of them by a single call. The numbers are in the byte order of the machine.
+ The server is a single thread with an epoll event loop. Every connection has a read buffer, which is filled by a single read() and whose whole requests
+ are served at once, and a write buffer of their responses. A round of the loop serves all the connections which are ready, makes the changes of the
+ round durable by a single sync of the write-ahead log of the box factory (group commit - see box_factory_sync), and only then writes the responses -
+ so a response of a change is never sent before the change is durable. If the sync fails, the connections which made changes in that round are closed
+ without their responses (like after a crash.)
+ The server is POSIX and Linux only (epoll), so the portable build (BOX_FACTORY_PORTABLE, see box_factory.h) doesn't compile or link it. */
+
+
+#include <stdbool.h>
+
+#include <signal.h>
+
+#include "box_factory.h"
+
+#ifndef BOX_SERVER_H_
+#define BOX_SERVER_H_
+
+
+#define BOX_SERVER_BUFFER_SIZE 65536			/* The size of the read buffer and of the write buffer of a connection. */
+
+#define BOX_SERVER_MAX_EVENTS 64			/* The most events a round of the loop handles. */
+
+#define BOX_SERVER_BACKLOG 128
+
+
+typedef enum box_server_op_e {			/* The operation of a request. */
+
+    BOX_SERVER_INSERT = 1,			/* INSERTBOX - see box_factory_insert. */
+    BOX_SERVER_REMOVE = 2,			/* REMOVEBOX - see box_factory_remove. */
+    BOX_SERVER_GET = 3,			/* GETBOX - see box_factory_get_box. */
+    BOX_SERVER_CHECK = 4			/* CHECKBOX - see box_factory_check_box. */
+} box_server_op;
+
+
+typedef enum box_server_status_e {			/* The status of a response. */
+
+    BOX_SERVER_FALSE = 0,			/* The function of the operation returned FALSE. */
+    BOX_SERVER_TRUE = 1,			/* The function of the operation returned TRUE. */
+    BOX_SERVER_INVALID = 2			/* The request is invalid (an unknown operation, or a dimension which doesn't fit in a box_dim.) */
+} box_server_status;
+
+
+typedef struct box_server_request_s {			/* A request of the protocol - 24 bytes. */
+
+    unsigned int op;			/* box_server_op. */
+    unsigned int id;			/* Chosen by the client, and returned in the response. */
+    unsigned long long side;
+    unsigned long long height;
+} box_server_request;
+
+
+typedef struct box_server_response_s {			/* A response of the protocol - 24 bytes. */
+
+    unsigned int id;			/* The id of the request. */
+    unsigned int status;			/* box_server_status. */
+    unsigned long long side_square;			/* The box found by BOX_SERVER_GET (0 otherwise.) */
+    unsigned long long height;
+} box_server_response;
+
+
+typedef struct box_server_connection_s {			/* A connection of a client. */
+
+    int fd;
+    unsigned char in[BOX_SERVER_BUFFER_SIZE];			/* The bytes read, which weren't served yet (a request may be cut at the end.) */
+    size_t in_size;
+    unsigned char out[BOX_SERVER_BUFFER_SIZE];			/* The responses which weren't written yet, from out_position to out_size. */
+    size_t out_position;
+    size_t out_size;
+    bool changed;			/* TRUE if the requests served in this round changed the box factory. */
+    bool closing;			/* TRUE once the client closed its side, or on an error - closed at the end of the round. */
+    unsigned int events;			/* The events epoll waits for on the connection. */
+    struct box_server_connection_s *next;			/* The list of the connections of the server. */
+    struct box_server_connection_s *prev;
+} box_server_connection;
+
+
+typedef struct box_server_stats_s {			/* Counters of a server since it was created. */
+
+    unsigned long long requests;
+    unsigned long long rounds;			/* Rounds of the event loop. */
+    unsigned long long syncs;			/* Group commits (rounds which changed the box factory.) */
+    unsigned long long connections;			/* Connections accepted. */
+} box_server_stats;
+
+
+typedef struct box_server_s {			/* Box server structure. */
+
+    box_factory *factory;
+    char *path;			/* The path of the socket. */
+    int listen_fd;
+    int epoll_fd;
+    box_server_connection *connections;
+    volatile sig_atomic_t stopping;			/* Set by box_server_stop (e.g. from a signal handler.) */
+    box_server_stats stats;
+} box_server;
+
+
+/* Create a server of the given box factory, listening on a Unix domain socket of the given path (a file left there by a previous server is removed.)
+ Returns NULL on an allocation error, or if the socket couldn't be created, otherwise returns a pointer to box_server. */
+
+box_server* box_server_create(box_factory *factory, const char *path);
+
+
+/* Run the event loop of the server until box_server_stop is called. Returns FALSE on an error of epoll, TRUE otherwise. */
+
+bool box_server_run(box_server *server);
+
+
+/* Ask the event loop to return - it may be called from a signal handler (a signal interrupts the wait of the loop.) */
+
+void box_server_stop(box_server *server);
+
+
+/* Close all the connections and the socket, remove the socket file, and free the server (the box factory isn't freed.) */
+
+void box_server_destroy(box_server *server);
+
+
+#endif /* BOX_SERVER_H_ */
@@ -0,0 +1,1357 @@
+/*
+ Box shared source file.
+ Here we implement the shared box store - the segment with its mapping and growth, the red-black trees of its nodes (based on the book's
+ implementation, like rb_tree.c), and the queries of the readers under the sequence lock.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* shm_open, mmap, ftruncate, pread, kill and strdup. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "rb_tree.h"
+
+#include "box_shared.h"
+
+#ifndef BOX_FACTORY_PORTABLE
+
+#include <errno.h>
+
+#include <fcntl.h>
+
+#include <sched.h>
+
+#include <signal.h>
+
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <sys/stat.h>
+
+
+/* The offset of the nodes in the segment - the header, rounded up to a cache line. */
+
+#define BOX_SHARED_NODES_OFFSET (((sizeof(box_shared_header) + 63) / 64) * 64)
+
+
+typedef struct box_shared_reader_s {			/* The state of a query of a reader - a single attempt under the sequence lock. */
+
+    const volatile box_shared_header *header;			/* volatile - every field is read from the segment at the place it's used, exactly once. */
+    const volatile box_shared_node *nodes;
+    unsigned int capacity;			/* The nodes of the mapping - a position beyond them is a sign of a change of the writer. */
+    unsigned long long sequence;			/* The (even) sequence the attempt started with. */
+    unsigned int steps;			/* Number of the nodes visited. */
+    bool torn;			/* TRUE once the attempt has read a change of the writer - its answer is dropped. */
+} box_shared_reader;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the size of a segment of the given number of nodes. */
+
+static size_t box_shared_size(unsigned int capacity);
+
+
+/* Map the segment of the given number of nodes (read-only for a reader), in place of the current mapping. Returns FALSE on an error (the current
+ mapping is kept then), TRUE otherwise. */
+
+static bool box_shared_map(box_shared *shared, unsigned int capacity);
+
+
+/* Make sure the writer has room for the given number of new nodes - double the segment until it has. Returns FALSE on an error, TRUE otherwise. */
+
+static bool box_shared_reserve(box_shared *shared, unsigned int nodes);
+
+
+/* Take a zeroed node of the free list, or a node which was never used. There must be room for it (see box_shared_reserve.) */
+
+static unsigned int box_shared_alloc_node(box_shared *shared);
+
+
+/* Return a node to the free list. */
+
+static void box_shared_free_node(box_shared *shared, unsigned int node);
+
+
+/* Start and end a change of the writer - make the sequence odd, and then even again. */
+
+static void box_shared_change_begin(box_shared *shared);
+
+static void box_shared_change_end(box_shared *shared);
+
+
+/* Return the node of the given key in the tree of the given root, NIL if there's none - the writer only. */
+
+static unsigned int box_shared_find(box_shared *shared, unsigned int root, box_dim key);
+
+
+/* Recompute max_height of the given node of a side from its top and from its children. */
+
+static void box_shared_update_node(box_shared *shared, unsigned int node);
+
+
+/* Recompute max_height of the given node of a side and of all its ancestors - after its top has changed. */
+
+static void box_shared_update_path(box_shared *shared, unsigned int node);
+
+
+/* The rotation functions of the trees - root is the root of the tree of the node, and sides tells whether it is the tree of the sides (whose max_height
+ is kept.) Based on the book's implementation. */
+
+static void box_shared_rotate_left(box_shared *shared, unsigned int *root, bool sides, unsigned int x);
+
+static void box_shared_rotate_right(box_shared *shared, unsigned int *root, bool sides, unsigned int x);
+
+
+/* Insert a new node, whose key isn't in the tree, to the tree of the given root. Based on the book's implementation. */
+
+static void box_shared_insert_node(box_shared *shared, unsigned int *root, bool sides, unsigned int z);
+
+
+/* Helper function of box_shared_insert_node. Based on the book's implementation. */
+
+static void box_shared_insert_fixup(box_shared *shared, unsigned int *root, bool sides, unsigned int z);
+
+
+/* Delete a given node from the tree of the given root. Returns the node which was spliced out of the tree - the given node, or its successor whose
+ key and fields were moved into the given node - which is the one to free. Based on the book's implementation. */
+
+static unsigned int box_shared_delete_node(box_shared *shared, unsigned int *root, bool sides, unsigned int z);
+
+
+/* Helper function of box_shared_delete_node. Based on the book's implementation. */
+
+static void box_shared_delete_fixup(box_shared *shared, unsigned int *root, bool sides, unsigned int x);
+
+
+/* Start an attempt of a query of a reader - wait until the sequence is even, and map the segment again if it has grown. Returns FALSE if the writer
+ died in the middle of a change, or if the segment couldn't be mapped again, TRUE otherwise. */
+
+static bool box_shared_read_begin(box_shared *shared, box_shared_reader *reader, unsigned int attempt);
+
+
+/* End an attempt of a query of a reader. Returns TRUE if its answer is valid - the writer changed nothing while it read - FALSE otherwise. */
+
+static bool box_shared_read_end(box_shared *shared, box_shared_reader *reader);
+
+
+/* Check whether the given position may be visited by the attempt of the reader - it is a node of the mapping, and the sequence didn't change since the
+ last check. Returns FALSE, and marks the attempt as torn, otherwise. */
+
+static bool box_shared_visit(box_shared_reader *reader, unsigned int node);
+
+
+/* Return the node with the smallest key that is larger than or equal to the given key in the tree of the given root, NIL if there's none - a reader. */
+
+static unsigned int box_shared_read_ceiling(box_shared_reader *reader, unsigned int root, box_dim key);
+
+
+/* Return the leftmost side in the subtree of the given side whose top is at least the given height - max_height of the given side must be at least
+ that height. NIL if the attempt is torn. */
+
+static unsigned int box_shared_read_leftmost(box_shared_reader *reader, unsigned int node, box_dim height);
+
+
+/* Return the next side after the given side (in the order of (side * side)) whose top is at least the given height, NIL if there's none. */
+
+static unsigned int box_shared_read_next(box_shared_reader *reader, unsigned int node, box_dim height);
+
+
+/* Return the first side from the given (side * side) whose top is at least the given height, NIL if there's none. */
+
+static unsigned int box_shared_read_first(box_shared_reader *reader, box_dim side_square, box_dim height);
+
+
+/* A single attempt of box_shared_get. */
+
+static bool box_shared_read_get(box_shared_reader *reader, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height);
+
+
+/* The implementation: */
+
+
+static size_t box_shared_size(unsigned int capacity)
+{
+
+    return BOX_SHARED_NODES_OFFSET + (size_t) capacity * sizeof(box_shared_node);
+}
+
+
+static bool box_shared_map(box_shared *shared, unsigned int capacity)
+{
+
+    size_t size = box_shared_size(capacity);
+    void *map = mmap(NULL, size, shared->writer ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, shared->fd, 0);
+
+    if (map == MAP_FAILED) {
+
+        return false;
+    }
+
+    if (shared->map != NULL) {
+
+        munmap(shared->map, shared->map_size);
+    }
+
+    shared->map = map;
+    shared->map_size = size;
+    shared->header = map;
+    shared->nodes = (box_shared_node *) ((char *) map + BOX_SHARED_NODES_OFFSET);
+    shared->capacity = capacity;
+
+    return true;
+}
+
+
+box_shared* box_shared_create(const char *name, const box_snapshot_record *records, unsigned int record_count)
+{
+
+    box_shared *shared = calloc(sizeof(box_shared), 1);
+    unsigned int capacity = BOX_SHARED_MIN_CAPACITY;
+    unsigned long long nodes = 1 + (unsigned long long) record_count;			/* NIL and a node of every size, and of every side below. */
+    unsigned int i = 0;
+
+    if (shared == NULL) {
+
+        return NULL;
+    }
+
+    for (i = 0; i < record_count; ++i) {
+
+        nodes += ((i == 0) || (records[i].side_square != records[i - 1].side_square)) ? 1 : 0;
+    }
+
+    while ((capacity < nodes) && (capacity <= 0x7FFFFFFFU)) {
+
+        capacity *= 2;
+    }
+
+    shared->fd = -1;
+    shared->writer = true;
+    shared->name = strdup(name);
+
+    if ((shared->name == NULL) || (capacity < nodes)) {
+
+        box_shared_close(shared);
+        return NULL;
+    }
+
+    shm_unlink(name);			/* The segment of a previous writer - its readers keep their mapping. */
+
+    shared->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if ((shared->fd < 0) || (ftruncate(shared->fd, (off_t) box_shared_size(capacity)) != 0) || !box_shared_map(shared, capacity)) {
+
+        box_shared_close(shared);
+        return NULL;
+    }
+
+    /* The new file is zeroed - NIL is a black node with no children, and the trees are empty. The magic number is written last, since a reader which
+     opens the segment earlier rejects it. */
+
+    shared->header->version = BOX_SHARED_VERSION;
+    shared->header->dim_size = sizeof(box_dim);
+    shared->header->writer = getpid();
+    shared->header->capacity = capacity;
+    shared->header->used = 1;
+    shared->header->root = BOX_SHARED_NIL;
+
+    for (i = 0; i < record_count; ++i) {
+
+        if (!box_shared_insert(shared, records[i].side_square, records[i].height, records[i].count)) {
+
+            box_shared_close(shared);
+            return NULL;
+        }
+    }
+
+    __atomic_store_n(&(shared->header->magic), BOX_SHARED_MAGIC, __ATOMIC_RELEASE);
+
+    return shared;
+}
+
+
+box_shared* box_shared_open(const char *name)
+{
+
+    box_shared *shared = calloc(sizeof(box_shared), 1);
+    box_shared_header header;
+    struct stat status;
+
+    if (shared == NULL) {
+
+        return NULL;
+    }
+
+    shared->fd = -1;
+    shared->name = strdup(name);
+
+    if (shared->name == NULL) {
+
+        box_shared_close(shared);
+        return NULL;
+    }
+
+    shared->fd = shm_open(name, O_RDONLY, 0);
+
+    /* The header is checked before the nodes are mapped - the capacity of a segment of another build means nothing. */
+
+    if ((shared->fd < 0) || (pread(shared->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) || (header.magic != BOX_SHARED_MAGIC) ||
+        (header.version != BOX_SHARED_VERSION) || (header.dim_size != sizeof(box_dim)) || (header.capacity == 0) || (fstat(shared->fd, &status) != 0) ||
+        ((unsigned long long) status.st_size < box_shared_size(header.capacity)) || !box_shared_map(shared, header.capacity)) {
+
+        box_shared_close(shared);
+        return NULL;
+    }
+
+    return shared;
+}
+
+
+void box_shared_close(box_shared *shared)
+{
+
+    if (shared->map != NULL) {
+
+        munmap(shared->map, shared->map_size);
+    }
+
+    if (shared->fd >= 0) {
+
+        close(shared->fd);
+
+        if (shared->writer) {
+
+            shm_unlink(shared->name);
+        }
+    }
+
+    free(shared->name);
+    free(shared);
+}
+
+
+static bool box_shared_reserve(box_shared *shared, unsigned int nodes)
+{
+
+    box_shared_header *header = shared->header;
+    unsigned int capacity = shared->capacity;
+    unsigned int free_nodes = 0;
+    unsigned int node = 0;
+
+    for (node = header->free_list; (node != BOX_SHARED_NIL) && (free_nodes < nodes); node = shared->nodes[node].left) {
+
+        free_nodes++;
+    }
+
+    if (capacity - header->used >= nodes - free_nodes) {
+
+        return true;
+    }
+
+    /* The file grows first, so a reader which finds the new capacity in the header can map it. The nodes keep their positions. */
+
+    while ((capacity - header->used < nodes - free_nodes) && (capacity <= 0x7FFFFFFFU)) {
+
+        capacity *= 2;
+    }
+
+    if ((capacity - header->used < nodes - free_nodes) || (ftruncate(shared->fd, (off_t) box_shared_size(capacity)) != 0) ||
+        !box_shared_map(shared, capacity)) {
+
+        return false;
+    }
+
+    __atomic_store_n(&(shared->header->capacity), capacity, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+
+static unsigned int box_shared_alloc_node(box_shared *shared)
+{
+
+    box_shared_header *header = shared->header;
+    unsigned int node = header->free_list;
+
+    if (node != BOX_SHARED_NIL) {
+
+        header->free_list = shared->nodes[node].left;
+    }
+
+    else {
+
+        node = header->used++;
+    }
+
+    memset(&(shared->nodes[node]), 0, sizeof(box_shared_node));
+
+    return node;
+}
+
+
+static void box_shared_free_node(box_shared *shared, unsigned int node)
+{
+
+    shared->nodes[node].left = shared->header->free_list;
+    shared->header->free_list = node;
+}
+
+
+static void box_shared_change_begin(box_shared *shared)
+{
+
+    /* The odd sequence is visible before any of the stores of the change. */
+
+    __atomic_store_n(&(shared->header->sequence), shared->header->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+static void box_shared_change_end(box_shared *shared)
+{
+
+    __atomic_store_n(&(shared->header->sequence), shared->header->sequence + 1, __ATOMIC_RELEASE);
+}
+
+
+static unsigned int box_shared_find(box_shared *shared, unsigned int root, box_dim key)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int node = root;
+
+    while ((node != BOX_SHARED_NIL) && (nodes[node].key != key)) {
+
+        node = (key < nodes[node].key) ? nodes[node].left : nodes[node].right;
+    }
+
+    return node;
+}
+
+
+static void box_shared_update_node(box_shared *shared, unsigned int node)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    box_dim max_height = nodes[node].top;
+
+    if ((nodes[node].left != BOX_SHARED_NIL) && (nodes[nodes[node].left].max_height > max_height)) {
+
+        max_height = nodes[nodes[node].left].max_height;
+    }
+
+    if ((nodes[node].right != BOX_SHARED_NIL) && (nodes[nodes[node].right].max_height > max_height)) {
+
+        max_height = nodes[nodes[node].right].max_height;
+    }
+
+    nodes[node].max_height = max_height;
+}
+
+
+static void box_shared_update_path(box_shared *shared, unsigned int node)
+{
+
+    for (; node != BOX_SHARED_NIL; node = shared->nodes[node].parent) {
+
+        box_shared_update_node(shared, node);
+    }
+}
+
+
+static void box_shared_rotate_left(box_shared *shared, unsigned int *root, bool sides, unsigned int x)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int y = nodes[x].right;
+
+    nodes[x].right = nodes[y].left;
+
+    if (nodes[y].left != BOX_SHARED_NIL) {
+
+        nodes[nodes[y].left].parent = x;
+    }
+
+    nodes[y].parent = nodes[x].parent;
+
+    if (nodes[x].parent == BOX_SHARED_NIL) {
+
+        *root = y;
+    }
+
+    else {
+
+        if (x == nodes[nodes[x].parent].left) {
+
+            nodes[nodes[x].parent].left = y;
+        }
+
+        else {
+
+            nodes[nodes[x].parent].right = y;
+        }
+    }
+
+    nodes[y].left = x;
+    nodes[x].parent = y;
+
+    /* y takes the place of x, so its subtree is the former subtree of x. */
+
+    if (sides) {
+
+        nodes[y].max_height = nodes[x].max_height;
+        box_shared_update_node(shared, x);
+    }
+}
+
+
+static void box_shared_rotate_right(box_shared *shared, unsigned int *root, bool sides, unsigned int x)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int y = nodes[x].left;
+
+    nodes[x].left = nodes[y].right;
+
+    if (nodes[y].right != BOX_SHARED_NIL) {
+
+        nodes[nodes[y].right].parent = x;
+    }
+
+    nodes[y].parent = nodes[x].parent;
+
+    if (nodes[x].parent == BOX_SHARED_NIL) {
+
+        *root = y;
+    }
+
+    else {
+
+        if (x == nodes[nodes[x].parent].right) {
+
+            nodes[nodes[x].parent].right = y;
+        }
+
+        else {
+
+            nodes[nodes[x].parent].left = y;
+        }
+    }
+
+    nodes[y].right = x;
+    nodes[x].parent = y;
+
+    if (sides) {
+
+        nodes[y].max_height = nodes[x].max_height;
+        box_shared_update_node(shared, x);
+    }
+}
+
+
+static void box_shared_insert_node(box_shared *shared, unsigned int *root, bool sides, unsigned int z)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int x = *root;
+    unsigned int y = BOX_SHARED_NIL;
+
+    while (x != BOX_SHARED_NIL) {
+
+        y = x;
+
+        if (sides && (nodes[z].top > nodes[y].max_height)) {			/* The new node would be in the subtree of every node on the way down. */
+
+            nodes[y].max_height = nodes[z].top;
+        }
+
+        x = (nodes[z].key < nodes[x].key) ? nodes[x].left : nodes[x].right;
+    }
+
+    nodes[z].parent = y;
+    nodes[z].left = BOX_SHARED_NIL;
+    nodes[z].right = BOX_SHARED_NIL;
+    nodes[z].color = RED;
+    nodes[z].max_height = nodes[z].top;
+
+    if (y == BOX_SHARED_NIL) {
+
+        *root = z;
+    }
+
+    else {
+
+        if (nodes[z].key < nodes[y].key) {
+
+            nodes[y].left = z;
+        }
+
+        else {
+
+            nodes[y].right = z;
+        }
+    }
+
+    box_shared_insert_fixup(shared, root, sides, z);
+}
+
+
+static void box_shared_insert_fixup(box_shared *shared, unsigned int *root, bool sides, unsigned int z)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int y = BOX_SHARED_NIL;
+
+    while (nodes[nodes[z].parent].color == RED) {
+
+        if (nodes[z].parent == nodes[nodes[nodes[z].parent].parent].left) {
+
+            y = nodes[nodes[nodes[z].parent].parent].right;
+
+            /* Case 1 */
+
+            if (nodes[y].color == RED) {
+
+                nodes[nodes[z].parent].color = BLACK;
+                nodes[y].color = BLACK;
+                nodes[nodes[nodes[z].parent].parent].color = RED;
+                z = nodes[nodes[z].parent].parent;
+            }
+
+            else {
+
+                /* Case 2 */
+
+                if (z == nodes[nodes[z].parent].right) {
+
+                    z = nodes[z].parent;
+
+                    box_shared_rotate_left(shared, root, sides, z);
+                }
+
+                /* Case 3 */
+
+                nodes[nodes[z].parent].color = BLACK;
+                nodes[nodes[nodes[z].parent].parent].color = RED;
+
+                box_shared_rotate_right(shared, root, sides, nodes[nodes[z].parent].parent);
+            }
+        }
+
+        else {
+
+            y = nodes[nodes[nodes[z].parent].parent].left;
+
+            /* Case 1 */
+
+            if (nodes[y].color == RED) {
+
+                nodes[nodes[z].parent].color = BLACK;
+                nodes[y].color = BLACK;
+                nodes[nodes[nodes[z].parent].parent].color = RED;
+                z = nodes[nodes[z].parent].parent;
+            }
+
+            else {
+
+                /* Case 2 */
+
+                if (z == nodes[nodes[z].parent].left) {
+
+                    z = nodes[z].parent;
+
+                    box_shared_rotate_right(shared, root, sides, z);
+                }
+
+                /* Case 3 */
+
+                nodes[nodes[z].parent].color = BLACK;
+                nodes[nodes[nodes[z].parent].parent].color = RED;
+
+                box_shared_rotate_left(shared, root, sides, nodes[nodes[z].parent].parent);
+            }
+        }
+    }
+
+    nodes[*root].color = BLACK;
+}
+
+
+static unsigned int box_shared_delete_node(box_shared *shared, unsigned int *root, bool sides, unsigned int z)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int y = z;
+    unsigned int x = BOX_SHARED_NIL;
+    unsigned int p = BOX_SHARED_NIL;
+
+    if ((nodes[z].left != BOX_SHARED_NIL) && (nodes[z].right != BOX_SHARED_NIL)) {
+
+        for (y = nodes[z].right; nodes[y].left != BOX_SHARED_NIL; y = nodes[y].left) {			/* The successor of z. */
+        }
+    }
+
+    x = (nodes[y].left == BOX_SHARED_NIL) ? nodes[y].right : nodes[y].left;
+
+    nodes[x].parent = nodes[y].parent;			/* Also when x is NIL - the fixup starts from its parent. */
+
+    if (nodes[y].parent == BOX_SHARED_NIL) {
+
+        *root = x;
+    }
+
+    else {
+
+        if (y == nodes[nodes[y].parent].left) {
+
+            nodes[nodes[y].parent].left = x;
+        }
+
+        else {
+
+            nodes[nodes[y].parent].right = x;
+        }
+    }
+
+    if (y != z) {			/* Copy y's satellite data into z. */
+
+        nodes[z].key = nodes[y].key;
+        nodes[z].top = nodes[y].top;
+        nodes[z].heights = nodes[y].heights;
+        nodes[z].count = nodes[y].count;
+    }
+
+    /* y was spliced out - fix max_height of its former ancestors (z is one of them, if y != z), before the rotations of the fixup. */
+
+    if (sides) {
+
+        for (p = nodes[y].parent; p != BOX_SHARED_NIL; p = nodes[p].parent) {
+
+            box_shared_update_node(shared, p);
+        }
+    }
+
+    if (nodes[y].color == BLACK) {
+
+        box_shared_delete_fixup(shared, root, sides, x);
+    }
+
+    return y;
+}
+
+
+static void box_shared_delete_fixup(box_shared *shared, unsigned int *root, bool sides, unsigned int x)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int w = BOX_SHARED_NIL;
+
+    while ((nodes[x].color == BLACK) && (x != *root)) {
+
+        if (x == nodes[nodes[x].parent].left) {
+
+            w = nodes[nodes[x].parent].right;
+
+            if (nodes[w].color == RED) {
+
+                nodes[w].color = BLACK;
+                nodes[nodes[x].parent].color = RED;
+
+                box_shared_rotate_left(shared, root, sides, nodes[x].parent);
+
+                w = nodes[nodes[x].parent].right;
+            }
+
+            if ((nodes[nodes[w].right].color == BLACK) && (nodes[nodes[w].left].color == BLACK)) {
+
+                nodes[w].color = RED;
+                x = nodes[x].parent;
+            }
+
+            else {
+
+                if (nodes[nodes[w].right].color == BLACK) {
+
+                    nodes[nodes[w].left].color = BLACK;
+                    nodes[w].color = RED;
+
+                    box_shared_rotate_right(shared, root, sides, w);
+
+                    w = nodes[nodes[x].parent].right;
+                }
+
+                nodes[w].color = nodes[nodes[x].parent].color;
+                nodes[nodes[x].parent].color = BLACK;
+                nodes[nodes[w].right].color = BLACK;
+
+                box_shared_rotate_left(shared, root, sides, nodes[x].parent);
+
+                x = *root;
+            }
+        }
+
+        else {
+
+            w = nodes[nodes[x].parent].left;
+
+            if (nodes[w].color == RED) {
+
+                nodes[w].color = BLACK;
+                nodes[nodes[x].parent].color = RED;
+
+                box_shared_rotate_right(shared, root, sides, nodes[x].parent);
+
+                w = nodes[nodes[x].parent].left;
+            }
+
+            if ((nodes[nodes[w].right].color == BLACK) && (nodes[nodes[w].left].color == BLACK)) {
+
+                nodes[w].color = RED;
+                x = nodes[x].parent;
+            }
+
+            else {
+
+                if (nodes[nodes[w].left].color == BLACK) {
+
+                    nodes[nodes[w].right].color = BLACK;
+                    nodes[w].color = RED;
+
+                    box_shared_rotate_left(shared, root, sides, w);
+
+                    w = nodes[nodes[x].parent].left;
+                }
+
+                nodes[w].color = nodes[nodes[x].parent].color;
+                nodes[nodes[x].parent].color = BLACK;
+                nodes[nodes[w].left].color = BLACK;
+
+                box_shared_rotate_right(shared, root, sides, nodes[x].parent);
+
+                x = *root;
+            }
+        }
+    }
+
+    nodes[x].color = BLACK;
+}
+
+
+bool box_shared_insert(box_shared *shared, box_dim side_square, box_dim height, unsigned int count)
+{
+
+    unsigned int side = BOX_SHARED_NIL;
+    unsigned int node = BOX_SHARED_NIL;
+
+    if (count == 0) {
+
+        return true;
+    }
+
+    /* The segment may grow only between the changes - a new side and a new height take two nodes at most. */
+
+    if (!box_shared_reserve(shared, 2)) {
+
+        return false;
+    }
+
+    box_shared_change_begin(shared);
+
+    side = box_shared_find(shared, shared->header->root, side_square);
+
+    if (side == BOX_SHARED_NIL) {
+
+        side = box_shared_alloc_node(shared);
+
+        shared->nodes[side].key = side_square;
+        shared->nodes[side].top = height;
+        shared->nodes[side].heights = BOX_SHARED_NIL;
+
+        box_shared_insert_node(shared, &(shared->header->root), true, side);
+        shared->header->side_count++;
+    }
+
+    node = box_shared_find(shared, shared->nodes[side].heights, height);
+
+    if (node == BOX_SHARED_NIL) {
+
+        node = box_shared_alloc_node(shared);
+
+        shared->nodes[node].key = height;
+
+        box_shared_insert_node(shared, &(shared->nodes[side].heights), false, node);
+        shared->header->record_count++;
+
+        if (height > shared->nodes[side].top) {
+
+            shared->nodes[side].top = height;
+            box_shared_update_path(shared, side);
+        }
+    }
+
+    shared->nodes[node].count += count;
+    shared->header->box_count += count;
+
+    box_shared_change_end(shared);
+
+    return true;
+}
+
+
+bool box_shared_remove(box_shared *shared, box_dim side_square, box_dim height, unsigned int count)
+{
+
+    box_shared_node *nodes = shared->nodes;
+    unsigned int side = box_shared_find(shared, shared->header->root, side_square);
+    unsigned int node = (side == BOX_SHARED_NIL) ? BOX_SHARED_NIL : box_shared_find(shared, nodes[side].heights, height);
+    unsigned int top = BOX_SHARED_NIL;
+
+    if ((node == BOX_SHARED_NIL) || (nodes[node].count < count)) {
+
+        return false;
+    }
+
+    if (count == 0) {
+
+        return true;
+    }
+
+    box_shared_change_begin(shared);
+
+    nodes[node].count -= count;
+    shared->header->box_count -= count;
+
+    if (nodes[node].count == 0) {
+
+        box_shared_free_node(shared, box_shared_delete_node(shared, &(nodes[side].heights), false, node));
+        shared->header->record_count--;
+
+        if (nodes[side].heights == BOX_SHARED_NIL) {			/* The last size of the side. */
+
+            box_shared_free_node(shared, box_shared_delete_node(shared, &(shared->header->root), true, side));
+            shared->header->side_count--;
+        }
+
+        else {
+
+            if (height == nodes[side].top) {			/* The maximal height of the side is the rightmost node of its heights. */
+
+                for (top = nodes[side].heights; nodes[top].right != BOX_SHARED_NIL; top = nodes[top].right) {
+                }
+
+                nodes[side].top = nodes[top].key;
+                box_shared_update_path(shared, side);
+            }
+        }
+    }
+
+    box_shared_change_end(shared);
+
+    return true;
+}
+
+
+static bool box_shared_read_begin(box_shared *shared, box_shared_reader *reader, unsigned int attempt)
+{
+
+    volatile box_shared_header *header = shared->header;
+    unsigned int capacity = 0;
+
+    reader->steps = 0;
+    reader->torn = false;
+
+    while (true) {
+
+        if ((attempt > 0) && (attempt % BOX_SHARED_SPIN == 0)) {
+
+            /* The writer is in the middle of a long change, or it is gone - a writer which died leaves the sequence odd forever. */
+
+            if ((kill(header->writer, 0) != 0) && (errno == ESRCH) && ((__atomic_load_n(&(header->sequence), __ATOMIC_ACQUIRE) & 1) != 0)) {
+
+                shared->orphaned = true;
+                return false;
+            }
+
+            sched_yield();
+        }
+
+        reader->sequence = __atomic_load_n(&(header->sequence), __ATOMIC_ACQUIRE);
+
+        if ((reader->sequence & 1) == 0) {
+
+            break;
+        }
+
+        attempt++;
+    }
+
+    capacity = __atomic_load_n(&(header->capacity), __ATOMIC_ACQUIRE);
+
+    if (capacity != shared->capacity) {			/* The writer has grown the segment. */
+
+        if (!box_shared_map(shared, capacity)) {
+
+            return false;
+        }
+
+        shared->stats.remaps++;
+    }
+
+    reader->header = shared->header;
+    reader->nodes = shared->nodes;
+    reader->capacity = shared->capacity;
+
+    return true;
+}
+
+
+static bool box_shared_read_end(box_shared *shared, box_shared_reader *reader)
+{
+
+    /* The loads of the attempt happen before the sequence is read again. */
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (reader->torn || (__atomic_load_n(&(shared->header->sequence), __ATOMIC_RELAXED) != reader->sequence)) {
+
+        shared->stats.retries++;
+        return false;
+    }
+
+    shared->stats.reads++;
+
+    return true;
+}
+
+
+static bool box_shared_visit(box_shared_reader *reader, unsigned int node)
+{
+
+    if (node >= reader->capacity) {			/* A node of a change - a new node beyond the mapping, or garbage of a node being written. */
+
+        reader->torn = true;
+        return false;
+    }
+
+    /* A long walk checks the sequence on the way - links being changed may make it a cycle. */
+
+    if ((++reader->steps % BOX_SHARED_CHECK_STEPS == 0) && (__atomic_load_n(&(reader->header->sequence), __ATOMIC_ACQUIRE) != reader->sequence)) {
+
+        reader->torn = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+static unsigned int box_shared_read_ceiling(box_shared_reader *reader, unsigned int root, box_dim key)
+{
+
+    unsigned int node = root;
+    unsigned int found = BOX_SHARED_NIL;
+
+    while (node != BOX_SHARED_NIL) {
+
+        if (!box_shared_visit(reader, node)) {
+
+            return BOX_SHARED_NIL;
+        }
+
+        if (reader->nodes[node].key >= key) {
+
+            found = node;
+            node = reader->nodes[node].left;
+        }
+
+        else {
+
+            node = reader->nodes[node].right;
+        }
+    }
+
+    return found;
+}
+
+
+static unsigned int box_shared_read_leftmost(box_shared_reader *reader, unsigned int node, box_dim height)
+{
+
+    unsigned int left = BOX_SHARED_NIL;
+
+    while (node != BOX_SHARED_NIL) {
+
+        left = reader->nodes[node].left;
+
+        if ((left != BOX_SHARED_NIL) && !box_shared_visit(reader, left)) {
+
+            return BOX_SHARED_NIL;
+        }
+
+        if ((left != BOX_SHARED_NIL) && (reader->nodes[left].max_height >= height)) {
+
+            node = left;
+            continue;
+        }
+
+        if (reader->nodes[node].top >= height) {
+
+            return node;
+        }
+
+        node = reader->nodes[node].right;
+
+        if ((node != BOX_SHARED_NIL) && !box_shared_visit(reader, node)) {
+
+            return BOX_SHARED_NIL;
+        }
+    }
+
+    reader->torn = true;			/* max_height of the subtree promised a suitable side. */
+
+    return BOX_SHARED_NIL;
+}
+
+
+static unsigned int box_shared_read_next(box_shared_reader *reader, unsigned int node, box_dim height)
+{
+
+    unsigned int next = BOX_SHARED_NIL;
+
+    while (true) {
+
+        /* The sides after the node are its right subtree, then its first ancestor of which it is in the left subtree, then the right subtree of that
+         ancestor, and so on. */
+
+        next = reader->nodes[node].right;
+
+        if ((next != BOX_SHARED_NIL) && !box_shared_visit(reader, next)) {
+
+            return BOX_SHARED_NIL;
+        }
+
+        if ((next != BOX_SHARED_NIL) && (reader->nodes[next].max_height >= height)) {
+
+            return box_shared_read_leftmost(reader, next, height);
+        }
+
+        next = reader->nodes[node].parent;
+
+        while ((next != BOX_SHARED_NIL) && box_shared_visit(reader, next) && (reader->nodes[next].right == node)) {
+
+            node = next;
+            next = reader->nodes[node].parent;
+        }
+
+        if ((next == BOX_SHARED_NIL) || reader->torn) {
+
+            return BOX_SHARED_NIL;
+        }
+
+        if (reader->nodes[next].top >= height) {
+
+            return next;
+        }
+
+        node = next;
+    }
+}
+
+
+static unsigned int box_shared_read_first(box_shared_reader *reader, box_dim side_square, box_dim height)
+{
+
+    unsigned int side = box_shared_read_ceiling(reader, reader->header->root, side_square);
+
+    if ((side == BOX_SHARED_NIL) || (reader->nodes[side].top >= height)) {
+
+        return side;
+    }
+
+    return box_shared_read_next(reader, side, height);
+}
+
+
+static bool box_shared_read_get(box_shared_reader *reader, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    unsigned int side = BOX_SHARED_NIL;
+    unsigned int node = BOX_SHARED_NIL;
+    box_dim key = 0;
+    box_volume volume = 0;
+    box_volume min_volume = 0;
+    bool found = false;
+
+    /* Scan the sides which have a suitable height from the given one, like box_snapshot_get. The scan stops once the volume of the side with the given
+     height can't be smaller than the minimal volume found. */
+
+    for (side = box_shared_read_first(reader, side_square, height); side != BOX_SHARED_NIL; side = box_shared_read_next(reader, side, height)) {
+
+        key = reader->nodes[side].key;
+
+        if (found && (min_volume <= (box_volume) key * height)) {
+
+            break;
+        }
+
+        node = box_shared_read_ceiling(reader, reader->nodes[side].heights, height);
+
+        if (node == BOX_SHARED_NIL) {			/* The top of the side promised a suitable height. */
+
+            reader->torn = true;
+            break;
+        }
+
+        volume = (box_volume) key * reader->nodes[node].key;
+
+        if (!found || (min_volume > volume)) {
+
+            found = true;
+            min_volume = volume;
+            *found_side_square = key;
+            *found_height = reader->nodes[node].key;
+        }
+    }
+
+    return found;
+}
+
+
+bool box_shared_get(box_shared *shared, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    box_shared_reader reader;
+    box_dim side_found = 0;
+    box_dim height_found = 0;
+    unsigned int attempt = 0;
+    bool found = false;
+
+    /* The answer of an attempt is kept aside until the attempt turns out valid. */
+
+    do {
+
+        if (shared->orphaned || !box_shared_read_begin(shared, &reader, attempt++)) {
+
+            return false;
+        }
+
+        found = box_shared_read_get(&reader, side_square, height, &side_found, &height_found);
+    } while (!box_shared_read_end(shared, &reader));
+
+    if (found) {
+
+        *found_side_square = side_found;
+        *found_height = height_found;
+    }
+
+    return found;
+}
+
+
+bool box_shared_check(box_shared *shared, box_dim side_square, box_dim height)
+{
+
+    box_shared_reader reader;
+    unsigned int attempt = 0;
+    bool found = false;
+
+    do {
+
+        if (shared->orphaned || !box_shared_read_begin(shared, &reader, attempt++)) {
+
+            return false;
+        }
+
+        found = (box_shared_read_first(&reader, side_square, height) != BOX_SHARED_NIL);
+    } while (!box_shared_read_end(shared, &reader));
+
+    return found;
+}
+
+
+#else /* BOX_FACTORY_PORTABLE - no segment is ever created or opened, so the functions which take one are never called. */
+
+
+box_shared* box_shared_create(const char *name, const box_snapshot_record *records, unsigned int record_count)
+{
+
+    (void) name;
+    (void) records;
+    (void) record_count;
+
+    return NULL;
+}
+
+
+box_shared* box_shared_open(const char *name)
+{
+
+    (void) name;
+
+    return NULL;
+}
+
+
+void box_shared_close(box_shared *shared)
+{
+
+    free(shared);
+}
+
+
+bool box_shared_insert(box_shared *shared, box_dim side_square, box_dim height, unsigned int count)
+{
+
+    (void) shared;
+    (void) side_square;
+    (void) height;
+    (void) count;
+
+    return false;
+}
+
+
+bool box_shared_remove(box_shared *shared, box_dim side_square, box_dim height, unsigned int count)
+{
+
+    (void) shared;
+    (void) side_square;
+    (void) height;
+    (void) count;
+
+    return false;
+}
+
+
+bool box_shared_get(box_shared *shared, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    (void) shared;
+    (void) side_square;
+    (void) height;
+    (void) found_side_square;
+    (void) found_height;
+
+    return false;
+}
+
+
+bool box_shared_check(box_shared *shared, box_dim side_square, box_dim height)
+{
+
+    (void) shared;
+    (void) side_square;
+    (void) height;
+
+    return false;
+}
+
+
+#endif
@@ -0,0 +1,149 @@
+/* Box shared header file.
+ Contains the structures and functions' prototype declarations of the shared box store - the boxes of a box factory in a POSIX shared-memory segment,
+ which other processes map and query directly, without a copy of the boxes of their own and without a round trip to the owner of the box factory.
+ The segment is a header followed by an array of nodes. The boxes are kept like in the main tree tree_by_side of a box factory and its subtrees: a
+ red-black tree of the different (side * side), whose every node has a red-black tree of the heights of that side with their numbers of boxes. Since
+ every process maps the segment at another address, the nodes are linked by their positions in the array instead of pointers (position 0 is the NIL
+ of all the trees.) Every node of a side also keeps the maximal height of the sides of its subtree, so CHECKBOX takes O(log n) steps for n sides,
+ and GETBOX skips the sides which have no suitable height.
+ There is a single writer - the process which created the segment - and any number of readers, which map it read-only. They are coordinated by a
+ sequence lock: the writer makes the sequence odd before a change and even again after it, and a reader retries its query if the sequence was odd or
+ changed while it read - so a reader never waits for another reader, and the writer never waits at all. A reader may follow links which the writer
+ is changing, so every position it reads is checked against the array before it's used, and a long query checks the sequence on the way too.
+ The array grows by doubling - the writer grows the segment and maps it again, and a reader maps it again once it finds a position beyond its
+ mapping. The numbers are in the byte order of the machine, and the segment of the 32-bit and of the 64-bit build aren't interchangeable (see
+ box_types.h) - a reader checks the header before it maps the nodes.
+ The portable build (BOX_FACTORY_PORTABLE, see box_factory.h) has no shared memory - a segment can't be created or opened there. */
+
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#ifndef BOX_FACTORY_PORTABLE
+
+#include <sys/types.h>
+
+#endif
+
+#include "box_types.h"
+
+#include "box_snapshot.h"
+
+#ifndef BOX_SHARED_H_
+#define BOX_SHARED_H_
+
+
+#define BOX_SHARED_MAGIC 0x0044524148535842ULL			/* "BXSHARD" */
+
+#define BOX_SHARED_VERSION 1
+
+#define BOX_SHARED_MIN_CAPACITY 1024			/* The number of nodes of a new segment. */
+
+#define BOX_SHARED_CHECK_STEPS 1024			/* A reader checks the sequence every this number of nodes it visits. */
+
+#define BOX_SHARED_SPIN 64			/* A reader yields the processor after this number of retries of a query in a row. */
+
+#define BOX_SHARED_NIL 0
+
+
+typedef struct box_shared_header_s {			/* The header of a segment. */
+
+    unsigned long long magic;
+    unsigned int version;
+    unsigned int dim_size;			/* sizeof(box_dim) of the writer. */
+    unsigned long long sequence;			/* The sequence lock - odd while the writer is changing the nodes. */
+#ifdef BOX_FACTORY_PORTABLE
+    int writer;
+#else
+    pid_t writer;			/* The process of the writer, so the readers of a writer which died in the middle of a change don't wait forever. */
+#endif
+    unsigned int capacity;			/* Number of the nodes of the segment (including NIL.) */
+    unsigned int used;			/* Number of the nodes ever handed out - the nodes from used on were never used. */
+    unsigned int free_list;			/* The freed nodes, linked by their left field. */
+    unsigned int root;			/* The root of the tree of the sides. */
+    unsigned int side_count;			/* Number of the different sides. */
+    unsigned int record_count;			/* Number of the different sizes. */
+    unsigned long long box_count;
+} box_shared_header;
+
+
+typedef struct box_shared_node_s {			/* A node of the tree of the sides, or of the tree of the heights of a side. */
+
+    box_dim key;			/* (side * side) of a node of a side, the height of a node of a height. */
+    box_dim top;			/* A node of a side - the maximal height of the boxes of the side. */
+    box_dim max_height;			/* A node of a side - the maximal top of the nodes of its subtree (including itself.) */
+    unsigned int left;			/* The positions of the children and of the parent of the node. */
+    unsigned int right;
+    unsigned int parent;
+    unsigned int heights;			/* A node of a side - the root of the tree of its heights. */
+    unsigned int count;			/* A node of a height - number of boxes of that size. */
+    unsigned int color;			/* rb_tree_color. */
+} box_shared_node;
+
+
+typedef struct box_shared_stats_s {			/* Counters of a reader of a segment since it was opened. */
+
+    unsigned long long reads;			/* Queries answered. */
+    unsigned long long retries;			/* Queries repeated since the writer changed the nodes while they read. */
+    unsigned long long remaps;			/* Mappings of a segment which has grown. */
+} box_shared_stats;
+
+
+typedef struct box_shared_s {			/* Box shared structure - a segment, as mapped by its writer or by a reader. */
+
+    char *name;			/* The name of the segment (see shm_open.) */
+    int fd;
+    bool writer;			/* TRUE for the process which created the segment. */
+    void *map;			/* The mapping of the segment, and its size. */
+    size_t map_size;
+    box_shared_header *header;
+    box_shared_node *nodes;			/* The nodes of the mapping (capacity of the header when it was mapped.) */
+    unsigned int capacity;
+    bool orphaned;			/* A reader - TRUE once the writer was found dead in the middle of a change (the queries answer FALSE then.) */
+    box_shared_stats stats;
+} box_shared;
+
+
+/* Create a segment of the given name for the given records (sorted by (side * side) and then by height, every size once), which replaces a segment
+ of that name if there is one. The calling process is its writer.
+ Returns NULL on an allocation error or an error of the segment (always in the portable build), otherwise returns a pointer to box_shared. */
+
+box_shared* box_shared_create(const char *name, const box_snapshot_record *records, unsigned int record_count);
+
+
+/* Open the segment of the given name as a reader - map it read-only, after checking its header.
+ Returns NULL on an allocation error, an error of the segment or a segment of another build, otherwise returns a pointer to box_shared. */
+
+box_shared* box_shared_open(const char *name);
+
+
+/* Unmap the segment and free the structure. The writer removes the name of the segment as well - the readers which have it mapped keep their mapping,
+ but it doesn't change anymore. */
+
+void box_shared_close(box_shared *shared);
+
+
+/* Add the given number of boxes of the given dimensions ((side * side) and height) - the writer only.
+ Returns FALSE on an allocation error (nothing is added then), TRUE otherwise. */
+
+bool box_shared_insert(box_shared *shared, box_dim side_square, box_dim height, unsigned int count);
+
+
+/* Remove the given number of boxes of the given dimensions - the writer only. Returns FALSE if there are less boxes of the given dimensions (nothing is
+ removed then), TRUE otherwise. */
+
+bool box_shared_remove(box_shared *shared, box_dim side_square, box_dim height, unsigned int count);
+
+
+/* GETBOX over the segment - the same as box_factory_get_box. Returns FALSE if there's no suitable box, TRUE otherwise. */
+
+bool box_shared_get(box_shared *shared, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height);
+
+
+/* CHECKBOX over the segment - the same as box_factory_check_box. */
+
+bool box_shared_check(box_shared *shared, box_dim side_square, box_dim height);
+
+
+#endif /* BOX_SHARED_H_ */
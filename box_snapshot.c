@@ -0,0 +1,495 @@
+/*
+ Box snapshot source file.
+ Here we implement the snapshot file of a box factory - its writing, its mapping to memory, and the queries which are answered from the mapped arrays.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* fileno and fsync. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <limits.h>
+
+#include <unistd.h>
+
+#include "box_file.h"
+
+#include "box_snapshot.h"
+
+
+typedef struct box_snapshot_height_item_s {			/* A record of box_snapshot_write, in the order by height. */
+
+    box_dim height;
+    box_dim side_square;
+    unsigned int index;			/* The position of the record. */
+} box_snapshot_height_item;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the size of a file of the given numbers of records and sides. sides_offset and by_height_offset would contain the positions of the arrays of
+ the sides and of the order by height (the records follow the header.) */
+
+static size_t box_snapshot_layout(unsigned long long record_count, unsigned long long side_count, size_t *sides_offset, size_t *by_height_offset);
+
+
+/* Return the given size rounded up to a multiple of BOX_SNAPSHOT_ALIGNMENT. */
+
+static size_t box_snapshot_padded(size_t size);
+
+
+/* Comparison function between two items of the order by height, for qsort - by height, and then by (side * side). */
+
+static int compare_height_items(const void *a, const void *b);
+
+
+/* Build the arrays of the sides and of the order by height of the given records (sorted by (side * side) and then by height.) sides and by_height
+ would contain the allocated arrays, and side_count the number of sides. Returns FALSE on an allocation error, TRUE otherwise. */
+
+static bool box_snapshot_build_arrays(const box_snapshot_record *records, unsigned int record_count, box_snapshot_side **sides,
+                                      unsigned int *side_count, unsigned int **by_height);
+
+
+/* Write the given bytes to the file, followed by zeros up to a multiple of BOX_SNAPSHOT_ALIGNMENT bytes, and add them to the hash.
+ Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_snapshot_write_array(FILE *file, const void *data, size_t size, unsigned long long *hash, bool hash_only);
+
+
+/* Return the position of the first side of the snapshot whose (side * side) is at least the given one (side_count if there's no such side.) */
+
+static unsigned int box_snapshot_first_side(box_snapshot *snapshot, box_dim side_square);
+
+
+/* Return the position of the first record in [low, high) - the records of a single side - whose height is at least the given height (high if there's
+ no such record.) */
+
+static unsigned int box_snapshot_first_height(box_snapshot *snapshot, unsigned int low, unsigned int high, box_dim height);
+
+
+/* The implementation: */
+
+
+static size_t box_snapshot_padded(size_t size)
+{
+
+    return (size + BOX_SNAPSHOT_ALIGNMENT - 1) / BOX_SNAPSHOT_ALIGNMENT * BOX_SNAPSHOT_ALIGNMENT;
+}
+
+
+static size_t box_snapshot_layout(unsigned long long record_count, unsigned long long side_count, size_t *sides_offset, size_t *by_height_offset)
+{
+
+    *sides_offset = box_snapshot_padded(sizeof(box_snapshot_header)) + box_snapshot_padded(sizeof(box_snapshot_record) * record_count);
+    *by_height_offset = *sides_offset + box_snapshot_padded(sizeof(box_snapshot_side) * side_count);
+
+    return *by_height_offset + box_snapshot_padded(sizeof(unsigned int) * record_count);
+}
+
+
+static int compare_height_items(const void *a, const void *b)
+{
+
+    const box_snapshot_height_item *item_a = a;
+    const box_snapshot_height_item *item_b = b;
+
+    if (item_a->height != item_b->height) {
+
+        return (item_a->height < item_b->height) ? -1 : 1;
+    }
+
+    if (item_a->side_square != item_b->side_square) {
+
+        return (item_a->side_square < item_b->side_square) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+static bool box_snapshot_build_arrays(const box_snapshot_record *records, unsigned int record_count, box_snapshot_side **sides,
+                                      unsigned int *side_count, unsigned int **by_height)
+{
+
+    box_snapshot_height_item *items = NULL;
+    unsigned int i = 0;
+
+    *side_count = 0;
+
+    for (i = 0; i < record_count; ++i) {
+
+        if ((i == 0) || (records[i].side_square != records[i - 1].side_square)) {
+
+            (*side_count)++;
+        }
+    }
+
+    /* calloc zeroes the padding of the structures too, so the same inventory always gives the same file. */
+
+    *sides = calloc(sizeof(box_snapshot_side), (*side_count == 0) ? 1 : *side_count);
+    items = malloc(sizeof(box_snapshot_height_item) * ((record_count == 0) ? 1 : record_count));
+    *by_height = malloc(sizeof(unsigned int) * ((record_count == 0) ? 1 : record_count));
+
+    if ((*sides == NULL) || (items == NULL) || (*by_height == NULL)) {
+
+        free(*sides);
+        free(items);
+        free(*by_height);
+
+        return false;
+    }
+
+    /* The sides with the heights of their last records (the records of a side are sorted by height.) Then, from the last side down, the maximal height
+     of a side and the larger sides is the maximum of its own height and of the maximal height of the next side. */
+
+    *side_count = 0;
+
+    for (i = 0; i < record_count; ++i) {
+
+        if ((i == 0) || (records[i].side_square != records[i - 1].side_square)) {
+
+            (*sides)[*side_count].side_square = records[i].side_square;
+            (*sides)[*side_count].first = i;
+            (*side_count)++;
+        }
+
+        (*sides)[*side_count - 1].max_height = records[i].height;
+    }
+
+    for (i = *side_count; i > 1; --i) {
+
+        if ((*sides)[i - 1].max_height > (*sides)[i - 2].max_height) {
+
+            (*sides)[i - 2].max_height = (*sides)[i - 1].max_height;
+        }
+    }
+
+    for (i = 0; i < record_count; ++i) {
+
+        items[i].height = records[i].height;
+        items[i].side_square = records[i].side_square;
+        items[i].index = i;
+    }
+
+    qsort(items, record_count, sizeof(box_snapshot_height_item), compare_height_items);
+
+    for (i = 0; i < record_count; ++i) {
+
+        (*by_height)[i] = items[i].index;
+    }
+
+    free(items);
+
+    return true;
+}
+
+
+static bool box_snapshot_write_array(FILE *file, const void *data, size_t size, unsigned long long *hash, bool hash_only)
+{
+
+    static const unsigned char zeros[BOX_SNAPSHOT_ALIGNMENT] = {0};
+    size_t padding = box_snapshot_padded(size) - size;
+
+    /* The file is hashed in a first pass (hash_only), since the checksum is a field of the header which is written first. */
+
+    *hash = box_file_hash(box_file_hash(*hash, data, size), zeros, padding);
+
+    if (hash_only) {
+
+        return true;
+    }
+
+    return (fwrite(data, 1, size, file) == size) && (fwrite(zeros, 1, padding, file) == padding);
+}
+
+
+bool box_snapshot_write(const char *path, const box_snapshot_record *records, unsigned int record_count, unsigned long long lsn)
+{
+
+    box_snapshot_header header;
+    box_snapshot_side *sides = NULL;
+    unsigned int *by_height = NULL;
+    unsigned int side_count = 0;
+    unsigned int i = 0;
+    unsigned int pass = 0;
+    unsigned long long hash = 0;
+    char *temporary_path = NULL;
+    FILE *file = NULL;
+    bool written = true;
+
+    memset(&header, 0, sizeof(box_snapshot_header));
+
+    for (i = 0; i < record_count; ++i) {
+
+        header.box_count += records[i].count;
+    }
+
+    temporary_path = malloc(strlen(path) + sizeof(".tmp"));
+
+    if ((temporary_path == NULL) || !box_snapshot_build_arrays(records, record_count, &sides, &side_count, &by_height)) {
+
+        free(temporary_path);
+
+        return false;
+    }
+
+    header.magic = BOX_SNAPSHOT_MAGIC;
+    header.version = BOX_SNAPSHOT_VERSION;
+    header.dim_size = sizeof(box_dim);
+    header.record_count = record_count;
+    header.side_count = side_count;
+    header.lsn = lsn;
+
+    sprintf(temporary_path, "%s.tmp", path);
+    file = fopen(temporary_path, "wb");
+
+    if (file == NULL) {
+
+        written = false;
+    }
+
+    /* Two passes over the same bytes - the first one computes the checksum, and the second one writes the file with it. */
+
+    for (pass = 0; (pass < 2) && written; ++pass) {
+
+        hash = BOX_FILE_HASH_INIT;
+
+        written = box_snapshot_write_array(file, &header, sizeof(box_snapshot_header), &hash, pass == 0) &&
+                  box_snapshot_write_array(file, records, sizeof(box_snapshot_record) * record_count, &hash, pass == 0) &&
+                  box_snapshot_write_array(file, sides, sizeof(box_snapshot_side) * side_count, &hash, pass == 0) &&
+                  box_snapshot_write_array(file, by_height, sizeof(unsigned int) * record_count, &hash, pass == 0);
+
+        if (pass == 0) {
+
+            header.checksum = hash;
+        }
+    }
+
+    if (file != NULL) {
+
+        written = written && (fflush(file) == 0) && (fsync(fileno(file)) == 0);
+        written = (fclose(file) == 0) && written;
+    }
+
+    written = written && (rename(temporary_path, path) == 0) && box_file_sync_directory(path);
+
+    if (!written) {
+
+        remove(temporary_path);
+    }
+
+    free(sides);
+    free(by_height);
+    free(temporary_path);
+
+    return written;
+}
+
+
+box_snapshot* box_snapshot_open(const char *path)
+{
+
+    box_snapshot *snapshot = NULL;
+    box_snapshot_header header;
+    size_t size = 0;
+    size_t sides_offset = 0;
+    size_t by_height_offset = 0;
+    unsigned long long hash = BOX_FILE_HASH_INIT;
+    void *map = box_file_map(path, sizeof(box_snapshot_header), &size);
+
+    if (map == NULL) {
+
+        return NULL;
+    }
+
+    /* Verify the header, the size of the file, and the checksum (of the header with a zeroed checksum field, followed by the rest of the file.) */
+
+    memcpy(&header, map, sizeof(box_snapshot_header));
+
+    if ((header.magic != BOX_SNAPSHOT_MAGIC) || (header.version != BOX_SNAPSHOT_VERSION) || (header.dim_size != sizeof(box_dim)) ||
+        (header.record_count > UINT_MAX) || (header.side_count > header.record_count) ||
+        (box_snapshot_layout(header.record_count, header.side_count, &sides_offset, &by_height_offset) != size)) {
+
+        box_file_unmap(map, size);
+
+        return NULL;
+    }
+
+    hash = box_file_hash(hash, &header, offsetof(box_snapshot_header, checksum));
+    hash = box_file_hash(hash, "\0\0\0\0\0\0\0\0", sizeof(header.checksum));
+    hash = box_file_hash(hash, (char *) map + sizeof(box_snapshot_header), size - sizeof(box_snapshot_header));
+
+    snapshot = (hash == header.checksum) ? calloc(sizeof(box_snapshot), 1) : NULL;
+
+    if (snapshot == NULL) {
+
+        box_file_unmap(map, size);
+
+        return NULL;
+    }
+
+    snapshot->map = map;
+    snapshot->map_size = size;
+    snapshot->lsn = header.lsn;
+    snapshot->record_count = (unsigned int) header.record_count;
+    snapshot->side_count = (unsigned int) header.side_count;
+    snapshot->records = (const box_snapshot_record *) ((char *) map + box_snapshot_padded(sizeof(box_snapshot_header)));
+    snapshot->sides = (const box_snapshot_side *) ((char *) map + sides_offset);
+    snapshot->by_height = (const unsigned int *) ((char *) map + by_height_offset);
+
+    return snapshot;
+}
+
+
+box_snapshot* box_snapshot_create(box_snapshot_record *records, unsigned int record_count, unsigned long long lsn)
+{
+
+    box_snapshot *snapshot = calloc(sizeof(box_snapshot), 1);
+    box_snapshot_side *sides = NULL;
+    unsigned int *by_height = NULL;
+    unsigned int side_count = 0;
+
+    if ((snapshot == NULL) || !box_snapshot_build_arrays(records, record_count, &sides, &side_count, &by_height)) {
+
+        free(snapshot);
+
+        return NULL;
+    }
+
+    snapshot->lsn = lsn;
+    snapshot->record_count = record_count;
+    snapshot->side_count = side_count;
+    snapshot->records = records;
+    snapshot->sides = sides;
+    snapshot->by_height = by_height;
+
+    return snapshot;
+}
+
+
+void box_snapshot_close(box_snapshot *snapshot)
+{
+
+    if (snapshot->map != NULL) {
+
+        box_file_unmap(snapshot->map, snapshot->map_size);
+    }
+
+    else {			/* A snapshot of box_snapshot_create - its arrays were allocated. */
+
+        free((void *) snapshot->records);
+        free((void *) snapshot->sides);
+        free((void *) snapshot->by_height);
+    }
+
+    free(snapshot);
+}
+
+
+static unsigned int box_snapshot_first_side(box_snapshot *snapshot, box_dim side_square)
+{
+
+    unsigned int low = 0;
+    unsigned int high = snapshot->side_count;
+    unsigned int middle = 0;
+
+    while (low < high) {
+
+        middle = low + (high - low) / 2;
+
+        if (snapshot->sides[middle].side_square < side_square) {
+
+            low = middle + 1;
+        }
+
+        else {
+
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+
+static unsigned int box_snapshot_first_height(box_snapshot *snapshot, unsigned int low, unsigned int high, box_dim height)
+{
+
+    unsigned int middle = 0;
+
+    while (low < high) {
+
+        middle = low + (high - low) / 2;
+
+        if (snapshot->records[middle].height < height) {
+
+            low = middle + 1;
+        }
+
+        else {
+
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+
+bool box_snapshot_get(box_snapshot *snapshot, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    unsigned int side = box_snapshot_first_side(snapshot, side_square);
+    unsigned int end = 0;
+    unsigned int record = 0;
+    box_volume volume = 0;
+    box_volume min_volume = 0;
+    bool found = false;
+
+    /* Scan the sides from the given one, like box_factory_get_by_input scans tree_by_side. The scan stops once no larger side has a suitable height,
+     or once the volume of the side with the given height can't be smaller than the minimal volume found. */
+
+    for (; (side < snapshot->side_count) && (snapshot->sides[side].max_height >= height); ++side) {
+
+        if (found && (min_volume <= (box_volume) snapshot->sides[side].side_square * height)) {
+
+            break;
+        }
+
+        end = (side + 1 < snapshot->side_count) ? snapshot->sides[side + 1].first : snapshot->record_count;
+        record = box_snapshot_first_height(snapshot, snapshot->sides[side].first, end, height);
+
+        if (record == end) {			/* No suitable height for this side. */
+
+            continue;
+        }
+
+        volume = (box_volume) snapshot->records[record].side_square * snapshot->records[record].height;
+
+        if (!found || (min_volume > volume)) {
+
+            found = true;
+            min_volume = volume;
+            *found_side_square = snapshot->records[record].side_square;
+            *found_height = snapshot->records[record].height;
+        }
+    }
+
+    return found;
+}
+
+
+bool box_snapshot_check(box_snapshot *snapshot, box_dim side_square, box_dim height)
+{
+
+    unsigned int side = box_snapshot_first_side(snapshot, side_square);
+
+    return (side < snapshot->side_count) && (snapshot->sides[side].max_height >= height);
+}
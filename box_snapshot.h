@@ -0,0 +1,108 @@
+/* Box snapshot header file.
+ Contains the structures and functions' prototype declarations of the snapshot of a box factory - a binary file of its inventory, which is used directly
+ from memory (mmap - or read into memory whole by the portable build, see box_file_map) without being parsed. The file is a header followed by three
+ arrays:
+ 1) The records - every size of the boxes ((side * side), height and number of boxes), sorted by (side * side) and then by height.
+ 2) The sides - every different (side * side) with the position of its first record, and the maximal height of the boxes of that side or of a larger
+    one - so CHECKBOX is a binary search, and GETBOX scans the sides from the given one like box_factory_get_by_input scans tree_by_side.
+ 3) The order of the records by height and then by (side * side) - so both main trees of the box factory are built from a snapshot in O(n) steps.
+ Every array starts at a multiple of BOX_SNAPSHOT_ALIGNMENT bytes. The header has a version, the size of box_dim of the writer (the snapshots of the
+ 32-bit and of the 64-bit build aren't interchangeable - see box_types.h), and a checksum of the whole file, verified when it's opened.
+ The numbers are in the byte order of the writer - a snapshot of another byte order is rejected by its magic number. */
+
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include "box_types.h"
+
+#ifndef BOX_SNAPSHOT_H_
+#define BOX_SNAPSHOT_H_
+
+
+#define BOX_SNAPSHOT_MAGIC 0x0050414E53584F42ULL			/* "BOXSNAP" */
+
+#define BOX_SNAPSHOT_VERSION 1
+
+#define BOX_SNAPSHOT_ALIGNMENT 8
+
+
+typedef struct box_snapshot_header_s {			/* The header of a snapshot file. */
+
+    unsigned long long magic;
+    unsigned int version;
+    unsigned int dim_size;			/* sizeof(box_dim) of the writer. */
+    unsigned long long record_count;
+    unsigned long long side_count;
+    unsigned long long box_count;			/* The sum of the counts of the records. */
+    unsigned long long lsn;			/* The position of the write-ahead log which the snapshot includes (0 without a log.) */
+    unsigned long long checksum;			/* FNV-1a of the file, computed with this field zeroed. */
+} box_snapshot_header;
+
+
+typedef struct box_snapshot_record_s {			/* A size of the boxes of a snapshot. */
+
+    box_dim side_square;
+    box_dim height;
+    unsigned int count;			/* Number of boxes of this size. */
+} box_snapshot_record;
+
+
+typedef struct box_snapshot_side_s {			/* A different (side * side) of a snapshot. */
+
+    box_dim side_square;
+    box_dim max_height;			/* The maximal height of the boxes of this side and of the larger sides. */
+    unsigned int first;			/* The position of the first record of this side - its records end at the first record of the next side. */
+} box_snapshot_side;
+
+
+typedef struct box_snapshot_s {			/* Box snapshot structure - an open snapshot file, mapped to memory. */
+
+    void *map;			/* The mapped file and its size (NULL for a snapshot of box_snapshot_create.) */
+    size_t map_size;
+    unsigned long long lsn;
+    unsigned int record_count;
+    unsigned int side_count;
+    const box_snapshot_record *records;			/* The arrays of the file (pointers into the mapped memory.) */
+    const box_snapshot_side *sides;
+    const unsigned int *by_height;			/* by_height[i] - the position of the record which is i'th by height and then by (side * side). */
+} box_snapshot;
+
+
+/* Write a snapshot of the given records (sorted by (side * side) and then by height, every size once) to the given path. The file is written under a
+ temporary name, synced and renamed over the path, so a crash leaves either the previous file or the new one.
+ Returns FALSE on an allocation error or an I/O error, TRUE otherwise. */
+
+bool box_snapshot_write(const char *path, const box_snapshot_record *records, unsigned int record_count, unsigned long long lsn);
+
+
+/* Open the snapshot file of the given path - map it to memory (read-only) and verify its header and checksum.
+ Returns NULL on an allocation error, an I/O error or an invalid file, otherwise returns a pointer to box_snapshot. */
+
+box_snapshot* box_snapshot_open(const char *path);
+
+
+/* Create a snapshot in memory, of the given records (sorted by (side * side) and then by height, every size once) - the records are taken by the
+ snapshot, and freed when it's closed. It is used like an open file, without a file - for a box factory built from another source (box_export.h.)
+ Returns NULL on an allocation error (the records are left to the caller then), otherwise returns a pointer to box_snapshot. */
+
+box_snapshot* box_snapshot_create(box_snapshot_record *records, unsigned int record_count, unsigned long long lsn);
+
+
+/* Unmap the snapshot file (or free the arrays of a snapshot in memory) and free the snapshot. */
+
+void box_snapshot_close(box_snapshot *snapshot);
+
+
+/* GETBOX over the snapshot - the same as box_factory_get_box. Returns FALSE if there's no suitable box, TRUE otherwise. */
+
+bool box_snapshot_get(box_snapshot *snapshot, box_dim side_square, box_dim height, box_dim *found_side_square, box_dim *found_height);
+
+
+/* CHECKBOX over the snapshot - the same as box_factory_check_box. */
+
+bool box_snapshot_check(box_snapshot *snapshot, box_dim side_square, box_dim height);
+
+
+#endif /* BOX_SNAPSHOT_H_ */
@@ -0,0 +1,627 @@
+/*
+ Box trace source file.
+ Here we implement the trace of a box factory - the encoding of its records, and their decoder.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* clock_gettime and fileno. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <limits.h>
+
+#include <time.h>
+
+#include <sys/stat.h>
+
+#include "box_file.h"
+
+#include "box_trace.h"
+
+
+#define BOX_TRACE_MAX_RECORD (1 + 6 * BOX_FILE_MAX_VARINT + sizeof(double))			/* The largest record - its operation byte, six varints and a
+                                                                                       price. An item or a size of the inventory is smaller. */
+
+#define BOX_TRACE_OP_MASK 0x7F
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the time of a monotonic clock, in nanoseconds. */
+
+static unsigned long long box_trace_now(void);
+
+
+/* Make sure the buffer of the trace has room for a whole record - write the records in it to the file if it may not.
+ Returns FALSE if the trace has failed (on an I/O error), TRUE otherwise. */
+
+static bool box_trace_reserve(box_trace *trace);
+
+
+/* Write the records of the buffer to the file and empty it. Returns FALSE on an I/O error (the trace has failed then), TRUE otherwise. */
+
+static bool box_trace_flush(box_trace *trace);
+
+
+/* Append val to the buffer of the trace as a varint. */
+
+static void box_trace_put(box_trace *trace, unsigned long long val);
+
+
+/* Make sure the buffer of the reader has the bytes of a whole record, unless the file ends before them - the bytes which weren't decoded yet are
+ moved to the start of the buffer, and followed by the next bytes of the file. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_trace_fill(box_trace_reader *reader);
+
+
+/* Decode a varint of the buffer of the reader into val, which must be at most max. Returns FALSE if the bytes end in the middle of the varint, or if
+ it's invalid or larger than max, TRUE otherwise. */
+
+static bool box_trace_get(box_trace_reader *reader, unsigned long long max, unsigned long long *val);
+
+
+/* Decode a dimension of the buffer of the reader. Returns FALSE like box_trace_get. */
+
+static bool box_trace_get_dim(box_trace_reader *reader, box_dim *val);
+
+
+/* Decode a price of the buffer of the reader. Returns FALSE if the bytes end before it, TRUE otherwise. */
+
+static bool box_trace_get_price(box_trace_reader *reader, double *price);
+
+
+/* Decode the items of the record of the given operation into the items of the reader. Returns FALSE on an allocation error, an I/O error, or if the
+ bytes are invalid or end in the middle of an item, TRUE otherwise. */
+
+static bool box_trace_get_items(box_trace_reader *reader, box_trace_op op, unsigned int item_count);
+
+
+/* The implementation: */
+
+
+static unsigned long long box_trace_now(void)
+{
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+}
+
+
+static bool box_trace_flush(box_trace *trace)
+{
+
+    if (!trace->failed && (trace->size > 0) && (fwrite(trace->buffer, 1, trace->size, trace->file) != trace->size)) {
+
+        trace->failed = true;
+    }
+
+    trace->stats.bytes += trace->failed ? 0 : trace->size;
+    trace->size = 0;
+
+    return !trace->failed;
+}
+
+
+static bool box_trace_reserve(box_trace *trace)
+{
+
+    if (trace->failed) {
+
+        return false;
+    }
+
+    if (trace->size + BOX_TRACE_MAX_RECORD > BOX_TRACE_BUFFER_SIZE) {
+
+        return box_trace_flush(trace);
+    }
+
+    return true;
+}
+
+
+static void box_trace_put(box_trace *trace, unsigned long long val)
+{
+
+    trace->size += box_file_put_varint(trace->buffer + trace->size, val);
+}
+
+
+box_trace* box_trace_create(const char *path, const box_snapshot_record *records, unsigned int record_count)
+{
+
+    box_trace *trace = calloc(sizeof(box_trace), 1);
+    box_trace_header header;
+    struct timespec now;
+    box_dim side_square = 0;
+    unsigned int i = 0;
+
+    if (trace == NULL) {
+
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    memset(&header, 0, sizeof(box_trace_header));
+
+    header.magic = BOX_TRACE_MAGIC;
+    header.version = BOX_TRACE_VERSION;
+    header.dim_size = sizeof(box_dim);
+    header.started = (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+    header.record_count = record_count;
+
+    trace->buffer = malloc(BOX_TRACE_BUFFER_SIZE);
+    trace->file = fopen(path, "wb");
+
+    if ((trace->buffer == NULL) || (trace->file == NULL) || (fwrite(&header, sizeof(box_trace_header), 1, trace->file) != 1)) {
+
+        trace->failed = true;
+        box_trace_close(trace);
+
+        return NULL;
+    }
+
+    trace->stats.bytes = sizeof(box_trace_header);
+
+    for (i = 0; i < record_count; ++i) {
+
+        if (!box_trace_reserve(trace)) {
+
+            box_trace_close(trace);
+            return NULL;
+        }
+
+        box_trace_put(trace, records[i].side_square - side_square);
+        box_trace_put(trace, records[i].height);
+        box_trace_put(trace, records[i].count);
+
+        side_square = records[i].side_square;
+    }
+
+    trace->started = box_trace_now();			/* The calls are timed from here. */
+
+    return trace;
+}
+
+
+bool box_trace_close(box_trace *trace)
+{
+
+    bool written = box_trace_flush(trace);
+
+    if (trace->file != NULL) {
+
+        written = (fclose(trace->file) == 0) && written;
+    }
+
+    free(trace->buffer);
+    free(trace);
+
+    return written;
+}
+
+
+void box_trace_begin(box_trace *trace, box_trace_record *record, box_trace_op op, box_dim side, box_dim height)
+{
+
+    memset(record, 0, sizeof(box_trace_record));
+
+    record->op = op;
+    record->side = side;
+    record->height = height;
+    record->time = box_trace_now() - trace->started;
+}
+
+
+void box_trace_write(box_trace *trace, box_trace_record *record)
+{
+
+    record->duration = box_trace_now() - trace->started - record->time;
+
+    if (!box_trace_reserve(trace)) {
+
+        return;
+    }
+
+    trace->buffer[trace->size++] = (unsigned char) (record->op | (record->result ? BOX_TRACE_RESULT : 0));
+
+    box_trace_put(trace, (record->time > trace->last) ? record->time - trace->last : 0);
+    box_trace_put(trace, record->duration);
+
+    trace->last = (record->time > trace->last) ? record->time : trace->last;
+    trace->stats.calls++;
+
+    if (record->op == BOX_TRACE_ASSIGN) {
+
+        box_trace_put(trace, record->item_count);
+        box_trace_put(trace, record->value);
+
+        return;
+    }
+
+    box_trace_put(trace, record->side);
+    box_trace_put(trace, record->height);
+
+    switch (record->op) {
+
+        case BOX_TRACE_TOP_K:
+
+            box_trace_put(trace, record->k);
+            box_trace_put(trace, record->item_count);
+            break;
+
+        case BOX_TRACE_SET_PRICE:
+
+            memcpy(trace->buffer + trace->size, &(record->price), sizeof(double));
+            trace->size += sizeof(double);
+            break;
+
+        case BOX_TRACE_GET:
+        case BOX_TRACE_GET_APPROX:
+        case BOX_TRACE_CHEAPEST:
+
+            if (record->result) {
+
+                box_trace_put(trace, record->found_side_square);
+                box_trace_put(trace, record->found_height);
+
+                if (record->op == BOX_TRACE_CHEAPEST) {
+
+                    memcpy(trace->buffer + trace->size, &(record->price), sizeof(double));
+                    trace->size += sizeof(double);
+                }
+            }
+
+            break;
+
+        case BOX_TRACE_COUNT_SUITABLE:
+        case BOX_TRACE_COUNT_SIDES:
+
+            box_trace_put(trace, record->value);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void box_trace_write_item(box_trace *trace, box_trace_op op, const box_trace_item *item)
+{
+
+    if (!box_trace_reserve(trace)) {
+
+        return;
+    }
+
+    box_trace_put(trace, item->side);
+    box_trace_put(trace, item->height);
+    box_trace_put(trace, item->count);
+
+    if ((op == BOX_TRACE_ASSIGN) && (item->count > 0)) {
+
+        box_trace_put(trace, item->box_side_square);
+        box_trace_put(trace, item->box_height);
+    }
+}
+
+
+box_trace_reader* box_trace_open(const char *path)
+{
+
+    box_trace_reader *reader = calloc(sizeof(box_trace_reader), 1);
+    struct stat status;
+    box_dim side_square = 0;
+    unsigned long long side_delta = 0;
+    unsigned long long count = 0;
+    unsigned int i = 0;
+
+    if (reader == NULL) {
+
+        return NULL;
+    }
+
+    reader->file = fopen(path, "rb");
+    reader->buffer = malloc(BOX_TRACE_BUFFER_SIZE);
+
+    if ((reader->file == NULL) || (reader->buffer == NULL) || (fread(&(reader->header), sizeof(box_trace_header), 1, reader->file) != 1) ||
+        (fstat(fileno(reader->file), &status) != 0)) {
+
+        box_trace_reader_close(reader);
+        return NULL;
+    }
+
+    /* Every size of the inventory takes three bytes at least, so its number is checked against the size of the file before anyone allocates by it. */
+
+    reader->file_size = (unsigned long long) status.st_size;
+
+    if ((reader->header.magic != BOX_TRACE_MAGIC) || (reader->header.version != BOX_TRACE_VERSION) || (reader->header.dim_size != sizeof(box_dim)) ||
+        (reader->header.record_count > UINT_MAX) || (reader->header.record_count > reader->file_size / 3)) {
+
+        box_trace_reader_close(reader);
+        return NULL;
+    }
+
+    reader->record_count = (unsigned int) reader->header.record_count;
+    reader->records = calloc(sizeof(box_snapshot_record), (reader->record_count == 0) ? 1 : reader->record_count);
+
+    if (reader->records == NULL) {
+
+        box_trace_reader_close(reader);
+        return NULL;
+    }
+
+    /* The sizes must be in the order of the snapshot records. */
+
+    for (i = 0; i < reader->record_count; ++i) {
+
+        if (!box_trace_fill(reader) || !box_trace_get(reader, (box_dim) ~side_square, &side_delta) ||
+            !box_trace_get_dim(reader, &(reader->records[i].height)) || !box_trace_get(reader, UINT_MAX, &count) || (count == 0)) {
+
+            box_trace_reader_close(reader);
+            return NULL;
+        }
+
+        side_square += (box_dim) side_delta;
+
+        if ((i > 0) && (side_delta == 0) && (reader->records[i].height <= reader->records[i - 1].height)) {
+
+            box_trace_reader_close(reader);
+            return NULL;
+        }
+
+        reader->records[i].side_square = side_square;
+        reader->records[i].count = (unsigned int) count;
+    }
+
+    return reader;
+}
+
+
+static bool box_trace_fill(box_trace_reader *reader)
+{
+
+    size_t wanted = 0;
+
+    if (reader->end_of_file || (reader->size - reader->position >= BOX_TRACE_MAX_RECORD)) {
+
+        return true;
+    }
+
+    memmove(reader->buffer, reader->buffer + reader->position, reader->size - reader->position);
+    reader->size -= reader->position;
+    reader->position = 0;
+
+    wanted = BOX_TRACE_BUFFER_SIZE - reader->size;
+    reader->size += fread(reader->buffer + reader->size, 1, wanted, reader->file);
+
+    if (reader->size < BOX_TRACE_BUFFER_SIZE) {			/* fread returns less than it was asked for only at the end of the file or on an error. */
+
+        reader->end_of_file = true;
+    }
+
+    return !ferror(reader->file);
+}
+
+
+static bool box_trace_get(box_trace_reader *reader, unsigned long long max, unsigned long long *val)
+{
+
+    return box_file_get_varint(reader->buffer, reader->size, &(reader->position), val) && (*val <= max);
+}
+
+
+static bool box_trace_get_dim(box_trace_reader *reader, box_dim *val)
+{
+
+    unsigned long long decoded = 0;
+
+    if (!box_trace_get(reader, (box_dim) ~((box_dim) 0), &decoded)) {
+
+        return false;
+    }
+
+    *val = (box_dim) decoded;
+
+    return true;
+}
+
+
+static bool box_trace_get_price(box_trace_reader *reader, double *price)
+{
+
+    if (reader->size - reader->position < sizeof(double)) {
+
+        reader->position = reader->size;			/* Like a varint the bytes end in the middle of. */
+        return false;
+    }
+
+    memcpy(price, reader->buffer + reader->position, sizeof(double));
+    reader->position += sizeof(double);
+
+    return true;
+}
+
+
+static bool box_trace_get_items(box_trace_reader *reader, box_trace_op op, unsigned int item_count)
+{
+
+    box_trace_item *items = NULL;
+    box_trace_item *item = NULL;
+    unsigned long long count = 0;
+    unsigned int i = 0;
+
+    if (item_count > reader->item_capacity) {
+
+        items = realloc(reader->items, sizeof(box_trace_item) * item_count);
+
+        if (items == NULL) {
+
+            return false;
+        }
+
+        reader->items = items;
+        reader->item_capacity = item_count;
+    }
+
+    for (i = 0; i < item_count; ++i) {
+
+        item = &(reader->items[i]);
+
+        memset(item, 0, sizeof(box_trace_item));
+
+        if (!box_trace_fill(reader) || !box_trace_get_dim(reader, &(item->side)) || !box_trace_get_dim(reader, &(item->height)) ||
+            !box_trace_get(reader, (op == BOX_TRACE_ASSIGN) ? 1 : UINT_MAX, &count)) {
+
+            return false;
+        }
+
+        item->count = (unsigned int) count;
+
+        if ((op == BOX_TRACE_ASSIGN) && (count > 0) &&
+            (!box_trace_get_dim(reader, &(item->box_side_square)) || !box_trace_get_dim(reader, &(item->box_height)))) {
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool box_trace_next(box_trace_reader *reader, box_trace_record *record)
+{
+
+    unsigned long long time_delta = 0;
+    unsigned long long val = 0;
+    unsigned int op = 0;
+    bool decoded = true;
+
+    if (reader->failed || reader->cut) {
+
+        return false;
+    }
+
+    if (!box_trace_fill(reader)) {
+
+        reader->failed = true;
+        return false;
+    }
+
+    if (reader->position == reader->size) {			/* The end of the trace. */
+
+        return false;
+    }
+
+    memset(record, 0, sizeof(box_trace_record));
+
+    op = reader->buffer[reader->position++];
+    record->op = (box_trace_op) (op & BOX_TRACE_OP_MASK);
+    record->result = ((op & BOX_TRACE_RESULT) != 0);
+
+    decoded = (record->op >= BOX_TRACE_INSERT) && (record->op <= BOX_TRACE_COUNT_SIDES) && box_trace_get(reader, ~0ULL - reader->time, &time_delta) &&
+              box_trace_get(reader, ~0ULL, &(record->duration));
+
+    /* Every item takes three bytes at least, so their number is checked against the size of the file before anyone allocates by it. */
+
+    if (decoded && (record->op == BOX_TRACE_ASSIGN)) {
+
+        decoded = box_trace_get(reader, reader->file_size / 3, &val) && box_trace_get(reader, val, &(record->value));
+        record->item_count = (unsigned int) val;
+    }
+
+    else {
+
+        decoded = decoded && box_trace_get_dim(reader, &(record->side)) && box_trace_get_dim(reader, &(record->height));
+    }
+
+    switch (record->op) {
+
+        case BOX_TRACE_TOP_K:
+
+            decoded = decoded && box_trace_get(reader, UINT_MAX, &val);
+            record->k = (unsigned int) val;
+
+            decoded = decoded && box_trace_get(reader, (reader->file_size / 3 < record->k) ? reader->file_size / 3 : record->k, &val);
+            record->item_count = (unsigned int) val;
+            break;
+
+        case BOX_TRACE_SET_PRICE:
+
+            decoded = decoded && box_trace_get_price(reader, &(record->price));
+            break;
+
+        case BOX_TRACE_GET:
+        case BOX_TRACE_GET_APPROX:
+        case BOX_TRACE_CHEAPEST:
+
+            if (record->result) {
+
+                decoded = decoded && box_trace_get_dim(reader, &(record->found_side_square)) && box_trace_get_dim(reader, &(record->found_height));
+                decoded = decoded && ((record->op != BOX_TRACE_CHEAPEST) || box_trace_get_price(reader, &(record->price)));
+            }
+
+            break;
+
+        case BOX_TRACE_COUNT_SUITABLE:
+        case BOX_TRACE_COUNT_SIDES:
+
+            decoded = decoded && box_trace_get(reader, ~0ULL, &(record->value));
+            break;
+
+        default:
+            break;
+    }
+
+    decoded = decoded && (((record->op != BOX_TRACE_TOP_K) && (record->op != BOX_TRACE_ASSIGN)) ||
+                          box_trace_get_items(reader, record->op, record->item_count));
+
+    /* A record which the file ends in the middle of was left by a writer which didn't end its trace - the trace ends before it. */
+
+    if (!decoded) {
+
+        if (reader->end_of_file && !ferror(reader->file) && (reader->position >= reader->size)) {
+
+            reader->cut = true;
+        }
+
+        else {
+
+            reader->failed = true;
+        }
+
+        return false;
+    }
+
+    reader->time += time_delta;
+    reader->calls++;
+
+    record->time = reader->time;
+
+    return true;
+}
+
+
+void box_trace_reader_close(box_trace_reader *reader)
+{
+
+    if (reader->file != NULL) {
+
+        fclose(reader->file);
+    }
+
+    free(reader->buffer);
+    free(reader->records);
+    free(reader->items);
+    free(reader);
+}
@@ -0,0 +1,175 @@
+/* Box trace header file.
+ Contains the structures and functions' prototype declarations of the trace of a box factory - a compact file of the calls made to it, with their
+ arguments, their results and their times, so a problem seen with real traffic may be replayed against another build (tools/box_replay.c.)
+ The file is a header, followed by the inventory of the box factory when the trace began - the sizes of its boxes in the order of the snapshot
+ records: the difference of every (side * side) from the previous one, the height and the number of boxes, as varints (see box_file.h) - and then
+ by a record of every call, until the end of the file. A record is its operation byte (whose highest bit is the boolean result of the call), the time
+ from the previous call and the duration of the call in nanoseconds, and the arguments and the results of the operation as varints - a few bytes
+ for the usual dimensions. The answers of TOP_K and the presents of a batch assignment follow their record as items.
+ The records are written through a buffer, so a process which didn't end its trace may leave a record cut at the end of the file - the reader stops
+ before it. Only the calls on the boxes are traced - not the calls on the files of the box factory, nor its cost function (see
+ box_factory_set_cost_function.) The numbers are in the byte order of the machine, and the traces of the 32-bit and of the 64-bit build aren't
+ interchangeable (see box_types.h.) */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include "box_types.h"
+
+#include "box_snapshot.h"
+
+#ifndef BOX_TRACE_H_
+#define BOX_TRACE_H_
+
+
+#define BOX_TRACE_MAGIC 0x0045434152545842ULL			/* "BXTRACE" */
+
+#define BOX_TRACE_VERSION 1
+
+#define BOX_TRACE_BUFFER_SIZE 65536			/* The size of the buffer of the writer and of the reader. */
+
+#define BOX_TRACE_RESULT 0x80			/* The bit of the operation byte of a record which holds the result of the call. */
+
+
+typedef enum box_trace_op_e {			/* The call of a record - the function of the box factory it traces. */
+
+    BOX_TRACE_INSERT = 1,			/* box_factory_insert. */
+    BOX_TRACE_REMOVE = 2,			/* box_factory_remove. */
+    BOX_TRACE_GET = 3,			/* box_factory_get_box. */
+    BOX_TRACE_GET_APPROX = 4,			/* box_factory_get_box_approx. */
+    BOX_TRACE_CHECK = 5,			/* box_factory_check_box. */
+    BOX_TRACE_TOP_K = 6,			/* box_factory_get_top_k. */
+    BOX_TRACE_SET_PRICE = 7,			/* box_factory_set_price. */
+    BOX_TRACE_REMOVE_PRICE = 8,			/* box_factory_remove_price. */
+    BOX_TRACE_CHEAPEST = 9,			/* box_factory_get_cheapest. */
+    BOX_TRACE_ASSIGN = 10,			/* box_factory_assign_batch. */
+    BOX_TRACE_COUNT_SUITABLE = 11,			/* box_factory_count_suitable. */
+    BOX_TRACE_COUNT_SIDES = 12			/* box_factory_count_sides. */
+} box_trace_op;
+
+
+typedef struct box_trace_header_s {			/* The header of a trace file. */
+
+    unsigned long long magic;
+    unsigned int version;
+    unsigned int dim_size;			/* sizeof(box_dim) of the writer (see box_types.h.) */
+    unsigned long long started;			/* The wall-clock time the trace began, in nanoseconds since the epoch. */
+    unsigned long long record_count;			/* Number of the sizes of the inventory. */
+} box_trace_header;
+
+
+typedef struct box_trace_record_s {			/* A call of the trace. */
+
+    box_trace_op op;
+    unsigned long long time;			/* The start of the call, in nanoseconds from the start of the trace. */
+    unsigned long long duration;			/* Nanoseconds the call took. */
+    box_dim side;			/* The arguments - the dimensions of the present (min_side and max_side of COUNT_SIDES, unused by ASSIGN.) */
+    box_dim height;
+    unsigned int k;			/* TOP_K - the number of sizes asked for. */
+    unsigned int item_count;			/* TOP_K - the number of sizes of the answer, ASSIGN - the number of presents (see box_trace_item.) */
+    double price;			/* SET_PRICE - the price, CHEAPEST - the cost of the box found. */
+    bool result;			/* The boolean result of the call (FALSE for the calls which return a number.) */
+    unsigned long long value;			/* COUNT_SUITABLE and COUNT_SIDES - the number returned, ASSIGN - the presents left unassigned. */
+    box_dim found_side_square;			/* GET, GET_APPROX and CHEAPEST which found a box - the box. */
+    box_dim found_height;
+} box_trace_record;
+
+
+typedef struct box_trace_item_s {			/* A size of the answer of TOP_K, or a present of ASSIGN with its box. */
+
+    box_dim side;			/* TOP_K - (side * side) of the size, ASSIGN - the side of the present. */
+    box_dim height;
+    unsigned int count;			/* TOP_K - the number of boxes of the size, ASSIGN - 1 if a box was assigned to the present, 0 otherwise. */
+    box_dim box_side_square;			/* ASSIGN - the box assigned to the present. */
+    box_dim box_height;
+} box_trace_item;
+
+
+typedef struct box_trace_stats_s {			/* Counters of a trace since it began. */
+
+    unsigned long long calls;			/* Number of records written. */
+    unsigned long long bytes;			/* Number of bytes written, including the header and the inventory. */
+} box_trace_stats;
+
+
+typedef struct box_trace_s {			/* Box trace structure - a trace file open for writing. */
+
+    FILE *file;
+    unsigned char *buffer;			/* The records which weren't written to the file yet. */
+    size_t size;
+    unsigned long long started;			/* The monotonic time the trace began, in nanoseconds. */
+    unsigned long long last;			/* The time of the last record, from the start of the trace. */
+    bool failed;			/* TRUE once a write has failed - nothing is written from then on. */
+    box_trace_stats stats;
+} box_trace;
+
+
+typedef struct box_trace_reader_s {			/* Box trace reader structure - a trace file open for decoding. */
+
+    FILE *file;
+    box_trace_header header;
+    box_snapshot_record *records;			/* The inventory of the trace. */
+    unsigned int record_count;
+    unsigned long long file_size;
+    unsigned char *buffer;			/* The bytes read from the file, from position to size not decoded yet. */
+    size_t position;
+    size_t size;
+    bool end_of_file;
+    unsigned long long time;			/* The time of the last record decoded. */
+    box_trace_item *items;			/* The items of the last record decoded (item_count of the record.) */
+    unsigned int item_capacity;
+    unsigned long long calls;			/* Number of records decoded. */
+    bool cut;			/* TRUE if the file ended in the middle of a record. */
+    bool failed;			/* TRUE once the file was found invalid, or on an I/O error. */
+} box_trace_reader;
+
+
+/* Create a trace file of the given path (an existing file is replaced), which starts with the given records (sorted by (side * side) and then by
+ height, every size once) - the inventory of the box factory.
+ Returns NULL on an allocation error or an I/O error, otherwise returns a pointer to box_trace. */
+
+box_trace* box_trace_create(const char *path, const box_snapshot_record *records, unsigned int record_count);
+
+
+/* Write the records left in the buffer, close the file and free the trace. Returns FALSE if a write failed since the trace began, TRUE otherwise. */
+
+bool box_trace_close(box_trace *trace);
+
+
+/* Begin a record of a call of the given operation and arguments - zero the record and take the time of the start of the call. */
+
+void box_trace_begin(box_trace *trace, box_trace_record *record, box_trace_op op, box_dim side, box_dim height);
+
+
+/* Take the duration of the call of the record, whose results were set by the caller, and write the record. A record of TOP_K or of ASSIGN must be
+ followed by its item_count items (see box_trace_write_item.) Nothing is written once the trace has failed. */
+
+void box_trace_write(box_trace *trace, box_trace_record *record);
+
+
+/* Write an item of the last record of the given operation (TOP_K or ASSIGN.) */
+
+void box_trace_write_item(box_trace *trace, box_trace_op op, const box_trace_item *item);
+
+
+/* Open the trace file of the given path for decoding, and read its header and its inventory.
+ Returns NULL on an allocation error, an I/O error, or an invalid header or inventory, otherwise returns a pointer to box_trace_reader. */
+
+box_trace_reader* box_trace_open(const char *path);
+
+
+/* Decode the next record of the file into record - its items are in the items of the reader until the next record is decoded.
+ Returns FALSE at the end of the file, or if the rest of the file is a record cut at its end, or on an error - the fields cut and failed of the
+ reader tell them apart - TRUE otherwise. */
+
+bool box_trace_next(box_trace_reader *reader, box_trace_record *record);
+
+
+/* Close the file and free the reader. */
+
+void box_trace_reader_close(box_trace_reader *reader);
+
+
+#endif /* BOX_TRACE_H_ */
@@ -0,0 +1,54 @@
+/* Box types header file.
+ Contains the types of the dimensions and of the volumes of the boxes, which are chosen at compile time, so every module of the box factory is built
+ for a single width from the same source:
+ - By default a dimension (side, height, or side * side) is an unsigned int, and a volume - (side * side) * height - is an unsigned long long, so the
+   volume of any two dimensions is computed without an overflow by a single 64-bit multiplication.
+ - Defining BOX_FACTORY_64BIT (e.g. -DBOX_FACTORY_64BIT) makes the dimensions unsigned long long, and the volumes unsigned __int128.
+ Either way (side * side) must fit in a dimension, so a side is at most BOX_DIM_MAX_SIDE - 65535 in the default build, and 2^32 - 1 in the 64-bit one.
+ The box factory treats larger sides as the sides of no box: they can't be inserted, and no box is suitable for them.
+ A program is linked with a single width. Both could be linked side by side only if every external name of the modules got a suffix of its width
+ (e.g. by token pasting in a macro around every name) and the modules were compiled once for every width - the tree doesn't do that, so a program
+ which needs both widths runs the two builds as two processes.
+ The box index (box_index.h) is built of ordered sets of unsigned int values, so the 64-bit build has no box index: box_factory_create_with_options
+ refuses BOX_FACTORY_INDEX_VEB and BOX_FACTORY_INDEX_AUTO unless it is given a disk_path - so the van Emde Boas sets (veb_tree.h), the adaptive sets
+ (adaptive_set.h) and the dictionary of the box index (box_dictionary.h), which is kept only with a box index, are of the default build only. The
+ 64-bit build keeps its boxes in the red-black trees (with or without an arena) or in the disk-backed B+-tree. */
+
+
+#ifndef BOX_TYPES_H_
+#define BOX_TYPES_H_
+
+
+#ifdef BOX_FACTORY_64BIT
+
+typedef unsigned long long box_dim;
+
+typedef unsigned __int128 box_volume;
+
+#define BOX_DIM_BITS 64
+
+#define BOX_DIM_FORMAT "%llu"			/* printf / scanf conversion of a dimension. */
+
+#define BOX_DIM_BIT_LENGTH(val) (((val) == 0) ? 0 : 64 - __builtin_clzll(val))			/* Number of bits of the value, without the leading zeros. */
+
+#else
+
+typedef unsigned int box_dim;
+
+typedef unsigned long long box_volume;
+
+#define BOX_DIM_BITS 32
+
+#define BOX_DIM_FORMAT "%u"
+
+#define BOX_DIM_BIT_LENGTH(val) (((val) == 0) ? 0 : 32 - __builtin_clz(val))
+
+#endif
+
+
+#define BOX_SIDE_BITS (BOX_DIM_BITS / 2)			/* Number of bits of a side. */
+
+#define BOX_DIM_MAX_SIDE ((((box_dim) 1) << BOX_SIDE_BITS) - 1)			/* The largest side, whose square fits in a dimension. */
+
+
+#endif /* BOX_TYPES_H_ */
@@ -0,0 +1,599 @@
+/*
+ Box write-ahead log source file.
+ Here we implement the write-ahead log of a box factory - the encoding of its records, the group commit, and the replay of a log file.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* pread, ftruncate, fdatasync and strdup. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <errno.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "box_file.h"
+
+#include "box_wal.h"
+
+
+#define BOX_WAL_MIN_CAPACITY 4096			/* The size of the buffer of a new log. */
+
+#define BOX_WAL_COPY_SIZE 65536			/* The size of the buffer which box_wal_truncate copies the groups with. */
+
+
+/* Functions' prototype declarations: */
+
+
+/* Read exactly the given number of bytes of the file. Returns 1 if they were read, 0 if the file ended before them, and -1 on an I/O error. */
+
+static int box_wal_read(int fd, void *data, size_t size);
+
+
+/* Write all the given bytes to the file. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool box_wal_write(int fd, const void *data, size_t size);
+
+
+/* Compute the checksum of a frame - of its header (with a zeroed checksum field) and of its records. */
+
+static unsigned long long box_wal_frame_checksum(const box_wal_frame_header *frame, const unsigned char *records);
+
+
+/* Read the log file from its start. header would contain the header of the file - a file without a whole header is an empty log (valid would be
+ FALSE then.) end would contain the position right after the last whole and valid frame, and last_lsn the LSN of its last record (base_lsn of the file
+ if it has none.) If apply isn't NULL, it is called for every record whose LSN is larger than after_lsn.
+ Returns FALSE on an allocation error, an I/O error, an invalid file or record, or if apply failed, TRUE otherwise. */
+
+static bool box_wal_scan(int fd, unsigned long long after_lsn, box_wal_apply apply, void *context, box_wal_file_header *header, bool *valid,
+                         off_t *end, unsigned long long *last_lsn);
+
+
+/* Write the open group to the file as a frame, and sync the file if sync is TRUE. Nothing is written if the group is empty.
+ Returns FALSE on an I/O error (the log has failed then), TRUE otherwise. */
+
+static bool box_wal_write_group(box_wal *wal, bool sync);
+
+
+/* The implementation: */
+
+
+static int box_wal_read(int fd, void *data, size_t size)
+{
+
+    size_t done = 0;
+    ssize_t result = 0;
+
+    while (done < size) {
+
+        result = read(fd, (char *) data + done, size - done);
+
+        if (result < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            return -1;
+        }
+
+        if (result == 0) {
+
+            return 0;
+        }
+
+        done += (size_t) result;
+    }
+
+    return 1;
+}
+
+
+static bool box_wal_write(int fd, const void *data, size_t size)
+{
+
+    size_t done = 0;
+    ssize_t result = 0;
+
+    while (done < size) {
+
+        result = write(fd, (const char *) data + done, size - done);
+
+        if (result < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            return false;
+        }
+
+        done += (size_t) result;
+    }
+
+    return true;
+}
+
+
+static unsigned long long box_wal_frame_checksum(const box_wal_frame_header *frame, const unsigned char *records)
+{
+
+    box_wal_frame_header zeroed = *frame;
+
+    zeroed.checksum = 0;
+
+    return box_file_hash(box_file_hash(BOX_FILE_HASH_INIT, &zeroed, sizeof(box_wal_frame_header)), records, frame->size);
+}
+
+
+static bool box_wal_scan(int fd, unsigned long long after_lsn, box_wal_apply apply, void *context, box_wal_file_header *header, bool *valid,
+                         off_t *end, unsigned long long *last_lsn)
+{
+
+    box_wal_frame_header frame;
+    struct stat status;
+    unsigned char *records = NULL;
+    unsigned char *new_records = NULL;
+    size_t capacity = 0;
+    size_t position = 0;
+    unsigned long long op = 0;
+    unsigned long long side = 0;
+    unsigned long long height = 0;
+    unsigned long long count = 0;
+    unsigned long long lsn = 0;
+    unsigned int i = 0;
+    int result = 0;
+    bool scanned = true;
+
+    *valid = false;
+    *end = 0;
+    *last_lsn = after_lsn;
+
+    if ((fstat(fd, &status) != 0) || (lseek(fd, 0, SEEK_SET) < 0)) {
+
+        return false;
+    }
+
+    result = box_wal_read(fd, header, sizeof(box_wal_file_header));
+
+    if (result <= 0) {			/* A crash before the header was synced leaves a log without records. */
+
+        return (result == 0);
+    }
+
+    if ((header->magic != BOX_WAL_MAGIC) || (header->version != BOX_WAL_VERSION) || (header->dim_size != sizeof(box_dim))) {
+
+        return false;
+    }
+
+    if ((apply != NULL) && (header->base_lsn > after_lsn)) {			/* The records right after the snapshot were cut off the log. */
+
+        return false;
+    }
+
+    *valid = true;
+    *end = sizeof(box_wal_file_header);
+    *last_lsn = header->base_lsn;
+
+    /* Read the frames up to the first one which is cut or corrupted - the end of the log. */
+
+    while (scanned) {
+
+        if ((result = box_wal_read(fd, &frame, sizeof(box_wal_frame_header))) <= 0) {
+
+            scanned = (result == 0);
+            break;
+        }
+
+        /* A header which is corrupted may have any size - the records are read only if they are within the file. */
+
+        if ((frame.record_count == 0) || (frame.size > (size_t) frame.record_count * BOX_WAL_MAX_RECORD) || (frame.first_lsn <= *last_lsn) ||
+            (frame.size > status.st_size - *end - (off_t) sizeof(box_wal_frame_header))) {
+
+            break;
+        }
+
+        if (capacity < frame.size) {
+
+            new_records = realloc(records, frame.size);
+
+            if (new_records == NULL) {
+
+                scanned = false;
+                break;
+            }
+
+            records = new_records;
+            capacity = frame.size;
+        }
+
+        if ((result = box_wal_read(fd, records, frame.size)) <= 0) {
+
+            scanned = (result == 0);
+            break;
+        }
+
+        if (box_wal_frame_checksum(&frame, records) != frame.checksum) {
+
+            break;
+        }
+
+        /* The frame is whole - a record which can't be decoded now was written so, and the file is invalid. */
+
+        for (i = 0, position = 0; (i < frame.record_count) && scanned; ++i) {
+
+            scanned = (position < frame.size) && box_file_get_varint(records, frame.size, &position, &op) &&
+                      box_file_get_varint(records, frame.size, &position, &side) && box_file_get_varint(records, frame.size, &position, &height) &&
+                      box_file_get_varint(records, frame.size, &position, &count) && ((op == BOX_WAL_INSERT) || (op == BOX_WAL_REMOVE)) &&
+                      ((box_dim) side == side) && ((box_dim) height == height) && ((unsigned int) count == count);
+
+            lsn = frame.first_lsn + i;
+
+            if (scanned && (apply != NULL) && (lsn > after_lsn)) {
+
+                scanned = apply(context, (box_wal_op) op, (box_dim) side, (box_dim) height, (unsigned int) count);
+            }
+        }
+
+        if (scanned) {
+
+            *end += (off_t) (sizeof(box_wal_frame_header) + frame.size);
+            *last_lsn = frame.first_lsn + frame.record_count - 1;
+        }
+    }
+
+    free(records);
+
+    return scanned;
+}
+
+
+box_wal* box_wal_open(const char *path, box_wal_sync sync, unsigned int group_size, unsigned long long after_lsn)
+{
+
+    box_wal *wal = NULL;
+    box_wal_file_header header;
+    struct stat status;
+    unsigned long long last_lsn = 0;
+    off_t end = 0;
+    bool valid = false;
+    bool opened = false;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0) {
+
+        return NULL;
+    }
+
+    opened = (fstat(fd, &status) == 0) && box_wal_scan(fd, after_lsn, NULL, NULL, &header, &valid, &end, &last_lsn);
+
+    if (opened && !valid) {			/* A new log - write its header, and make the file durable before any record. */
+
+        memset(&header, 0, sizeof(box_wal_file_header));
+
+        header.magic = BOX_WAL_MAGIC;
+        header.version = BOX_WAL_VERSION;
+        header.dim_size = sizeof(box_dim);
+        header.base_lsn = after_lsn;
+
+        end = sizeof(box_wal_file_header);
+        last_lsn = after_lsn;
+
+        opened = (ftruncate(fd, 0) == 0) && (lseek(fd, 0, SEEK_SET) == 0) && box_wal_write(fd, &header, sizeof(box_wal_file_header)) &&
+                 (fsync(fd) == 0) && box_file_sync_directory(path);
+    }
+
+    else {
+
+        /* Cut off the frame which a crash has left in the middle of its write, so the next frames follow the last valid one. */
+
+        opened = opened && ((end == status.st_size) || ((ftruncate(fd, end) == 0) && (fsync(fd) == 0)));
+    }
+
+    opened = opened && (lseek(fd, end, SEEK_SET) == end);
+
+    if (opened) {
+
+        wal = calloc(sizeof(box_wal), 1);
+    }
+
+    if (wal != NULL) {
+
+        wal->buffer = malloc(BOX_WAL_MIN_CAPACITY);
+        wal->path = strdup(path);
+    }
+
+    if ((wal == NULL) || (wal->buffer == NULL) || (wal->path == NULL)) {
+
+        if (wal != NULL) {
+
+            free(wal->buffer);
+            free(wal->path);
+            free(wal);
+        }
+
+        close(fd);
+
+        return NULL;
+    }
+
+    wal->fd = fd;
+    wal->sync = sync;
+    wal->group_size = (group_size == 0) ? 1 : group_size;
+    wal->capacity = BOX_WAL_MIN_CAPACITY;
+    wal->size = sizeof(box_wal_frame_header);			/* Room for the header of the open group. */
+    wal->next_lsn = ((last_lsn > after_lsn) ? last_lsn : after_lsn) + 1;
+    wal->durable_lsn = wal->next_lsn - 1;
+    wal->end = (unsigned long long) end;
+
+    return wal;
+}
+
+
+bool box_wal_close(box_wal *wal)
+{
+
+    bool closed = box_wal_flush(wal);
+
+    closed = (close(wal->fd) == 0) && closed;
+
+    free(wal->buffer);
+    free(wal->path);
+    free(wal);
+
+    return closed;
+}
+
+
+bool box_wal_reserve(box_wal *wal, unsigned int records)
+{
+
+    size_t needed = wal->size + (size_t) records * BOX_WAL_MAX_RECORD;
+    size_t capacity = wal->capacity;
+    unsigned char *buffer = NULL;
+
+    if (wal->failed) {
+
+        return false;
+    }
+
+    if (needed <= wal->capacity) {
+
+        return true;
+    }
+
+    while (capacity < needed) {
+
+        capacity *= 2;
+    }
+
+    buffer = realloc(wal->buffer, capacity);
+
+    if (buffer == NULL) {
+
+        return false;
+    }
+
+    wal->buffer = buffer;
+    wal->capacity = capacity;
+
+    return true;
+}
+
+
+bool box_wal_append(box_wal *wal, box_wal_op op, box_dim side, box_dim height, unsigned int count)
+{
+
+    if (!box_wal_reserve(wal, 1)) {
+
+        return false;
+    }
+
+    wal->last_record = wal->size;
+    wal->buffer[wal->size++] = (unsigned char) op;
+
+    wal->size += box_file_put_varint(wal->buffer + wal->size, side);
+    wal->size += box_file_put_varint(wal->buffer + wal->size, height);
+    wal->size += box_file_put_varint(wal->buffer + wal->size, count);
+
+    wal->pending++;
+    wal->next_lsn++;
+    wal->stats.records++;
+
+    return true;
+}
+
+
+void box_wal_cancel(box_wal *wal)
+{
+
+    wal->size = wal->last_record;
+    wal->pending--;
+    wal->next_lsn--;
+    wal->stats.records--;
+}
+
+
+static bool box_wal_write_group(box_wal *wal, bool sync)
+{
+
+    box_wal_frame_header *frame = (box_wal_frame_header *) wal->buffer;
+
+    if (wal->failed) {
+
+        return false;
+    }
+
+    if (wal->pending == 0) {
+
+        return true;
+    }
+
+    frame->size = (unsigned int) (wal->size - sizeof(box_wal_frame_header));
+    frame->record_count = wal->pending;
+    frame->first_lsn = wal->next_lsn - wal->pending;
+    frame->checksum = box_wal_frame_checksum(frame, wal->buffer + sizeof(box_wal_frame_header));
+
+    if (!box_wal_write(wal->fd, wal->buffer, wal->size) || (sync && (fdatasync(wal->fd) != 0))) {
+
+        wal->failed = true;			/* The records of the group may be on the disk or not - the log can't go on. */
+        return false;
+    }
+
+    wal->stats.groups++;
+    wal->stats.syncs += sync ? 1 : 0;
+    wal->stats.bytes += wal->size;
+
+    wal->durable_lsn = wal->next_lsn - 1;
+    wal->end += wal->size;
+    wal->size = sizeof(box_wal_frame_header);
+    wal->pending = 0;
+
+    return true;
+}
+
+
+bool box_wal_commit(box_wal *wal)
+{
+
+    if (wal->sync == BOX_WAL_SYNC_ALWAYS) {
+
+        return box_wal_write_group(wal, true);
+    }
+
+    if (wal->pending < wal->group_size) {			/* The group isn't full yet. */
+
+        return !wal->failed;
+    }
+
+    return box_wal_write_group(wal, wal->sync == BOX_WAL_SYNC_GROUP);
+}
+
+
+bool box_wal_flush(box_wal *wal)
+{
+
+    return box_wal_write_group(wal, wal->sync != BOX_WAL_SYNC_NONE);
+}
+
+
+bool box_wal_truncate(box_wal *wal, unsigned long long lsn, unsigned long long offset)
+{
+
+    box_wal_file_header header;
+    unsigned char *copy = NULL;
+    char *temporary_path = NULL;
+    unsigned long long position = offset;
+    ssize_t result = 0;
+    bool written = false;
+    int fd = -1;
+
+    if (wal->failed || (offset < sizeof(box_wal_file_header)) || (offset > wal->end)) {
+
+        return false;
+    }
+
+    memset(&header, 0, sizeof(box_wal_file_header));
+
+    header.magic = BOX_WAL_MAGIC;
+    header.version = BOX_WAL_VERSION;
+    header.dim_size = sizeof(box_dim);
+    header.base_lsn = lsn;
+
+    copy = malloc(BOX_WAL_COPY_SIZE);
+    temporary_path = malloc(strlen(wal->path) + sizeof(".tmp"));
+
+    if ((copy != NULL) && (temporary_path != NULL)) {
+
+        strcpy(temporary_path, wal->path);
+        strcat(temporary_path, ".tmp");
+
+        fd = open(temporary_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+
+    /* Copy the groups which follow the offset - the records written since the snapshot was started. */
+
+    written = (fd >= 0) && box_wal_write(fd, &header, sizeof(box_wal_file_header));
+
+    while (written && (position < wal->end)) {
+
+        result = pread(wal->fd, copy, ((wal->end - position) < BOX_WAL_COPY_SIZE) ? (size_t) (wal->end - position) : BOX_WAL_COPY_SIZE, (off_t) position);
+
+        if ((result < 0) && (errno == EINTR)) {
+
+            continue;
+        }
+
+        written = (result > 0) && box_wal_write(fd, copy, (size_t) result);
+        position += (written ? (unsigned long long) result : 0);
+    }
+
+    written = written && (fsync(fd) == 0) && (rename(temporary_path, wal->path) == 0);
+
+    if (!written) {
+
+        if (fd >= 0) {
+
+            close(fd);
+            unlink(temporary_path);
+        }
+
+        free(copy);
+        free(temporary_path);
+
+        return false;
+    }
+
+    /* The log is the new file now - the next groups are appended to it. */
+
+    close(wal->fd);
+
+    wal->fd = fd;
+    wal->end = sizeof(box_wal_file_header) + (wal->end - offset);
+
+    free(copy);
+    free(temporary_path);
+
+    return (lseek(fd, 0, SEEK_END) == (off_t) wal->end) && box_file_sync_directory(wal->path);
+}
+
+
+bool box_wal_replay(const char *path, unsigned long long after_lsn, box_wal_apply apply, void *context, unsigned long long *last_lsn)
+{
+
+    box_wal_file_header header;
+    off_t end = 0;
+    bool valid = false;
+    bool replayed = false;
+    int fd = open(path, O_RDONLY);
+
+    *last_lsn = after_lsn;
+
+    if (fd < 0) {
+
+        return (errno == ENOENT);			/* A missing log has no records. */
+    }
+
+    replayed = box_wal_scan(fd, after_lsn, apply, context, &header, &valid, &end, last_lsn);
+
+    if (*last_lsn < after_lsn) {			/* The snapshot is newer than the whole log. */
+
+        *last_lsn = after_lsn;
+    }
+
+    close(fd);
+
+    return replayed;
+}
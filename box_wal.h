@@ -0,0 +1,156 @@
+/* Box write-ahead log header file.
+ Contains the structures and functions' prototype declarations of the write-ahead log of a box factory - an append-only file of its insertions and
+ removals, which are replayed on top of the latest snapshot (box_snapshot.h) after a crash.
+ Every record has a log sequence number (LSN) - the LSNs of the records of a log are increasing, and a snapshot holds the LSN of the last record it
+ includes, so the replay starts right after it. A record is compact: its operation byte and its side, height and number of boxes as varints - a few
+ bytes for the usual dimensions.
+ The records are written in groups (group commit): a group is a frame of a header - its size, number of records, first LSN and checksum - followed by
+ its records, written to the file by a single write() and made durable by a single fsync(). A crash in the middle of a write leaves a frame with a
+ wrong checksum or a short frame at the end of the file, which the replay ignores and box_wal_open cuts off.
+ The sync policy (box_wal_sync) chooses when a group is written: after every change (every change is durable when it returns), once a group has a
+ number of records, or only when the user asks for it (box_wal_flush) - so a user serving many clients may apply the changes of all of them, and make
+ them durable together by one fsync before it answers them. */
+
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include "box_types.h"
+
+#ifndef BOX_WAL_H_
+#define BOX_WAL_H_
+
+
+#define BOX_WAL_MAGIC 0x004C4157584F42ULL			/* "BOXWAL" */
+
+#define BOX_WAL_VERSION 1
+
+#define BOX_WAL_MAX_RECORD (1 + 3 * 10)			/* The largest record - its operation byte and three varints of at most 10 bytes. */
+
+
+typedef enum box_wal_op_e {			/* The operation of a record. */
+
+    BOX_WAL_INSERT = 1,			/* Insert the given number of boxes of the given dimensions. */
+    BOX_WAL_REMOVE = 2			/* Remove the given number of boxes of the given dimensions. */
+} box_wal_op;
+
+
+typedef enum box_wal_sync_e {			/* When the records are written and synced. */
+
+    BOX_WAL_SYNC_ALWAYS = 0,			/* Every change is written and synced before it returns (a group of its own.) */
+    BOX_WAL_SYNC_GROUP = 1,			/* The records are written and synced once there are group_size of them, or by box_wal_flush. */
+    BOX_WAL_SYNC_NONE = 2			/* Like BOX_WAL_SYNC_GROUP, but the groups are only written - syncing them is left to the operating system. */
+} box_wal_sync;
+
+
+typedef struct box_wal_file_header_s {			/* The header of a log file. */
+
+    unsigned long long magic;
+    unsigned int version;
+    unsigned int dim_size;			/* sizeof(box_dim) of the writer (see box_types.h.) */
+    unsigned long long base_lsn;			/* The records of the file follow this LSN - a snapshot older than it can't be brought up to date. */
+} box_wal_file_header;
+
+
+typedef struct box_wal_frame_header_s {			/* The header of a group of records. */
+
+    unsigned int size;			/* Number of bytes of the records which follow the header. */
+    unsigned int record_count;
+    unsigned long long first_lsn;			/* The LSN of the first record - the LSN of every following record is larger by one. */
+    unsigned long long checksum;			/* FNV-1a of the header, computed with this field zeroed, and of the records. */
+} box_wal_frame_header;
+
+
+typedef struct box_wal_stats_s {			/* Counters of a log since it was opened. */
+
+    unsigned long long records;			/* Number of records appended. */
+    unsigned long long groups;			/* Number of groups written. */
+    unsigned long long syncs;			/* Number of fsync() calls. */
+    unsigned long long bytes;			/* Number of bytes written. */
+} box_wal_stats;
+
+
+typedef struct box_wal_s {			/* Box write-ahead log structure - a log file open for appending. */
+
+    int fd;
+    char *path;
+    box_wal_sync sync;
+    unsigned int group_size;			/* The records of a group, for BOX_WAL_SYNC_GROUP and BOX_WAL_SYNC_NONE. */
+    unsigned char *buffer;			/* The open group - a frame header followed by its records, which weren't written yet. */
+    size_t size;
+    size_t capacity;
+    size_t last_record;			/* The position of the last record of the open group (for box_wal_cancel.) */
+    unsigned int pending;			/* Number of records of the open group. */
+    unsigned long long next_lsn;			/* The LSN of the next record. */
+    unsigned long long durable_lsn;			/* The LSN of the last record written (and synced, unless the policy is BOX_WAL_SYNC_NONE.) */
+    unsigned long long end;			/* The size of the file - the end of the last group written. */
+    bool failed;			/* TRUE once a write or a sync has failed - the log refuses new records then. */
+    box_wal_stats stats;
+} box_wal;
+
+
+/* The function box_wal_replay calls for every record - apply the given number of boxes of the operation. Returns FALSE if it failed (which stops the
+ replay), TRUE otherwise. */
+
+typedef bool (*box_wal_apply)(void *context, box_wal_op op, box_dim side, box_dim height, unsigned int count);
+
+
+/* Open the log file of the given path for appending, or create it. The frames which are cut or corrupted at the end of the file (by a crash in the
+ middle of a write) are cut off. The next record gets an LSN larger than the LSNs of the file and than after_lsn (the LSN of the snapshot the log
+ follows), and a new file starts after after_lsn.
+ Returns NULL on an allocation error, an I/O error or an invalid file, otherwise returns a pointer to box_wal. */
+
+box_wal* box_wal_open(const char *path, box_wal_sync sync, unsigned int group_size, unsigned long long after_lsn);
+
+
+/* Write the open group, close the log file and free the log. Returns FALSE if the group couldn't be written, TRUE otherwise. */
+
+bool box_wal_close(box_wal *wal);
+
+
+/* Make sure the open group has room for the given number of records, so appending them can't fail on an allocation error.
+ Returns FALSE on an allocation error, or if the log has failed, TRUE otherwise. */
+
+bool box_wal_reserve(box_wal *wal, unsigned int records);
+
+
+/* Append a record to the open group - it isn't written until box_wal_commit or box_wal_flush.
+ Returns FALSE on an allocation error, or if the log has failed, TRUE otherwise. */
+
+bool box_wal_append(box_wal *wal, box_wal_op op, box_dim side, box_dim height, unsigned int count);
+
+
+/* Drop the last appended record from the open group - for a change which failed after its record was appended. */
+
+void box_wal_cancel(box_wal *wal);
+
+
+/* End a change - write the open group if the sync policy says so (see box_wal_sync.) Returns FALSE on an I/O error, TRUE otherwise. */
+
+bool box_wal_commit(box_wal *wal);
+
+
+/* Write the open group now, and sync it unless the policy is BOX_WAL_SYNC_NONE. Returns FALSE on an I/O error, TRUE otherwise. */
+
+bool box_wal_flush(box_wal *wal);
+
+
+/* Drop the records of the log up to the given LSN, once a snapshot includes them - the log file is replaced by a file which starts after that LSN,
+ with the groups of the file from the given offset on (offset must be the end of the file when the given LSN was the last record written - see
+ box_wal_flush.) The new file is written under a temporary name, synced and renamed over the log, so a crash leaves either the whole log or the new
+ one. The open group isn't affected.
+ Returns FALSE on an allocation error or an I/O error (the log is left whole then, and goes on), TRUE otherwise. */
+
+bool box_wal_truncate(box_wal *wal, unsigned long long lsn, unsigned long long offset);
+
+
+/* Replay the log file of the given path - call apply for every record whose LSN is larger than after_lsn, in order. last_lsn would contain the LSN of
+ the last record of the file (after_lsn if there's none.) The frames which are cut or corrupted at the end of the file are ignored.
+ Returns FALSE on an allocation error, an I/O error, an invalid file, a file which starts after after_lsn (a gap after the snapshot), or if apply
+ failed, TRUE otherwise. */
+
+bool box_wal_replay(const char *path, unsigned long long after_lsn, box_wal_apply apply, void *context, unsigned long long *last_lsn);
+
+
+#endif /* BOX_WAL_H_ */
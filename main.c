@@ -1,17 +1,87 @@
+#define _POSIX_C_SOURCE 200809L			/* sigaction. */
+
 #include <stdio.h>
 
 #include <stdbool.h>
 
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <signal.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
 #include "box_factory.h"
 
 #include "box_menu.h"
 
+#include "box_batch.h"
+
 #include "menu.h"
 
+#ifndef BOX_FACTORY_PORTABLE
+
+#include "box_server.h"
+
+
+#define SERVER_WAL_GROUP_SIZE 4096			/* The group size of the log of --serve - a bound, since every round of the server syncs its group anyway. */
+
+
+static box_server *running_server = NULL;			/* The server of --serve, for the signal handler. */
+
+#endif
+
+
+/* Run the batch mode (see box_batch.h) on the commands of the given file, or of stdin if it's NULL. */
 
-int main(void)
+static int run_batch(const char *path);
+
+
+/* Serve a box factory on the Unix domain socket of the given path (see box_server.h) until SIGINT or SIGTERM. With a write-ahead log (wal_path
+ isn't NULL), the box factory is recovered from the snapshot and the log first, and every round of the server is a group commit of the log. With a
+ shared name, the boxes are published in a shared-memory segment of that name too (see box_factory_share), for readers which query them directly.
+ The portable build (BOX_FACTORY_PORTABLE, see box_factory.h) has no server - it only reports so. */
+
+static int run_server(const char *path, const char *snapshot_path, const char *wal_path, const char *shared_name);
+
+
+/* Begin a trace of the given box factory (see box_factory_trace_begin) in the file named by the environment variable BOX_TRACE, if it's set.
+ Returns FALSE if the trace couldn't begin, TRUE otherwise. */
+
+static bool start_trace(box_factory *factory);
+
+
+#ifndef BOX_FACTORY_PORTABLE
+
+/* The handler of SIGINT and SIGTERM of --serve. */
+
+static void stop_server(int signal_number);
+
+#endif
+
+
+/* Usage: without arguments - the interactive menu. With --batch [file] - the batch mode, reading the commands from the file, or from stdin without
+ one. With --serve socket [snapshot wal [shared]] - the server mode. In every mode, BOX_TRACE=path in the environment traces the calls of the box
+ factory to that file, for tools/box_replay.c. */
+
+int main(int argc, char *argv[])
 {
-    box_factory *factory = box_factory_create();
+    box_factory *factory = NULL;
+
+    if ((argc > 1) && (strcmp(argv[1], "--batch") == 0)) {
+
+        return run_batch((argc > 2) ? argv[2] : NULL);
+    }
+
+    if ((argc > 2) && (strcmp(argv[1], "--serve") == 0)) {
+
+        return run_server(argv[2], (argc > 4) ? argv[3] : NULL, (argc > 4) ? argv[4] : NULL, (argc > 5) ? argv[5] : NULL);
+    }
+
+    factory = box_factory_create();
 
     if (factory == NULL) {
 
@@ -19,6 +89,12 @@ int main(void)
             return -1;
     }
 
+    if (!start_trace(factory)) {
+
+        box_factory_destroy(factory);
+        return -1;
+    }
+
     menu_item menu_items[] = {{box_menu_insert, "Insert a box of the given dimensions", factory},
                               {box_menu_remove, "Remove a box of the given dimensions", factory},
                               {box_menu_get, "Get the dimensions of a suitable box with minimal volume", factory},
@@ -27,8 +103,169 @@ int main(void)
 
     menu_run(menu_items, sizeof(menu_items) / sizeof(menu_item));
 
+    box_factory_destroy(factory);
+
     return 0;
 }
 
 
+static int run_batch(const char *path)
+{
+    box_factory *factory = NULL;
+    int input = STDIN_FILENO;
+    bool succeeded = true;
+
+    if (path != NULL) {
+
+        input = open(path, O_RDONLY);
+
+        if (input < 0) {
+
+            printf("Error: Unable to open %s\n", path);
+            return -1;
+        }
+    }
+
+    factory = box_factory_create();
+
+    if (factory == NULL) {
+
+        printf("Error: Unable to create a box factory instance\n");
+
+        if (input != STDIN_FILENO) {
+
+            close(input);
+        }
+
+        return -1;
+    }
+
+    succeeded = start_trace(factory) && box_batch_run(factory, input, STDOUT_FILENO);
+
+    if (input != STDIN_FILENO) {
+
+        close(input);
+    }
+
+    box_factory_destroy(factory);
+
+    return succeeded ? 0 : -1;
+}
+
+
+static bool start_trace(box_factory *factory)
+{
+    const char *path = getenv("BOX_TRACE");
+
+    if ((path != NULL) && (path[0] != '\0') && !box_factory_trace_begin(factory, path)) {
+
+        printf("Error: Unable to trace to %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+
+#ifdef BOX_FACTORY_PORTABLE
+
+static int run_server(const char *path, const char *snapshot_path, const char *wal_path, const char *shared_name)
+{
+    (void) path;
+    (void) snapshot_path;
+    (void) wal_path;
+    (void) shared_name;
+
+    printf("Error: The server isn't part of the portable build\n");
+    return -1;
+}
+
+#else
+
+static void stop_server(int signal_number)
+{
+    (void) signal_number;
+
+    if (running_server != NULL) {
+
+        box_server_stop(running_server);
+    }
+}
+
+
+static int run_server(const char *path, const char *snapshot_path, const char *wal_path, const char *shared_name)
+{
+    struct sigaction action;
+    box_factory *factory = NULL;
+    bool succeeded = true;
+
+    if (wal_path != NULL) {
+
+        factory = box_factory_recover(snapshot_path, wal_path, NULL, BOX_WAL_SYNC_GROUP, SERVER_WAL_GROUP_SIZE);
+    }
+
+    else {
+
+        factory = box_factory_create();
+    }
+
+    if (factory == NULL) {
+
+        printf("Error: Unable to create a box factory instance\n");
+        return -1;
+    }
+
+    if (!start_trace(factory)) {
+
+        box_factory_destroy(factory);
+        return -1;
+    }
+
+    if ((shared_name != NULL) && !box_factory_share(factory, shared_name)) {
+
+        printf("Error: Unable to share the boxes as %s\n", shared_name);
+
+        box_factory_destroy(factory);
+        return -1;
+    }
+
+    running_server = box_server_create(factory, path);
+
+    if (running_server == NULL) {
+
+        printf("Error: Unable to listen on %s\n", path);
+
+        box_factory_destroy(factory);
+        return -1;
+    }
+
+    /* Without SA_RESTART, so the signal interrupts the wait of the event loop. */
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_server;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    succeeded = box_server_run(running_server);
+
+    printf("Served %llu requests of %llu connections in %llu rounds, with %llu group commits\n", running_server->stats.requests,
+           running_server->stats.connections, running_server->stats.rounds, running_server->stats.syncs);
+
+    box_server_destroy(running_server);
+    running_server = NULL;
+
+    /* A snapshot on shutdown, so the next start replays a short log. */
+
+    if ((snapshot_path != NULL) && !box_factory_save(factory, snapshot_path)) {
+
+        printf("Error: Unable to save %s\n", snapshot_path);
+        succeeded = false;
+    }
+
+    box_factory_destroy(factory);
+
+    return succeeded ? 0 : -1;
+}
 
+#endif
@@ -0,0 +1,65 @@
+/* Ordered set header file.
+ Contains the interface of the ordered sets of dimension values, which the box index (box_index.h) is built of.
+ An ordered set holds unsigned integer values with the same counted semantics as the red-black tree: a single entry for each unique value, which counts
+ the number of instances of the value. Every unique value also has a payload - a single pointer which the user may use (the box index keeps the
+ secondary set of a main set value there.)
+ Different implementations (veb_tree.h and so on) provide a table of functions of the type ordered_set_ops. */
+
+
+#include <stdbool.h>
+
+#ifndef ORDERED_SET_H_
+#define ORDERED_SET_H_
+
+
+typedef struct ordered_set_ops_s {			/* Table of the operations of an ordered set implementation. */
+
+    /* Create an empty set. Returns NULL on an allocation error. */
+
+    void* (*create)(void);
+
+    /* Free the set. The payloads of the values are not freed - it's the user's responsibility. */
+
+    void (*destroy)(void *set);
+
+    /* Add the given number of instances of val. 'exists' would be TRUE if val was already in the set (only its count was increased.)
+     Returns FALSE on an allocation error. */
+
+    bool (*insert)(void *set, unsigned int val, unsigned int count, bool *exists);
+
+    /* Remove an instance of val. 'deleted' would be TRUE if it was the last instance, and val was deleted from the set.
+     Returns FALSE if val is not in the set. */
+
+    bool (*remove)(void *set, unsigned int val, bool *deleted);
+
+    /* Return the number of instances of val (0 if val is not in the set.) */
+
+    unsigned int (*instances)(void *set, unsigned int val);
+
+    /* Return a pointer to the payload of val, NULL if val is not in the set. The pointer is valid until the next insertion or removal. */
+
+    void** (*payload)(void *set, unsigned int val);
+
+    /* Find the smallest value that is larger than or equal to val. Returns FALSE if there's no such value. */
+
+    bool (*lower_bound)(void *set, unsigned int val, unsigned int *found);
+
+    /* Find the smallest value that is larger than val. Returns FALSE if there's no such value. */
+
+    bool (*successor)(void *set, unsigned int val, unsigned int *found);
+
+    /* Find the largest value that is smaller than val. Returns FALSE if there's no such value. */
+
+    bool (*predecessor)(void *set, unsigned int val, unsigned int *found);
+
+    /* Find the maximum value of the set. Returns FALSE if the set is empty. */
+
+    bool (*max)(void *set, unsigned int *found);
+
+    /* Return the number of different (unique) values in the set. */
+
+    unsigned int (*size)(void *set);
+} ordered_set_ops;
+
+
+#endif /* ORDERED_SET_H_ */
@@ -24,6 +24,18 @@ static void rb_tree_rotate_left(rb_tree *tree, rb_tree_node *x);
 static void rb_tree_rotate_right(rb_tree *tree, rb_tree_node *x);
 
 
+/* Recompute the subtree size and total of the given node from its children. Called for the nodes whose subtrees have changed - by the rotations,
+ and for the path from the parent of a deleted node up to the root. */
+
+static void rb_tree_update_node(rb_tree_node *node);
+
+
+/* Count the keys of the tree which are smaller than the given key (or smaller than or equal to it, if inclusive is TRUE.)
+ unique would contain the number of unique keys, and instances the sum of their counts. We use this function in rb_tree_count_range. */
+
+static void rb_tree_count_below(rb_tree *tree, void *key, bool inclusive, unsigned int *unique, unsigned long long *instances);
+
+
 /* Helper function of rb_tree_insert. Based on the book's implementation. */
 
 static void rb_tree_insert_fixup(rb_tree *tree, rb_tree_node *z);
@@ -45,6 +57,28 @@ static void rb_tree_delete_fixup(rb_tree *tree, rb_tree_node *x);
 static rb_tree_node* rb_tree_search_exact_node(rb_tree *tree, rb_tree_node *node, void *key);
 
 
+/* Allocate a zeroed node - from the arena of the tree, if it has one. Returns NULL on an allocation error. */
+
+static rb_tree_node* rb_tree_alloc_node(rb_tree *tree);
+
+
+/* Free a node allocated by rb_tree_alloc_node. */
+
+static void rb_tree_free_node(rb_tree *tree, rb_tree_node *node);
+
+
+/* Free the nodes of the subtree rooted at the given node, calling free_key for their keys (if it isn't NULL.) We use this function in rb_tree_destroy. */
+
+static void rb_tree_destroy_node(rb_tree *tree, rb_tree_node *node, rb_tree_free_key free_key, void *context);
+
+
+/* Build a balanced subtree of the keys [low, high) of rb_tree_build_sorted, whose root is at the given depth - the nodes at red_depth are red, and the
+ others are black. Returns the root of the subtree (NIL for an empty range), or NULL on an allocation error (nothing is left allocated then.) */
+
+static rb_tree_node* rb_tree_build_node(rb_tree *tree, void **keys, const unsigned int *counts, unsigned int low, unsigned int high,
+                                        unsigned int depth, unsigned int red_depth);
+
+
 /* Search the tree for a node with the smallest key that is larger than or equal to the given key, starting from the given node.
  Returns a pointer to the node containing the key if found, NULL otherwise (if there's no node in the tree with the key that is larger than or equal
  to the given key.) We use this function in rb_tree_search_smallest_from. */
@@ -56,11 +90,20 @@ static rb_tree_node* rb_tree_search_smallest_from_node(rb_tree *tree, rb_tree_no
 
 
 rb_tree* rb_tree_create(rb_tree_compare cmp)
+{
+
+    return rb_tree_create_in_arena(cmp, NULL);
+}
+
+
+rb_tree* rb_tree_create_in_arena(rb_tree_compare cmp, arena *arena)
 {
 
 	rb_tree *red_black_tree = NULL;
 
-    red_black_tree = (rb_tree *)calloc(sizeof(rb_tree), 1);			/* Memory allocation for the tree. (Allocation for the rb_tree structure.) */
+    /* Memory allocation for the tree. (Allocation for the rb_tree structure.) */
+
+    red_black_tree = (arena == NULL) ? (rb_tree *)calloc(sizeof(rb_tree), 1) : (rb_tree *)arena_alloc(arena, sizeof(rb_tree));
 
     if (red_black_tree == NULL) {
 
@@ -79,11 +122,172 @@ rb_tree* rb_tree_create(rb_tree_compare cmp)
 
     red_black_tree->cmp = cmp;			/* Assigning an appropriate (given as a parameter) comparison function for the tree. (Function pointer) */
     red_black_tree->count = 0;
+    red_black_tree->arena = arena;
 
     return red_black_tree;
 }
 
 
+static rb_tree_node* rb_tree_alloc_node(rb_tree *tree)
+{
+
+    if (tree->arena != NULL) {
+
+        return arena_alloc(tree->arena, sizeof(rb_tree_node));
+    }
+
+    return calloc(sizeof(rb_tree_node), 1);
+}
+
+
+static void rb_tree_free_node(rb_tree *tree, rb_tree_node *node)
+{
+
+    if (tree->arena != NULL) {
+
+        arena_free(tree->arena, node, sizeof(rb_tree_node));
+    }
+
+    else {
+
+        free(node);
+    }
+}
+
+
+static void rb_tree_destroy_node(rb_tree *tree, rb_tree_node *node, rb_tree_free_key free_key, void *context)
+{
+
+    rb_tree_node *left = NULL;
+
+    /* Recurse into the left subtree only, and go on with the right one in a loop - the recursion depth is at most the height of the tree. */
+
+    while (!IS_NIL(tree, node)) {
+
+        left = node->left;
+
+        if (!IS_NIL(tree, left)) {
+
+            rb_tree_destroy_node(tree, left, free_key, context);
+        }
+
+        if (free_key != NULL) {
+
+            free_key(node->key, context);
+        }
+
+        left = node->right;			/* The node is freed - keep its right child. */
+
+        rb_tree_free_node(tree, node);
+
+        node = left;
+    }
+}
+
+
+void rb_tree_destroy(rb_tree *tree, rb_tree_free_key free_key, void *context)
+{
+
+    rb_tree_destroy_node(tree, tree->root, free_key, context);
+
+    if (tree->arena == NULL) {
+
+        free(tree);
+    }
+
+    else {
+
+        arena_free(tree->arena, tree, sizeof(rb_tree));
+    }
+}
+
+
+static rb_tree_node* rb_tree_build_node(rb_tree *tree, void **keys, const unsigned int *counts, unsigned int low, unsigned int high,
+                                        unsigned int depth, unsigned int red_depth)
+{
+
+    unsigned int middle = low + (high - low) / 2;
+    rb_tree_node *node = NULL;
+    rb_tree_node *left = NULL;
+    rb_tree_node *right = NULL;
+
+    if (low == high) {
+
+        return &(tree->nil);
+    }
+
+    left = rb_tree_build_node(tree, keys, counts, low, middle, depth + 1, red_depth);
+
+    if (left == NULL) {
+
+        return NULL;
+    }
+
+    node = rb_tree_alloc_node(tree);
+    right = (node == NULL) ? NULL : rb_tree_build_node(tree, keys, counts, middle + 1, high, depth + 1, red_depth);
+
+    if (right == NULL) {
+
+        rb_tree_destroy_node(tree, left, NULL, NULL);
+
+        if (node != NULL) {
+
+            rb_tree_free_node(tree, node);
+        }
+
+        return NULL;
+    }
+
+    node->key = keys[middle];
+    node->count = (counts == NULL) ? 1 : counts[middle];
+    node->color = (depth == red_depth) ? RED : BLACK;
+    node->left = left;
+    node->right = right;
+    node->parent = &(tree->nil);
+    left->parent = node;			/* Setting the parent of NIL is harmless - the deletion sets it anyway before it is used. */
+    right->parent = node;
+
+    rb_tree_update_node(node);
+
+    return node;
+}
+
+
+bool rb_tree_build_sorted(rb_tree *tree, void **keys, const unsigned int *counts, unsigned int n)
+{
+
+    unsigned int red_depth = 0;
+    rb_tree_node *root = NULL;
+
+    /* Splitting the keys at the middle puts every leaf at the deepest level, floor(log2(n)), or at the one above it. The nodes of the deepest level are
+     colored red, so every path from the root down has the same number of black nodes. A single node is the root, which is black. */
+
+    while ((2ULL << red_depth) <= n) {
+
+        red_depth++;
+    }
+
+    if (red_depth == 0) {
+
+        red_depth = 1;
+    }
+
+    root = rb_tree_build_node(tree, keys, counts, 0, n, 0, red_depth);
+
+    if (root == NULL) {
+
+        return false;
+    }
+
+    tree->root = root;
+    tree->nil.parent = &(tree->nil);
+    tree->count = n;
+    tree->max = rb_tree_max(tree);
+
+    return true;
+}
+
+
 rb_tree_node* rb_tree_successor(rb_tree *tree, rb_tree_node *node)
 {
 
@@ -134,6 +338,14 @@ rb_tree_node* rb_tree_max(rb_tree *tree)
 }
 
 
+static void rb_tree_update_node(rb_tree_node *node)
+{
+
+    node->size = node->left->size + node->right->size + 1;
+    node->total = node->left->total + node->right->total + node->count;
+}
+
+
 static void rb_tree_rotate_left(rb_tree *tree, rb_tree_node *x)
 {
 
@@ -168,6 +380,13 @@ static void rb_tree_rotate_left(rb_tree *tree, rb_tree_node *x)
 
     y->left = x;
     x->parent = y;
+
+    /* y takes the place of x, so its subtree is the former subtree of x. */
+
+    y->size = x->size;
+    y->total = x->total;
+
+    rb_tree_update_node(x);
 }
 
 
@@ -205,6 +424,11 @@ static void rb_tree_rotate_right(rb_tree *tree, rb_tree_node *x)
 
     y->right = x;
     x->parent = y;
+
+    y->size = x->size;
+    y->total = x->total;
+
+    rb_tree_update_node(x);
 }
 
 
@@ -226,13 +450,19 @@ bool rb_tree_insert(rb_tree *tree, void *key, bool *exists)
 
         *exists = true;
         x->count += 1;
+
+        for (; !IS_NIL(tree, x); x = x->parent) {			/* One more instance in the subtrees of the node and all its ancestors. */
+
+            x->total++;
+        }
+
         return true;
     }
 
     /* In case the key doesn't exist, we allocate a new node for the key and actually insert the node to the three.
      Based on the book's implementation. */
 
-    z = (rb_tree_node *)calloc(sizeof(rb_tree_node), 1);
+    z = rb_tree_alloc_node(tree);
 
     if (z == NULL) {
 
@@ -241,6 +471,8 @@ bool rb_tree_insert(rb_tree *tree, void *key, bool *exists)
 
     z->key = key;
     z->count = 1;			/* One new key was inserted. */
+    z->size = 1;
+    z->total = 1;
 
     y = &(tree->nil);
     x = tree->root;
@@ -248,6 +480,8 @@ bool rb_tree_insert(rb_tree *tree, void *key, bool *exists)
     while (!IS_NIL(tree, x)) {
 
         y = x;
+        y->size++;			/* The new node would be in the subtree of every node on the way down. */
+        y->total++;
 
         if (tree->cmp(z->key, x->key) < 0) {			/* If (z->key) < (x->key) */
 
@@ -380,6 +614,7 @@ static void rb_tree_delete(rb_tree *tree, rb_tree_node *z)
 
     rb_tree_node *y = NULL;
     rb_tree_node *x = NULL;
+    rb_tree_node *p = NULL;
 
     if (IS_NIL(tree, z->left) || IS_NIL(tree, z->right)) {
 
@@ -427,12 +662,19 @@ static void rb_tree_delete(rb_tree *tree, rb_tree_node *z)
         z->count = y->count;			/* Copy y's satellite data into z. */
     }
 
+    /* y was spliced out - fix the subtree sizes and totals of its former ancestors (z is one of them, if y != z), before the rotations of the fixup. */
+
+    for (p = y->parent; !IS_NIL(tree, p); p = p->parent) {
+
+        rb_tree_update_node(p);
+    }
+
     if (y->color == BLACK) {
 
         rb_tree_delete_fixup(tree, x);
     }
 
-    free(y);
+    rb_tree_free_node(tree, y);
 }
 
 
@@ -534,20 +776,33 @@ static void rb_tree_delete_fixup(rb_tree *tree, rb_tree_node *x)
 
 
 bool rb_tree_remove(rb_tree *tree, void *key, void **deleted)
+{
+
+    return rb_tree_remove_instances(tree, key, 1, deleted);
+}
+
+
+bool rb_tree_remove_instances(rb_tree *tree, void *key, unsigned int instances, void **deleted)
 {
 
 	*deleted = NULL;
 
-	/* First, search the tree for an exact given key. In case the key exists in the tree, we decrease it's count by 1. */
+	/* First, search the tree for an exact given key. In case the key exists in the tree, we decrease it's count by the given number of instances. */
 
     rb_tree_node *node = rb_tree_search_exact_node(tree, tree->root, key);
+    rb_tree_node *x = NULL;
 
-    if (node == NULL) {
+    if ((node == NULL) || (node->count < instances)) {
 
         return false;			/* Returns FALSE in case the key doesn't exists in the tree (nothing to remove). */
     }
 
-    node->count -= 1;
+    node->count -= instances;
+
+    for (x = node; !IS_NIL(tree, x); x = x->parent) {			/* Less instances in the subtrees of the node and all its ancestors. */
+
+        x->total -= instances;
+    }
 
     /* If key's count is decreased to 0 (no more instances of the key left), this means we have to delete the corresponding node from the tree.
      Based on the book's implementation. */
@@ -676,3 +931,115 @@ rb_tree_node* rb_tree_search_smallest_from(rb_tree *tree, void *key)
     return node;			/* Returns a pointer to the node containing the key if found, NULL otherwise. */
 }
 
+
+static void rb_tree_count_below(rb_tree *tree, void *key, bool inclusive, unsigned int *unique, unsigned long long *instances)
+{
+
+    rb_tree_node *node = tree->root;
+    int compare = 0;
+
+    *unique = 0;
+    *instances = 0;
+
+    /* Walk down towards the key. Whenever we go right - the node and its left subtree are all below the key. */
+
+    while (!IS_NIL(tree, node)) {
+
+        compare = tree->cmp(key, node->key);
+
+        if ((compare > 0) || ((compare == 0) && inclusive)) {
+
+            *unique += node->left->size + 1;
+            *instances += node->left->total + node->count;
+
+            if (compare == 0) {
+
+                return;
+            }
+
+            node = node->right;
+        }
+
+        else {
+
+            if (compare == 0) {			/* The key itself is not counted - only its left subtree is below it. */
+
+                *unique += node->left->size;
+                *instances += node->left->total;
+
+                return;
+            }
+
+            node = node->left;
+        }
+    }
+}
+
+
+void rb_tree_count_range(rb_tree *tree, void *low, void *high, unsigned int *unique, unsigned long long *instances)
+{
+
+    unsigned int unique_below = 0;
+    unsigned int unique_up_to = tree->root->size;
+    unsigned long long instances_below = 0;
+    unsigned long long instances_up_to = tree->root->total;
+
+    /* The keys in [low, high] are the keys up to high (inclusive), minus the keys below low. */
+
+    if (high != NULL) {
+
+        rb_tree_count_below(tree, high, true, &unique_up_to, &instances_up_to);
+    }
+
+    if (low != NULL) {
+
+        rb_tree_count_below(tree, low, false, &unique_below, &instances_below);
+    }
+
+    *unique = (unique_up_to > unique_below) ? unique_up_to - unique_below : 0;			/* An empty range if low > high. */
+
+    if (instances != NULL) {
+
+        *instances = (instances_up_to > instances_below) ? instances_up_to - instances_below : 0;
+    }
+}
+
+
+unsigned int rb_tree_rank(rb_tree *tree, void *key)
+{
+
+    unsigned int unique = 0;
+    unsigned long long instances = 0;
+
+    rb_tree_count_below(tree, key, false, &unique, &instances);
+
+    return unique;
+}
+
+
+rb_tree_node* rb_tree_select(rb_tree *tree, unsigned int rank)
+{
+
+    rb_tree_node *node = tree->root;
+
+    while (!IS_NIL(tree, node)) {
+
+        if (rank == node->left->size) {
+
+            return node;
+        }
+
+        if (rank < node->left->size) {			/* The node we're looking for is in the left subtree. */
+
+            node = node->left;
+        }
+
+        else {			/* Skip the left subtree and the node itself. */
+
+            rank -= node->left->size + 1;
+            node = node->right;
+        }
+    }
+
+    return NULL;
+}
@@ -6,6 +6,8 @@
 
 #include <stdbool.h>
 
+#include "arena.h"
+
 #ifndef RB_TREE_H_
 #define RB_TREE_H_
 
@@ -26,6 +28,11 @@ typedef enum rb_tree_color_s {
 typedef int (*rb_tree_compare)(void *a, void *b);
 
 
+/* A function freeing a key of a tree that is destroyed, with the context given to rb_tree_destroy. */
+
+typedef void (*rb_tree_free_key)(void *key, void *context);
+
+
 typedef struct rb_tree_node_s rb_tree_node;
 
 
@@ -37,6 +44,8 @@ struct rb_tree_node_s {			/* Red-black tree node structure. */
     rb_tree_node *right;
     rb_tree_node *parent;
     unsigned int count;			/* Number of instances the key of the node has. */
+    unsigned int size;			/* Number of unique keys in the subtree rooted at the node (including the node itself.) */
+    unsigned long long total;		/* Sum of the counts of the nodes in the subtree rooted at the node. */
 };
 
 
@@ -47,6 +56,7 @@ typedef struct rb_tree_s {			/* Red-black tree structure. */
     rb_tree_node *max;
     rb_tree_compare cmp;
     unsigned int count;			/* Number of different (unique) keys in the tree. (m / n in the project.) */
+    arena *arena;			/* The arena of the tree and of its nodes, NULL if they are allocated one by one. */
 } rb_tree;
 
 
@@ -56,6 +66,23 @@ typedef struct rb_tree_s {			/* Red-black tree structure. */
 rb_tree* rb_tree_create(rb_tree_compare cmp);
 
 
+/* The same as rb_tree_create, but the tree and its nodes are allocated from the given arena (see arena.h.) */
+
+rb_tree* rb_tree_create_in_arena(rb_tree_compare cmp, arena *arena);
+
+
+/* Free the tree with all of its nodes. If free_key isn't NULL, it is called for every key of the tree (with the given context.) */
+
+void rb_tree_destroy(rb_tree *tree, rb_tree_free_key free_key, void *context);
+
+
+/* Fill an empty tree with the given keys, which must be unique and sorted in increasing order, with the given counts (a single instance of every key
+ if counts is NULL.) The tree is built balanced in O(n) steps, without searches or rotations.
+ Returns FALSE on an allocation error, in which case the tree is left empty. */
+
+bool rb_tree_build_sorted(rb_tree *tree, void **keys, const unsigned int *counts, unsigned int n);
+
+
 /* Return a pointer to the successor of the given node (the node with the smallest key that is larger than the key of the given node.)
  Based on the book's implementation. */
 
@@ -87,6 +114,12 @@ bool rb_tree_insert(rb_tree *tree, void *key, bool *exists);
 bool rb_tree_remove(rb_tree *tree, void *key, void **deleted);
 
 
+/* Remove the given number of instances of the given key from the tree at once - the same as calling rb_tree_remove 'instances' times, but with
+ a single search. Returns FALSE in case the key doesn't exist in the tree or has less instances than that (nothing is removed then). */
+
+bool rb_tree_remove_instances(rb_tree *tree, void *key, unsigned int instances, void **deleted);
+
+
 /* Search the tree for an exact given key. Returns an equal key if found, NULL otherwise. */
 
 void* rb_tree_search_exact(rb_tree *tree, void *key);
@@ -98,4 +131,21 @@ void* rb_tree_search_exact(rb_tree *tree, void *key);
 rb_tree_node* rb_tree_search_smallest_from(rb_tree *tree, void *key);
 
 
+/* Count the keys of the tree in the range [low, high] - NULL low / high means the range is unbounded from below / above.
+ unique would contain the number of unique keys in the range, and instances (if not NULL) the sum of their counts. Takes O(log n) steps, using the
+ subtree sizes and totals kept in the nodes. */
+
+void rb_tree_count_range(rb_tree *tree, void *low, void *high, unsigned int *unique, unsigned long long *instances);
+
+
+/* Return the rank of the given key - the number of unique keys in the tree which are smaller than it. */
+
+unsigned int rb_tree_rank(rb_tree *tree, void *key);
+
+
+/* Return a pointer to the node with the given rank (the node with exactly rank smaller keys in the tree), NULL if rank >= the tree's count. */
+
+rb_tree_node* rb_tree_select(rb_tree *tree, unsigned int rank);
+
+
 #endif /* RB_TREE_H_ */
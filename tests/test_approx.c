@@ -0,0 +1,234 @@
+/*
+ Box approx test.
+ Here we fuzz the approximate GETBOX (box_approx.h) of box factories with approximate indexes of several epsilons against an oracle: a table of the
+ numbers of the boxes of every size, whose minimal suitable volume is found by scanning it. The box returned must be in the oracle and suitable, and
+ its volume must be less than (1 + epsilon) times the minimal one (or both are zero) - so a box kept in the bucket of a wrong volume class is found.
+ The epsilons include 1, whose classes start at the powers of 2, so the volumes on the bounds of the classes are checked too.
+ Usage: test_approx. Prints a key=value line for every epsilon, and returns 0 if all the answers matched.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_factory.h"
+
+
+#define TEST_SIZE 64			/* The sides and the heights of the boxes are smaller than this, so the oracle is a small table. */
+
+#define TEST_OPERATIONS 40000			/* Number of random calls made for every epsilon. */
+
+#define TEST_EPSILONS (sizeof(test_epsilons) / sizeof(test_epsilons[0]))
+
+
+typedef struct test_oracle_s {			/* The oracle - the number of the boxes of every size. */
+
+    unsigned int count[TEST_SIZE][TEST_SIZE];
+} test_oracle;
+
+
+static const double test_epsilons[] = {BOX_APPROX_MIN_EPSILON, 0.01, 0.1, 0.5, 1};
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the given state - the test has the same calls on every system. */
+
+static unsigned long long test_random(unsigned long long *state);
+
+
+/* Return the minimal volume of the boxes of the oracle suitable for a present of the given dimensions. Returns FALSE if there is no suitable box. */
+
+static bool test_oracle_min_volume(const test_oracle *oracle, box_dim side, box_dim height, box_volume *min_volume);
+
+
+/* Make the random calls on the box factory and on the oracle, and return the number of the answers which didn't match. */
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, double epsilon);
+
+
+/* The implementation: */
+
+
+int main(void)
+{
+
+    box_factory_options options;
+    box_factory *factory = NULL;
+    test_oracle *oracle = NULL;
+    unsigned long long failures = 0;
+    unsigned long long run_failures = 0;
+    unsigned int e = 0;
+
+    oracle = malloc(sizeof(test_oracle));
+
+    if (oracle == NULL) {
+
+        printf("Error: Unable to allocate the oracle\n");
+        return 2;
+    }
+
+    for (e = 0; e < TEST_EPSILONS; ++e) {
+
+        memset(&options, 0, sizeof(options));
+        options.approx_epsilon = test_epsilons[e];
+
+        factory = box_factory_create_with_options(&options);
+
+        if (factory == NULL) {
+
+            printf("Error: Unable to create the box factory (epsilon %g)\n", test_epsilons[e]);
+            free(oracle);
+            return 2;
+        }
+
+        memset(oracle, 0, sizeof(test_oracle));
+
+        run_failures = test_run(factory, oracle, e + 1, test_epsilons[e]);
+        failures += run_failures;
+
+        printf("test=approx epsilon=%g operations=%u failures=%llu\n", test_epsilons[e], TEST_OPERATIONS, run_failures);
+
+        box_factory_destroy(factory);
+    }
+
+    free(oracle);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned long long test_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static bool test_oracle_min_volume(const test_oracle *oracle, box_dim side, box_dim height, box_volume *min_volume)
+{
+
+    box_volume volume = 0;
+    bool found = false;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = side; s < TEST_SIZE; ++s) {
+
+        for (h = height; h < TEST_SIZE; ++h) {
+
+            volume = (box_volume) (s * s) * h;
+
+            if ((oracle->count[s][h] != 0) && (!found || (volume < *min_volume))) {
+
+                found = true;
+                *min_volume = volume;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, double epsilon)
+{
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * seed;
+    unsigned long long failures = 0;
+    unsigned long long operation = 0;
+    unsigned int choice = 0;
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    box_dim found_side = 0;
+    box_volume volume = 0;
+    box_volume min_volume = 0;
+    bool found = false;
+    bool oracle_found = false;
+    bool mismatch = false;
+
+    for (operation = 0; operation < TEST_OPERATIONS; ++operation) {
+
+        choice = (unsigned int) (test_random(&state) % 10);
+        side = (box_dim) (test_random(&state) % TEST_SIZE);
+        height = (box_dim) (test_random(&state) % TEST_SIZE);
+
+        if (choice < 3) {
+
+            if (!box_factory_insert(factory, side, height)) {
+
+                ++failures;
+            }
+
+            else {
+
+                ++oracle->count[side][height];
+            }
+        }
+
+        else {
+
+            if (choice < 5) {
+
+                found = box_factory_remove(factory, side, height);
+
+                if (found != (oracle->count[side][height] != 0)) {
+
+                    ++failures;
+                }
+
+                if (found) {
+
+                    --oracle->count[side][height];
+                }
+            }
+
+            else {
+
+                found = box_factory_get_box_approx(factory, side, height, &found_side_square, &found_height);
+                oracle_found = test_oracle_min_volume(oracle, side, height, &min_volume);
+
+                mismatch = (found != oracle_found);
+
+                if (found && !mismatch) {
+
+                    /* The side of the box, from (side * side) - the sides of the oracle are small. */
+
+                    for (found_side = 0; (found_side < TEST_SIZE) && (found_side * found_side < found_side_square); ++found_side);
+
+                    volume = (box_volume) found_side_square * found_height;
+
+                    mismatch = (found_side >= TEST_SIZE) || (found_side * found_side != found_side_square) || (found_height >= TEST_SIZE) ||
+                               (oracle->count[found_side][found_height] == 0) || (found_side < side) || (found_height < height) ||
+                               ((min_volume == 0) ? (volume != 0) : ((double) volume >= (1 + epsilon) * (double) min_volume));
+                }
+
+                if (mismatch) {
+
+                    if (failures < 5) {
+
+                        printf("test=approx epsilon=%g operation=%llu get=" BOX_DIM_FORMAT "," BOX_DIM_FORMAT " answer=%d oracle=%d volume=%llu "
+                               "min_volume=%llu\n", epsilon, operation, side, height, found, oracle_found, (unsigned long long) volume,
+                               (unsigned long long) min_volume);
+                    }
+
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    return failures;
+}
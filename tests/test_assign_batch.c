@@ -0,0 +1,467 @@
+/*
+ Box assign batch test.
+ Here we fuzz box_factory_assign_batch on every structure the box factory can keep its boxes in against an oracle: a table of the numbers of the
+ boxes of every size, which takes the presents of a batch from the largest volume down (equal volumes by larger side, then larger height, then by
+ their order in the batch) and gives each of them its GETBOX answer, found by scanning the table, and removes it. Every present must get the box of
+ the oracle, and the boxes left must be the oracle's - the GETBOX answers and the counts of the suitable boxes between the batches are checked too.
+ Usage: test_assign_batch directory - the files of the B+-tree are created in the directory. Prints a key=value line for every structure, and returns
+ 0 if all the answers matched.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_factory.h"
+
+
+#define TEST_SIZE 32			/* The sides and the heights of the boxes are smaller than this, so the oracle is a small table. */
+
+#define TEST_OPERATIONS 20000			/* Number of random calls made on every structure. */
+
+#define TEST_BATCH_MAX 48			/* The largest batch - larger than the boxes of the factory at times, so some presents get no box. */
+
+#define TEST_MODES 8
+
+#define TEST_PATH_SIZE 4096
+
+
+typedef struct test_oracle_s {			/* The oracle - the number of the boxes of every size. */
+
+    unsigned int count[TEST_SIZE][TEST_SIZE];
+} test_oracle;
+
+
+typedef struct test_item_s {			/* A present of a batch, in the order of the oracle. */
+
+    box_volume volume;
+    box_dim side;
+    box_dim height;
+    unsigned int index;			/* Its index in the batch. */
+} test_item;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the given state - the test has the same calls on every system. */
+
+static unsigned long long test_random(unsigned long long *state);
+
+
+/* Set the options of the structure of the given mode, and return its name. */
+
+static const char* test_mode_options(unsigned int mode, const char *directory, char *path, box_factory_options *options);
+
+
+/* Comparison function between two presents, for qsort - by larger volume, then by larger side, then by larger height, then by their order. */
+
+static int test_compare_items(const void *a, const void *b);
+
+
+/* GETBOX of the oracle - the suitable box of the minimal volume, then of the minimal side, then of the minimal height. Returns FALSE if there is no
+ suitable box. */
+
+static bool test_oracle_get(const test_oracle *oracle, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height);
+
+
+/* Return the number of the boxes of the oracle. */
+
+static unsigned long long test_oracle_total(const test_oracle *oracle);
+
+
+/* Assign the presents of the batch with the oracle, and return the number of the presents whose box differs from the one the box factory assigned. */
+
+static unsigned int test_oracle_assign(test_oracle *oracle, const box_factory_present presents[], unsigned int count, test_item items[]);
+
+
+/* Make the random calls on the box factory and on the oracle, and return the number of the answers which didn't match. */
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, const char *name);
+
+
+/* The implementation: */
+
+
+int main(int argc, char *argv[])
+{
+
+    char path[TEST_PATH_SIZE];
+    box_factory_options options;
+    box_factory *factory = NULL;
+    test_oracle *oracle = NULL;
+    const char *name = NULL;
+    unsigned long long failures = 0;
+    unsigned long long mode_failures = 0;
+    unsigned int mode = 0;
+
+    if (argc != 2) {
+
+        printf("Usage: %s directory\n", argv[0]);
+        return 2;
+    }
+
+    oracle = malloc(sizeof(test_oracle));
+
+    if (oracle == NULL) {
+
+        printf("Error: Unable to allocate the oracle\n");
+        return 2;
+    }
+
+    for (mode = 0; mode < TEST_MODES; ++mode) {
+
+        name = test_mode_options(mode, argv[1], path, &options);
+
+        remove(path);
+
+        factory = box_factory_create_with_options(&options);
+
+        if (factory == NULL) {
+
+            /* The 64-bit build has no box index (see box_types.h.) */
+
+            printf("test=assign_batch mode=%s skipped=1\n", name);
+            continue;
+        }
+
+        memset(oracle, 0, sizeof(test_oracle));
+
+        mode_failures = test_run(factory, oracle, mode + 1, name);
+        failures += mode_failures;
+
+        printf("test=assign_batch mode=%s operations=%u failures=%llu\n", name, TEST_OPERATIONS, mode_failures);
+
+        box_factory_destroy(factory);
+
+        remove(path);
+    }
+
+    free(oracle);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned long long test_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static const char* test_mode_options(unsigned int mode, const char *directory, char *path, box_factory_options *options)
+{
+
+    static const char *names[TEST_MODES] = {"rb_tree", "arena", "veb", "auto", "veb_dictionary", "auto_dictionary", "count_index", "disk"};
+
+    memset(options, 0, sizeof(box_factory_options));
+
+    snprintf(path, TEST_PATH_SIZE, "%s/test_assign_batch.db", directory);
+
+    switch (mode) {
+
+        case 1:
+
+            options->arena = true;
+            break;
+
+        case 2:
+
+            options->index_type = BOX_FACTORY_INDEX_VEB;
+            break;
+
+        case 3:
+
+            options->index_type = BOX_FACTORY_INDEX_AUTO;
+            break;
+
+        case 4:
+
+            options->index_type = BOX_FACTORY_INDEX_VEB;
+            options->dictionary = true;
+            break;
+
+        case 5:
+
+            options->index_type = BOX_FACTORY_INDEX_AUTO;
+            options->dictionary = true;
+            break;
+
+        case 6:
+
+            options->count_index = true;
+            break;
+
+        case 7:
+
+            options->disk_path = path;
+            options->disk_memory = 65536;			/* A small buffer pool, so the pages are evicted and read back. */
+            break;
+
+        default:
+
+            break;
+    }
+
+    return names[mode];
+}
+
+
+static int test_compare_items(const void *a, const void *b)
+{
+
+    const test_item *item_a = a;
+    const test_item *item_b = b;
+
+    if (item_a->volume != item_b->volume) {
+
+        return (item_a->volume > item_b->volume) ? -1 : 1;
+    }
+
+    if (item_a->side != item_b->side) {
+
+        return (item_a->side > item_b->side) ? -1 : 1;
+    }
+
+    if (item_a->height != item_b->height) {
+
+        return (item_a->height > item_b->height) ? -1 : 1;
+    }
+
+    return (item_a->index < item_b->index) ? -1 : 1;
+}
+
+
+static bool test_oracle_get(const test_oracle *oracle, box_dim side, box_dim height, box_dim *found_side, box_dim *found_height)
+{
+
+    box_volume best = 0;
+    box_volume volume = 0;
+    bool found = false;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = side; s < TEST_SIZE; ++s) {
+
+        for (h = height; h < TEST_SIZE; ++h) {
+
+            if (oracle->count[s][h] == 0) {
+
+                continue;
+            }
+
+            volume = (box_volume) (s * s) * h;
+
+            /* The sizes are visited by side and then by height, so the first of equal volumes is the canonical one. */
+
+            if (!found || (volume < best)) {
+
+                found = true;
+                best = volume;
+                *found_side = s;
+                *found_height = h;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+static unsigned long long test_oracle_total(const test_oracle *oracle)
+{
+
+    unsigned long long count = 0;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = 0; s < TEST_SIZE; ++s) {
+
+        for (h = 0; h < TEST_SIZE; ++h) {
+
+            count += oracle->count[s][h];
+        }
+    }
+
+    return count;
+}
+
+
+static unsigned int test_oracle_assign(test_oracle *oracle, const box_factory_present presents[], unsigned int count, test_item items[])
+{
+
+    const box_factory_present *present = NULL;
+    unsigned int mismatches = 0;
+    unsigned int i = 0;
+    box_dim side = 0;
+    box_dim height = 0;
+    bool found = false;
+
+    for (i = 0; i < count; ++i) {
+
+        items[i].volume = (box_volume) presents[i].side * presents[i].side * presents[i].height;
+        items[i].side = presents[i].side;
+        items[i].height = presents[i].height;
+        items[i].index = i;
+    }
+
+    qsort(items, count, sizeof(test_item), test_compare_items);
+
+    for (i = 0; i < count; ++i) {
+
+        present = &(presents[items[i].index]);
+
+        found = test_oracle_get(oracle, present->side, present->height, &side, &height);
+
+        if (found) {
+
+            --oracle->count[side][height];
+        }
+
+        if ((found != present->assigned) || (found && ((present->box_side_square != side * side) || (present->box_height != height)))) {
+
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, const char *name)
+{
+
+    box_factory_present presents[TEST_BATCH_MAX];
+    test_item items[TEST_BATCH_MAX];
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * seed;
+    unsigned long long failures = 0;
+    unsigned long long operation = 0;
+    unsigned int choice = 0;
+    unsigned int count = 0;
+    unsigned int unassigned = 0;
+    unsigned int assigned = 0;
+    unsigned int mismatches = 0;
+    unsigned int i = 0;
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    box_dim oracle_side = 0;
+    box_dim oracle_height = 0;
+    bool found = false;
+    bool oracle_found = false;
+
+    for (operation = 0; operation < TEST_OPERATIONS; ++operation) {
+
+        choice = (unsigned int) (test_random(&state) % 10);
+        side = (box_dim) (test_random(&state) % TEST_SIZE);
+        height = (box_dim) (test_random(&state) % TEST_SIZE);
+
+        if (choice < 5) {
+
+            if (!box_factory_insert(factory, side, height)) {
+
+                ++failures;
+            }
+
+            else {
+
+                ++oracle->count[side][height];
+            }
+        }
+
+        else {
+
+            if (choice < 6) {
+
+                found = box_factory_remove(factory, side, height);
+
+                if (found != (oracle->count[side][height] != 0)) {
+
+                    ++failures;
+                }
+
+                if (found) {
+
+                    --oracle->count[side][height];
+                }
+            }
+
+            else {
+
+                if (choice < 8) {
+
+                    found = box_factory_get_box(factory, side, height, &found_side_square, &found_height);
+                    oracle_found = test_oracle_get(oracle, side, height, &oracle_side, &oracle_height);
+
+                    if ((found != oracle_found) ||
+                        (found && ((found_side_square != oracle_side * oracle_side) || (found_height != oracle_height)))) {
+
+                        ++failures;
+                    }
+
+                    if (box_factory_count_suitable(factory, 0, 0) != test_oracle_total(oracle)) {
+
+                        ++failures;
+                    }
+                }
+
+                else {
+
+                    /* A batch of small presents, with repeated ones - so runs of equal presents share their GETBOX answers. */
+
+                    count = 1 + (unsigned int) (test_random(&state) % TEST_BATCH_MAX);
+
+                    for (i = 0; i < count; ++i) {
+
+                        presents[i].side = (box_dim) (test_random(&state) % (TEST_SIZE / 2));
+                        presents[i].height = (box_dim) (test_random(&state) % (TEST_SIZE / 2));
+
+                        if ((i > 0) && ((test_random(&state) % 4) == 0)) {
+
+                            presents[i] = presents[i - 1];
+                        }
+                    }
+
+                    if (!box_factory_assign_batch(factory, presents, count, &unassigned)) {
+
+                        ++failures;
+                        continue;
+                    }
+
+                    assigned = 0;
+
+                    for (i = 0; i < count; ++i) {
+
+                        assigned += presents[i].assigned ? 1 : 0;
+                    }
+
+                    mismatches = test_oracle_assign(oracle, presents, count, items);
+
+                    if ((mismatches > 0) || (unassigned != count - assigned)) {
+
+                        if (failures < 5) {
+
+                            printf("test=assign_batch mode=%s operation=%llu presents=%u unassigned=%u mismatches=%u\n", name, operation, count,
+                                   unassigned, mismatches);
+                        }
+
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,304 @@
+/*
+ Box batch test.
+ Here we check the batch mode (box_batch.h) against the menu: the session of tests/menu.in is turned into batch commands - the words and their
+ first letters in turn, separated by different white space - and the results of box_batch_run must be byte-identical to tests/menu.out without the
+ listing of the menu, its prompts, its invalid options and its quit.
+ Usage: test_batch directory - run from the top of the tree (like make test); the commands and the results are written to files in the directory.
+ Prints a key=value line, and returns 0 if the results matched.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* open and close. */
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include "box_factory.h"
+
+#include "box_batch.h"
+
+
+#define TEST_MENU_INPUT "tests/menu.in"
+
+#define TEST_MENU_OUTPUT "tests/menu.out"
+
+#define TEST_MENU_ITEMS 5			/* The lines of the listing of the menu - its options are 0 to 3, and 4 quits. */
+
+#define TEST_PROMPTS "Enter the side of the box: Enter the height of the box: "
+
+#define TEST_PATH_SIZE 4096
+
+
+/* Functions' prototype declarations: */
+
+
+/* Read the whole file into a new buffer, ended by a zero byte. Returns NULL on an error, otherwise the buffer (size would contain its length.) */
+
+static char* test_read_file(const char *path, size_t *size);
+
+
+/* Turn the session of the menu into batch commands, written to the commands file, and its output into the expected results. Returns FALSE if the
+ output doesn't follow the input, TRUE otherwise - commands would contain the number of the commands. */
+
+static bool test_translate(const char *menu_input, const char *menu_output, FILE *commands_file, char *expected, size_t *expected_size,
+                           unsigned int *commands);
+
+
+/* Run box_batch_run with a new box factory over the commands file, writing the results file. Returns FALSE on an error, TRUE otherwise. */
+
+static bool test_run_batch(const char *commands_path, const char *results_path);
+
+
+/* The implementation: */
+
+
+int main(int argc, char *argv[])
+{
+
+    char commands_path[TEST_PATH_SIZE];
+    char results_path[TEST_PATH_SIZE];
+    FILE *commands_file = NULL;
+    char *menu_input = NULL;
+    char *menu_output = NULL;
+    char *expected = NULL;
+    char *results = NULL;
+    size_t size = 0;
+    size_t expected_size = 0;
+    size_t results_size = 0;
+    unsigned int commands = 0;
+    unsigned int failures = 0;
+
+    if (argc != 2) {
+
+        printf("Usage: %s directory\n", argv[0]);
+        return 2;
+    }
+
+    snprintf(commands_path, sizeof(commands_path), "%s/test_batch.in", argv[1]);
+    snprintf(results_path, sizeof(results_path), "%s/test_batch.out", argv[1]);
+
+    menu_input = test_read_file(TEST_MENU_INPUT, &size);
+    menu_output = test_read_file(TEST_MENU_OUTPUT, &size);
+    expected = (menu_output != NULL) ? malloc(size + 1) : NULL;
+    commands_file = fopen(commands_path, "w");
+
+    if ((menu_input == NULL) || (menu_output == NULL) || (expected == NULL) || (commands_file == NULL)) {
+
+        printf("Error: Unable to read %s and %s, or to write %s\n", TEST_MENU_INPUT, TEST_MENU_OUTPUT, commands_path);
+        failures++;
+    }
+
+    else {
+
+        if (!test_translate(menu_input, menu_output, commands_file, expected, &expected_size, &commands)) {
+
+            printf("Error: %s doesn't follow %s\n", TEST_MENU_OUTPUT, TEST_MENU_INPUT);
+            failures++;
+        }
+    }
+
+    if ((commands_file != NULL) && (fclose(commands_file) != 0)) {
+
+        failures++;
+    }
+
+    if ((failures == 0) && !test_run_batch(commands_path, results_path)) {
+
+        printf("Error: The batch mode failed\n");
+        failures++;
+    }
+
+    results = (failures == 0) ? test_read_file(results_path, &results_size) : NULL;
+
+    if ((failures == 0) && ((results == NULL) || (results_size != expected_size) || (memcmp(results, expected, expected_size) != 0))) {
+
+        printf("Error: The results of the batch mode differ from the menu's\n");
+        failures++;
+    }
+
+    printf("test=batch commands=%u bytes=%lu failures=%u\n", commands, (unsigned long) expected_size, failures);
+
+    free(menu_input);
+    free(menu_output);
+    free(expected);
+    free(results);
+
+    remove(commands_path);
+    remove(results_path);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static char* test_read_file(const char *path, size_t *size)
+{
+
+    FILE *file = fopen(path, "rb");
+    char *buffer = NULL;
+    long length = 0;
+
+    if (file == NULL) {
+
+        return NULL;
+    }
+
+    if ((fseek(file, 0, SEEK_END) == 0) && ((length = ftell(file)) >= 0) && (fseek(file, 0, SEEK_SET) == 0)) {
+
+        buffer = malloc((size_t) length + 1);
+    }
+
+    if ((buffer != NULL) && (fread(buffer, 1, (size_t) length, file) != (size_t) length)) {
+
+        free(buffer);
+        buffer = NULL;
+    }
+
+    fclose(file);
+
+    if (buffer != NULL) {
+
+        buffer[length] = '\0';
+        *size = (size_t) length;
+    }
+
+    return buffer;
+}
+
+
+static bool test_translate(const char *menu_input, const char *menu_output, FILE *commands_file, char *expected, size_t *expected_size,
+                           unsigned int *commands)
+{
+
+    static const char *words[] = {"INSERT", "REMOVE", "GET", "CHECK"};			/* The commands of the options of the menu. */
+    static const char *separators[] = {" ", "\t", "\n  ", "   "};
+    const char *output = menu_output;
+    const char *line_end = NULL;
+    char *end = NULL;
+    char invalid[64];
+    unsigned long option = 0;
+    unsigned long side = 0;
+    unsigned long height = 0;
+    unsigned int i = 0;
+    size_t length = 0;
+
+    *expected_size = 0;
+    *commands = 0;
+
+    for (i = 0; i < TEST_MENU_ITEMS; ++i) {
+
+        if ((output = strchr(output, '\n')) == NULL) {
+
+            return false;
+        }
+
+        output++;
+    }
+
+    while (true) {
+
+        option = strtoul(menu_input, &end, 10);
+
+        if (end == menu_input) {			/* The input ended without a quit. */
+
+            return false;
+        }
+
+        menu_input = end;
+
+        if (option == TEST_MENU_ITEMS - 1) {			/* The quit - an empty line, and the end of the output. */
+
+            return strcmp(output, "\n") == 0;
+        }
+
+        if (option >= TEST_MENU_ITEMS) {			/* An invalid option - the batch mode has none. */
+
+            snprintf(invalid, sizeof(invalid), "Invalid option: %lu\n\n", option);
+
+            if (strncmp(output, invalid, strlen(invalid)) != 0) {
+
+                return false;
+            }
+
+            output += strlen(invalid);
+            continue;
+        }
+
+        side = strtoul(menu_input, &end, 10);
+        height = strtoul(end, &end, 10);
+        menu_input = end;
+
+        /* The word or its first letter, and the numbers, separated by any white space. */
+
+        if ((*commands % 2) == 0) {
+
+            fprintf(commands_file, "%s%s%lu%s%lu\n", words[option], separators[*commands % 4], side, separators[(*commands / 2) % 4], height);
+        }
+
+        else {
+
+            fprintf(commands_file, "%c%s%lu%s%lu\n", words[option][0], separators[*commands % 4], side, separators[(*commands / 2) % 4], height);
+        }
+
+        (*commands)++;
+
+        /* The results of an operation are the lines after the prompts, up to the empty line which follows every operation. */
+
+        if (strncmp(output, TEST_PROMPTS, strlen(TEST_PROMPTS)) != 0) {
+
+            return false;
+        }
+
+        output += strlen(TEST_PROMPTS);
+
+        do {
+
+            if ((line_end = strchr(output, '\n')) == NULL) {
+
+                return false;
+            }
+
+            length = (size_t) (line_end + 1 - output);
+
+            memcpy(expected + *expected_size, output, length);
+            *expected_size += length;
+            output += length;
+
+        } while (length > 1);
+    }
+}
+
+
+static bool test_run_batch(const char *commands_path, const char *results_path)
+{
+
+    box_factory *factory = box_factory_create();
+    int input = open(commands_path, O_RDONLY);
+    int output = open(results_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool succeeded = (factory != NULL) && (input >= 0) && (output >= 0) && box_batch_run(factory, input, output);
+
+    if (input >= 0) {
+
+        close(input);
+    }
+
+    if ((output >= 0) && (close(output) != 0)) {
+
+        succeeded = false;
+    }
+
+    if (factory != NULL) {
+
+        box_factory_destroy(factory);
+    }
+
+    return succeeded;
+}
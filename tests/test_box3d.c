@@ -0,0 +1,247 @@
+/*
+ Box 3D test.
+ Here we fuzz the three-dimensional box factory (box3d.h) against an oracle: a table of the numbers of the boxes of every length, width and height,
+ whose GETBOX answer is found by scanning it - the suitable box of the minimal volume, then of the smallest length, width and height, with the
+ footprint of the boxes turned too if asked for. The removals are many, so the k-d tree is rebuilt without the nodes of the removed boxes, and its
+ scapegoat rebuilds are checked with them. Every answer of INSERTBOX, REMOVEBOX and GETBOX, and the number of the boxes, must be the oracle's.
+ Usage: test_box3d. Prints a key=value line for every run, and returns 0 if all the answers matched.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box3d.h"
+
+
+#define TEST_SIZE 16			/* The dimensions of the boxes are smaller than this, so the oracle is a small table. */
+
+#define TEST_OPERATIONS 100000			/* Number of random calls made in every run. */
+
+#define TEST_RUNS 3
+
+
+typedef struct test_oracle_s {			/* The oracle - the number of the boxes of every size. */
+
+    unsigned int count[TEST_SIZE][TEST_SIZE][TEST_SIZE];
+    unsigned long long boxes;
+} test_oracle;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the given state - the test has the same calls on every system. */
+
+static unsigned long long test_random(unsigned long long *state);
+
+
+/* GETBOX of the oracle. Returns FALSE if there is no suitable box. */
+
+static bool test_oracle_get(const test_oracle *oracle, box_dim length, box_dim width, box_dim height, bool rotate, box_dim found[]);
+
+
+/* Make the random calls on the 3D box factory and on the oracle, and return the number of the answers which didn't match. The calls of a run insert
+ boxes in the given part of them (out of 10), and remove them in most of the others. */
+
+static unsigned long long test_run(box3d_factory *factory, test_oracle *oracle, unsigned long long seed, unsigned int inserts);
+
+
+/* The implementation: */
+
+
+int main(void)
+{
+
+    static const unsigned int inserts[TEST_RUNS] = {6, 4, 3};			/* A growing inventory, a steady one and a shrinking one. */
+    box3d_factory *factory = NULL;
+    test_oracle *oracle = NULL;
+    unsigned long long failures = 0;
+    unsigned long long run_failures = 0;
+    unsigned int run = 0;
+
+    oracle = malloc(sizeof(test_oracle));
+
+    if (oracle == NULL) {
+
+        printf("Error: Unable to allocate the oracle\n");
+        return 2;
+    }
+
+    for (run = 0; run < TEST_RUNS; ++run) {
+
+        factory = box3d_factory_create();
+
+        if (factory == NULL) {
+
+            printf("Error: Unable to create the 3D box factory\n");
+            free(oracle);
+            return 2;
+        }
+
+        memset(oracle, 0, sizeof(test_oracle));
+
+        run_failures = test_run(factory, oracle, run + 1, inserts[run]);
+        failures += run_failures;
+
+        printf("test=box3d inserts=%u operations=%u boxes=%llu failures=%llu\n", inserts[run], TEST_OPERATIONS, oracle->boxes, run_failures);
+
+        box3d_factory_destroy(factory);
+    }
+
+    free(oracle);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned long long test_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static bool test_oracle_get(const test_oracle *oracle, box_dim length, box_dim width, box_dim height, bool rotate, box_dim found[])
+{
+
+    box_volume best = 0;
+    box_volume volume = 0;
+    bool found_any = false;
+    box_dim l = 0;
+    box_dim w = 0;
+    box_dim h = 0;
+
+    for (l = 0; l < TEST_SIZE; ++l) {
+
+        for (w = 0; w < TEST_SIZE; ++w) {
+
+            /* The footprint fits as it is, or turned by 90 degrees. */
+
+            if (!((l >= length) && (w >= width)) && !(rotate && (l >= width) && (w >= length))) {
+
+                continue;
+            }
+
+            for (h = height; h < TEST_SIZE; ++h) {
+
+                volume = (box_volume) l * w * h;
+
+                /* The sizes are visited by length, then by width and then by height, so the first of equal volumes is the canonical one. */
+
+                if ((oracle->count[l][w][h] != 0) && (!found_any || (volume < best))) {
+
+                    found_any = true;
+                    best = volume;
+                    found[0] = l;
+                    found[1] = w;
+                    found[2] = h;
+                }
+            }
+        }
+    }
+
+    return found_any;
+}
+
+
+static unsigned long long test_run(box3d_factory *factory, test_oracle *oracle, unsigned long long seed, unsigned int inserts)
+{
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * seed;
+    unsigned long long failures = 0;
+    unsigned long long operation = 0;
+    unsigned int choice = 0;
+    box_dim dims[3] = {0, 0, 0};
+    box_dim found[3] = {0, 0, 0};
+    box_dim oracle_found[3] = {0, 0, 0};
+    bool rotate = false;
+    bool result = false;
+    bool oracle_result = false;
+
+    for (operation = 0; operation < TEST_OPERATIONS; ++operation) {
+
+        choice = (unsigned int) (test_random(&state) % 10);
+        dims[0] = (box_dim) (test_random(&state) % TEST_SIZE);
+        dims[1] = (box_dim) (test_random(&state) % TEST_SIZE);
+        dims[2] = (box_dim) (test_random(&state) % TEST_SIZE);
+
+        if (choice < inserts) {
+
+            if (!box3d_factory_insert(factory, dims[0], dims[1], dims[2])) {
+
+                ++failures;
+            }
+
+            else {
+
+                ++oracle->count[dims[0]][dims[1]][dims[2]];
+                ++oracle->boxes;
+            }
+        }
+
+        else {
+
+            if (choice < 8) {
+
+                /* Remove a box which exists, most of the time - the one GETBOX of the oracle gives for a random present. */
+
+                if (((choice % 4) != 0) && test_oracle_get(oracle, dims[0] / 2, dims[1] / 2, dims[2] / 2, false, oracle_found)) {
+
+                    dims[0] = oracle_found[0];
+                    dims[1] = oracle_found[1];
+                    dims[2] = oracle_found[2];
+                }
+
+                result = box3d_factory_remove(factory, dims[0], dims[1], dims[2]);
+
+                if (result != (oracle->count[dims[0]][dims[1]][dims[2]] != 0)) {
+
+                    ++failures;
+                }
+
+                if (result) {
+
+                    --oracle->count[dims[0]][dims[1]][dims[2]];
+                    --oracle->boxes;
+                }
+            }
+
+            else {
+
+                rotate = ((test_random(&state) % 2) == 0);
+
+                result = box3d_factory_get_box(factory, dims[0], dims[1], dims[2], rotate, &(found[0]), &(found[1]), &(found[2]));
+                oracle_result = test_oracle_get(oracle, dims[0], dims[1], dims[2], rotate, oracle_found);
+
+                if ((result != oracle_result) ||
+                    (result && ((found[0] != oracle_found[0]) || (found[1] != oracle_found[1]) || (found[2] != oracle_found[2])))) {
+
+                    if (failures < 5) {
+
+                        printf("test=box3d inserts=%u operation=%llu get=" BOX_DIM_FORMAT "," BOX_DIM_FORMAT "," BOX_DIM_FORMAT " rotate=%d answer=%d "
+                               "oracle=%d\n", inserts, operation, dims[0], dims[1], dims[2], rotate, result, oracle_result);
+                    }
+
+                    ++failures;
+                }
+            }
+        }
+
+        if (factory->boxes != oracle->boxes) {
+
+            ++failures;
+        }
+    }
+
+    return failures;
+}
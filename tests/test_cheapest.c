@@ -0,0 +1,329 @@
+/*
+ Box cheapest test.
+ Here we fuzz box_factory_get_cheapest against an oracle - a table of the numbers of the boxes of every size and of their prices, whose cheapest
+ suitable box is found by scanning it - with the volume, a monotone cost function and an arbitrary one, while prices are set and removed, on the
+ red-black trees and on the box index. Equal costs must be ordered like the oracle orders them - by volume, then by side, then by height.
+ Usage: test_cheapest. Prints a key=value line for every structure and cost model, and returns 0 if all the answers matched.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_factory.h"
+
+
+#define TEST_SIZE 40			/* The sides and the heights of the boxes are smaller than this. */
+
+#define TEST_OPERATIONS 60000			/* Number of random calls made on every structure, for every cost model. */
+
+#define TEST_MODES 3
+
+#define TEST_COSTS 3
+
+
+typedef struct test_oracle_s {			/* The oracle - the number of the boxes and the price of every size. */
+
+    unsigned int count[TEST_SIZE][TEST_SIZE];
+    bool priced[TEST_SIZE][TEST_SIZE];
+    double price[TEST_SIZE][TEST_SIZE];
+    box_cost_function function;			/* The cost function of the box factory, NULL for the volume. */
+} test_oracle;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the given state. */
+
+static unsigned long long test_random(unsigned long long *state);
+
+
+/* A monotone cost function - steps of the side and of the height. */
+
+static double test_cost_monotone(box_dim side_square, box_dim height, void *context);
+
+
+/* An arbitrary cost function - a hash of the size. */
+
+static double test_cost_arbitrary(box_dim side_square, box_dim height, void *context);
+
+
+/* box_factory_get_cheapest of the oracle. Returns FALSE if there is no suitable box. */
+
+static bool test_oracle_cheapest(const test_oracle *oracle, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height,
+                                 double *found_cost);
+
+
+/* Make the random calls on the box factory and on the oracle, and return the number of the answers which didn't match. */
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed);
+
+
+/* The implementation: */
+
+
+int main(void)
+{
+
+    static const char *mode_names[TEST_MODES] = {"rb_tree", "veb", "auto_dictionary"};
+    static const char *cost_names[TEST_COSTS] = {"volume", "monotone", "arbitrary"};
+    box_factory_options options;
+    box_factory *factory = NULL;
+    test_oracle *oracle = NULL;
+    unsigned long long failures = 0;
+    unsigned long long run_failures = 0;
+    unsigned int mode = 0;
+    unsigned int cost = 0;
+
+    oracle = malloc(sizeof(test_oracle));
+
+    if (oracle == NULL) {
+
+        printf("Error: Unable to allocate the oracle\n");
+        return 2;
+    }
+
+    for (mode = 0; mode < TEST_MODES; ++mode) {
+
+        for (cost = 0; cost < TEST_COSTS; ++cost) {
+
+            memset(&options, 0, sizeof(options));
+            options.index_type = (mode == 0) ? BOX_FACTORY_INDEX_RB_TREE : ((mode == 1) ? BOX_FACTORY_INDEX_VEB : BOX_FACTORY_INDEX_AUTO);
+            options.dictionary = (mode == 2);
+
+            factory = box_factory_create_with_options(&options);
+
+            if (factory == NULL) {
+
+                /* The 64-bit build has no box index (see box_types.h.) */
+
+                printf("test=cheapest mode=%s cost=%s skipped=1\n", mode_names[mode], cost_names[cost]);
+                continue;
+            }
+
+            memset(oracle, 0, sizeof(test_oracle));
+
+            if (cost == 1) {
+
+                oracle->function = test_cost_monotone;
+                box_factory_set_cost_function(factory, test_cost_monotone, NULL, true);
+            }
+
+            else {
+
+                if (cost == 2) {
+
+                    oracle->function = test_cost_arbitrary;
+                    box_factory_set_cost_function(factory, test_cost_arbitrary, NULL, false);
+                }
+            }
+
+            run_failures = test_run(factory, oracle, mode * TEST_COSTS + cost + 1);
+            failures += run_failures;
+
+            printf("test=cheapest mode=%s cost=%s operations=%u failures=%llu\n", mode_names[mode], cost_names[cost], TEST_OPERATIONS,
+                   run_failures);
+
+            box_factory_destroy(factory);
+        }
+    }
+
+    free(oracle);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned long long test_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static double test_cost_monotone(box_dim side_square, box_dim height, void *context)
+{
+
+    (void) context;
+
+    return (double) (side_square / 7) + 3.0 * (double) (height / 5);
+}
+
+
+static double test_cost_arbitrary(box_dim side_square, box_dim height, void *context)
+{
+
+    (void) context;
+
+    return (double) (((side_square * 31) ^ (height * 17)) % 23);
+}
+
+
+static bool test_oracle_cheapest(const test_oracle *oracle, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height,
+                                 double *found_cost)
+{
+
+    box_volume best_volume = 0;
+    box_volume volume = 0;
+    double best_cost = 0;
+    double cost = 0;
+    bool found = false;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = side; s < TEST_SIZE; ++s) {
+
+        for (h = height; h < TEST_SIZE; ++h) {
+
+            if (oracle->count[s][h] == 0) {
+
+                continue;
+            }
+
+            volume = (box_volume) (s * s) * h;
+
+            if (oracle->priced[s][h]) {
+
+                cost = oracle->price[s][h];
+            }
+
+            else {
+
+                cost = (oracle->function != NULL) ? oracle->function(s * s, h, NULL) : (double) volume;
+            }
+
+            /* The sizes are visited by side and then by height, so the first of equal costs and volumes is the canonical one. */
+
+            if (!found || (cost < best_cost) || ((cost == best_cost) && (volume < best_volume))) {
+
+                found = true;
+                best_cost = cost;
+                best_volume = volume;
+                *found_side_square = s * s;
+                *found_height = h;
+            }
+        }
+    }
+
+    *found_cost = best_cost;
+
+    return found;
+}
+
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed)
+{
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * seed;
+    unsigned long long failures = 0;
+    unsigned long long operation = 0;
+    unsigned int choice = 0;
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    box_dim oracle_side_square = 0;
+    box_dim oracle_height = 0;
+    double found_cost = 0;
+    double oracle_cost = 0;
+    double price = 0;
+    bool found = false;
+    bool oracle_found = false;
+
+    for (operation = 0; operation < TEST_OPERATIONS; ++operation) {
+
+        choice = (unsigned int) (test_random(&state) % 10);
+        side = (box_dim) (test_random(&state) % TEST_SIZE);
+        height = (box_dim) (test_random(&state) % TEST_SIZE);
+
+        if (choice < 3) {
+
+            if (!box_factory_insert(factory, side, height)) {
+
+                ++failures;
+            }
+
+            else {
+
+                ++oracle->count[side][height];
+            }
+        }
+
+        else {
+
+            if (choice < 5) {
+
+                found = box_factory_remove(factory, side, height);
+
+                if (found != (oracle->count[side][height] != 0)) {
+
+                    ++failures;
+                }
+
+                if (found) {
+
+                    --oracle->count[side][height];
+                }
+            }
+
+            else {
+
+                if (choice == 5) {
+
+                    if ((test_random(&state) % 2) == 0) {
+
+                        price = (double) (test_random(&state) % 40);
+
+                        if (!box_factory_set_price(factory, side, height, price)) {
+
+                            ++failures;
+                        }
+
+                        oracle->priced[side][height] = true;
+                        oracle->price[side][height] = price;
+                    }
+
+                    else {
+
+                        if (box_factory_remove_price(factory, side, height) != oracle->priced[side][height]) {
+
+                            ++failures;
+                        }
+
+                        oracle->priced[side][height] = false;
+                    }
+                }
+
+                else {
+
+                    found = box_factory_get_cheapest(factory, side, height, &found_side_square, &found_height, &found_cost);
+                    oracle_found = test_oracle_cheapest(oracle, side, height, &oracle_side_square, &oracle_height, &oracle_cost);
+
+                    if ((found != oracle_found) || (found && ((found_side_square != oracle_side_square) || (found_height != oracle_height) ||
+                                                               (found_cost != oracle_cost)))) {
+
+                        if (failures < 5) {
+
+                            printf("test=cheapest operation=%llu get=" BOX_DIM_FORMAT "," BOX_DIM_FORMAT " answer=%d oracle=%d\n", operation, side,
+                                   height, found, oracle_found);
+                        }
+
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,359 @@
+/*
+ Box cursor test.
+ Here we fuzz the cursor over the suitable boxes (box_cursor.h) on every structure the box factory can keep its boxes in against an oracle: a table
+ of the numbers of the boxes of every size, whose suitable sizes are sorted by volume, then by side, then by height. The sizes the cursor yields must
+ be the oracle's, in its order and with their numbers of boxes - up to a random number of them, so cursors left in the middle are freed too - and the
+ cursor must end right after the last one. A box factory on disk has no cursor, so there it must fail at once.
+ Usage: test_cursor directory - the files of the B+-tree are created in the directory. Prints a key=value line for every structure, and returns 0 if
+ all the answers matched.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_factory.h"
+
+#include "box_cursor.h"
+
+
+#define TEST_SIZE 32			/* The sides and the heights of the boxes are smaller than this, so the oracle is a small table. */
+
+#define TEST_OPERATIONS 40000			/* Number of random calls made on every structure. */
+
+#define TEST_MODES 8
+
+#define TEST_PATH_SIZE 4096
+
+
+typedef struct test_oracle_s {			/* The oracle - the number of the boxes of every size, and room for its sorted suitable sizes. */
+
+    unsigned int count[TEST_SIZE][TEST_SIZE];
+    box_factory_box sizes[TEST_SIZE * TEST_SIZE];
+} test_oracle;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the given state - the test has the same calls on every system. */
+
+static unsigned long long test_random(unsigned long long *state);
+
+
+/* Set the options of the structure of the given mode, and return its name. */
+
+static const char* test_mode_options(unsigned int mode, const char *directory, char *path, box_factory_options *options);
+
+
+/* Comparison function between two sizes, for qsort - by volume, then by side, then by height. */
+
+static int test_compare_sizes(const void *a, const void *b);
+
+
+/* Sort the suitable sizes of the oracle into its sizes, and return their number. */
+
+static unsigned int test_oracle_top(test_oracle *oracle, box_dim side, box_dim height);
+
+
+/* Make the random calls on the box factory and on the oracle, and return the number of the answers which didn't match. */
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, const char *name);
+
+
+/* The implementation: */
+
+
+int main(int argc, char *argv[])
+{
+
+    char path[TEST_PATH_SIZE];
+    box_factory_options options;
+    box_factory *factory = NULL;
+    test_oracle *oracle = NULL;
+    const char *name = NULL;
+    unsigned long long failures = 0;
+    unsigned long long mode_failures = 0;
+    unsigned int mode = 0;
+
+    if (argc != 2) {
+
+        printf("Usage: %s directory\n", argv[0]);
+        return 2;
+    }
+
+    oracle = malloc(sizeof(test_oracle));
+
+    if (oracle == NULL) {
+
+        printf("Error: Unable to allocate the oracle\n");
+        return 2;
+    }
+
+    for (mode = 0; mode < TEST_MODES; ++mode) {
+
+        name = test_mode_options(mode, argv[1], path, &options);
+
+        remove(path);
+
+        factory = box_factory_create_with_options(&options);
+
+        if (factory == NULL) {
+
+            /* The 64-bit build has no box index (see box_types.h.) */
+
+            printf("test=cursor mode=%s skipped=1\n", name);
+            continue;
+        }
+
+        memset(oracle, 0, sizeof(test_oracle));
+
+        mode_failures = test_run(factory, oracle, mode + 1, name);
+        failures += mode_failures;
+
+        printf("test=cursor mode=%s operations=%u failures=%llu\n", name, TEST_OPERATIONS, mode_failures);
+
+        box_factory_destroy(factory);
+
+        remove(path);
+    }
+
+    free(oracle);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned long long test_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static const char* test_mode_options(unsigned int mode, const char *directory, char *path, box_factory_options *options)
+{
+
+    static const char *names[TEST_MODES] = {"rb_tree", "arena", "veb", "auto", "veb_dictionary", "auto_dictionary", "count_index", "disk"};
+
+    memset(options, 0, sizeof(box_factory_options));
+
+    snprintf(path, TEST_PATH_SIZE, "%s/test_cursor.db", directory);
+
+    switch (mode) {
+
+        case 1:
+
+            options->arena = true;
+            break;
+
+        case 2:
+
+            options->index_type = BOX_FACTORY_INDEX_VEB;
+            break;
+
+        case 3:
+
+            options->index_type = BOX_FACTORY_INDEX_AUTO;
+            break;
+
+        case 4:
+
+            options->index_type = BOX_FACTORY_INDEX_VEB;
+            options->dictionary = true;
+            break;
+
+        case 5:
+
+            options->index_type = BOX_FACTORY_INDEX_AUTO;
+            options->dictionary = true;
+            break;
+
+        case 6:
+
+            options->count_index = true;
+            break;
+
+        case 7:
+
+            options->disk_path = path;
+            options->disk_memory = 65536;			/* A small buffer pool, so the pages are evicted and read back. */
+            break;
+
+        default:
+
+            break;
+    }
+
+    return names[mode];
+}
+
+
+static int test_compare_sizes(const void *a, const void *b)
+{
+
+    const box_factory_box *size_a = a;
+    const box_factory_box *size_b = b;
+    box_volume volume_a = (box_volume) size_a->side_square * size_a->height;
+    box_volume volume_b = (box_volume) size_b->side_square * size_b->height;
+
+    if (volume_a != volume_b) {
+
+        return (volume_a < volume_b) ? -1 : 1;
+    }
+
+    if (size_a->side_square != size_b->side_square) {
+
+        return (size_a->side_square < size_b->side_square) ? -1 : 1;
+    }
+
+    return (size_a->height < size_b->height) ? -1 : ((size_a->height > size_b->height) ? 1 : 0);
+}
+
+
+static unsigned int test_oracle_top(test_oracle *oracle, box_dim side, box_dim height)
+{
+
+    unsigned int count = 0;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = side; s < TEST_SIZE; ++s) {
+
+        for (h = height; h < TEST_SIZE; ++h) {
+
+            if (oracle->count[s][h] != 0) {
+
+                oracle->sizes[count].side_square = s * s;
+                oracle->sizes[count].height = h;
+                oracle->sizes[count].count = oracle->count[s][h];
+                ++count;
+            }
+        }
+    }
+
+    qsort(oracle->sizes, count, sizeof(box_factory_box), test_compare_sizes);
+
+    return count;
+}
+
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, const char *name)
+{
+
+    box_cursor cursor;
+    box_factory_box box;
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * seed;
+    bool on_disk = (strcmp(name, "disk") == 0);			/* A box factory on disk has no cursor. */
+    unsigned long long failures = 0;
+    unsigned long long operation = 0;
+    unsigned int choice = 0;
+    unsigned int limit = 0;
+    unsigned int count = 0;
+    unsigned int oracle_count = 0;
+    box_dim side = 0;
+    box_dim height = 0;
+    bool found = false;
+    bool mismatch = false;
+
+    for (operation = 0; operation < TEST_OPERATIONS; ++operation) {
+
+        choice = (unsigned int) (test_random(&state) % 10);
+        side = (box_dim) (test_random(&state) % TEST_SIZE);
+        height = (box_dim) (test_random(&state) % TEST_SIZE);
+
+        if (choice < 4) {
+
+            if (!box_factory_insert(factory, side, height)) {
+
+                ++failures;
+            }
+
+            else {
+
+                ++oracle->count[side][height];
+            }
+        }
+
+        else {
+
+            if (choice < 6) {
+
+                found = box_factory_remove(factory, side, height);
+
+                if (found != (oracle->count[side][height] != 0)) {
+
+                    ++failures;
+                }
+
+                if (found) {
+
+                    --oracle->count[side][height];
+                }
+            }
+
+            else {
+
+                /* Small queries too, so the cursors have many suitable sizes to yield. */
+
+                side = (choice < 8) ? side / 4 : side;
+                height = (choice < 8) ? height / 4 : height;
+                limit = 1 + (unsigned int) (test_random(&state) % (TEST_SIZE * TEST_SIZE));
+
+                oracle_count = test_oracle_top(oracle, side, height);
+                count = 0;
+                mismatch = false;
+
+                box_factory_suitable_begin(factory, side, height, &cursor);
+
+                while (!mismatch && (count < limit) && box_factory_suitable_next(&cursor, &box)) {
+
+                    mismatch = (count >= oracle_count) || (box.side_square != oracle->sizes[count].side_square) ||
+                               (box.height != oracle->sizes[count].height) || (box.count != oracle->sizes[count].count);
+                    ++count;
+                }
+
+                /* A cursor which stopped before the limit has ended - right after the last size. So must the next one after the last size. */
+
+                if (!mismatch && (count < limit)) {
+
+                    mismatch = on_disk ? (count != 0) : (count != oracle_count);
+                }
+
+                else {
+
+                    if (!mismatch && (count == oracle_count)) {
+
+                        mismatch = box_factory_suitable_next(&cursor, &box);
+                    }
+                }
+
+                mismatch = mismatch || (cursor.failed != on_disk);
+
+                box_factory_suitable_end(&cursor);
+
+                if (mismatch) {
+
+                    if (failures < 5) {
+
+                        printf("test=cursor mode=%s operation=%llu suitable=" BOX_DIM_FORMAT "," BOX_DIM_FORMAT " limit=%u count=%u oracle=%u\n",
+                               name, operation, side, height, limit, count, oracle_count);
+                    }
+
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,383 @@
+/*
+ Box index test.
+ Here we fuzz every structure the box factory can keep its boxes in - the red-black trees (with and without an arena), the box index of van Emde
+ Boas trees and of adaptive sets (with and without the dictionary), the dominance index and the disk-backed B+-tree - against an oracle: a table of
+ the numbers of the boxes of every size, whose answers are found by scanning it. Every answer of GETBOX, CHECKBOX, box_factory_count_suitable and
+ box_factory_count_sides must be the oracle's, including the order of the boxes of equal volumes (by side, then by height.)
+ Usage: test_index directory - the files of the B+-tree are created in the directory. Prints a key=value line for every structure, and returns 0 if
+ all the answers matched.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_factory.h"
+
+
+#define TEST_SIZE 64			/* The sides and the heights of the boxes are smaller than this, so the oracle is a small table. */
+
+#define TEST_OPERATIONS 100000			/* Number of random calls made on every structure. */
+
+#define TEST_MODES 8
+
+#define TEST_PATH_SIZE 4096
+
+
+typedef struct test_oracle_s {			/* The oracle - the number of the boxes of every size. */
+
+    unsigned int count[TEST_SIZE][TEST_SIZE];
+} test_oracle;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the given state - the test has the same calls on every system. */
+
+static unsigned long long test_random(unsigned long long *state);
+
+
+/* Set the options of the structure of the given mode, and return its name. */
+
+static const char* test_mode_options(unsigned int mode, const char *directory, char *path, box_factory_options *options);
+
+
+/* GETBOX of the oracle - the suitable box of the minimal volume, then of the minimal side, then of the minimal height. Returns FALSE if there is no
+ suitable box. */
+
+static bool test_oracle_get(const test_oracle *oracle, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height);
+
+
+/* Return the number of the suitable boxes of the oracle. */
+
+static unsigned long long test_oracle_count_suitable(const test_oracle *oracle, box_dim side, box_dim height);
+
+
+/* Return the number of the different sides of the oracle in the range [min_side, max_side]. */
+
+static unsigned int test_oracle_count_sides(const test_oracle *oracle, box_dim min_side, box_dim max_side);
+
+
+/* Make the random calls on the box factory and on the oracle, and return the number of the answers which didn't match. */
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, const char *name);
+
+
+/* The implementation: */
+
+
+int main(int argc, char *argv[])
+{
+
+    char path[TEST_PATH_SIZE];
+    box_factory_options options;
+    box_factory *factory = NULL;
+    test_oracle *oracle = NULL;
+    const char *name = NULL;
+    unsigned long long failures = 0;
+    unsigned long long mode_failures = 0;
+    unsigned int mode = 0;
+
+    if (argc != 2) {
+
+        printf("Usage: %s directory\n", argv[0]);
+        return 2;
+    }
+
+    oracle = malloc(sizeof(test_oracle));
+
+    if (oracle == NULL) {
+
+        printf("Error: Unable to allocate the oracle\n");
+        return 2;
+    }
+
+    for (mode = 0; mode < TEST_MODES; ++mode) {
+
+        name = test_mode_options(mode, argv[1], path, &options);
+
+        remove(path);
+
+        factory = box_factory_create_with_options(&options);
+
+        if (factory == NULL) {
+
+            /* The 64-bit build has no box index (see box_types.h.) */
+
+            printf("test=index mode=%s skipped=1\n", name);
+            continue;
+        }
+
+        memset(oracle, 0, sizeof(test_oracle));
+
+        mode_failures = test_run(factory, oracle, mode + 1, name);
+        failures += mode_failures;
+
+        printf("test=index mode=%s operations=%u failures=%llu\n", name, TEST_OPERATIONS, mode_failures);
+
+        box_factory_destroy(factory);
+
+        remove(path);
+    }
+
+    free(oracle);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned long long test_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static const char* test_mode_options(unsigned int mode, const char *directory, char *path, box_factory_options *options)
+{
+
+    static const char *names[TEST_MODES] = {"rb_tree", "arena", "veb", "auto", "veb_dictionary", "auto_dictionary", "count_index", "disk"};
+
+    memset(options, 0, sizeof(box_factory_options));
+
+    snprintf(path, TEST_PATH_SIZE, "%s/test_index.db", directory);
+
+    switch (mode) {
+
+        case 1:
+
+            options->arena = true;
+            break;
+
+        case 2:
+
+            options->index_type = BOX_FACTORY_INDEX_VEB;
+            break;
+
+        case 3:
+
+            options->index_type = BOX_FACTORY_INDEX_AUTO;
+            break;
+
+        case 4:
+
+            options->index_type = BOX_FACTORY_INDEX_VEB;
+            options->dictionary = true;
+            break;
+
+        case 5:
+
+            options->index_type = BOX_FACTORY_INDEX_AUTO;
+            options->dictionary = true;
+            break;
+
+        case 6:
+
+            options->count_index = true;
+            break;
+
+        case 7:
+
+            options->disk_path = path;
+            options->disk_memory = 65536;			/* A small buffer pool, so the pages are evicted and read back. */
+            break;
+
+        default:
+
+            break;
+    }
+
+    return names[mode];
+}
+
+
+static bool test_oracle_get(const test_oracle *oracle, box_dim side, box_dim height, box_dim *found_side_square, box_dim *found_height)
+{
+
+    box_volume best = 0;
+    box_volume volume = 0;
+    bool found = false;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = side; s < TEST_SIZE; ++s) {
+
+        for (h = height; h < TEST_SIZE; ++h) {
+
+            if (oracle->count[s][h] == 0) {
+
+                continue;
+            }
+
+            volume = (box_volume) (s * s) * h;
+
+            /* The sizes are visited by side and then by height, so the first of equal volumes is the canonical one. */
+
+            if (!found || (volume < best)) {
+
+                found = true;
+                best = volume;
+                *found_side_square = s * s;
+                *found_height = h;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+static unsigned long long test_oracle_count_suitable(const test_oracle *oracle, box_dim side, box_dim height)
+{
+
+    unsigned long long count = 0;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = side; s < TEST_SIZE; ++s) {
+
+        for (h = height; h < TEST_SIZE; ++h) {
+
+            count += oracle->count[s][h];
+        }
+    }
+
+    return count;
+}
+
+
+static unsigned int test_oracle_count_sides(const test_oracle *oracle, box_dim min_side, box_dim max_side)
+{
+
+    unsigned int count = 0;
+    box_dim s = 0;
+    box_dim h = 0;
+
+    for (s = min_side; (s <= max_side) && (s < TEST_SIZE); ++s) {
+
+        for (h = 0; h < TEST_SIZE; ++h) {
+
+            if (oracle->count[s][h] != 0) {
+
+                ++count;
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+static unsigned long long test_run(box_factory *factory, test_oracle *oracle, unsigned long long seed, const char *name)
+{
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL * seed;
+    unsigned long long failures = 0;
+    unsigned long long operation = 0;
+    unsigned int choice = 0;
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    box_dim oracle_side_square = 0;
+    box_dim oracle_height = 0;
+    bool found = false;
+    bool oracle_found = false;
+
+    for (operation = 0; operation < TEST_OPERATIONS; ++operation) {
+
+        choice = (unsigned int) (test_random(&state) % 10);
+        side = (box_dim) (test_random(&state) % TEST_SIZE);
+        height = (box_dim) (test_random(&state) % TEST_SIZE);
+
+        /* Phases of queries only, so the cached answers and the cascades live long enough to be used. */
+
+        if (((operation / 3000) % 2) == 1) {
+
+            choice = 5 + (choice % 5);
+        }
+
+        if (choice < 3) {
+
+            if (!box_factory_insert(factory, side, height)) {
+
+                ++failures;
+            }
+
+            else {
+
+                ++oracle->count[side][height];
+            }
+        }
+
+        else {
+
+            if (choice < 5) {
+
+                found = box_factory_remove(factory, side, height);
+
+                if (found != (oracle->count[side][height] != 0)) {
+
+                    ++failures;
+                }
+
+                if (found) {
+
+                    --oracle->count[side][height];
+                }
+            }
+
+            else {
+
+                if (choice < 8) {
+
+                    found = box_factory_get_box(factory, side, height, &found_side_square, &found_height);
+                    oracle_found = test_oracle_get(oracle, side, height, &oracle_side_square, &oracle_height);
+
+                    if ((found != oracle_found) ||
+                        (found && ((found_side_square != oracle_side_square) || (found_height != oracle_height)))) {
+
+                        if (failures < 5) {
+
+                            printf("test=index mode=%s operation=%llu get=" BOX_DIM_FORMAT "," BOX_DIM_FORMAT " answer=%d oracle=%d\n", name,
+                                   operation, side, height, found, oracle_found);
+                        }
+
+                        ++failures;
+                    }
+
+                    if (box_factory_check_box(factory, side, height) != oracle_found) {
+
+                        ++failures;
+                    }
+                }
+
+                else {
+
+                    if (box_factory_count_suitable(factory, side, height) != test_oracle_count_suitable(oracle, side, height)) {
+
+                        ++failures;
+                    }
+
+                    if (box_factory_count_sides(factory, side, side + height) != test_oracle_count_sides(oracle, side, side + height)) {
+
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,551 @@
+/*
+ Box persistence test.
+ Here we check the round trips of every file of the box factory - the snapshot (saved, opened read-only and writable, and saved again to the same
+ bytes), the write-ahead log (recovered after a shutdown, after a checkpoint, and after garbage at its end), the export (imported, and exported again
+ to the same bytes), the B+-tree file (closed and opened again) and the trace (read back record by record.) After every round trip the box factory
+ must answer like a box factory which made the same changes in memory, and a snapshot or an export with a byte changed must be refused.
+ Usage: test_persistence directory - the files are created in the directory. Prints a key=value line for every file, and returns 0 if all the round
+ trips kept the boxes.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "box_factory.h"
+
+
+#define TEST_SIZE 48			/* The sides and the heights of the boxes are smaller than this. */
+
+#define TEST_CHANGES 3000			/* Number of random changes made before every round trip. */
+
+#define TEST_PATH_SIZE 4096
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the given state. */
+
+static unsigned long long test_random(unsigned long long *state);
+
+
+/* Make the same random changes on the two box factories. Returns FALSE if their results differed. */
+
+static bool test_change(box_factory *factory, box_factory *reference, unsigned long long *state, unsigned int changes);
+
+
+/* Returns TRUE if the two box factories give the same answers to GETBOX and to box_factory_count_suitable for every present. */
+
+static bool test_same(box_factory *factory, box_factory *reference);
+
+
+/* Returns TRUE if the two files have the same bytes. */
+
+static bool test_same_file(const char *path, const char *other_path);
+
+
+/* Flip a bit of the byte of the file at the given distance from its end. Returns FALSE on an I/O error. */
+
+static bool test_corrupt(const char *path, long from_end);
+
+
+/* Append bytes which aren't a record to the file. Returns FALSE on an I/O error. */
+
+static bool test_append_garbage(const char *path);
+
+
+/* The round trips of every file - each returns the number of the checks which failed. */
+
+static unsigned int test_snapshot(const char *directory, unsigned long long *state);
+
+static unsigned int test_wal(const char *directory, unsigned long long *state);
+
+static unsigned int test_export(const char *directory, unsigned long long *state);
+
+static unsigned int test_disk(const char *directory, unsigned long long *state);
+
+static unsigned int test_trace(const char *directory, unsigned long long *state);
+
+
+/* The implementation: */
+
+
+int main(int argc, char *argv[])
+{
+
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    unsigned int failures = 0;
+    unsigned int file_failures = 0;
+
+    if (argc != 2) {
+
+        printf("Usage: %s directory\n", argv[0]);
+        return 2;
+    }
+
+    file_failures = test_snapshot(argv[1], &state);
+    printf("test=persistence file=snapshot failures=%u\n", file_failures);
+    failures += file_failures;
+
+    file_failures = test_wal(argv[1], &state);
+    printf("test=persistence file=wal failures=%u\n", file_failures);
+    failures += file_failures;
+
+    file_failures = test_export(argv[1], &state);
+    printf("test=persistence file=export failures=%u\n", file_failures);
+    failures += file_failures;
+
+    file_failures = test_disk(argv[1], &state);
+    printf("test=persistence file=disk failures=%u\n", file_failures);
+    failures += file_failures;
+
+    file_failures = test_trace(argv[1], &state);
+    printf("test=persistence file=trace failures=%u\n", file_failures);
+    failures += file_failures;
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned long long test_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static bool test_change(box_factory *factory, box_factory *reference, unsigned long long *state, unsigned int changes)
+{
+
+    box_dim side = 0;
+    box_dim height = 0;
+    unsigned int i = 0;
+    bool same = true;
+
+    for (i = 0; i < changes; ++i) {
+
+        side = (box_dim) (test_random(state) % TEST_SIZE);
+        height = (box_dim) (test_random(state) % TEST_SIZE);
+
+        if ((test_random(state) % 3) != 0) {
+
+            same = (box_factory_insert(factory, side, height) == box_factory_insert(reference, side, height)) && same;
+        }
+
+        else {
+
+            same = (box_factory_remove(factory, side, height) == box_factory_remove(reference, side, height)) && same;
+        }
+    }
+
+    return same;
+}
+
+
+static bool test_same(box_factory *factory, box_factory *reference)
+{
+
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    box_dim reference_side_square = 0;
+    box_dim reference_height = 0;
+    bool found = false;
+
+    for (side = 0; side <= TEST_SIZE; ++side) {
+
+        for (height = 0; height <= TEST_SIZE; ++height) {
+
+            found = box_factory_get_box(factory, side, height, &found_side_square, &found_height);
+
+            if (found != box_factory_get_box(reference, side, height, &reference_side_square, &reference_height)) {
+
+                return false;
+            }
+
+            if (found && ((found_side_square != reference_side_square) || (found_height != reference_height))) {
+
+                return false;
+            }
+
+            if (box_factory_count_suitable(factory, side, height) != box_factory_count_suitable(reference, side, height)) {
+
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+static bool test_same_file(const char *path, const char *other_path)
+{
+
+    FILE *file = fopen(path, "rb");
+    FILE *other_file = fopen(other_path, "rb");
+    int byte = 0;
+    bool same = (file != NULL) && (other_file != NULL);
+
+    while (same) {
+
+        byte = fgetc(file);
+        same = (byte == fgetc(other_file));
+
+        if (byte == EOF) {
+
+            break;
+        }
+    }
+
+    if (file != NULL) {
+
+        fclose(file);
+    }
+
+    if (other_file != NULL) {
+
+        fclose(other_file);
+    }
+
+    return same;
+}
+
+
+static bool test_corrupt(const char *path, long from_end)
+{
+
+    FILE *file = fopen(path, "r+b");
+    int byte = 0;
+    bool written = false;
+
+    if (file == NULL) {
+
+        return false;
+    }
+
+    if ((fseek(file, -from_end, SEEK_END) == 0) && ((byte = fgetc(file)) != EOF) && (fseek(file, -from_end, SEEK_END) == 0)) {
+
+        written = (fputc(byte ^ 0x10, file) != EOF);
+    }
+
+    return (fclose(file) == 0) && written;
+}
+
+
+static bool test_append_garbage(const char *path)
+{
+
+    static const char garbage[] = "\x07\x00\x00\x00 not a record of the log";
+    FILE *file = fopen(path, "ab");
+    bool written = false;
+
+    if (file == NULL) {
+
+        return false;
+    }
+
+    written = (fwrite(garbage, 1, sizeof(garbage), file) == sizeof(garbage));
+
+    return (fclose(file) == 0) && written;
+}
+
+
+static unsigned int test_snapshot(const char *directory, unsigned long long *state)
+{
+
+    char path[TEST_PATH_SIZE];
+    char other_path[TEST_PATH_SIZE];
+    box_factory *factory = box_factory_create();
+    box_factory *reference = box_factory_create();
+    box_factory *opened = NULL;
+    unsigned int failures = 0;
+
+    snprintf(path, sizeof(path), "%s/test.snapshot", directory);
+    snprintf(other_path, sizeof(other_path), "%s/test_again.snapshot", directory);
+
+    failures += test_change(factory, reference, state, TEST_CHANGES) ? 0 : 1;
+    failures += box_factory_save(factory, path) ? 0 : 1;
+
+    /* Read-only - the queries are answered from the mapped file, and the changes are refused. */
+
+    opened = box_factory_open_snapshot(path, NULL, false);
+
+    if (opened == NULL) {
+
+        ++failures;
+    }
+
+    else {
+
+        failures += test_same(opened, reference) ? 0 : 1;
+        failures += box_factory_insert(opened, 1, 1) ? 1 : 0;
+
+        box_factory_destroy(opened);
+    }
+
+    /* Writable - saved again before a change, it is the same file. */
+
+    opened = box_factory_open_snapshot(path, NULL, true);
+
+    if (opened == NULL) {
+
+        ++failures;
+    }
+
+    else {
+
+        failures += box_factory_save(opened, other_path) ? 0 : 1;
+        failures += test_same_file(path, other_path) ? 0 : 1;
+        failures += test_change(opened, reference, state, TEST_CHANGES) ? 0 : 1;
+        failures += test_same(opened, reference) ? 0 : 1;
+
+        box_factory_destroy(opened);
+    }
+
+    failures += test_corrupt(path, 3) ? 0 : 1;
+
+    opened = box_factory_open_snapshot(path, NULL, false);
+
+    if (opened != NULL) {
+
+        ++failures;
+        box_factory_destroy(opened);
+    }
+
+    remove(path);
+    remove(other_path);
+
+    box_factory_destroy(factory);
+    box_factory_destroy(reference);
+
+    return failures;
+}
+
+
+static unsigned int test_wal(const char *directory, unsigned long long *state)
+{
+
+    char snapshot_path[TEST_PATH_SIZE];
+    char wal_path[TEST_PATH_SIZE];
+    box_factory *reference = box_factory_create();
+    box_factory *factory = NULL;
+    unsigned int failures = 0;
+    unsigned int generation = 0;
+
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s/test_wal.snapshot", directory);
+    snprintf(wal_path, sizeof(wal_path), "%s/test.wal", directory);
+
+    remove(snapshot_path);
+    remove(wal_path);
+
+    /* Every generation recovers what the previous one left - the log alone, then a checkpoint and the log which follows it. */
+
+    for (generation = 0; generation < 4; ++generation) {
+
+        factory = box_factory_recover(snapshot_path, wal_path, NULL, BOX_WAL_SYNC_GROUP, 16);
+
+        if (factory == NULL) {
+
+            return failures + 1;
+        }
+
+        failures += test_same(factory, reference) ? 0 : 1;
+        failures += test_change(factory, reference, state, TEST_CHANGES) ? 0 : 1;
+
+        if (generation == 1) {
+
+            failures += box_factory_checkpoint_begin(factory, snapshot_path) ? 0 : 1;
+            failures += test_change(factory, reference, state, TEST_CHANGES / 10) ? 0 : 1;
+            failures += (box_factory_checkpoint_poll(factory, true) == BOX_CHECKPOINT_DONE) ? 0 : 1;
+        }
+
+        failures += test_change(factory, reference, state, TEST_CHANGES / 10) ? 0 : 1;
+
+        box_factory_destroy(factory);
+    }
+
+    /* A record cut by a crash at the end of the log is dropped. */
+
+    failures += test_append_garbage(wal_path) ? 0 : 1;
+
+    factory = box_factory_recover(snapshot_path, wal_path, NULL, BOX_WAL_SYNC_GROUP, 16);
+
+    if (factory == NULL) {
+
+        ++failures;
+    }
+
+    else {
+
+        failures += test_same(factory, reference) ? 0 : 1;
+
+        box_factory_destroy(factory);
+    }
+
+    remove(snapshot_path);
+    remove(wal_path);
+
+    box_factory_destroy(reference);
+
+    return failures;
+}
+
+
+static unsigned int test_export(const char *directory, unsigned long long *state)
+{
+
+    char path[TEST_PATH_SIZE];
+    char other_path[TEST_PATH_SIZE];
+    box_factory *factory = box_factory_create();
+    box_factory *reference = box_factory_create();
+    box_factory *imported = NULL;
+    unsigned int failures = 0;
+
+    snprintf(path, sizeof(path), "%s/test.export", directory);
+    snprintf(other_path, sizeof(other_path), "%s/test_again.export", directory);
+
+    failures += test_change(factory, reference, state, TEST_CHANGES) ? 0 : 1;
+    failures += box_factory_export(factory, path) ? 0 : 1;
+
+    imported = box_factory_import(path, NULL);
+
+    if (imported == NULL) {
+
+        ++failures;
+    }
+
+    else {
+
+        failures += test_same(imported, reference) ? 0 : 1;
+        failures += box_factory_export(imported, other_path) ? 0 : 1;
+        failures += test_same_file(path, other_path) ? 0 : 1;
+        failures += test_change(imported, reference, state, TEST_CHANGES) ? 0 : 1;
+        failures += test_same(imported, reference) ? 0 : 1;
+
+        box_factory_destroy(imported);
+    }
+
+    failures += test_corrupt(path, 5) ? 0 : 1;
+
+    imported = box_factory_import(path, NULL);
+
+    if (imported != NULL) {
+
+        ++failures;
+        box_factory_destroy(imported);
+    }
+
+    remove(path);
+    remove(other_path);
+
+    box_factory_destroy(factory);
+    box_factory_destroy(reference);
+
+    return failures;
+}
+
+
+static unsigned int test_disk(const char *directory, unsigned long long *state)
+{
+
+    char path[TEST_PATH_SIZE];
+    box_factory_options options;
+    box_factory *reference = box_factory_create();
+    box_factory *factory = NULL;
+    unsigned int failures = 0;
+    unsigned int generation = 0;
+
+    snprintf(path, sizeof(path), "%s/test_persistence.db", directory);
+
+    remove(path);
+
+    memset(&options, 0, sizeof(options));
+    options.disk_path = path;
+    options.disk_memory = 65536;
+
+    for (generation = 0; generation < 3; ++generation) {
+
+        factory = (generation == 0) ? box_factory_create_with_options(&options) : box_factory_open_disk(path, &options);
+
+        if (factory == NULL) {
+
+            return failures + 1;
+        }
+
+        failures += test_same(factory, reference) ? 0 : 1;
+        failures += test_change(factory, reference, state, TEST_CHANGES) ? 0 : 1;
+
+        box_factory_destroy(factory);
+    }
+
+    remove(path);
+
+    box_factory_destroy(reference);
+
+    return failures;
+}
+
+
+static unsigned int test_trace(const char *directory, unsigned long long *state)
+{
+
+    char path[TEST_PATH_SIZE];
+    box_factory *factory = box_factory_create();
+    box_factory *reference = box_factory_create();
+    box_trace_reader *reader = NULL;
+    box_trace_record record;
+    unsigned long long calls = 0;
+    unsigned long long inserts = 0;
+    unsigned int failures = 0;
+
+    snprintf(path, sizeof(path), "%s/test.trace", directory);
+
+    failures += test_change(factory, reference, state, TEST_CHANGES) ? 0 : 1;
+    failures += box_factory_trace_begin(factory, path) ? 0 : 1;
+    failures += test_same(factory, reference) ? 0 : 1;
+    failures += test_change(factory, reference, state, TEST_CHANGES) ? 0 : 1;
+
+    calls = (factory->trace != NULL) ? factory->trace->stats.calls : 0;
+
+    failures += box_factory_trace_end(factory) ? 0 : 1;
+
+    /* The inventory is the boxes when the trace began, and every call is read back. */
+
+    reader = box_trace_open(path);
+
+    if (reader == NULL) {
+
+        ++failures;
+    }
+
+    else {
+
+        while (box_trace_next(reader, &record)) {
+
+            inserts += (record.op == BOX_TRACE_INSERT) ? 1 : 0;
+        }
+
+        failures += ((reader->calls == calls) && !reader->cut && !reader->failed && (inserts != 0)) ? 0 : 1;
+
+        box_trace_reader_close(reader);
+    }
+
+    remove(path);
+
+    box_factory_destroy(factory);
+    box_factory_destroy(reference);
+
+    return failures;
+}
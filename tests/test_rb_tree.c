@@ -0,0 +1,447 @@
+/*
+ Red-black tree test.
+ Here we make random insertions and removals on red-black trees (allocated one by one, from an arena, and built from sorted keys), and check the
+ invariants of the tree after them - the order of the keys, the parent links, no red node with a red child, the same number of black nodes on every
+ path, a black root, the subtree sizes and totals, the count and the maximum of the tree - and the answers of its queries against an array of the
+ counts of the keys.
+ Usage: test_rb_tree. Prints a key=value line for every kind of tree, and returns 0 if the trees kept their invariants.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include "arena.h"
+
+#include "rb_tree.h"
+
+
+#define TEST_KEYS 1000			/* The keys are the integers 0 to TEST_KEYS - 1. */
+
+#define TEST_OPERATIONS 200000			/* Number of random changes made on every tree. */
+
+#define TEST_CHECK_PERIOD 97			/* The invariants are checked after every so many changes. */
+
+#define TEST_KINDS 3
+
+
+typedef struct test_state_s {			/* A tree under test, with the counts its keys should have. */
+
+    rb_tree *tree;
+    int keys[TEST_KEYS];
+    unsigned int counts[TEST_KEYS];
+    unsigned long long random;			/* The state of the xorshift generator. */
+    unsigned long long failures;
+} test_state;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the next value of the xorshift generator of the state. */
+
+static unsigned int test_random(test_state *state, unsigned int range);
+
+
+/* Compare two keys (pointers to int.) */
+
+static int test_compare(void *a, void *b);
+
+
+/* Check the invariants of the subtree rooted at the node, whose keys must be in [low, high]. size and total would contain the size and the total of
+ the subtree. Returns the black height of the subtree. */
+
+static unsigned int test_check_node(test_state *state, rb_tree_node *node, int low, int high, unsigned int *size, unsigned long long *total);
+
+
+/* Check the invariants of the whole tree. */
+
+static void test_check_tree(test_state *state);
+
+
+/* Check the answers of the queries of the tree on random keys. */
+
+static void test_check_queries(test_state *state);
+
+
+/* Make the random changes on the tree, and check it after them. */
+
+static void test_run(test_state *state);
+
+
+/* The implementation: */
+
+
+int main(void)
+{
+
+    static const char *names[TEST_KINDS] = {"malloc", "arena", "build_sorted"};
+    static void *sorted[TEST_KEYS];
+    static unsigned int sorted_counts[TEST_KEYS];
+    test_state *state = NULL;
+    arena *tree_arena = NULL;
+    unsigned long long failures = 0;
+    unsigned int kind = 0;
+    unsigned int i = 0;
+
+    state = calloc(1, sizeof(test_state));
+
+    if (state == NULL) {
+
+        printf("Error: Unable to allocate the test state\n");
+        return 2;
+    }
+
+    for (kind = 0; kind < TEST_KINDS; ++kind) {
+
+        for (i = 0; i < TEST_KEYS; ++i) {
+
+            state->keys[i] = (int) i;
+            state->counts[i] = 0;
+        }
+
+        state->random = 0x9E3779B97F4A7C15ULL * (kind + 1);
+        state->failures = 0;
+
+        if (kind == 1) {
+
+            tree_arena = arena_create();
+            state->tree = (tree_arena != NULL) ? rb_tree_create_in_arena(test_compare, tree_arena) : NULL;
+        }
+
+        else {
+
+            state->tree = rb_tree_create(test_compare);
+        }
+
+        if (state->tree == NULL) {
+
+            printf("Error: Unable to create a tree\n");
+            return 2;
+        }
+
+        if (kind == 2) {
+
+            /* Every third key, with 1 to 3 instances. */
+
+            for (i = 0; i < TEST_KEYS / 3; ++i) {
+
+                sorted[i] = &state->keys[i * 3];
+                sorted_counts[i] = 1 + (i % 3);
+                state->counts[i * 3] = sorted_counts[i];
+            }
+
+            if (!rb_tree_build_sorted(state->tree, sorted, sorted_counts, TEST_KEYS / 3)) {
+
+                printf("Error: Unable to build a tree\n");
+                return 2;
+            }
+
+            test_check_tree(state);
+        }
+
+        test_run(state);
+
+        printf("test=rb_tree kind=%s operations=%u failures=%llu\n", names[kind], TEST_OPERATIONS, state->failures);
+        failures += state->failures;
+
+        rb_tree_destroy(state->tree, NULL, NULL);
+
+        if (tree_arena != NULL) {
+
+            arena_destroy(tree_arena);
+            tree_arena = NULL;
+        }
+    }
+
+    free(state);
+
+    return (failures == 0) ? 0 : 1;
+}
+
+
+static unsigned int test_random(test_state *state, unsigned int range)
+{
+
+    state->random ^= state->random << 13;
+    state->random ^= state->random >> 7;
+    state->random ^= state->random << 17;
+
+    return (unsigned int) (state->random % range);
+}
+
+
+static int test_compare(void *a, void *b)
+{
+
+    int first = *(int*) a;
+    int second = *(int*) b;
+
+    if (first < second) {
+
+        return -1;
+    }
+
+    return (first > second) ? 1 : 0;
+}
+
+
+static unsigned int test_check_node(test_state *state, rb_tree_node *node, int low, int high, unsigned int *size, unsigned long long *total)
+{
+
+    unsigned int left_size = 0;
+    unsigned int right_size = 0;
+    unsigned long long left_total = 0;
+    unsigned long long right_total = 0;
+    unsigned int left_height = 0;
+    unsigned int right_height = 0;
+    int key = 0;
+
+    *size = 0;
+    *total = 0;
+
+    if (node == &state->tree->nil) {
+
+        return 1;
+    }
+
+    key = *(int*) node->key;
+
+    if ((key < low) || (key > high) || (node->count == 0) || (node->count != state->counts[key])) {
+
+        ++state->failures;
+    }
+
+    if (((node->left != &state->tree->nil) && (node->left->parent != node)) ||
+        ((node->right != &state->tree->nil) && (node->right->parent != node))) {
+
+        ++state->failures;
+    }
+
+    if ((node->color == RED) && ((node->left->color == RED) || (node->right->color == RED))) {
+
+        ++state->failures;
+    }
+
+    left_height = test_check_node(state, node->left, low, key - 1, &left_size, &left_total);
+    right_height = test_check_node(state, node->right, key + 1, high, &right_size, &right_total);
+
+    if (left_height != right_height) {
+
+        ++state->failures;
+    }
+
+    *size = left_size + right_size + 1;
+    *total = left_total + right_total + node->count;
+
+    if ((node->size != *size) || (node->total != *total)) {
+
+        ++state->failures;
+    }
+
+    return left_height + ((node->color == BLACK) ? 1 : 0);
+}
+
+
+static void test_check_tree(test_state *state)
+{
+
+    unsigned int size = 0;
+    unsigned long long total = 0;
+    unsigned int unique = 0;
+    int max = -1;
+    unsigned int i = 0;
+
+    if (state->tree->root->color != BLACK) {
+
+        ++state->failures;
+    }
+
+    test_check_node(state, state->tree->root, 0, TEST_KEYS - 1, &size, &total);
+
+    for (i = 0; i < TEST_KEYS; ++i) {
+
+        if (state->counts[i] != 0) {
+
+            ++unique;
+            max = (int) i;
+        }
+    }
+
+    if ((size != unique) || (state->tree->count != unique)) {
+
+        ++state->failures;
+    }
+
+    if ((max >= 0) && ((state->tree->max == NULL) || (state->tree->max == &state->tree->nil) || (*(int*) state->tree->max->key != max))) {
+
+        ++state->failures;
+    }
+}
+
+
+static void test_check_queries(test_state *state)
+{
+
+    rb_tree_node *node = NULL;
+    unsigned int low = test_random(state, TEST_KEYS);
+    unsigned int high = test_random(state, TEST_KEYS);
+    unsigned int expected_unique = 0;
+    unsigned long long expected_instances = 0;
+    unsigned int unique = 0;
+    unsigned long long instances = 0;
+    unsigned int rank = 0;
+    int next = -1;
+    unsigned int i = 0;
+
+    for (i = low; i <= high; ++i) {
+
+        if (state->counts[i] != 0) {
+
+            ++expected_unique;
+            expected_instances += state->counts[i];
+        }
+    }
+
+    rb_tree_count_range(state->tree, &state->keys[low], &state->keys[high], &unique, &instances);
+
+    if ((unique != expected_unique) || (instances != expected_instances)) {
+
+        ++state->failures;
+    }
+
+    for (i = 0; i < low; ++i) {
+
+        rank += (state->counts[i] != 0) ? 1 : 0;
+    }
+
+    if (rb_tree_rank(state->tree, &state->keys[low]) != rank) {
+
+        ++state->failures;
+    }
+
+    for (i = low; i < TEST_KEYS; ++i) {
+
+        if (state->counts[i] != 0) {
+
+            next = (int) i;
+            break;
+        }
+    }
+
+    node = rb_tree_search_smallest_from(state->tree, &state->keys[low]);
+
+    if (((node == NULL) ? -1 : *(int*) node->key) != next) {
+
+        ++state->failures;
+    }
+
+    if ((node != NULL) && (rb_tree_select(state->tree, rank) != node)) {
+
+        ++state->failures;
+    }
+
+    if ((rb_tree_search_exact(state->tree, &state->keys[low]) != NULL) != (state->counts[low] != 0)) {
+
+        ++state->failures;
+    }
+
+    if (rb_tree_select(state->tree, state->tree->count) != NULL) {
+
+        ++state->failures;
+    }
+}
+
+
+static void test_run(test_state *state)
+{
+
+    rb_tree_node *node = NULL;
+    void *deleted = NULL;
+    bool exists = false;
+    unsigned int operation = 0;
+    unsigned int key = 0;
+    unsigned int instances = 0;
+    unsigned int visited = 0;
+
+    for (operation = 0; operation < TEST_OPERATIONS; ++operation) {
+
+        key = test_random(state, TEST_KEYS);
+
+        switch (test_random(state, 5)) {
+
+            case 0:
+            case 1:
+
+                if (!rb_tree_insert(state->tree, &state->keys[key], &exists) || (exists != (state->counts[key] != 0))) {
+
+                    ++state->failures;
+                }
+
+                ++state->counts[key];
+                break;
+
+            case 2:
+            case 3:
+
+                if (rb_tree_remove(state->tree, &state->keys[key], &deleted) != (state->counts[key] != 0)) {
+
+                    ++state->failures;
+                }
+
+                if (state->counts[key] != 0) {
+
+                    --state->counts[key];
+                }
+
+                break;
+
+            default:
+
+                instances = 1 + test_random(state, 3);
+
+                if (rb_tree_remove_instances(state->tree, &state->keys[key], instances, &deleted) != (state->counts[key] >= instances)) {
+
+                    ++state->failures;
+                }
+
+                if (state->counts[key] >= instances) {
+
+                    state->counts[key] -= instances;
+                }
+
+                break;
+        }
+
+        test_check_queries(state);
+
+        if ((operation % TEST_CHECK_PERIOD) == 0) {
+
+            test_check_tree(state);
+        }
+    }
+
+    test_check_tree(state);
+
+    /* The successors visit every key once, in order. */
+
+    visited = 0;
+
+    for (node = rb_tree_select(state->tree, 0); node != NULL; node = rb_tree_successor(state->tree, node)) {
+
+        if (node == &state->tree->nil) {
+
+            break;
+        }
+
+        ++visited;
+    }
+
+    if (visited != state->tree->count) {
+
+        ++state->failures;
+    }
+}
@@ -0,0 +1,2507 @@
+/*
+ Box bench source file.
+ A benchmark of the box factory (box_factory.h) - seeded workloads, so two builds of the program (before and after a change of rb_tree.c or of
+ box_factory.c) run the very same operations, and their results may be compared.
+ Usage: box_bench [boxes [queries [seed [range [workload [index]]]]]]
+ The workloads (all of them by default):
+ uniform - the sides and the heights are uniform in [1, range].
+ zipf - the sizes are drawn from a Zipfian distribution over boxes different sizes, so a few sizes are most of the boxes and of the queries.
+ adversarial - the boxes of every side have about the same volume ((range / side) ^ 2 is their height), and the queries are low, so every side from
+ the side of a query on is suitable and GETBOX has to scan many of them for the smallest volume.
+ restock - insert-heavy: a quarter of the boxes is inserted, then queries operations which are 70% INSERTBOX (the rest GETBOX and CHECKBOX.)
+ fulfillment - take-heavy: boxes are inserted, then queries operations which are 85% a GETBOX followed by the REMOVEBOX of the box it found (the rest
+ INSERTBOX.)
+ The first three workloads insert boxes boxes, run queries GETBOX, queries CHECKBOX, and queries mixed operations (40% GETBOX, 30% CHECKBOX, 15%
+ INSERTBOX and 15% REMOVEBOX of a box of the factory), and then remove all the boxes.
+ box3d - the three-dimensional box factory (box3d.h): boxes boxes with uniform dimensions in [1, range] are inserted, then queries GETBOX, queries
+ GETBOX with the footprint rotated, queries mixed operations (70% GETBOX, 15% INSERTBOX and 15% REMOVEBOX), and then all the boxes are removed.
+ The index is ignored - its phases are printed with index=kd.
+ cheapest - GET_CHEAPEST (box_factory_get_cheapest): boxes uniform boxes are inserted and 1% of their sizes get a price, then queries queries run with
+ the volume as the cost and with a monotone cost function - and BENCH_ORACLE_QUERIES with an arbitrary one, which visits every suitable size.
+ The first BENCH_ORACLE_QUERIES answers of every cost are checked against a brute-force oracle over all the sizes, after the phase is measured - the
+ workload fails if one differs.
+ wal - the cost of the write-ahead log (box_wal.h): the same boxes boxes are inserted, and then the same queries changes (half INSERTBOX and half
+ REMOVEBOX) are made, without a log and with a log of every sync policy - none, group (of BENCH_WAL_GROUP records) and always (at most
+ BENCH_SYNCED_CHANGES changes of each phase, since every change waits for the disk.) Every log is followed by a line of its counters per change. The
+ logs are written to $TMPDIR (/tmp by default), and deleted.
+ export - the export file (box_export.h) against the snapshot (box_snapshot.h), the raw one: boxes boxes are inserted, then the factory is saved,
+ exported, opened from the snapshot and imported from the export BENCH_FILE_ROUNDS times each, and a line compares the sizes of the files and the
+ sizes per second of every operation. The files are in $TMPDIR too, and every factory read back is checked to have all the boxes.
+ approx - the approximate GETBOX (box_factory_get_box_approx) against the exact one, over the boxes and the queries of the adversarial workload: for
+ every epsilon of bench_epsilons, a factory with an approximate index of that epsilon gets the boxes, then the same queries are measured with the exact
+ GETBOX and with the approximate one, and a line gives the ratios of the volumes found by the approximate one to the minimal volumes. The workload
+ fails if a ratio isn't below 1 + epsilon, or if only one of them found a box.
+ skewed - the query planner (box_planner.h) on a skewed inventory: half of the boxes have both dimensions in the lower half of [1, range], and half
+ are in the corner of the last BENCH_SKEWED_CORNER sides and heights. Half of the queries are high (a side in the lower half and a height in the
+ upper one) and half are wide (the other way around), so only the boxes of the corner are suitable - the scan of one main tree visits the keys of
+ the lower half without finding a box, and the scan of the other one starts at the corner. boxes boxes are inserted, then the same queries GETBOX
+ and queries CHECKBOX are measured with the planner, and with the planner forced to scan tree_by_side and tree_by_height (the rule of the tree with
+ less keys is one of them.) A line counts the queries the planner sent to every main tree, and a line gives the p99 and p99.9 latencies of GETBOX
+ of the three. The workload fails if their answers differ, or if the p99.9 of the planner is more than BENCH_TAIL_RATIO times the best of the forced
+ ones. The veb and auto indexes keep their own rule, so the three are the same there.
+ disk - the disk-backed B+-tree (box_btree.h) against its memory budget: for every budget of bench_disk_budgets, a factory on a B+-tree file in
+ $TMPDIR gets boxes uniform boxes, then queries GETBOX and queries CHECKBOX are made, and all the boxes are removed - and the same for a factory in
+ memory at the end, with the index. Every phase of the B+-tree is followed by a line of the counters of its buffer pool per operation (the pages
+ read from the file are mostly in the page cache of the system), and the workload fails if an answer differs from the one of the first budget.
+ cascade - the rebuild of the cascades (box_cascade.h), which GETBOX makes in parts: boxes uniform boxes are inserted, then queries GETBOX are
+ measured (the first rebuild), and queries more after a change has dropped the cascades. A line of every phase gives the slowest GETBOX which made a
+ part of a rebuild and the slowest of the others, in CPU time (so a preemption isn't mistaken for a slow GETBOX), and the workload fails if the
+ first is more than BENCH_SLOWEST_RATIO times the second.
+ The index is the structure of the factory - rb (the default), veb, auto or arena (see box_factory_options.)
+ Every workload runs in a process of its own, so its peak memory isn't mixed with the others'. Every phase is printed as a single line of key=value
+ pairs, for scripts: the number of operations, their throughput, the percentiles of their latencies, the allocations per operation (malloc, calloc
+ and realloc calls, counted with glibc only - -1 otherwise) and the peak resident memory of the process so far.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* clock_gettime, fork and getrusage. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <math.h>
+
+#include <time.h>
+
+#include <unistd.h>
+
+#include <sys/types.h>
+
+#include <sys/wait.h>
+
+#include <sys/resource.h>
+
+#include <sys/stat.h>
+
+#include "box_factory.h"
+
+#include "box3d.h"
+
+
+#define BENCH_ZIPF_EXPONENT 0.99
+
+#define BENCH_ZIPF_MAX_SIZES (1U << 20)			/* The most different sizes of the Zipfian distribution. */
+
+#define BENCH_ADVERSARIAL_MAX_HEIGHT 64			/* The queries of the adversarial workload are at most this high. */
+
+#define BENCH_SKEWED_CORNER 8			/* Number of the sides and of the heights of the corner of the skewed workload. */
+
+#define BENCH_TAIL_RATIO 2			/* The most times the p99.9 GETBOX latency of the planner may take the best forced one, in the skewed workload. */
+
+#define BENCH_ORACLE_QUERIES 1000			/* Number of the answers of a phase which are checked against a brute-force oracle. */
+
+#define BENCH_PRICE_PERCENT 1			/* The percentage of the sizes which get a price in the cheapest workload. */
+
+#define BENCH_WAL_GROUP 64			/* The group size of the logs of the wal workload. */
+
+#define BENCH_SYNCED_CHANGES 2000			/* The most changes of a phase whose every change is synced. */
+
+#define BENCH_FILE_ROUNDS 5			/* Number of the times every file operation of the export workload is measured. */
+
+#define BENCH_SLOWEST_RATIO 3			/* The most times the slowest GETBOX of a rebuild may take the slowest of the others, in the cascade workload. */
+
+#define BENCH_DISK_BUDGETS (sizeof(bench_disk_budgets) / sizeof(bench_disk_budgets[0]))
+
+#define BENCH_PATH_SIZE 4096
+
+#define BENCH_OP_SIZE 64
+
+
+typedef enum bench_distribution_e {			/* The distribution of the sizes of the boxes and of the queries. */
+
+    BENCH_UNIFORM = 0,
+    BENCH_ZIPF = 1,
+    BENCH_ADVERSARIAL = 2,
+    BENCH_SKEWED = 3,
+} bench_distribution;
+
+
+typedef enum bench_mix_e {			/* The phases of a workload. */
+
+    BENCH_MIX_STANDARD = 0,			/* insert, get, check, mixed and remove. */
+    BENCH_MIX_RESTOCK = 1,			/* insert (a quarter of the boxes) and an insert-heavy mixed. */
+    BENCH_MIX_FULFILLMENT = 2,			/* insert and a take-heavy mixed. */
+} bench_mix;
+
+
+typedef struct bench_workload_s bench_workload;
+
+
+typedef struct bench_options_s bench_options;
+
+
+struct bench_workload_s {			/* A workload of the benchmark. */
+
+    const char *name;
+    bench_distribution distribution;
+    bench_mix mix;
+    bool (*run)(const bench_workload *workload, const bench_options *options, unsigned long long seed);			/* See bench_run. */
+};
+
+
+struct bench_options_s {			/* The parameters of a run. */
+
+    unsigned int boxes;
+    unsigned int queries;
+    unsigned long long seed;
+    unsigned long long range;
+    const char *workload;			/* The name of a single workload, or "all". */
+    const char *index;
+};
+
+
+typedef struct bench_generator_s {			/* A seeded generator of the sizes of a workload. */
+
+    bench_distribution distribution;
+    unsigned long long state;			/* The state of the xorshift generator. */
+    unsigned long long range;
+    unsigned long long salt;			/* Maps the ranks of the Zipfian distribution to sizes. */
+    double *zipf;			/* The cumulative distribution of the ranks of the Zipfian distribution. */
+    unsigned int zipf_count;
+} bench_generator;
+
+
+typedef struct bench_box_s {			/* A box of the factory, so REMOVEBOX removes boxes which exist. */
+
+    box_dim side;
+    box_dim height;
+} bench_box;
+
+
+typedef struct bench_box3d_s {			/* A box of the 3D factory, so REMOVEBOX removes boxes which exist. */
+
+    box_dim dims[BOX3D_DIMENSIONS];
+} bench_box3d;
+
+
+typedef struct bench_size_s {			/* A size of the boxes of the factory, for the brute-force oracle. */
+
+    box_dim side;
+    box_dim height;
+    bool priced;
+    double price;
+} bench_size;
+
+
+typedef struct bench_wal_policy_s {			/* A configuration of the log of the wal workload. */
+
+    const char *insert_op;			/* The names of its phases. */
+    const char *change_op;
+    const char *log_op;
+    bool logged;			/* FALSE for the box factory without a log. */
+    box_wal_sync sync;
+    unsigned int group_size;
+    bool bounded;			/* TRUE if its phases make at most BENCH_SYNCED_CHANGES changes. */
+} bench_wal_policy;
+
+
+static const double bench_epsilons[] = {0.01, 0.1, 0.5};			/* The epsilons of the approx workload. */
+
+
+static const size_t bench_disk_budgets[] = {128 * 1024, 512 * 1024, 2 * 1024 * 1024, 32 * 1024 * 1024};			/* The budgets of the disk workload. */
+
+
+static const bench_wal_policy bench_wal_policies[] = {
+
+    {"insert_unlogged", "change_unlogged", NULL, false, BOX_WAL_SYNC_NONE, 0, false},
+    {"insert_sync_none", "change_sync_none", "log_sync_none", true, BOX_WAL_SYNC_NONE, BENCH_WAL_GROUP, false},
+    {"insert_sync_group", "change_sync_group", "log_sync_group", true, BOX_WAL_SYNC_GROUP, BENCH_WAL_GROUP, false},
+    {"insert_sync_always", "change_sync_always", "log_sync_always", true, BOX_WAL_SYNC_ALWAYS, 1, true},
+};
+
+
+typedef struct bench_answer_s {			/* A query of the cheapest workload and the answer of the factory, kept for the oracle. */
+
+    box_dim side;
+    box_dim height;
+    bool found;
+    box_dim found_side_square;
+    box_dim found_height;
+    double found_cost;
+} bench_answer;
+
+
+typedef struct bench_phase_s {			/* The measurement of a phase of a workload. */
+
+    const char *workload;
+    const char *index;
+    const char *op;
+    double *latencies;			/* The latency of every operation of the phase, in seconds. */
+    unsigned int count;
+    unsigned long long allocations;			/* The allocations counter when the phase began. */
+    double started;
+} bench_phase;
+
+
+/* Run the given workload with a new factory, and print its phases. Returns FALSE on an error, TRUE otherwise. */
+
+static bool bench_run(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the box3d workload with a new 3D factory, and print its phases. Returns FALSE on an error, TRUE otherwise. */
+
+static bool bench_run_box3d(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the cheapest workload with a new factory, and print its phases. Returns FALSE on an error, or if an answer differs from the oracle, TRUE
+ otherwise. */
+
+static bool bench_run_cheapest(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the wal workload with a new factory for every policy, and print its phases. Returns FALSE on an error, TRUE otherwise. */
+
+static bool bench_run_wal(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the export workload with a new factory, and print its phases. Returns FALSE on an error, or if a factory read back lost boxes, TRUE otherwise. */
+
+static bool bench_run_export(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the approx workload with a new factory for every epsilon, and print its phases. Returns FALSE on an error, or if an approximate answer is out of
+ its bound, TRUE otherwise. */
+
+static bool bench_run_approx(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the skewed workload with a new factory, and print its phases. Returns FALSE on an error, if the answers of the directions differ, or if the
+ tail of GETBOX with the planner is too long, TRUE otherwise. */
+
+static bool bench_run_skewed(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the disk workload with a new factory for every memory budget and one in memory, and print its phases. Returns FALSE on an error, or if the
+ answers of the factories differ, TRUE otherwise. */
+
+static bool bench_run_disk(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+/* Run the cascade workload with a new factory, and print its phases. Returns FALSE on an error, or if a GETBOX which made a part of a rebuild was
+ too slow, TRUE otherwise. */
+
+static bool bench_run_cascade(const bench_workload *workload, const bench_options *options, unsigned long long seed);
+
+
+static const bench_workload bench_workloads[] = {
+
+    {"uniform", BENCH_UNIFORM, BENCH_MIX_STANDARD, bench_run},
+    {"zipf", BENCH_ZIPF, BENCH_MIX_STANDARD, bench_run},
+    {"adversarial", BENCH_ADVERSARIAL, BENCH_MIX_STANDARD, bench_run},
+    {"restock", BENCH_UNIFORM, BENCH_MIX_RESTOCK, bench_run},
+    {"fulfillment", BENCH_UNIFORM, BENCH_MIX_FULFILLMENT, bench_run},
+    {"box3d", BENCH_UNIFORM, BENCH_MIX_STANDARD, bench_run_box3d},
+    {"cheapest", BENCH_UNIFORM, BENCH_MIX_STANDARD, bench_run_cheapest},
+    {"wal", BENCH_UNIFORM, BENCH_MIX_STANDARD, bench_run_wal},
+    {"export", BENCH_UNIFORM, BENCH_MIX_STANDARD, bench_run_export},
+    {"approx", BENCH_ADVERSARIAL, BENCH_MIX_STANDARD, bench_run_approx},
+    {"skewed", BENCH_SKEWED, BENCH_MIX_STANDARD, bench_run_skewed},
+    {"disk", BENCH_UNIFORM, BENCH_MIX_STANDARD, bench_run_disk},
+    {"cascade", BENCH_UNIFORM, BENCH_MIX_STANDARD, bench_run_cascade},
+};
+
+
+static unsigned long long bench_allocations = 0;			/* Number of the calls of malloc, calloc and realloc. */
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the time of a monotonic clock, in seconds. */
+
+static double bench_now(void);
+
+
+/* Return the CPU time of the calling thread, in seconds - the time it ran, without the time the system gave the CPU to others. */
+
+static double bench_cpu_now(void);
+
+
+/* Return the next number of a xorshift generator of the given state. */
+
+static unsigned long long bench_random(unsigned long long *state);
+
+
+/* Return a well-mixed 64-bit hash of the given number (the finalizer of splitmix64.) */
+
+static unsigned long long bench_hash(unsigned long long value);
+
+
+/* Initialize the generator of the given distribution and seed. Returns FALSE on an allocation error, TRUE otherwise. */
+
+static bool bench_generator_init(bench_generator *generator, bench_distribution distribution, const bench_options *options, unsigned long long seed);
+
+
+/* Draw the dimensions of a box to insert. */
+
+static void bench_draw_box(bench_generator *generator, box_dim *side, box_dim *height);
+
+
+/* Draw the dimensions of a present to query. */
+
+static void bench_draw_present(bench_generator *generator, box_dim *side, box_dim *height);
+
+
+/* Begin to measure a phase of the given operation. */
+
+static void bench_phase_begin(bench_phase *phase, const char *op);
+
+
+/* Print the results of the phase. */
+
+static void bench_phase_end(bench_phase *phase);
+
+
+/* Insert a box to the factory and to the boxes which exist, and record its latency. Returns FALSE if the insertion failed, TRUE otherwise. */
+
+static bool bench_insert(box_factory *factory, bench_generator *generator, bench_box *boxes, unsigned int *box_count, bench_phase *phase);
+
+
+/* Remove a random box which exists from the factory, and record its latency. Returns FALSE if the removal failed, TRUE otherwise. */
+
+static bool bench_remove(box_factory *factory, bench_generator *generator, bench_box *boxes, unsigned int *box_count, bench_phase *phase);
+
+
+/* Run a GETBOX (and a REMOVEBOX of the box it found, if take is TRUE) or a CHECKBOX of a new present, and record its latency.
+ Returns FALSE if the removal failed, TRUE otherwise. */
+
+static bool bench_query(box_factory *factory, bench_generator *generator, bool get, bool take, bench_phase *phase);
+
+
+/* Draw the dimensions of a box of the 3D factory (or of a present for it.) */
+
+static void bench_draw_box3d(bench_generator *generator, box_dim dims[]);
+
+
+/* Insert a box to the 3D factory and to the boxes which exist, and record its latency. Returns FALSE if the insertion failed, TRUE otherwise. */
+
+static bool bench_insert_box3d(box3d_factory *factory, bench_generator *generator, bench_box3d *boxes, unsigned int *box_count, bench_phase *phase);
+
+
+/* Remove a random box which exists from the 3D factory, and record its latency. Returns FALSE if the removal failed, TRUE otherwise. */
+
+static bool bench_remove_box3d(box3d_factory *factory, bench_generator *generator, bench_box3d *boxes, unsigned int *box_count, bench_phase *phase);
+
+
+/* Run a GETBOX of a new present on the 3D factory, with the footprint rotated if rotate is TRUE, and record its latency. */
+
+static void bench_query_box3d(box3d_factory *factory, bench_generator *generator, bool rotate, bench_phase *phase);
+
+
+/* Set the options of a factory of the given index (see bench_options.) */
+
+static void bench_factory_options(const bench_options *options, box_factory_options *factory_options);
+
+
+/* The cost functions of the cheapest workload - a monotone one, and an arbitrary one. */
+
+static double bench_cost_monotone(box_dim side_square, box_dim height, void *context);
+
+static double bench_cost_arbitrary(box_dim side_square, box_dim height, void *context);
+
+
+/* The brute-force oracle of GET_CHEAPEST - the answer over all the sizes, with the given cost function (NULL for the volume.) */
+
+static bool bench_oracle_cheapest(const bench_size *sizes, unsigned int size_count, box_cost_function function, box_dim side, box_dim height,
+                                  bench_answer *answer);
+
+
+/* Run the given number of GET_CHEAPEST with the given cost function as a phase, and then check the first of their answers against the oracle.
+ Returns FALSE if an answer differs, TRUE otherwise. */
+
+static bool bench_cheapest_phase(box_factory *factory, bench_generator *generator, unsigned int queries, const bench_size *sizes, unsigned int size_count,
+                                 box_cost_function function, bool monotone, const char *op, bench_phase *phase, bench_answer *answers);
+
+
+/* Write the path of a temporary file of the benchmark, with the given suffix, to path (of BENCH_PATH_SIZE bytes.) */
+
+static void bench_temporary_path(char *path, const char *suffix);
+
+
+/* Run the phases of the wal workload of the given policy, with a new factory. Returns FALSE on an error, TRUE otherwise. */
+
+static bool bench_wal_policy_run(const bench_workload *workload, const bench_options *options, unsigned long long seed, const bench_wal_policy *policy,
+                                 bench_box *boxes, bench_phase *phase);
+
+
+/* Run an operation of the export workload BENCH_FILE_ROUNDS times as a phase - write the factory to the file of the given path (save or export), or
+ read a factory of the given options back from it (open_snapshot or import) and check it has the given number of boxes. Returns the mean seconds of
+ an operation, or a negative number on an error. */
+
+static double bench_file_phase(box_factory *factory, const char *op, const char *path, const box_factory_options *factory_options,
+                               unsigned long long boxes, bench_phase *phase);
+
+
+/* Run the given queries with the exact GETBOX (if approximate is FALSE) or the approximate one as a phase, and keep their answers.
+ The answers hold the volumes found (0 if none was found.) */
+
+static void bench_get_phase(box_factory *factory, const bench_box *presents, unsigned int count, bool approximate, const char *op, bench_phase *phase,
+                            box_volume *volumes);
+
+
+/* Measure CHECKBOX of the given presents as a phase of the given name, and keep its answers in results. */
+
+static void bench_check_phase(box_factory *factory, const bench_box *presents, unsigned int count, const char *op, bench_phase *phase, bool *results);
+
+
+/* Print the counters of the buffer pool of the B+-tree of the given factory since the given ones, per operation of the given phase. */
+
+static void bench_disk_pool(const box_factory *factory, const bench_phase *phase, size_t budget, const box_btree_stats *before);
+
+
+/* Set the histograms of the given planner so it picks tree_by_side for every query (side_first TRUE), or tree_by_height for every query. */
+
+static void bench_force_planner(box_planner *planner, bool side_first);
+
+
+/* Return TRUE if the given cascade went on with its rebuild since the given copy of it was taken. */
+
+static bool bench_cascade_moved(const box_cascade *before, const box_cascade *after);
+
+
+/* Comparison function between two boxes, for qsort - by side, then by height. */
+
+static int compare_boxes(const void *a, const void *b);
+
+
+/* Comparison function between two latencies, for qsort. */
+
+static int compare_latencies(const void *a, const void *b);
+
+
+/* The implementation: */
+
+
+#ifdef __GLIBC__
+
+/* The allocations are counted by functions which replace those of the C library for the whole process, and call its own ones. */
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void *pointer, size_t size);
+
+
+void* malloc(size_t size)
+{
+
+    bench_allocations++;
+
+    return __libc_malloc(size);
+}
+
+
+void* calloc(size_t count, size_t size)
+{
+
+    bench_allocations++;
+
+    return __libc_calloc(count, size);
+}
+
+
+void* realloc(void *pointer, size_t size)
+{
+
+    bench_allocations++;
+
+    return __libc_realloc(pointer, size);
+}
+
+#endif
+
+
+static double bench_now(void)
+{
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+static double bench_cpu_now(void)
+{
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+static unsigned long long bench_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static unsigned long long bench_hash(unsigned long long value)
+{
+
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+
+    return value ^ (value >> 31);
+}
+
+
+static bool bench_generator_init(bench_generator *generator, bench_distribution distribution, const bench_options *options, unsigned long long seed)
+{
+
+    unsigned int i = 0;
+    double sum = 0;
+
+    memset(generator, 0, sizeof(bench_generator));
+
+    generator->distribution = distribution;
+    generator->state = bench_hash(seed) | 1;			/* xorshift never leaves 0. */
+    generator->range = options->range;
+    generator->salt = bench_hash(seed ^ 0x5A5A5A5A5A5A5A5AULL);
+
+    if (distribution != BENCH_ZIPF) {
+
+        return true;
+    }
+
+    /* Rank i (from 0) is drawn with a probability proportional to 1 / (i + 1) ^ exponent. */
+
+    generator->zipf_count = (options->boxes == 0) ? 1 : ((options->boxes > BENCH_ZIPF_MAX_SIZES) ? BENCH_ZIPF_MAX_SIZES : options->boxes);
+    generator->zipf = malloc(sizeof(double) * generator->zipf_count);
+
+    if (generator->zipf == NULL) {
+
+        return false;
+    }
+
+    for (i = 0; i < generator->zipf_count; ++i) {
+
+        sum += 1.0 / pow((double) (i + 1), BENCH_ZIPF_EXPONENT);
+        generator->zipf[i] = sum;
+    }
+
+    for (i = 0; i < generator->zipf_count; ++i) {
+
+        generator->zipf[i] /= sum;
+    }
+
+    return true;
+}
+
+
+static void bench_draw_box(bench_generator *generator, box_dim *side, box_dim *height)
+{
+
+    unsigned long long value = 0;
+    unsigned long long quotient = 0;
+    double uniform = 0;
+    unsigned int low = 0;
+    unsigned int high = 0;
+    unsigned int middle = 0;
+
+    switch (generator->distribution) {
+
+        case BENCH_ZIPF:
+
+            /* The rank is the first whose cumulative probability reaches a uniform number in [0, 1), and its size is a hash of the rank. */
+
+            uniform = (double) (bench_random(&(generator->state)) >> 11) / 9007199254740992.0;
+            high = generator->zipf_count - 1;
+
+            while (low < high) {
+
+                middle = low + (high - low) / 2;
+
+                if (generator->zipf[middle] < uniform) {
+
+                    low = middle + 1;
+                }
+
+                else {
+
+                    high = middle;
+                }
+            }
+
+            value = bench_hash(generator->salt ^ low);
+            *side = (box_dim) (1 + (value & 0xFFFFFFFFULL) % generator->range);
+            *height = (box_dim) (1 + (value >> 32) % generator->range);
+            break;
+
+        case BENCH_ADVERSARIAL:
+
+            *side = (box_dim) (1 + bench_random(&(generator->state)) % generator->range);
+            quotient = generator->range / *side;
+            *height = (box_dim) (quotient * quotient + 1 + bench_random(&(generator->state)) % 8);
+            break;
+
+        case BENCH_SKEWED:
+
+            /* A box of the lower half, or a box of the corner. */
+
+            if (bench_random(&(generator->state)) & 1) {
+
+                *side = (box_dim) (1 + bench_random(&(generator->state)) % ((generator->range + 1) / 2));
+                *height = (box_dim) (1 + bench_random(&(generator->state)) % ((generator->range + 1) / 2));
+            }
+
+            else {
+
+                quotient = (generator->range < BENCH_SKEWED_CORNER) ? generator->range : BENCH_SKEWED_CORNER;
+                *side = (box_dim) (generator->range - bench_random(&(generator->state)) % quotient);
+                *height = (box_dim) (generator->range - bench_random(&(generator->state)) % quotient);
+            }
+
+            break;
+
+        default:
+
+            *side = (box_dim) (1 + bench_random(&(generator->state)) % generator->range);
+            *height = (box_dim) (1 + bench_random(&(generator->state)) % generator->range);
+            break;
+    }
+}
+
+
+static void bench_draw_present(bench_generator *generator, box_dim *side, box_dim *height)
+{
+
+    box_dim swapped = 0;
+
+    if (generator->distribution == BENCH_SKEWED) {
+
+        /* A high present or a wide one - only the boxes of the corner are larger than the lower half in both dimensions. */
+
+        *side = (box_dim) (1 + bench_random(&(generator->state)) % ((generator->range + 1) / 2));
+        *height = (box_dim) (generator->range - bench_random(&(generator->state)) % ((generator->range + 1) / 2));
+
+        if (bench_random(&(generator->state)) & 1) {
+
+            swapped = *side;
+            *side = *height;
+            *height = swapped;
+        }
+
+        return;
+    }
+
+    if (generator->distribution != BENCH_ADVERSARIAL) {
+
+        bench_draw_box(generator, side, height);
+        return;
+    }
+
+    /* A side in the lower half, and a low height - every side from it up to about range / sqrt(height) is suitable. */
+
+    *side = (box_dim) (1 + bench_random(&(generator->state)) % ((generator->range + 1) / 2));
+    *height = (box_dim) (1 + bench_random(&(generator->state)) % BENCH_ADVERSARIAL_MAX_HEIGHT);
+}
+
+
+static void bench_phase_begin(bench_phase *phase, const char *op)
+{
+
+    phase->op = op;
+    phase->count = 0;
+    phase->allocations = bench_allocations;
+    phase->started = bench_now();
+}
+
+
+static void bench_phase_end(bench_phase *phase)
+{
+
+    double seconds = bench_now() - phase->started;
+    unsigned int count = phase->count;
+    double allocations = (count == 0) ? 0 : (double) (bench_allocations - phase->allocations) / count;
+    double *latencies = phase->latencies;
+    struct rusage usage;
+
+    memset(&usage, 0, sizeof(usage));
+    getrusage(RUSAGE_SELF, &usage);
+
+    qsort(latencies, count, sizeof(double), compare_latencies);
+
+#ifndef __GLIBC__
+    allocations = -1;
+#endif
+
+    printf("workload=%s index=%s op=%s ops=%u seconds=%.6f ops_per_sec=%.0f p50_ns=%.0f p90_ns=%.0f p99_ns=%.0f p999_ns=%.0f max_ns=%.0f "
+           "allocs_per_op=%.3f peak_rss_kb=%ld\n", phase->workload, phase->index, phase->op, count, seconds, (seconds > 0) ? count / seconds : 0,
+           (count == 0) ? 0 : latencies[count / 2] * 1e9, (count == 0) ? 0 : latencies[(count * 9ULL) / 10] * 1e9,
+           (count == 0) ? 0 : latencies[(count * 99ULL) / 100] * 1e9, (count == 0) ? 0 : latencies[(count * 999ULL) / 1000] * 1e9,
+           (count == 0) ? 0 : latencies[count - 1] * 1e9, allocations, usage.ru_maxrss);
+}
+
+
+static bool bench_insert(box_factory *factory, bench_generator *generator, bench_box *boxes, unsigned int *box_count, bench_phase *phase)
+{
+
+    box_dim side = 0;
+    box_dim height = 0;
+    double started = 0;
+    bool result = false;
+
+    bench_draw_box(generator, &side, &height);
+
+    started = bench_now();
+    result = box_factory_insert(factory, side, height);
+    phase->latencies[phase->count++] = bench_now() - started;
+
+    if (result) {
+
+        boxes[*box_count].side = side;
+        boxes[*box_count].height = height;
+        (*box_count)++;
+    }
+
+    return result;
+}
+
+
+static bool bench_remove(box_factory *factory, bench_generator *generator, bench_box *boxes, unsigned int *box_count, bench_phase *phase)
+{
+
+    unsigned int chosen = (unsigned int) (bench_random(&(generator->state)) % *box_count);
+    bench_box box = boxes[chosen];
+    double started = 0;
+    bool result = false;
+
+    boxes[chosen] = boxes[--(*box_count)];
+
+    started = bench_now();
+    result = box_factory_remove(factory, box.side, box.height);
+    phase->latencies[phase->count++] = bench_now() - started;
+
+    return result;
+}
+
+
+static bool bench_query(box_factory *factory, bench_generator *generator, bool get, bool take, bench_phase *phase)
+{
+
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    double started = 0;
+    bool result = true;
+
+    bench_draw_present(generator, &side, &height);
+
+    started = bench_now();
+
+    if (!get) {
+
+        box_factory_check_box(factory, side, height);
+    }
+
+    else {
+
+        if (box_factory_get_box(factory, side, height, &found_side_square, &found_height) && take) {
+
+            result = box_factory_remove(factory, (box_dim) (sqrt((double) found_side_square) + 0.5), found_height);
+        }
+    }
+
+    phase->latencies[phase->count++] = bench_now() - started;
+
+    return result;
+}
+
+
+static bool bench_run(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    unsigned int box_count = 0;
+    unsigned int preload = (workload->mix == BENCH_MIX_RESTOCK) ? options->boxes / 4 : options->boxes;
+    unsigned int capacity = options->boxes + options->queries;
+    unsigned int percent = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+
+    bench_factory_options(options, &factory_options);
+
+    if (!bench_generator_init(&generator, workload->distribution, options, seed)) {
+
+        printf("Error: Allocation failed\n");
+        return false;
+    }
+
+    factory = box_factory_create_with_options(&factory_options);
+    boxes = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    if ((factory == NULL) || (boxes == NULL) || (phase.latencies == NULL)) {
+
+        printf("Error: Unable to create the box factory (index %s)\n", options->index);
+
+        if (factory != NULL) {
+
+            box_factory_destroy(factory);
+        }
+
+        free(boxes);
+        free(phase.latencies);
+        free(generator.zipf);
+        return false;
+    }
+
+    bench_phase_begin(&phase, "insert");
+
+    for (i = 0; (i < preload) && ok; ++i) {
+
+        ok = bench_insert(factory, &generator, boxes, &box_count, &phase);
+    }
+
+    bench_phase_end(&phase);
+
+    if (ok && (workload->mix == BENCH_MIX_STANDARD)) {
+
+        bench_phase_begin(&phase, "get");
+
+        for (i = 0; i < options->queries; ++i) {
+
+            bench_query(factory, &generator, true, false, &phase);
+        }
+
+        bench_phase_end(&phase);
+        bench_phase_begin(&phase, "check");
+
+        for (i = 0; i < options->queries; ++i) {
+
+            bench_query(factory, &generator, false, false, &phase);
+        }
+
+        bench_phase_end(&phase);
+    }
+
+    if (ok) {
+
+        bench_phase_begin(&phase, "mixed");
+
+        for (i = 0; (i < options->queries) && ok; ++i) {
+
+            percent = (unsigned int) (bench_random(&(generator.state)) % 100);
+
+            switch (workload->mix) {
+
+                case BENCH_MIX_RESTOCK:
+
+                    ok = (percent < 70) ? bench_insert(factory, &generator, boxes, &box_count, &phase)
+                                        : bench_query(factory, &generator, percent < 85, false, &phase);
+                    break;
+
+                case BENCH_MIX_FULFILLMENT:
+
+                    /* The boxes taken aren't tracked - nothing else is removed in this workload. */
+
+                    ok = (percent < 85) ? bench_query(factory, &generator, true, true, &phase)
+                                        : bench_insert(factory, &generator, boxes, &box_count, &phase);
+                    break;
+
+                default:
+
+                    if ((percent < 70) || ((percent >= 85) && (box_count == 0))) {
+
+                        bench_query(factory, &generator, percent < 40, false, &phase);
+                    }
+
+                    else {
+
+                        ok = (percent < 85) ? bench_insert(factory, &generator, boxes, &box_count, &phase)
+                                            : bench_remove(factory, &generator, boxes, &box_count, &phase);
+                    }
+
+                    break;
+            }
+        }
+
+        bench_phase_end(&phase);
+    }
+
+    if (ok && (workload->mix == BENCH_MIX_STANDARD)) {
+
+        bench_phase_begin(&phase, "remove");
+
+        while ((box_count > 0) && ok) {
+
+            ok = bench_remove(factory, &generator, boxes, &box_count, &phase);
+        }
+
+        bench_phase_end(&phase);
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    box_factory_destroy(factory);
+    free(boxes);
+    free(phase.latencies);
+    free(generator.zipf);
+
+    return ok;
+}
+
+
+static void bench_draw_box3d(bench_generator *generator, box_dim dims[])
+{
+
+    unsigned int i = 0;
+
+    for (i = 0; i < BOX3D_DIMENSIONS; ++i) {
+
+        dims[i] = (box_dim) (1 + bench_random(&(generator->state)) % generator->range);
+    }
+}
+
+
+static bool bench_insert_box3d(box3d_factory *factory, bench_generator *generator, bench_box3d *boxes, unsigned int *box_count, bench_phase *phase)
+{
+
+    bench_box3d box;
+    double started = 0;
+    bool result = false;
+
+    bench_draw_box3d(generator, box.dims);
+
+    started = bench_now();
+    result = box3d_factory_insert(factory, box.dims[0], box.dims[1], box.dims[2]);
+    phase->latencies[phase->count++] = bench_now() - started;
+
+    if (result) {
+
+        boxes[(*box_count)++] = box;
+    }
+
+    return result;
+}
+
+
+static bool bench_remove_box3d(box3d_factory *factory, bench_generator *generator, bench_box3d *boxes, unsigned int *box_count, bench_phase *phase)
+{
+
+    unsigned int chosen = (unsigned int) (bench_random(&(generator->state)) % *box_count);
+    bench_box3d box = boxes[chosen];
+    double started = 0;
+    bool result = false;
+
+    boxes[chosen] = boxes[--(*box_count)];
+
+    started = bench_now();
+    result = box3d_factory_remove(factory, box.dims[0], box.dims[1], box.dims[2]);
+    phase->latencies[phase->count++] = bench_now() - started;
+
+    return result;
+}
+
+
+static void bench_query_box3d(box3d_factory *factory, bench_generator *generator, bool rotate, bench_phase *phase)
+{
+
+    box_dim dims[BOX3D_DIMENSIONS];
+    box_dim found[BOX3D_DIMENSIONS];
+    double started = 0;
+
+    bench_draw_box3d(generator, dims);
+
+    started = bench_now();
+    box3d_factory_get_box(factory, dims[0], dims[1], dims[2], rotate, &(found[0]), &(found[1]), &(found[2]));
+    phase->latencies[phase->count++] = bench_now() - started;
+}
+
+
+static bool bench_run_box3d(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    box3d_factory *factory = NULL;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box3d *boxes = NULL;
+    unsigned int box_count = 0;
+    unsigned int capacity = options->boxes + options->queries;
+    unsigned int percent = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+
+    if (!bench_generator_init(&generator, workload->distribution, options, seed)) {
+
+        printf("Error: Allocation failed\n");
+        return false;
+    }
+
+    factory = box3d_factory_create();
+    boxes = malloc(sizeof(bench_box3d) * ((capacity == 0) ? 1 : capacity));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = "kd";
+
+    if ((factory == NULL) || (boxes == NULL) || (phase.latencies == NULL)) {
+
+        printf("Error: Unable to create the 3D box factory\n");
+
+        if (factory != NULL) {
+
+            box3d_factory_destroy(factory);
+        }
+
+        free(boxes);
+        free(phase.latencies);
+        return false;
+    }
+
+    bench_phase_begin(&phase, "insert");
+
+    for (i = 0; (i < options->boxes) && ok; ++i) {
+
+        ok = bench_insert_box3d(factory, &generator, boxes, &box_count, &phase);
+    }
+
+    bench_phase_end(&phase);
+
+    if (ok) {
+
+        bench_phase_begin(&phase, "get");
+
+        for (i = 0; i < options->queries; ++i) {
+
+            bench_query_box3d(factory, &generator, false, &phase);
+        }
+
+        bench_phase_end(&phase);
+        bench_phase_begin(&phase, "get_rotated");
+
+        for (i = 0; i < options->queries; ++i) {
+
+            bench_query_box3d(factory, &generator, true, &phase);
+        }
+
+        bench_phase_end(&phase);
+        bench_phase_begin(&phase, "mixed");
+
+        for (i = 0; (i < options->queries) && ok; ++i) {
+
+            percent = (unsigned int) (bench_random(&(generator.state)) % 100);
+
+            if ((percent < 70) || ((percent >= 85) && (box_count == 0))) {
+
+                bench_query_box3d(factory, &generator, false, &phase);
+            }
+
+            else {
+
+                ok = (percent < 85) ? bench_insert_box3d(factory, &generator, boxes, &box_count, &phase)
+                                    : bench_remove_box3d(factory, &generator, boxes, &box_count, &phase);
+            }
+        }
+
+        bench_phase_end(&phase);
+    }
+
+    if (ok) {
+
+        bench_phase_begin(&phase, "remove");
+
+        while ((box_count > 0) && ok) {
+
+            ok = bench_remove_box3d(factory, &generator, boxes, &box_count, &phase);
+        }
+
+        bench_phase_end(&phase);
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    box3d_factory_destroy(factory);
+    free(boxes);
+    free(phase.latencies);
+
+    return ok;
+}
+
+
+static void bench_factory_options(const bench_options *options, box_factory_options *factory_options)
+{
+
+    memset(factory_options, 0, sizeof(box_factory_options));
+
+    if (strcmp(options->index, "veb") == 0) {
+
+        factory_options->index_type = BOX_FACTORY_INDEX_VEB;
+    }
+
+    else {
+
+        if (strcmp(options->index, "auto") == 0) {
+
+            factory_options->index_type = BOX_FACTORY_INDEX_AUTO;
+        }
+
+        else {
+
+            factory_options->arena = (strcmp(options->index, "arena") == 0);
+        }
+    }
+}
+
+
+static double bench_cost_monotone(box_dim side_square, box_dim height, void *context)
+{
+
+    (void) context;
+
+    return (double) side_square + 4.0 * height;			/* The area of the base and four times the height. */
+}
+
+
+static double bench_cost_arbitrary(box_dim side_square, box_dim height, void *context)
+{
+
+    (void) context;
+
+    return (double) (bench_hash(((unsigned long long) side_square << 32) ^ height) % 1000);			/* Many equal costs, in no order. */
+}
+
+
+static bool bench_oracle_cheapest(const bench_size *sizes, unsigned int size_count, box_cost_function function, box_dim side, box_dim height,
+                                  bench_answer *answer)
+{
+
+    unsigned int i = 0;
+    box_dim side_square = 0;
+    box_volume volume = 0;
+    box_volume best_volume = 0;
+    double cost = 0;
+    bool better = false;
+
+    answer->found = false;
+    answer->found_side_square = 0;
+    answer->found_height = 0;
+    answer->found_cost = 0;
+
+    for (i = 0; i < size_count; ++i) {
+
+        if ((sizes[i].side < side) || (sizes[i].height < height)) {
+
+            continue;
+        }
+
+        side_square = sizes[i].side * sizes[i].side;
+        volume = (box_volume) side_square * sizes[i].height;
+        cost = (function == NULL) ? (double) side_square * sizes[i].height : function(side_square, sizes[i].height, NULL);
+        cost = sizes[i].priced ? sizes[i].price : cost;
+
+        /* The order of box_factory_get_cheapest - the cost, then the volume, then the side and then the height. */
+
+        better = !answer->found || (cost < answer->found_cost);
+
+        if (answer->found && (cost == answer->found_cost)) {
+
+            better = (volume < best_volume) || ((volume == best_volume) && ((side_square < answer->found_side_square) ||
+                                                                           ((side_square == answer->found_side_square) &&
+                                                                            (sizes[i].height < answer->found_height))));
+        }
+
+        if (better) {
+
+            answer->found = true;
+            answer->found_cost = cost;
+            answer->found_side_square = side_square;
+            answer->found_height = sizes[i].height;
+            best_volume = volume;
+        }
+    }
+
+    return answer->found;
+}
+
+
+static bool bench_cheapest_phase(box_factory *factory, bench_generator *generator, unsigned int queries, const bench_size *sizes, unsigned int size_count,
+                                 box_cost_function function, bool monotone, const char *op, bench_phase *phase, bench_answer *answers)
+{
+
+    bench_answer expected;
+    bench_answer *answer = NULL;
+    unsigned int checked = (queries < BENCH_ORACLE_QUERIES) ? queries : BENCH_ORACLE_QUERIES;
+    unsigned int mismatches = 0;
+    unsigned int i = 0;
+    double started = 0;
+
+    box_factory_set_cost_function(factory, function, NULL, monotone);
+
+    bench_phase_begin(phase, op);
+
+    for (i = 0; i < queries; ++i) {
+
+        answer = &(answers[(i < checked) ? i : checked]);			/* The answers past the checked ones share the last element. */
+
+        bench_draw_present(generator, &(answer->side), &(answer->height));
+
+        started = bench_now();
+        answer->found = box_factory_get_cheapest(factory, answer->side, answer->height, &(answer->found_side_square), &(answer->found_height),
+                                                 &(answer->found_cost));
+        phase->latencies[phase->count++] = bench_now() - started;
+    }
+
+    bench_phase_end(phase);
+
+    for (i = 0; i < checked; ++i) {
+
+        answer = &(answers[i]);
+
+        bench_oracle_cheapest(sizes, size_count, function, answer->side, answer->height, &expected);
+
+        if ((answer->found != expected.found) || (answer->found && ((answer->found_side_square != expected.found_side_square) ||
+                                                                    (answer->found_height != expected.found_height) ||
+                                                                    (answer->found_cost != expected.found_cost)))) {
+
+            if (mismatches == 0) {
+
+                printf("mismatch op=%s side=%llu height=%llu found=%d side_square=%llu found_height=%llu cost=%.17g expected_found=%d "
+                       "expected_side_square=%llu expected_height=%llu expected_cost=%.17g\n", op, (unsigned long long) answer->side,
+                       (unsigned long long) answer->height, answer->found, (unsigned long long) answer->found_side_square,
+                       (unsigned long long) answer->found_height, answer->found_cost, expected.found, (unsigned long long) expected.found_side_square,
+                       (unsigned long long) expected.found_height, expected.found_cost);
+            }
+
+            mismatches++;
+        }
+    }
+
+    printf("workload=%s index=%s op=%s_oracle checked=%u mismatches=%u\n", phase->workload, phase->index, op, checked, mismatches);
+
+    return (mismatches == 0);
+}
+
+
+static bool bench_run_cheapest(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    bench_size *sizes = NULL;
+    bench_answer *answers = NULL;
+    unsigned int box_count = 0;
+    unsigned int size_count = 0;
+    unsigned int capacity = (options->boxes > options->queries) ? options->boxes : options->queries;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+
+    bench_factory_options(options, &factory_options);
+
+    if (!bench_generator_init(&generator, workload->distribution, options, seed)) {
+
+        printf("Error: Allocation failed\n");
+        return false;
+    }
+
+    factory = box_factory_create_with_options(&factory_options);
+    boxes = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    sizes = malloc(sizeof(bench_size) * ((capacity == 0) ? 1 : capacity));
+    answers = malloc(sizeof(bench_answer) * (BENCH_ORACLE_QUERIES + 1));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    if ((factory == NULL) || (boxes == NULL) || (sizes == NULL) || (answers == NULL) || (phase.latencies == NULL)) {
+
+        printf("Error: Unable to create the box factory (index %s)\n", options->index);
+
+        if (factory != NULL) {
+
+            box_factory_destroy(factory);
+        }
+
+        free(boxes);
+        free(sizes);
+        free(answers);
+        free(phase.latencies);
+        return false;
+    }
+
+    bench_phase_begin(&phase, "insert");
+
+    for (i = 0; (i < options->boxes) && ok; ++i) {
+
+        ok = bench_insert(factory, &generator, boxes, &box_count, &phase);
+    }
+
+    bench_phase_end(&phase);
+
+    /* The sizes of the oracle - the boxes in order, once each. */
+
+    qsort(boxes, box_count, sizeof(bench_box), compare_boxes);
+
+    for (i = 0; i < box_count; ++i) {
+
+        if ((size_count == 0) || (boxes[i].side != sizes[size_count - 1].side) || (boxes[i].height != sizes[size_count - 1].height)) {
+
+            sizes[size_count].side = boxes[i].side;
+            sizes[size_count].height = boxes[i].height;
+            sizes[size_count].priced = false;
+            size_count++;
+        }
+    }
+
+    if (ok) {
+
+        /* A price between half the volume and one and a half times the volume - some priced sizes are the cheapest, some are not. */
+
+        bench_phase_begin(&phase, "set_price");
+
+        for (i = 0; (i < size_count) && ok; ++i) {
+
+            if (bench_random(&(generator.state)) % 100 >= BENCH_PRICE_PERCENT) {
+
+                continue;
+            }
+
+            sizes[i].priced = true;
+            sizes[i].price = (double) sizes[i].side * sizes[i].side * sizes[i].height * (0.5 + (double) (bench_random(&(generator.state)) % 1000) / 1000);
+
+            phase.latencies[phase.count] = bench_now();
+            ok = box_factory_set_price(factory, sizes[i].side, sizes[i].height, sizes[i].price);
+            phase.latencies[phase.count] = bench_now() - phase.latencies[phase.count];
+            phase.count++;
+        }
+
+        bench_phase_end(&phase);
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    /* An arbitrary cost visits every suitable size - it runs only the queries which are checked. */
+
+    ok = ok && bench_cheapest_phase(factory, &generator, options->queries, sizes, size_count, NULL, true, "cheapest_volume", &phase, answers);
+    ok = ok && bench_cheapest_phase(factory, &generator, options->queries, sizes, size_count, bench_cost_monotone, true, "cheapest_monotone", &phase,
+                                    answers);
+    ok = ok && bench_cheapest_phase(factory, &generator, (options->queries < BENCH_ORACLE_QUERIES) ? options->queries : BENCH_ORACLE_QUERIES, sizes,
+                                    size_count, bench_cost_arbitrary, false, "cheapest_arbitrary", &phase, answers);
+
+    box_factory_destroy(factory);
+    free(boxes);
+    free(sizes);
+    free(answers);
+    free(phase.latencies);
+
+    return ok;
+}
+
+
+static void bench_temporary_path(char *path, const char *suffix)
+{
+
+    const char *directory = getenv("TMPDIR");
+
+    snprintf(path, BENCH_PATH_SIZE, "%s/box_bench_%ld.%s", ((directory == NULL) || (directory[0] == '\0')) ? "/tmp" : directory, (long) getpid(),
+             suffix);
+}
+
+
+static bool bench_wal_policy_run(const bench_workload *workload, const bench_options *options, unsigned long long seed, const bench_wal_policy *policy,
+                                 bench_box *boxes, bench_phase *phase)
+{
+
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    bench_generator generator;
+    char path[BENCH_PATH_SIZE];
+    unsigned int box_count = 0;
+    unsigned int changes = options->queries;
+    unsigned int preload = options->boxes;
+    unsigned int percent = 0;
+    unsigned int i = 0;
+    box_wal_stats stats;
+    bool ok = true;
+
+    bench_factory_options(options, &factory_options);
+    bench_temporary_path(path, "wal");
+
+    if (!bench_generator_init(&generator, workload->distribution, options, seed)) {			/* Every policy makes the same changes. */
+
+        printf("Error: Allocation failed\n");
+        return false;
+    }
+
+    if (policy->bounded) {
+
+        preload = (preload < BENCH_SYNCED_CHANGES) ? preload : BENCH_SYNCED_CHANGES;
+        changes = (changes < BENCH_SYNCED_CHANGES) ? changes : BENCH_SYNCED_CHANGES;
+    }
+
+    if (policy->logged) {
+
+        unlink(path);
+        factory = box_factory_recover(NULL, path, &factory_options, policy->sync, policy->group_size);
+    }
+
+    else {
+
+        factory = box_factory_create_with_options(&factory_options);
+    }
+
+    if (factory == NULL) {
+
+        printf("Error: Unable to create the box factory (index %s, log %s)\n", options->index, path);
+        free(generator.zipf);
+        return false;
+    }
+
+    bench_phase_begin(phase, policy->insert_op);
+
+    for (i = 0; (i < preload) && ok; ++i) {
+
+        ok = bench_insert(factory, &generator, boxes, &box_count, phase);
+    }
+
+    bench_phase_end(phase);
+
+    if (ok) {
+
+        bench_phase_begin(phase, policy->change_op);
+
+        for (i = 0; (i < changes) && ok; ++i) {
+
+            percent = (unsigned int) (bench_random(&(generator.state)) % 100);
+
+            ok = ((percent < 50) || (box_count == 0)) ? bench_insert(factory, &generator, boxes, &box_count, phase)
+                                                      : bench_remove(factory, &generator, boxes, &box_count, phase);
+        }
+
+        bench_phase_end(phase);
+    }
+
+    ok = ok && box_factory_sync(factory);
+
+    if (ok && policy->logged) {
+
+        stats = factory->wal->stats;
+
+        printf("workload=%s index=%s op=%s changes=%llu groups=%llu syncs=%llu bytes=%llu bytes_per_change=%.2f syncs_per_change=%.4f\n",
+               workload->name, options->index, policy->log_op, stats.records, stats.groups, stats.syncs, stats.bytes,
+               (stats.records == 0) ? 0 : (double) stats.bytes / stats.records, (stats.records == 0) ? 0 : (double) stats.syncs / stats.records);
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed (%s)\n", workload->name, policy->change_op);
+    }
+
+    box_factory_destroy(factory);
+    free(generator.zipf);
+
+    if (policy->logged) {
+
+        unlink(path);
+    }
+
+    return ok;
+}
+
+
+static bool bench_run_wal(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    unsigned int capacity = options->boxes + options->queries;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+
+    boxes = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    if ((boxes == NULL) || (phase.latencies == NULL)) {
+
+        printf("Error: Allocation failed\n");
+
+        free(boxes);
+        free(phase.latencies);
+        return false;
+    }
+
+    for (i = 0; (i < sizeof(bench_wal_policies) / sizeof(bench_wal_policies[0])) && ok; ++i) {
+
+        ok = bench_wal_policy_run(workload, options, seed, &(bench_wal_policies[i]), boxes, &phase);
+    }
+
+    free(boxes);
+    free(phase.latencies);
+
+    return ok;
+}
+
+
+static double bench_file_phase(box_factory *factory, const char *op, const char *path, const box_factory_options *factory_options,
+                               unsigned long long boxes, bench_phase *phase)
+{
+
+    box_factory *read = NULL;
+    double started = 0;
+    double total = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    bench_phase_begin(phase, op);
+
+    for (i = 0; (i < BENCH_FILE_ROUNDS) && ok; ++i) {
+
+        read = NULL;
+        started = bench_now();
+
+        if (strcmp(op, "save") == 0) {
+
+            ok = box_factory_save(factory, path);
+        }
+
+        else {
+
+            if (strcmp(op, "export") == 0) {
+
+                ok = box_factory_export(factory, path);
+            }
+
+            else {
+
+                read = (strcmp(op, "import") == 0) ? box_factory_import(path, factory_options) : box_factory_open_snapshot(path, factory_options, false);
+                ok = (read != NULL);
+            }
+        }
+
+        phase->latencies[phase->count] = bench_now() - started;
+        total += phase->latencies[phase->count++];
+
+        if (read != NULL) {
+
+            ok = (box_factory_count_suitable(read, 0, 0) == boxes);
+            box_factory_destroy(read);
+        }
+    }
+
+    bench_phase_end(phase);
+
+    if (!ok) {
+
+        printf("Error: The %s of %s failed\n", op, path);
+        return -1;
+    }
+
+    return total / BENCH_FILE_ROUNDS;
+}
+
+
+static bool bench_run_export(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    char snapshot_path[BENCH_PATH_SIZE];
+    char export_path[BENCH_PATH_SIZE];
+    struct stat snapshot_status;
+    struct stat export_status;
+    const char *ops[] = {"save", "export", "open_snapshot", "import"};
+    double seconds[sizeof(ops) / sizeof(ops[0])];
+    unsigned int box_count = 0;
+    unsigned int sizes = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+
+    bench_factory_options(options, &factory_options);
+    bench_temporary_path(snapshot_path, "snapshot");
+    bench_temporary_path(export_path, "export");
+
+    if (!bench_generator_init(&generator, workload->distribution, options, seed)) {
+
+        printf("Error: Allocation failed\n");
+        return false;
+    }
+
+    factory = box_factory_create_with_options(&factory_options);
+    boxes = malloc(sizeof(bench_box) * ((options->boxes == 0) ? 1 : options->boxes));
+    phase.latencies = malloc(sizeof(double) * (((options->boxes > BENCH_FILE_ROUNDS) ? options->boxes : BENCH_FILE_ROUNDS)));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    if ((factory == NULL) || (boxes == NULL) || (phase.latencies == NULL)) {
+
+        printf("Error: Unable to create the box factory (index %s)\n", options->index);
+
+        if (factory != NULL) {
+
+            box_factory_destroy(factory);
+        }
+
+        free(boxes);
+        free(phase.latencies);
+        free(generator.zipf);
+        return false;
+    }
+
+    bench_phase_begin(&phase, "insert");
+
+    for (i = 0; (i < options->boxes) && ok; ++i) {
+
+        ok = bench_insert(factory, &generator, boxes, &box_count, &phase);
+    }
+
+    bench_phase_end(&phase);
+
+    /* The files hold every size once - count the sizes, for the sizes per second. */
+
+    qsort(boxes, box_count, sizeof(bench_box), compare_boxes);
+
+    for (i = 0; i < box_count; ++i) {
+
+        sizes += ((i == 0) || (boxes[i].side != boxes[i - 1].side) || (boxes[i].height != boxes[i - 1].height)) ? 1 : 0;
+    }
+
+    /* The files are read back in the order they are written - each after its writer. */
+
+    for (i = 0; (i < sizeof(ops) / sizeof(ops[0])) && ok; ++i) {
+
+        seconds[i] = bench_file_phase(factory, ops[i], (i % 2 == 0) ? snapshot_path : export_path, &factory_options, box_count, &phase);
+        ok = (seconds[i] >= 0);
+    }
+
+    if (ok && (stat(snapshot_path, &snapshot_status) == 0) && (stat(export_path, &export_status) == 0)) {
+
+        printf("workload=%s index=%s op=export_vs_snapshot boxes=%u sizes=%u snapshot_bytes=%lld export_bytes=%lld ratio=%.3f "
+               "snapshot_bytes_per_size=%.2f export_bytes_per_size=%.2f save_sizes_per_sec=%.0f export_sizes_per_sec=%.0f "
+               "open_snapshot_sizes_per_sec=%.0f import_sizes_per_sec=%.0f\n", workload->name, options->index, box_count, sizes,
+               (long long) snapshot_status.st_size, (long long) export_status.st_size,
+               (snapshot_status.st_size == 0) ? 0 : (double) export_status.st_size / snapshot_status.st_size,
+               (sizes == 0) ? 0 : (double) snapshot_status.st_size / sizes, (sizes == 0) ? 0 : (double) export_status.st_size / sizes,
+               (seconds[0] > 0) ? sizes / seconds[0] : 0, (seconds[1] > 0) ? sizes / seconds[1] : 0, (seconds[2] > 0) ? sizes / seconds[2] : 0,
+               (seconds[3] > 0) ? sizes / seconds[3] : 0);
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    unlink(snapshot_path);
+    unlink(export_path);
+
+    box_factory_destroy(factory);
+    free(boxes);
+    free(phase.latencies);
+    free(generator.zipf);
+
+    return ok;
+}
+
+
+static void bench_get_phase(box_factory *factory, const bench_box *presents, unsigned int count, bool approximate, const char *op, bench_phase *phase,
+                            box_volume *volumes)
+{
+
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    double started = 0;
+    bool found = false;
+    unsigned int i = 0;
+
+    bench_phase_begin(phase, op);
+
+    for (i = 0; i < count; ++i) {
+
+        started = bench_now();
+
+        if (approximate) {
+
+            found = box_factory_get_box_approx(factory, presents[i].side, presents[i].height, &found_side_square, &found_height);
+        }
+
+        else {
+
+            found = box_factory_get_box(factory, presents[i].side, presents[i].height, &found_side_square, &found_height);
+        }
+
+        phase->latencies[phase->count++] = bench_now() - started;
+
+        volumes[i] = found ? (box_volume) found_side_square * found_height : 0;
+    }
+
+    bench_phase_end(phase);
+}
+
+
+static bool bench_run_approx(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    bench_box *presents = NULL;
+    box_volume *exact = NULL;
+    box_volume *approximate = NULL;
+    char op[BENCH_OP_SIZE];
+    unsigned int capacity = (options->boxes > options->queries) ? options->boxes : options->queries;
+    unsigned int box_count = 0;
+    unsigned int found = 0;
+    unsigned int violations = 0;
+    unsigned int mismatches = 0;
+    double ratio = 0;
+    double ratio_sum = 0;
+    double ratio_max = 0;
+    unsigned int e = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+
+    boxes = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    presents = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    exact = malloc(sizeof(box_volume) * ((capacity == 0) ? 1 : capacity));
+    approximate = malloc(sizeof(box_volume) * ((capacity == 0) ? 1 : capacity));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    for (e = 0; (e < sizeof(bench_epsilons) / sizeof(bench_epsilons[0])) && ok; ++e) {
+
+        /* Every epsilon gets the same boxes and the same queries. */
+
+        bench_factory_options(options, &factory_options);
+        factory_options.approx_epsilon = bench_epsilons[e];
+
+        ok = (boxes != NULL) && (presents != NULL) && (exact != NULL) && (approximate != NULL) && (phase.latencies != NULL) &&
+             bench_generator_init(&generator, workload->distribution, options, seed);
+
+        factory = ok ? box_factory_create_with_options(&factory_options) : NULL;
+
+        if (factory == NULL) {
+
+            printf("Error: Unable to create the box factory (index %s, epsilon %g)\n", options->index, bench_epsilons[e]);
+            ok = false;
+            break;
+        }
+
+        box_count = 0;
+        snprintf(op, sizeof(op), "insert_epsilon_%g", bench_epsilons[e]);
+        bench_phase_begin(&phase, op);
+
+        for (i = 0; (i < options->boxes) && ok; ++i) {
+
+            ok = bench_insert(factory, &generator, boxes, &box_count, &phase);
+        }
+
+        bench_phase_end(&phase);
+
+        for (i = 0; i < options->queries; ++i) {
+
+            bench_draw_present(&generator, &(presents[i].side), &(presents[i].height));
+        }
+
+        snprintf(op, sizeof(op), "get_exact_epsilon_%g", bench_epsilons[e]);
+        bench_get_phase(factory, presents, options->queries, false, op, &phase, exact);
+
+        snprintf(op, sizeof(op), "get_approx_epsilon_%g", bench_epsilons[e]);
+        bench_get_phase(factory, presents, options->queries, true, op, &phase, approximate);
+
+        found = 0;
+        violations = 0;
+        mismatches = 0;
+        ratio_sum = 0;
+        ratio_max = 0;
+
+        for (i = 0; i < options->queries; ++i) {
+
+            if ((exact[i] == 0) || (approximate[i] == 0)) {			/* The boxes of the benchmark have no zero volume. */
+
+                mismatches += (exact[i] != approximate[i]) ? 1 : 0;
+                continue;
+            }
+
+            ratio = (double) approximate[i] / exact[i];
+            violations += (ratio >= 1 + bench_epsilons[e]) ? 1 : 0;
+            ratio_sum += ratio;
+            ratio_max = (ratio > ratio_max) ? ratio : ratio_max;
+            found++;
+        }
+
+        printf("workload=%s index=%s op=approx_quality epsilon=%g queries=%u found=%u mean_ratio=%.6f max_ratio=%.6f bound_violations=%u "
+               "found_mismatches=%u\n", workload->name, options->index, bench_epsilons[e], options->queries, found,
+               (found == 0) ? 0 : ratio_sum / found, ratio_max, violations, mismatches);
+
+        ok = ok && (violations == 0) && (mismatches == 0);
+
+        box_factory_destroy(factory);
+        free(generator.zipf);
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    free(boxes);
+    free(presents);
+    free(exact);
+    free(approximate);
+    free(phase.latencies);
+
+    return ok;
+}
+
+
+static bool bench_run_skewed(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    static const char *directions[] = {"planner", "side", "height"};			/* The planner of the factory, and the forced ones. */
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    box_planner planner;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    bench_box *presents = NULL;
+    box_volume *volumes[3] = {NULL, NULL, NULL};
+    bool *checks[3] = {NULL, NULL, NULL};
+    double tails[3][2] = {{0, 0}, {0, 0}, {0, 0}};			/* The p99 and p99.9 GETBOX latencies of every direction, in seconds. */
+    char op[BENCH_OP_SIZE];
+    unsigned int capacity = (options->boxes > options->queries) ? options->boxes : options->queries;
+    unsigned int box_count = 0;
+    unsigned int side_first = 0;
+    unsigned int mismatches = 0;
+    unsigned int d = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+    memset(&generator, 0, sizeof(generator));			/* Its distribution is freed even if it wasn't initialized. */
+
+    bench_factory_options(options, &factory_options);
+
+    boxes = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    presents = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    for (d = 0; d < 3; ++d) {
+
+        volumes[d] = malloc(sizeof(box_volume) * ((capacity == 0) ? 1 : capacity));
+        checks[d] = malloc(sizeof(bool) * ((capacity == 0) ? 1 : capacity));
+        ok = ok && (volumes[d] != NULL) && (checks[d] != NULL);
+    }
+
+    ok = ok && (boxes != NULL) && (presents != NULL) && (phase.latencies != NULL) && bench_generator_init(&generator, workload->distribution, options, seed);
+
+    factory = ok ? box_factory_create_with_options(&factory_options) : NULL;
+
+    if (factory == NULL) {
+
+        printf("Error: Unable to create the box factory (index %s)\n", options->index);
+        ok = false;
+    }
+
+    if (ok) {
+
+        bench_phase_begin(&phase, "insert");
+
+        for (i = 0; (i < options->boxes) && ok; ++i) {
+
+            ok = bench_insert(factory, &generator, boxes, &box_count, &phase);
+        }
+
+        bench_phase_end(&phase);
+
+        for (i = 0; i < options->queries; ++i) {
+
+            bench_draw_present(&generator, &(presents[i].side), &(presents[i].height));
+            side_first += box_planner_side_first(&(factory->planner), presents[i].side * presents[i].side, presents[i].height) ? 1 : 0;
+        }
+
+        printf("workload=%s index=%s op=planner_choice queries=%u side_first=%u height_first=%u side_keys=%u height_keys=%u\n", workload->name,
+               options->index, options->queries, side_first, options->queries - side_first, factory->planner.by_side.total,
+               factory->planner.by_height.total);
+
+        planner = factory->planner;
+    }
+
+    for (d = 0; (d < 3) && ok; ++d) {
+
+        /* The queries don't change the histograms, so they may be replaced during the phases and restored after them. A change of the boxes
+         before every direction drops the cascades, so every direction starts without them, like the first. */
+
+        if (d > 0) {
+
+            bench_force_planner(&(factory->planner), d == 1);
+
+            ok = box_factory_insert(factory, 1, 1) && box_factory_remove(factory, 1, 1);
+        }
+
+        snprintf(op, sizeof(op), "get_%s", directions[d]);
+        bench_get_phase(factory, presents, options->queries, false, op, &phase, volumes[d]);
+
+        /* The latencies of the phase are sorted by its end. */
+
+        if (phase.count > 0) {
+
+            tails[d][0] = phase.latencies[(phase.count * 99ULL) / 100];
+            tails[d][1] = phase.latencies[(phase.count * 999ULL) / 1000];
+        }
+
+        snprintf(op, sizeof(op), "check_%s", directions[d]);
+        bench_check_phase(factory, presents, options->queries, op, &phase, checks[d]);
+
+        factory->planner = planner;
+    }
+
+    for (d = 1; (d < 3) && ok; ++d) {
+
+        for (i = 0; i < options->queries; ++i) {
+
+            mismatches += ((volumes[d][i] != volumes[0][i]) || (checks[d][i] != checks[0][i])) ? 1 : 0;
+        }
+    }
+
+    if (ok && (mismatches > 0)) {
+
+        printf("Error: %u answers of the forced directions differ from the planner's\n", mismatches);
+        ok = false;
+    }
+
+    if (ok) {
+
+        printf("workload=%s index=%s op=get_tail planner_p99_ns=%.0f planner_p999_ns=%.0f side_p99_ns=%.0f side_p999_ns=%.0f height_p99_ns=%.0f "
+               "height_p999_ns=%.0f\n", workload->name, options->index, tails[0][0] * 1e9, tails[0][1] * 1e9, tails[1][0] * 1e9, tails[1][1] * 1e9,
+               tails[2][0] * 1e9, tails[2][1] * 1e9);
+
+        if (tails[0][1] > BENCH_TAIL_RATIO * ((tails[1][1] < tails[2][1]) ? tails[1][1] : tails[2][1])) {
+
+            printf("Error: The p99.9 GETBOX latency of the planner is %.0f ns, more than %u times the best forced direction\n", tails[0][1] * 1e9,
+                   BENCH_TAIL_RATIO);
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    for (d = 0; d < 3; ++d) {
+
+        free(volumes[d]);
+        free(checks[d]);
+    }
+
+    if (factory != NULL) {
+
+        box_factory_destroy(factory);
+    }
+
+    free(boxes);
+    free(presents);
+    free(phase.latencies);
+    free(generator.zipf);
+
+    return ok;
+}
+
+
+static bool bench_run_disk(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    bench_box *presents = NULL;
+    box_volume *volumes[2] = {NULL, NULL};			/* The answers of the first factory, and of the current one. */
+    bool *checks[2] = {NULL, NULL};
+    box_btree_stats before;
+    char path[BENCH_PATH_SIZE];
+    char label[BENCH_OP_SIZE / 2];
+    char op[BENCH_OP_SIZE];
+    const char *phases[] = {"insert", "get", "check", "remove"};
+    unsigned int capacity = (options->boxes > options->queries) ? options->boxes : options->queries;
+    unsigned int box_count = 0;
+    unsigned int mismatches = 0;
+    unsigned int b = 0;
+    unsigned int p = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+    memset(&generator, 0, sizeof(generator));
+    memset(&before, 0, sizeof(before));
+
+    bench_temporary_path(path, "btree");
+
+    boxes = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    presents = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    for (i = 0; i < 2; ++i) {
+
+        volumes[i] = malloc(sizeof(box_volume) * ((capacity == 0) ? 1 : capacity));
+        checks[i] = malloc(sizeof(bool) * ((capacity == 0) ? 1 : capacity));
+        ok = ok && (volumes[i] != NULL) && (checks[i] != NULL);
+    }
+
+    ok = ok && (boxes != NULL) && (presents != NULL) && (phase.latencies != NULL);
+
+    for (b = 0; (b <= BENCH_DISK_BUDGETS) && ok; ++b) {
+
+        /* Every budget gets the same boxes and the same queries - the last factory is the one in memory. */
+
+        bench_factory_options(options, &factory_options);
+
+        if (b < BENCH_DISK_BUDGETS) {
+
+            factory_options.disk_path = path;
+            factory_options.disk_memory = bench_disk_budgets[b];
+            snprintf(label, sizeof(label), "disk_%luk", (unsigned long) (bench_disk_budgets[b] / 1024));
+        }
+
+        else {
+
+            snprintf(label, sizeof(label), "memory");
+        }
+
+        free(generator.zipf);
+        ok = bench_generator_init(&generator, workload->distribution, options, seed);
+        factory = ok ? box_factory_create_with_options(&factory_options) : NULL;
+
+        if (factory == NULL) {
+
+            printf("Error: Unable to create the box factory (%s, index %s)\n", label, options->index);
+            ok = false;
+            break;
+        }
+
+        box_count = 0;
+
+        for (p = 0; (p < sizeof(phases) / sizeof(phases[0])) && ok; ++p) {
+
+            if (factory->disk != NULL) {
+
+                before = factory->disk->stats;
+            }
+
+            snprintf(op, sizeof(op), "%s_%s", phases[p], label);
+
+            switch (p) {
+
+                case 0:
+
+                    bench_phase_begin(&phase, op);
+
+                    for (i = 0; (i < options->boxes) && ok; ++i) {
+
+                        ok = bench_insert(factory, &generator, boxes, &box_count, &phase);
+                    }
+
+                    bench_phase_end(&phase);
+
+                    for (i = 0; i < options->queries; ++i) {
+
+                        bench_draw_present(&generator, &(presents[i].side), &(presents[i].height));
+                    }
+
+                    break;
+
+                case 1:
+
+                    bench_get_phase(factory, presents, options->queries, false, op, &phase, volumes[(b == 0) ? 0 : 1]);
+                    break;
+
+                case 2:
+
+                    bench_check_phase(factory, presents, options->queries, op, &phase, checks[(b == 0) ? 0 : 1]);
+                    break;
+
+                default:
+
+                    bench_phase_begin(&phase, op);
+
+                    while ((box_count > 0) && ok) {
+
+                        ok = bench_remove(factory, &generator, boxes, &box_count, &phase);
+                    }
+
+                    bench_phase_end(&phase);
+                    break;
+            }
+
+            if (factory->disk != NULL) {
+
+                bench_disk_pool(factory, &phase, bench_disk_budgets[b], &before);
+            }
+        }
+
+        for (i = 0; (i < options->queries) && (b > 0); ++i) {
+
+            mismatches += ((volumes[1][i] != volumes[0][i]) || (checks[1][i] != checks[0][i])) ? 1 : 0;
+        }
+
+        box_factory_destroy(factory);
+        unlink(path);
+    }
+
+    if (ok && (mismatches > 0)) {
+
+        printf("Error: %u answers differ from the ones of the first budget\n", mismatches);
+        ok = false;
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    for (i = 0; i < 2; ++i) {
+
+        free(volumes[i]);
+        free(checks[i]);
+    }
+
+    free(boxes);
+    free(presents);
+    free(phase.latencies);
+    free(generator.zipf);
+
+    return ok;
+}
+
+
+static bool bench_run_cascade(const bench_workload *workload, const bench_options *options, unsigned long long seed)
+{
+
+    static const char *ops[] = {"get_first", "get_again"};			/* The first rebuild, and the one after a change. */
+    box_factory_options factory_options;
+    box_factory *factory = NULL;
+    bench_generator generator;
+    bench_phase phase;
+    bench_box *boxes = NULL;
+    box_cascade before[2];
+    box_dim side = 0;
+    box_dim height = 0;
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    double latency = 0;
+    double cpu = 0;
+    double slowest[2] = {0, 0};			/* The slowest GETBOX which made a part of a rebuild, and the slowest of the others, in CPU time. */
+    unsigned int counts[2] = {0, 0};
+    unsigned int capacity = (options->boxes > options->queries) ? options->boxes : options->queries;
+    unsigned int box_count = 0;
+    unsigned int kind = 0;			/* 0 - the GETBOX made a part of a rebuild, 1 - it's one of the others. */
+    unsigned int p = 0;
+    unsigned int i = 0;
+    bool ok = true;
+
+    memset(&phase, 0, sizeof(phase));
+    memset(&generator, 0, sizeof(generator));
+
+    bench_factory_options(options, &factory_options);
+
+    boxes = malloc(sizeof(bench_box) * ((capacity == 0) ? 1 : capacity));
+    phase.latencies = malloc(sizeof(double) * ((capacity == 0) ? 1 : capacity));
+    phase.workload = workload->name;
+    phase.index = options->index;
+
+    ok = (boxes != NULL) && (phase.latencies != NULL) && bench_generator_init(&generator, workload->distribution, options, seed);
+
+    factory = ok ? box_factory_create_with_options(&factory_options) : NULL;
+
+    if (factory == NULL) {
+
+        printf("Error: Unable to create the box factory (index %s)\n", options->index);
+        ok = false;
+    }
+
+    if (ok) {
+
+        bench_phase_begin(&phase, "insert");
+
+        for (i = 0; (i < options->boxes) && ok; ++i) {
+
+            ok = bench_insert(factory, &generator, boxes, &box_count, &phase);
+        }
+
+        bench_phase_end(&phase);
+    }
+
+    for (p = 0; (p < 2) && ok; ++p) {
+
+        if (p > 0) {
+
+            ok = box_factory_insert(factory, 1, 1) && box_factory_remove(factory, 1, 1);
+        }
+
+        slowest[0] = 0;
+        slowest[1] = 0;
+        counts[0] = 0;
+        counts[1] = 0;
+
+        bench_phase_begin(&phase, ops[p]);
+
+        for (i = 0; i < options->queries; ++i) {
+
+            bench_draw_present(&generator, &side, &height);
+
+            before[0] = factory->cascade_by_side;
+            before[1] = factory->cascade_by_height;
+
+            cpu = bench_cpu_now();
+            latency = bench_now();
+            box_factory_get_box(factory, side, height, &found_side_square, &found_height);
+            latency = bench_now() - latency;
+            cpu = bench_cpu_now() - cpu;
+
+            phase.latencies[phase.count++] = latency;
+
+            /* A GETBOX answered from a cascade, or by a scan which didn't rebuild, is one of the others. */
+
+            kind = (bench_cascade_moved(&(before[0]), &(factory->cascade_by_side)) ||
+                    bench_cascade_moved(&(before[1]), &(factory->cascade_by_height))) ? 0 : 1;
+
+            counts[kind]++;
+            slowest[kind] = (cpu > slowest[kind]) ? cpu : slowest[kind];
+        }
+
+        bench_phase_end(&phase);
+
+        printf("workload=%s index=%s op=%s_slowest rebuild_queries=%u rebuild_max_cpu_ns=%.0f other_queries=%u other_max_cpu_ns=%.0f\n",
+               workload->name, options->index, ops[p], counts[0], slowest[0] * 1e9, counts[1], slowest[1] * 1e9);
+
+        if ((counts[0] > 0) && (counts[1] > 0) && (slowest[0] > BENCH_SLOWEST_RATIO * slowest[1])) {
+
+            printf("Error: The slowest GETBOX of a rebuild took %.0f ns of CPU time, more than %u times the slowest of the others\n",
+                   slowest[0] * 1e9, BENCH_SLOWEST_RATIO);
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+
+        printf("Error: An operation of the %s workload failed\n", workload->name);
+    }
+
+    if (factory != NULL) {
+
+        box_factory_destroy(factory);
+    }
+
+    free(boxes);
+    free(phase.latencies);
+    free(generator.zipf);
+
+    return ok;
+}
+
+
+static void bench_check_phase(box_factory *factory, const bench_box *presents, unsigned int count, const char *op, bench_phase *phase, bool *results)
+{
+
+    double started = 0;
+    unsigned int i = 0;
+
+    bench_phase_begin(phase, op);
+
+    for (i = 0; i < count; ++i) {
+
+        started = bench_now();
+        results[i] = box_factory_check_box(factory, presents[i].side, presents[i].height);
+        phase->latencies[phase->count++] = bench_now() - started;
+    }
+
+    bench_phase_end(phase);
+}
+
+
+static void bench_disk_pool(const box_factory *factory, const bench_phase *phase, size_t budget, const box_btree_stats *before)
+{
+
+    const box_btree *tree = factory->disk;
+    double count = (phase->count == 0) ? 1 : phase->count;
+
+    printf("workload=%s index=%s op=%s_pool budget_kb=%lu frames=%u file_kb=%llu hits_per_op=%.3f reads_per_op=%.3f writes_per_op=%.3f "
+           "evictions_per_op=%.3f\n", phase->workload, phase->index, phase->op, (unsigned long) (budget / 1024), tree->frame_count,
+           ((unsigned long long) tree->meta.page_count * BOX_BTREE_PAGE_SIZE) / 1024, (tree->stats.hits - before->hits) / count,
+           (tree->stats.reads - before->reads) / count, (tree->stats.writes - before->writes) / count,
+           (tree->stats.evictions - before->evictions) / count);
+}
+
+
+static void bench_force_planner(box_planner *planner, bool side_first)
+{
+
+    /* The main tree to scan gets an empty histogram, and the other a single key above all the keys - so the estimate of the other is never
+     smaller, and on equal estimates the planner falls back to the main tree of the larger total. */
+
+    box_planner_init(planner);
+
+    box_histogram_add(side_first ? &(planner->by_height) : &(planner->by_side), (box_dim) ~((box_dim) 0));
+}
+
+
+static bool bench_cascade_moved(const box_cascade *before, const box_cascade *after)
+{
+
+    /* Every phase of the rebuild moves one of these. */
+
+    return (before->current != after->current) || (before->phase != after->phase) || (before->catalog_count != after->catalog_count) ||
+           (before->build_index != after->build_index) || (before->merge_out != after->merge_out);
+}
+
+
+static int compare_boxes(const void *a, const void *b)
+{
+
+    const bench_box *box_a = a;
+    const bench_box *box_b = b;
+
+    if (box_a->side != box_b->side) {
+
+        return (box_a->side < box_b->side) ? -1 : 1;
+    }
+
+    if (box_a->height != box_b->height) {
+
+        return (box_a->height < box_b->height) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+static int compare_latencies(const void *a, const void *b)
+{
+
+    double latency_a = *((const double *) a);
+    double latency_b = *((const double *) b);
+
+    if (latency_a != latency_b) {
+
+        return (latency_a < latency_b) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+
+    bench_options options = {100000, 100000, 1, 1000, "all", "rb"};
+    unsigned int i = 0;
+    unsigned int ran = 0;
+    int status = 0;
+    pid_t child = 0;
+    bool failed = false;
+
+    if ((argc > 1) && (strcmp(argv[1], "-h") == 0)) {
+
+        printf("Usage: %s [boxes [queries [seed [range [workload [index]]]]]]\n", argv[0]);
+        return -1;
+    }
+
+    options.boxes = (argc > 1) ? (unsigned int) strtoul(argv[1], NULL, 10) : options.boxes;
+    options.queries = (argc > 2) ? (unsigned int) strtoul(argv[2], NULL, 10) : options.queries;
+    options.seed = (argc > 3) ? strtoull(argv[3], NULL, 10) : options.seed;
+    options.range = (argc > 4) ? strtoull(argv[4], NULL, 10) : options.range;
+    options.workload = (argc > 5) ? argv[5] : options.workload;
+    options.index = (argc > 6) ? argv[6] : options.index;
+
+    if ((options.range == 0) || (options.range > BOX_DIM_MAX_SIDE) || (options.boxes > (~0U) - options.queries)) {
+
+        printf("Error: range must be in [1, %llu], and boxes + queries must fit in 32 bits\n", (unsigned long long) BOX_DIM_MAX_SIDE);
+        return -1;
+    }
+
+    if ((strcmp(options.index, "rb") != 0) && (strcmp(options.index, "veb") != 0) && (strcmp(options.index, "auto") != 0) &&
+        (strcmp(options.index, "arena") != 0)) {
+
+        printf("Error: index must be rb, veb, auto or arena\n");
+        return -1;
+    }
+
+    for (i = 0; i < sizeof(bench_workloads) / sizeof(bench_workloads[0]); ++i) {
+
+        if ((strcmp(options.workload, "all") != 0) && (strcmp(options.workload, bench_workloads[i].name) != 0)) {
+
+            continue;
+        }
+
+        ran++;
+        fflush(stdout);			/* Or the child prints it once more. */
+
+        child = fork();
+
+        if (child == 0) {
+
+            status = bench_workloads[i].run(&(bench_workloads[i]), &options, options.seed * 31 + i) ? 0 : 1;
+            fflush(stdout);
+            _exit(status);
+        }
+
+        if ((child < 0) || (waitpid(child, &status, 0) != child) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+
+            failed = true;
+        }
+    }
+
+    if (ran == 0) {
+
+        printf("Error: Unknown workload %s\n", options.workload);
+        return -1;
+    }
+
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,391 @@
+/*
+ Box client source file.
+ A load generator for the box server (box_server.h) - a single thread which drives a number of connections, keeping a number of pipelined requests in
+ flight on each of them, and measures the throughput and the latency of the requests.
+ Usage: box_client socket [requests [connections [depth [range [insert% [remove% [get%]]]]]]]
+ (the rest of the requests are CHECKBOX; the sides and heights are uniform in [1, range].)
+ The results are printed as a single line of key=value pairs, for scripts.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* clock_gettime, poll and the sockets. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <errno.h>
+
+#include <time.h>
+
+#include <poll.h>
+
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include <sys/un.h>
+
+#include "box_server.h"
+
+
+#define CLIENT_MAX_DEPTH 4096
+
+
+typedef struct client_connection_s {			/* A connection of the load generator. */
+
+    int fd;
+    unsigned int sent;			/* Number of requests written. */
+    unsigned int received;			/* Number of responses read. */
+    unsigned int target;			/* Number of requests this connection sends. */
+    unsigned char in[sizeof(box_server_response) * 1024];			/* The bytes of a response which was cut by the end of a read. */
+    size_t in_size;
+    double *sent_at;			/* sent_at[i % depth] - the time request i was written (at most depth requests are in flight.) */
+} client_connection;
+
+
+typedef struct client_options_s {			/* The parameters of a run. */
+
+    unsigned int requests;
+    unsigned int connections;
+    unsigned int depth;			/* The most requests in flight on a connection. */
+    unsigned long long range;
+    unsigned int insert_percent;
+    unsigned int remove_percent;
+    unsigned int get_percent;
+} client_options;
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the time of a monotonic clock, in seconds. */
+
+static double client_now(void);
+
+
+/* Return the next number of a xorshift generator of the given state. */
+
+static unsigned long long client_random(unsigned long long *state);
+
+
+/* Connect to the server of the given socket path. Returns the socket, or -1 on an error. */
+
+static int client_connect(const char *path);
+
+
+/* Write new requests of the connection, up to depth in flight. Returns FALSE on an I/O error, TRUE otherwise. */
+
+static bool client_send(client_connection *connection, const client_options *options, unsigned long long *state);
+
+
+/* Read the responses which arrived on the connection, and record their latencies. Returns FALSE on an I/O error or an invalid response, TRUE
+ otherwise. */
+
+static bool client_receive(client_connection *connection, const client_options *options, double *latencies, unsigned int *latency_count);
+
+
+/* Comparison function between two latencies, for qsort. */
+
+static int compare_latencies(const void *a, const void *b);
+
+
+/* The implementation: */
+
+
+static double client_now(void)
+{
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+static unsigned long long client_random(unsigned long long *state)
+{
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+
+static int client_connect(const char *path)
+{
+
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    if ((fd >= 0) && (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0)) {
+
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+
+static bool client_send(client_connection *connection, const client_options *options, unsigned long long *state)
+{
+
+    box_server_request requests[1024];
+    unsigned int count = 0;
+    unsigned int percent = 0;
+    ssize_t result = 0;
+    size_t done = 0;
+    double now = client_now();
+
+    /* All the requests which may be sent now are written by a single call. */
+
+    while ((connection->sent + count < connection->target) && (connection->sent + count - connection->received < options->depth) &&
+           (count < sizeof(requests) / sizeof(requests[0]))) {
+
+        percent = (unsigned int) (client_random(state) % 100);
+
+        if (percent < options->insert_percent) {
+
+            requests[count].op = BOX_SERVER_INSERT;
+        }
+
+        else {
+
+            if (percent < options->insert_percent + options->remove_percent) {
+
+                requests[count].op = BOX_SERVER_REMOVE;
+            }
+
+            else {
+
+                requests[count].op = (percent < options->insert_percent + options->remove_percent + options->get_percent) ? BOX_SERVER_GET
+                                                                                                                          : BOX_SERVER_CHECK;
+            }
+        }
+
+        requests[count].id = connection->sent + count;
+        requests[count].side = 1 + client_random(state) % options->range;
+        requests[count].height = 1 + client_random(state) % options->range;
+
+        connection->sent_at[(connection->sent + count) % options->depth] = now;
+        count++;
+    }
+
+    while (done < count * sizeof(box_server_request)) {
+
+        result = write(connection->fd, (unsigned char *) requests + done, count * sizeof(box_server_request) - done);
+
+        if (result < 0) {
+
+            if (errno == EINTR) {
+
+                continue;
+            }
+
+            return false;
+        }
+
+        done += (size_t) result;
+    }
+
+    connection->sent += count;
+
+    return true;
+}
+
+
+static bool client_receive(client_connection *connection, const client_options *options, double *latencies, unsigned int *latency_count)
+{
+
+    box_server_response response;
+    size_t position = 0;
+    ssize_t result = 0;
+    double now = 0;
+
+    do {
+
+        result = read(connection->fd, connection->in + connection->in_size, sizeof(connection->in) - connection->in_size);
+    } while ((result < 0) && (errno == EINTR));
+
+    if (result <= 0) {			/* The server closed the connection before all the responses arrived, or an error. */
+
+        return false;
+    }
+
+    connection->in_size += (size_t) result;
+    now = client_now();
+
+    while (connection->in_size - position >= sizeof(box_server_response)) {
+
+        memcpy(&response, connection->in + position, sizeof(box_server_response));
+
+        if ((response.id != connection->received) || (response.status == BOX_SERVER_INVALID)) {
+
+            return false;
+        }
+
+        latencies[(*latency_count)++] = now - connection->sent_at[connection->received % options->depth];
+
+        connection->received++;
+        position += sizeof(box_server_response);
+    }
+
+    memmove(connection->in, connection->in + position, connection->in_size - position);
+    connection->in_size -= position;
+
+    return true;
+}
+
+
+static int compare_latencies(const void *a, const void *b)
+{
+
+    double latency_a = *((const double *) a);
+    double latency_b = *((const double *) b);
+
+    if (latency_a != latency_b) {
+
+        return (latency_a < latency_b) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+
+    client_options options = {100000, 4, 64, 1000, 40, 20, 30};
+    client_connection *connections = NULL;
+    struct pollfd *polls = NULL;
+    double *latencies = NULL;
+    unsigned int latency_count = 0;
+    unsigned int done = 0;
+    unsigned int i = 0;
+    unsigned long long state = 0x9E3779B97F4A7C15ULL;
+    double started = 0;
+    double seconds = 0;
+    bool failed = false;
+
+    if (argc < 2) {
+
+        printf("Usage: %s socket [requests [connections [depth [range [insert%% [remove%% [get%%]]]]]]]\n", argv[0]);
+        return -1;
+    }
+
+    options.requests = (argc > 2) ? (unsigned int) strtoul(argv[2], NULL, 10) : options.requests;
+    options.connections = (argc > 3) ? (unsigned int) strtoul(argv[3], NULL, 10) : options.connections;
+    options.depth = (argc > 4) ? (unsigned int) strtoul(argv[4], NULL, 10) : options.depth;
+    options.range = (argc > 5) ? strtoull(argv[5], NULL, 10) : options.range;
+    options.insert_percent = (argc > 6) ? (unsigned int) strtoul(argv[6], NULL, 10) : options.insert_percent;
+    options.remove_percent = (argc > 7) ? (unsigned int) strtoul(argv[7], NULL, 10) : options.remove_percent;
+    options.get_percent = (argc > 8) ? (unsigned int) strtoul(argv[8], NULL, 10) : options.get_percent;
+
+    /* The requests in flight must fit in the buffers of the sockets and of the server, since a connection is written before it's read. */
+
+    if ((options.connections == 0) || (options.depth == 0) || (options.depth > CLIENT_MAX_DEPTH) || (options.range == 0)) {
+
+        printf("Error: connections and range must be positive, and depth in [1, %u]\n", CLIENT_MAX_DEPTH);
+        return -1;
+    }
+
+    connections = calloc(sizeof(client_connection), options.connections);
+    polls = calloc(sizeof(struct pollfd), options.connections);
+    latencies = malloc(sizeof(double) * ((options.requests == 0) ? 1 : options.requests));
+
+    if ((connections == NULL) || (polls == NULL) || (latencies == NULL)) {
+
+        printf("Error: Allocation failed\n");
+        return -1;
+    }
+
+    for (i = 0; i < options.connections; ++i) {
+
+        connections[i].fd = client_connect(argv[1]);
+        connections[i].target = options.requests / options.connections + ((i < options.requests % options.connections) ? 1 : 0);
+        connections[i].sent_at = malloc(sizeof(double) * options.depth);
+
+        if ((connections[i].fd < 0) || (connections[i].sent_at == NULL)) {
+
+            printf("Error: Unable to connect to %s\n", argv[1]);
+            return -1;
+        }
+
+        polls[i].fd = (connections[i].target == 0) ? -1 : connections[i].fd;
+        polls[i].events = POLLIN;
+        done += (connections[i].target == 0) ? 1 : 0;
+    }
+
+    started = client_now();
+
+    for (i = 0; (i < options.connections) && !failed; ++i) {
+
+        failed = !client_send(&(connections[i]), &options, &state);
+    }
+
+    /* Every response makes room for another request of its connection. */
+
+    while ((done < options.connections) && !failed) {
+
+        if (poll(polls, options.connections, -1) < 0) {
+
+            failed = (errno != EINTR);
+            continue;
+        }
+
+        for (i = 0; (i < options.connections) && !failed; ++i) {
+
+            if ((polls[i].revents == 0) || (connections[i].received == connections[i].target)) {
+
+                continue;
+            }
+
+            failed = !client_receive(&(connections[i]), &options, latencies, &latency_count) || !client_send(&(connections[i]), &options, &state);
+
+            if (connections[i].received == connections[i].target) {
+
+                done++;
+                polls[i].fd = -1;			/* poll ignores it from now on. */
+            }
+        }
+    }
+
+    seconds = client_now() - started;
+
+    for (i = 0; i < options.connections; ++i) {
+
+        close(connections[i].fd);
+        free(connections[i].sent_at);
+    }
+
+    if (failed) {
+
+        printf("Error: The connection to the server failed\n");
+        return -1;
+    }
+
+    qsort(latencies, latency_count, sizeof(double), compare_latencies);
+
+    printf("requests=%u connections=%u depth=%u seconds=%.3f throughput=%.0f p50_us=%.1f p99_us=%.1f max_us=%.1f\n", latency_count,
+           options.connections, options.depth, seconds, latency_count / seconds,
+           (latency_count == 0) ? 0 : latencies[latency_count / 2] * 1e6, (latency_count == 0) ? 0 : latencies[(latency_count * 99ULL) / 100] * 1e6,
+           (latency_count == 0) ? 0 : latencies[latency_count - 1] * 1e6);
+
+    free(connections);
+    free(polls);
+    free(latencies);
+
+    return 0;
+}
@@ -0,0 +1,567 @@
+/*
+ Box replay source file.
+ Replays a trace of a box factory (box_trace.h) - recorded by box_factory_trace_begin, or by the program with BOX_TRACE=path - against a new box
+ factory of this build: the boxes of the trace are inserted first, and then every call of the trace is made again, and its results are compared
+ with the recorded ones. A regression gate over real traffic - a build which answers differently fails, and one which is slower shows it.
+ Usage: box_replay trace [speed [index]]
+ speed 0 (the default) makes the calls as fast as possible, and a positive speed keeps the pacing of the recording at that rate (1 - the recorded
+ times, 2 - twice as fast.) The index is the structure of the box factory - rb (the default), veb, auto or arena (see box_factory_options.)
+ The first calls whose results differ are printed, and then a single line of key=value pairs for the whole trace and a line for every operation, for
+ scripts: the number of calls and of mismatches, the throughput, and the percentiles of the latencies of the replay next to the recorded ones.
+ The exit status is 0 only if every result matched. GETBOX breaks the ties of volume by the side in every structure, so its answers are compared
+ exactly, whichever index replays the trace. The cost function of the traced box factory isn't in the trace, so the calls of GET_CHEAPEST
+ match only if it's the default one.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L			/* clock_gettime and nanosleep. */
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <math.h>
+
+#include <time.h>
+
+#include "box_factory.h"
+
+
+#define REPLAY_OPS (BOX_TRACE_COUNT_SIDES + 1)
+
+#define REPLAY_MAX_PRINTED 10			/* The most mismatches printed. */
+
+
+typedef struct replay_call_s {			/* A call of the replay - its operation and its latencies. */
+
+    box_trace_op op;
+    double latency;			/* Seconds the call took in the replay. */
+    double recorded;			/* Seconds the call took when it was recorded. */
+} replay_call;
+
+
+typedef struct replay_buffers_s {			/* The arguments and the results of the calls which take arrays. */
+
+    box_factory_box *boxes;
+    box_factory_present *presents;
+    unsigned int capacity;
+} replay_buffers;
+
+
+static const char *replay_op_names[REPLAY_OPS] = {"none", "insert", "remove", "get", "get_approx", "check", "top_k", "set_price", "remove_price",
+                                                  "cheapest", "assign", "count_suitable", "count_sides"};
+
+
+/* Functions' prototype declarations: */
+
+
+/* Return the time of a monotonic clock, in seconds. */
+
+static double replay_now(void);
+
+
+/* Return the side of the given (side * side.) */
+
+static box_dim replay_side_of(box_dim side_square);
+
+
+/* Make sure the buffers have room for the given number of elements. Returns FALSE on an allocation error, TRUE otherwise. */
+
+static bool replay_reserve(replay_buffers *buffers, unsigned int count);
+
+
+/* Make the call of the record on the box factory, and compare its results with the recorded ones. latency would contain the seconds the call took.
+ Returns FALSE if the results differ, TRUE otherwise. */
+
+static bool replay_call_record(box_factory *factory, const box_trace_record *record, const box_trace_item *items, replay_buffers *buffers,
+                               double *latency);
+
+
+/* Print the latencies of the given calls (of a single operation, or all of them if op is 0) as a line of key=value pairs. */
+
+static void replay_print(replay_call *calls, unsigned long long call_count, box_trace_op op, unsigned long long mismatches, double seconds,
+                         double *latencies, double *recorded);
+
+
+/* Comparison function between two latencies, for qsort. */
+
+static int compare_latencies(const void *a, const void *b);
+
+
+/* The implementation: */
+
+
+static double replay_now(void)
+{
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+static box_dim replay_side_of(box_dim side_square)
+{
+
+    box_dim side = (box_dim) sqrt((double) side_square);
+
+    /* A double has 53 bits of precision, so the root of a 64-bit square may be off by one - fix it. */
+
+    if (side > BOX_DIM_MAX_SIDE) {
+
+        side = BOX_DIM_MAX_SIDE;
+    }
+
+    while (side * side > side_square) {
+
+        side--;
+    }
+
+    while ((side < BOX_DIM_MAX_SIDE) && ((side + 1) * (side + 1) <= side_square)) {
+
+        side++;
+    }
+
+    return side;
+}
+
+
+static bool replay_reserve(replay_buffers *buffers, unsigned int count)
+{
+
+    box_factory_box *boxes = NULL;
+    box_factory_present *presents = NULL;
+
+    if (count <= buffers->capacity) {
+
+        return true;
+    }
+
+    boxes = realloc(buffers->boxes, sizeof(box_factory_box) * count);
+
+    if (boxes == NULL) {
+
+        return false;
+    }
+
+    buffers->boxes = boxes;
+    presents = realloc(buffers->presents, sizeof(box_factory_present) * count);
+
+    if (presents == NULL) {
+
+        return false;
+    }
+
+    buffers->presents = presents;
+    buffers->capacity = count;
+
+    return true;
+}
+
+
+static bool replay_call_record(box_factory *factory, const box_trace_record *record, const box_trace_item *items, replay_buffers *buffers,
+                               double *latency)
+{
+
+    box_dim found_side_square = 0;
+    box_dim found_height = 0;
+    double found_cost = 0;
+    unsigned long long value = 0;
+    unsigned int unassigned = 0;
+    unsigned int count = 0;
+    unsigned int i = 0;
+    bool result = false;
+    bool same = true;
+    double started = 0;
+
+    /* The arrays of the call are set up before it's timed. */
+
+    if ((record->op == BOX_TRACE_TOP_K) || (record->op == BOX_TRACE_ASSIGN)) {
+
+        count = (record->op == BOX_TRACE_TOP_K) ? record->k : record->item_count;
+
+        if (!replay_reserve(buffers, count)) {
+
+            printf("Error: Allocation failed\n");
+            exit(-1);
+        }
+
+        for (i = 0; (record->op == BOX_TRACE_ASSIGN) && (i < count); ++i) {
+
+            buffers->presents[i].side = items[i].side;
+            buffers->presents[i].height = items[i].height;
+        }
+    }
+
+    started = replay_now();
+
+    switch (record->op) {
+
+        case BOX_TRACE_INSERT:
+
+            result = box_factory_insert(factory, record->side, record->height);
+            break;
+
+        case BOX_TRACE_REMOVE:
+
+            result = box_factory_remove(factory, record->side, record->height);
+            break;
+
+        case BOX_TRACE_GET:
+
+            result = box_factory_get_box(factory, record->side, record->height, &found_side_square, &found_height);
+            break;
+
+        case BOX_TRACE_GET_APPROX:
+
+            result = box_factory_get_box_approx(factory, record->side, record->height, &found_side_square, &found_height);
+            break;
+
+        case BOX_TRACE_CHECK:
+
+            result = box_factory_check_box(factory, record->side, record->height);
+            break;
+
+        case BOX_TRACE_TOP_K:
+
+            count = box_factory_get_top_k(factory, record->side, record->height, record->k, buffers->boxes);
+            break;
+
+        case BOX_TRACE_SET_PRICE:
+
+            result = box_factory_set_price(factory, record->side, record->height, record->price);
+            break;
+
+        case BOX_TRACE_REMOVE_PRICE:
+
+            result = box_factory_remove_price(factory, record->side, record->height);
+            break;
+
+        case BOX_TRACE_CHEAPEST:
+
+            result = box_factory_get_cheapest(factory, record->side, record->height, &found_side_square, &found_height, &found_cost);
+            break;
+
+        case BOX_TRACE_ASSIGN:
+
+            result = box_factory_assign_batch(factory, buffers->presents, record->item_count, &unassigned);
+            break;
+
+        case BOX_TRACE_COUNT_SUITABLE:
+
+            value = box_factory_count_suitable(factory, record->side, record->height);
+            break;
+
+        default:
+
+            value = box_factory_count_sides(factory, record->side, record->height);
+            break;
+    }
+
+    *latency = replay_now() - started;
+
+    /* The results the recorded call had. */
+
+    switch (record->op) {
+
+        case BOX_TRACE_GET:
+        case BOX_TRACE_GET_APPROX:
+        case BOX_TRACE_CHEAPEST:
+
+            same = (result == record->result) && (!result || ((found_side_square == record->found_side_square) &&
+                                                              (found_height == record->found_height)));
+            same = same && (!result || (record->op != BOX_TRACE_CHEAPEST) || (found_cost == record->price));
+            break;
+
+        case BOX_TRACE_TOP_K:
+
+            same = (count == record->item_count);
+
+            for (i = 0; same && (i < count); ++i) {
+
+                same = (buffers->boxes[i].side_square == items[i].side) && (buffers->boxes[i].height == items[i].height) &&
+                       (buffers->boxes[i].count == items[i].count);
+            }
+
+            break;
+
+        case BOX_TRACE_ASSIGN:
+
+            same = (result == record->result) && (unassigned == record->value);
+
+            for (i = 0; same && (i < record->item_count); ++i) {
+
+                same = (buffers->presents[i].assigned == (items[i].count > 0)) &&
+                       (!buffers->presents[i].assigned || ((buffers->presents[i].box_side_square == items[i].box_side_square) &&
+                                                           (buffers->presents[i].box_height == items[i].box_height)));
+            }
+
+            break;
+
+        case BOX_TRACE_COUNT_SUITABLE:
+        case BOX_TRACE_COUNT_SIDES:
+
+            same = (value == record->value);
+            break;
+
+        default:
+
+            same = (result == record->result);
+            break;
+    }
+
+    return same;
+}
+
+
+static void replay_print(replay_call *calls, unsigned long long call_count, box_trace_op op, unsigned long long mismatches, double seconds,
+                         double *latencies, double *recorded)
+{
+
+    unsigned long long count = 0;
+    unsigned long long i = 0;
+
+    for (i = 0; i < call_count; ++i) {
+
+        if ((op == 0) || (calls[i].op == op)) {
+
+            latencies[count] = calls[i].latency;
+            recorded[count] = calls[i].recorded;
+            count++;
+        }
+    }
+
+    if ((count == 0) && (op != 0)) {
+
+        return;
+    }
+
+    qsort(latencies, count, sizeof(double), compare_latencies);
+    qsort(recorded, count, sizeof(double), compare_latencies);
+
+    if (op == 0) {
+
+        printf("calls=%llu mismatches=%llu seconds=%.6f throughput=%.0f ", count, mismatches, seconds, (seconds > 0) ? count / seconds : 0);
+    }
+
+    else {
+
+        printf("op=%s calls=%llu ", replay_op_names[op], count);
+    }
+
+    printf("p50_ns=%.0f p99_ns=%.0f max_ns=%.0f recorded_p50_ns=%.0f recorded_p99_ns=%.0f recorded_max_ns=%.0f\n",
+           (count == 0) ? 0 : latencies[count / 2] * 1e9, (count == 0) ? 0 : latencies[(count * 99ULL) / 100] * 1e9,
+           (count == 0) ? 0 : latencies[count - 1] * 1e9, (count == 0) ? 0 : recorded[count / 2] * 1e9,
+           (count == 0) ? 0 : recorded[(count * 99ULL) / 100] * 1e9, (count == 0) ? 0 : recorded[count - 1] * 1e9);
+}
+
+
+static int compare_latencies(const void *a, const void *b)
+{
+
+    double latency_a = *((const double *) a);
+    double latency_b = *((const double *) b);
+
+    if (latency_a != latency_b) {
+
+        return (latency_a < latency_b) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+
+    box_factory_options options;
+    box_factory *factory = NULL;
+    box_trace_reader *reader = NULL;
+    box_trace_record record;
+    replay_buffers buffers = {NULL, NULL, 0};
+    replay_call *calls = NULL;
+    replay_call *grown = NULL;
+    unsigned long long call_count = 0;
+    unsigned long long call_capacity = 0;
+    unsigned long long mismatches = 0;
+    double *latencies = NULL;
+    double *recorded = NULL;
+    double speed = 0;
+    double started = 0;
+    double seconds = 0;
+    double wait = 0;
+    struct timespec pause;
+    const char *index = "rb";
+    unsigned int i = 0;
+    unsigned int unit = 0;
+    int op = 0;
+    int status = 0;
+
+    if (argc < 2) {
+
+        printf("Usage: %s trace [speed [index]]\n", argv[0]);
+        return -1;
+    }
+
+    speed = (argc > 2) ? strtod(argv[2], NULL) : speed;
+    index = (argc > 3) ? argv[3] : index;
+
+    memset(&options, 0, sizeof(options));
+
+    if (strcmp(index, "veb") == 0) {
+
+        options.index_type = BOX_FACTORY_INDEX_VEB;
+    }
+
+    else {
+
+        if (strcmp(index, "auto") == 0) {
+
+            options.index_type = BOX_FACTORY_INDEX_AUTO;
+        }
+
+        else {
+
+            options.arena = (strcmp(index, "arena") == 0);
+        }
+    }
+
+    if ((speed < 0) || ((strcmp(index, "rb") != 0) && (strcmp(index, "veb") != 0) && (strcmp(index, "auto") != 0) && (strcmp(index, "arena") != 0))) {
+
+        printf("Error: speed must be at least 0, and index rb, veb, auto or arena\n");
+        return -1;
+    }
+
+    reader = box_trace_open(argv[1]);
+
+    if (reader == NULL) {
+
+        printf("Error: Unable to open the trace %s\n", argv[1]);
+        return -1;
+    }
+
+    factory = box_factory_create_with_options(&options);
+
+    if (factory == NULL) {
+
+        printf("Error: Unable to create the box factory (index %s)\n", index);
+        box_trace_reader_close(reader);
+        return -1;
+    }
+
+    /* The boxes the traced box factory had when the trace began. */
+
+    for (i = 0; i < reader->record_count; ++i) {
+
+        for (unit = 0; unit < reader->records[i].count; ++unit) {
+
+            if (!box_factory_insert(factory, replay_side_of(reader->records[i].side_square), reader->records[i].height)) {
+
+                printf("Error: Unable to insert the boxes of the trace\n");
+                box_factory_destroy(factory);
+                box_trace_reader_close(reader);
+                return -1;
+            }
+        }
+    }
+
+    started = replay_now();
+
+    while (box_trace_next(reader, &record)) {
+
+        if (call_count == call_capacity) {
+
+            call_capacity = (call_capacity == 0) ? 4096 : call_capacity * 2;
+            grown = realloc(calls, sizeof(replay_call) * call_capacity);
+
+            if (grown == NULL) {
+
+                printf("Error: Allocation failed\n");
+                exit(-1);
+            }
+
+            calls = grown;
+        }
+
+        /* At a positive speed - wait for the time of the call in the recording, as scaled by the speed. */
+
+        wait = (speed > 0) ? started + (double) record.time / 1e9 / speed - replay_now() : 0;
+
+        if (wait > 0) {
+
+            pause.tv_sec = (time_t) wait;
+            pause.tv_nsec = (long) ((wait - (double) pause.tv_sec) * 1e9);
+
+            nanosleep(&pause, NULL);
+        }
+
+        calls[call_count].op = record.op;
+        calls[call_count].recorded = (double) record.duration / 1e9;
+
+        if (!replay_call_record(factory, &record, reader->items, &buffers, &(calls[call_count].latency))) {
+
+            if (mismatches < REPLAY_MAX_PRINTED) {
+
+                printf("mismatch call=%llu op=%s side=%llu height=%llu\n", call_count, replay_op_names[record.op], (unsigned long long) record.side,
+                       (unsigned long long) record.height);
+            }
+
+            mismatches++;
+        }
+
+        call_count++;
+    }
+
+    seconds = replay_now() - started;
+
+    latencies = malloc(sizeof(double) * ((call_count == 0) ? 1 : call_count));
+    recorded = malloc(sizeof(double) * ((call_count == 0) ? 1 : call_count));
+
+    if (reader->failed) {
+
+        printf("Error: The trace is invalid after %llu calls\n", reader->calls);
+        status = -1;
+    }
+
+    else {
+
+        if ((latencies == NULL) || (recorded == NULL)) {
+
+            printf("Error: Allocation failed\n");
+            status = -1;
+        }
+
+        else {
+
+            replay_print(calls, call_count, 0, mismatches, seconds, latencies, recorded);
+
+            for (op = BOX_TRACE_INSERT; op < REPLAY_OPS; ++op) {
+
+                replay_print(calls, call_count, (box_trace_op) op, mismatches, seconds, latencies, recorded);
+            }
+
+            if (reader->cut) {
+
+                printf("The trace ends with a cut record, which was ignored\n");
+            }
+
+            status = (mismatches == 0) ? 0 : 1;
+        }
+    }
+
+    box_factory_destroy(factory);
+    box_trace_reader_close(reader);
+    free(buffers.boxes);
+    free(buffers.presents);
+    free(calls);
+    free(latencies);
+    free(recorded);
+
+    return status;
+}
@@ -0,0 +1,922 @@
+/*
+ Van Emde Boas tree source file.
+ Here we implement the layered van Emde Boas tree (based on the book's implementation, with the minimum of a node not stored in its clusters),
+ and its operations as an ordered set of the box index.
+ */
+
+
+#include <stdbool.h>
+
+#include <stdlib.h>
+
+#include "veb_tree.h"
+
+
+#define VEB_TREE_BITS 32			/* Number of bits of the values of the tree. */
+
+#define VEB_LEAF_BITS 8			/* Nodes of at most this number of bits are plain bitmaps. */
+
+#define VEB_ARRAY_BITS 8			/* Nodes with at most 2^VEB_ARRAY_BITS clusters keep them in an array instead of a hash table. */
+
+#define VEB_TABLE_MIN_CAPACITY 8
+
+
+/* Split a value of the node into the index of its cluster (high half) and its value inside the cluster (low half), and back. */
+
+#define VEB_LOW_BITS(node) ((node)->bits / 2)
+#define VEB_HIGH(node, x) ((x) >> VEB_LOW_BITS(node))
+#define VEB_LOW(node, x) ((x) & ((1ULL << VEB_LOW_BITS(node)) - 1))
+#define VEB_INDEX(node, high, low) (((high) << VEB_LOW_BITS(node)) | (low))
+
+#define VEB_IS_LEAF(node) ((node)->bits <= VEB_LEAF_BITS)
+
+
+/* Functions' prototype declarations: */
+
+
+/* Hash table functions. Find returns the slot of the key, or NULL if the key is not in the table. Put returns the slot of the key, adding the key with
+ zeroed count and value if it's not in the table, or NULL on an allocation error. Delete removes the key (backward shift deletion.) */
+
+static veb_slot* veb_table_find(veb_table *table, unsigned long long key);
+
+static veb_slot* veb_table_put(veb_table *table, unsigned long long key);
+
+static void veb_table_delete(veb_table *table, unsigned long long key);
+
+static bool veb_table_grow(veb_table *table);
+
+
+/* Create a node over the values of the given number of bits. Returns NULL on an allocation error. */
+
+static veb_node* veb_node_create(unsigned int bits);
+
+
+/* Free the node with its summary and clusters. */
+
+static void veb_node_destroy(veb_node *node);
+
+
+/* Return the cluster of the given index, NULL if it doesn't exist. */
+
+static veb_node* veb_node_cluster(veb_node *node, unsigned long long high);
+
+
+/* Return the cluster of the given index, creating an empty one if it doesn't exist. Returns NULL on an allocation error. */
+
+static veb_node* veb_node_cluster_create(veb_node *node, unsigned long long high);
+
+
+/* Free the (empty) cluster of the given index. */
+
+static void veb_node_cluster_drop(veb_node *node, unsigned long long high);
+
+
+/* Insert a value that is not in the node. Returns FALSE on an allocation error, in which case the node is left unchanged. */
+
+static bool veb_node_insert(veb_node *node, unsigned long long x);
+
+
+/* Delete a value that is in the node. */
+
+static void veb_node_delete(veb_node *node, unsigned long long x);
+
+
+/* Find the smallest value of the node that is larger than x / the largest value that is smaller than x. Returns FALSE if there's no such value. */
+
+static bool veb_node_successor(veb_node *node, unsigned long long x, unsigned long long *found);
+
+static bool veb_node_predecessor(veb_node *node, unsigned long long x, unsigned long long *found);
+
+
+/* Bitmap operations of the leaves. */
+
+static void veb_leaf_update(veb_node *node);
+
+static bool veb_leaf_successor(veb_node *node, unsigned long long x, unsigned long long *found);
+
+static bool veb_leaf_predecessor(veb_node *node, unsigned long long x, unsigned long long *found);
+
+
+/* Ordered set operations (see ordered_set.h). */
+
+static void* veb_set_create(void);
+
+static void veb_set_destroy(void *set);
+
+static bool veb_set_insert(void *set, unsigned int val, unsigned int count, bool *exists);
+
+static bool veb_set_remove(void *set, unsigned int val, bool *deleted);
+
+static unsigned int veb_set_instances(void *set, unsigned int val);
+
+static void** veb_set_payload(void *set, unsigned int val);
+
+static bool veb_set_lower_bound(void *set, unsigned int val, unsigned int *found);
+
+static bool veb_set_successor(void *set, unsigned int val, unsigned int *found);
+
+static bool veb_set_predecessor(void *set, unsigned int val, unsigned int *found);
+
+static bool veb_set_max(void *set, unsigned int *found);
+
+static unsigned int veb_set_size(void *set);
+
+
+const ordered_set_ops veb_tree_ops = {veb_set_create, veb_set_destroy, veb_set_insert, veb_set_remove, veb_set_instances, veb_set_payload,
+                                      veb_set_lower_bound, veb_set_successor, veb_set_predecessor, veb_set_max, veb_set_size};
+
+
+/* The implementation: */
+
+
+static unsigned int veb_hash(unsigned long long key, unsigned int capacity)
+{
+
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+
+    return (unsigned int) key & (capacity - 1);
+}
+
+
+static veb_slot* veb_table_find(veb_table *table, unsigned long long key)
+{
+
+    unsigned int i = 0;
+
+    if (table->capacity == 0) {
+
+        return NULL;
+    }
+
+    for (i = veb_hash(key, table->capacity); table->slots[i].used; i = (i + 1) & (table->capacity - 1)) {
+
+        if (table->slots[i].key == key) {
+
+            return &(table->slots[i]);
+        }
+    }
+
+    return NULL;
+}
+
+
+static bool veb_table_grow(veb_table *table)
+{
+
+    veb_slot *old_slots = table->slots;
+    unsigned int old_capacity = table->capacity;
+    unsigned int new_capacity = (old_capacity == 0) ? VEB_TABLE_MIN_CAPACITY : old_capacity * 2;
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    table->slots = calloc(sizeof(veb_slot), new_capacity);
+
+    if (table->slots == NULL) {
+
+        table->slots = old_slots;
+        return false;
+    }
+
+    table->capacity = new_capacity;
+
+    /* Rehash the used slots of the old array into the new one. */
+
+    for (i = 0; i < old_capacity; ++i) {
+
+        if (old_slots[i].used) {
+
+            for (j = veb_hash(old_slots[i].key, new_capacity); table->slots[j].used; j = (j + 1) & (new_capacity - 1)) {
+            }
+
+            table->slots[j] = old_slots[i];
+        }
+    }
+
+    free(old_slots);
+
+    return true;
+}
+
+
+static veb_slot* veb_table_put(veb_table *table, unsigned long long key)
+{
+
+    veb_slot *slot = veb_table_find(table, key);
+    unsigned int i = 0;
+
+    if (slot != NULL) {
+
+        return slot;
+    }
+
+    /* Keep the load factor of the table below 3/4. */
+
+    if (((table->size + 1) * 4 > table->capacity * 3) && !veb_table_grow(table)) {
+
+        return NULL;
+    }
+
+    for (i = veb_hash(key, table->capacity); table->slots[i].used; i = (i + 1) & (table->capacity - 1)) {
+    }
+
+    table->slots[i].key = key;
+    table->slots[i].count = 0;
+    table->slots[i].value = NULL;
+    table->slots[i].used = true;
+    table->size++;
+
+    return &(table->slots[i]);
+}
+
+
+static void veb_table_delete(veb_table *table, unsigned long long key)
+{
+
+    veb_slot *slot = veb_table_find(table, key);
+    unsigned int mask = table->capacity - 1;
+    unsigned int hole = 0;
+    unsigned int i = 0;
+    unsigned int home = 0;
+
+    if (slot == NULL) {
+
+        return;
+    }
+
+    hole = (unsigned int) (slot - table->slots);
+    table->slots[hole].used = false;
+    table->size--;
+
+    /* Shift back the following slots of the probe sequence, which would not be found anymore because of the hole. */
+
+    for (i = (hole + 1) & mask; table->slots[i].used; i = (i + 1) & mask) {
+
+        home = veb_hash(table->slots[i].key, table->capacity);
+
+        /* The slot may move into the hole only if its home position isn't cyclically between the hole and the slot. */
+
+        if (((i > hole) && ((home <= hole) || (home > i))) || ((i < hole) && ((home <= hole) && (home > i)))) {
+
+            table->slots[hole] = table->slots[i];
+            table->slots[i].used = false;
+            hole = i;
+        }
+    }
+}
+
+
+static veb_node* veb_node_create(unsigned int bits)
+{
+
+    veb_node *node = calloc(sizeof(veb_node), 1);
+
+    if (node == NULL) {
+
+        return NULL;
+    }
+
+    node->bits = bits;
+    node->empty = true;
+
+    return node;
+}
+
+
+static void veb_node_destroy(veb_node *node)
+{
+
+    unsigned int i = 0;
+
+    if (node == NULL) {
+
+        return;
+    }
+
+    veb_node_destroy(node->summary);
+
+    if (node->clusters != NULL) {
+
+        for (i = 0; i < (1U << (node->bits - VEB_LOW_BITS(node))); ++i) {
+
+            veb_node_destroy(node->clusters[i]);
+        }
+
+        free(node->clusters);
+    }
+
+    for (i = 0; i < node->cluster_table.capacity; ++i) {
+
+        if (node->cluster_table.slots[i].used) {
+
+            veb_node_destroy(node->cluster_table.slots[i].value);
+        }
+    }
+
+    free(node->cluster_table.slots);
+    free(node);
+}
+
+
+static veb_node* veb_node_cluster(veb_node *node, unsigned long long high)
+{
+
+    veb_slot *slot = NULL;
+
+    if (node->bits - VEB_LOW_BITS(node) <= VEB_ARRAY_BITS) {
+
+        return (node->clusters == NULL) ? NULL : node->clusters[high];
+    }
+
+    slot = veb_table_find(&(node->cluster_table), high);
+
+    return (slot == NULL) ? NULL : slot->value;
+}
+
+
+static veb_node* veb_node_cluster_create(veb_node *node, unsigned long long high)
+{
+
+    veb_node *cluster = veb_node_cluster(node, high);
+    veb_slot *slot = NULL;
+    unsigned int high_bits = node->bits - VEB_LOW_BITS(node);
+
+    if (cluster != NULL) {
+
+        return cluster;
+    }
+
+    if ((high_bits <= VEB_ARRAY_BITS) && (node->clusters == NULL)) {
+
+        node->clusters = calloc(sizeof(veb_node *), 1U << high_bits);			/* The array of the clusters is allocated on first use. */
+
+        if (node->clusters == NULL) {
+
+            return NULL;
+        }
+    }
+
+    cluster = veb_node_create(VEB_LOW_BITS(node));
+
+    if (cluster == NULL) {
+
+        return NULL;
+    }
+
+    if (high_bits <= VEB_ARRAY_BITS) {
+
+        node->clusters[high] = cluster;
+
+        return cluster;
+    }
+
+    slot = veb_table_put(&(node->cluster_table), high);
+
+    if (slot == NULL) {
+
+        free(cluster);
+        return NULL;
+    }
+
+    slot->value = cluster;
+
+    return cluster;
+}
+
+
+static void veb_node_cluster_drop(veb_node *node, unsigned long long high)
+{
+
+    veb_node *cluster = veb_node_cluster(node, high);
+
+    if (node->bits - VEB_LOW_BITS(node) <= VEB_ARRAY_BITS) {
+
+        node->clusters[high] = NULL;
+    }
+
+    else {
+
+        veb_table_delete(&(node->cluster_table), high);
+    }
+
+    veb_node_destroy(cluster);
+}
+
+
+static void veb_leaf_update(veb_node *node)
+{
+
+    int i = 0;
+
+    node->empty = true;
+
+    for (i = 0; i < 4; ++i) {
+
+        if (node->words[i] != 0) {
+
+            node->min = (unsigned long long) (i * 64 + __builtin_ctzll(node->words[i]));
+            node->empty = false;
+            break;
+        }
+    }
+
+    for (i = 3; (i >= 0) && !node->empty; --i) {
+
+        if (node->words[i] != 0) {
+
+            node->max = (unsigned long long) (i * 64 + 63 - __builtin_clzll(node->words[i]));
+            break;
+        }
+    }
+}
+
+
+static bool veb_leaf_successor(veb_node *node, unsigned long long x, unsigned long long *found)
+{
+
+    unsigned int i = 0;
+    unsigned long long word = 0;
+
+    if (node->empty || (x >= node->max)) {
+
+        return false;
+    }
+
+    x++;
+    i = (unsigned int) (x >> 6);
+    word = node->words[i] & (~0ULL << (x & 63));			/* Bits of the word of x, starting from x. */
+
+    while (word == 0) {
+
+        word = node->words[++i];
+    }
+
+    *found = i * 64 + __builtin_ctzll(word);
+
+    return true;
+}
+
+
+static bool veb_leaf_predecessor(veb_node *node, unsigned long long x, unsigned long long *found)
+{
+
+    unsigned int i = 0;
+    unsigned long long word = 0;
+
+    if (node->empty || (x <= node->min)) {
+
+        return false;
+    }
+
+    x--;
+    i = (unsigned int) (x >> 6);
+    word = node->words[i] & (~0ULL >> (63 - (x & 63)));			/* Bits of the word of x, up to x. */
+
+    while (word == 0) {
+
+        word = node->words[--i];
+    }
+
+    *found = i * 64 + 63 - __builtin_clzll(word);
+
+    return true;
+}
+
+
+static bool veb_node_insert(veb_node *node, unsigned long long x)
+{
+
+    veb_node *cluster = NULL;
+    unsigned long long original_min = node->min;
+    unsigned long long high = 0;
+    bool new_cluster = false;
+
+    if (VEB_IS_LEAF(node)) {
+
+        node->words[x >> 6] |= 1ULL << (x & 63);
+        veb_leaf_update(node);
+
+        return true;
+    }
+
+    if (node->empty) {			/* The first value of the node is kept only in min. */
+
+        node->min = x;
+        node->max = x;
+        node->empty = false;
+
+        return true;
+    }
+
+    if (x < node->min) {			/* The new value becomes the minimum, and the old minimum goes down to the clusters. */
+
+        node->min = x;
+        x = original_min;
+    }
+
+    high = VEB_HIGH(node, x);
+    new_cluster = (veb_node_cluster(node, high) == NULL);
+    cluster = veb_node_cluster_create(node, high);
+
+    if (cluster == NULL) {
+
+        node->min = original_min;
+        return false;
+    }
+
+    if (cluster->empty) {
+
+        /* The cluster was empty - its index must be added to the summary, and then the insertion to the cluster is O(1). */
+
+        if ((node->summary == NULL) && ((node->summary = veb_node_create(node->bits - VEB_LOW_BITS(node))) == NULL)) {
+
+            veb_node_cluster_drop(node, high);
+            node->min = original_min;
+            return false;
+        }
+
+        if (!veb_node_insert(node->summary, high)) {
+
+            veb_node_cluster_drop(node, high);
+            node->min = original_min;
+            return false;
+        }
+    }
+
+    if (!veb_node_insert(cluster, VEB_LOW(node, x))) {			/* May fail only if the cluster wasn't empty, so the summary is unchanged. */
+
+        if (new_cluster) {
+
+            veb_node_cluster_drop(node, high);
+        }
+
+        node->min = original_min;
+        return false;
+    }
+
+    if (x > node->max) {
+
+        node->max = x;
+    }
+
+    return true;
+}
+
+
+static void veb_node_delete(veb_node *node, unsigned long long x)
+{
+
+    veb_node *cluster = NULL;
+    unsigned long long high = 0;
+    unsigned long long first = 0;
+
+    if (VEB_IS_LEAF(node)) {
+
+        node->words[x >> 6] &= ~(1ULL << (x & 63));
+        veb_leaf_update(node);
+
+        return;
+    }
+
+    if (node->min == node->max) {			/* The only value of the node. */
+
+        node->empty = true;
+
+        return;
+    }
+
+    if (x == node->min) {
+
+        /* The minimum is deleted - the smallest value of the clusters becomes the new minimum, and it is deleted from its cluster instead. */
+
+        first = node->summary->min;
+        x = VEB_INDEX(node, first, veb_node_cluster(node, first)->min);
+        node->min = x;
+    }
+
+    high = VEB_HIGH(node, x);
+    cluster = veb_node_cluster(node, high);
+
+    veb_node_delete(cluster, VEB_LOW(node, x));
+
+    if (cluster->empty) {
+
+        veb_node_delete(node->summary, high);
+        veb_node_cluster_drop(node, high);
+    }
+
+    if (x == node->max) {
+
+        if (node->summary->empty) {
+
+            node->max = node->min;
+        }
+
+        else {
+
+            high = node->summary->max;
+            node->max = VEB_INDEX(node, high, veb_node_cluster(node, high)->max);
+        }
+    }
+}
+
+
+static bool veb_node_successor(veb_node *node, unsigned long long x, unsigned long long *found)
+{
+
+    veb_node *cluster = NULL;
+    unsigned long long high = 0;
+    unsigned long long low = 0;
+
+    if (VEB_IS_LEAF(node)) {
+
+        return veb_leaf_successor(node, x, found);
+    }
+
+    if (node->empty || (x >= node->max)) {
+
+        return false;
+    }
+
+    if (x < node->min) {
+
+        *found = node->min;
+
+        return true;
+    }
+
+    high = VEB_HIGH(node, x);
+    cluster = veb_node_cluster(node, high);
+
+    /* If the successor is in the cluster of x - search only there, otherwise take the minimum of the next non-empty cluster. */
+
+    if ((cluster != NULL) && !cluster->empty && (VEB_LOW(node, x) < cluster->max)) {
+
+        veb_node_successor(cluster, VEB_LOW(node, x), &low);
+
+        *found = VEB_INDEX(node, high, low);
+
+        return true;
+    }
+
+    if ((node->summary == NULL) || !veb_node_successor(node->summary, high, &high)) {
+
+        return false;
+    }
+
+    *found = VEB_INDEX(node, high, veb_node_cluster(node, high)->min);
+
+    return true;
+}
+
+
+static bool veb_node_predecessor(veb_node *node, unsigned long long x, unsigned long long *found)
+{
+
+    veb_node *cluster = NULL;
+    unsigned long long high = 0;
+    unsigned long long low = 0;
+
+    if (VEB_IS_LEAF(node)) {
+
+        return veb_leaf_predecessor(node, x, found);
+    }
+
+    if (node->empty || (x <= node->min)) {
+
+        return false;
+    }
+
+    if (x > node->max) {
+
+        *found = node->max;
+
+        return true;
+    }
+
+    high = VEB_HIGH(node, x);
+    cluster = veb_node_cluster(node, high);
+
+    if ((cluster != NULL) && !cluster->empty && (VEB_LOW(node, x) > cluster->min)) {
+
+        veb_node_predecessor(cluster, VEB_LOW(node, x), &low);
+
+        *found = VEB_INDEX(node, high, low);
+
+        return true;
+    }
+
+    /* The predecessor is the maximum of the previous non-empty cluster, or the minimum of the node (which isn't stored in the clusters.) */
+
+    if ((node->summary == NULL) || !veb_node_predecessor(node->summary, high, &high)) {
+
+        *found = node->min;
+
+        return true;
+    }
+
+    *found = VEB_INDEX(node, high, veb_node_cluster(node, high)->max);
+
+    return true;
+}
+
+
+veb_tree* veb_tree_create(void)
+{
+
+    veb_tree *tree = calloc(sizeof(veb_tree), 1);
+
+    if (tree == NULL) {
+
+        return NULL;
+    }
+
+    tree->root = veb_node_create(VEB_TREE_BITS);
+
+    if (tree->root == NULL) {
+
+        free(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+
+void veb_tree_destroy(veb_tree *tree)
+{
+
+    veb_node_destroy(tree->root);
+    free(tree->values.slots);
+    free(tree);
+}
+
+
+static void* veb_set_create(void)
+{
+
+    return veb_tree_create();
+}
+
+
+static void veb_set_destroy(void *set)
+{
+
+    veb_tree_destroy(set);
+}
+
+
+static bool veb_set_insert(void *set, unsigned int val, unsigned int count, bool *exists)
+{
+
+    veb_tree *tree = set;
+    veb_slot *slot = veb_table_find(&(tree->values), val);
+
+    *exists = (slot != NULL);
+
+    if (slot != NULL) {			/* The value exists in the tree - we simply increase its count. */
+
+        slot->count += count;
+
+        return true;
+    }
+
+    slot = veb_table_put(&(tree->values), val);
+
+    if (slot == NULL) {
+
+        return false;
+    }
+
+    if (!veb_node_insert(tree->root, val)) {
+
+        veb_table_delete(&(tree->values), val);
+
+        return false;
+    }
+
+    slot->count = count;
+
+    return true;
+}
+
+
+static bool veb_set_remove(void *set, unsigned int val, bool *deleted)
+{
+
+    veb_tree *tree = set;
+    veb_slot *slot = veb_table_find(&(tree->values), val);
+
+    *deleted = false;
+
+    if (slot == NULL) {
+
+        return false;
+    }
+
+    if (--slot->count == 0) {			/* The last instance of the value was removed. */
+
+        veb_table_delete(&(tree->values), val);
+        veb_node_delete(tree->root, val);
+
+        *deleted = true;
+    }
+
+    return true;
+}
+
+
+static unsigned int veb_set_instances(void *set, unsigned int val)
+{
+
+    veb_tree *tree = set;
+    veb_slot *slot = veb_table_find(&(tree->values), val);
+
+    return (slot == NULL) ? 0 : slot->count;
+}
+
+
+static void** veb_set_payload(void *set, unsigned int val)
+{
+
+    veb_tree *tree = set;
+    veb_slot *slot = veb_table_find(&(tree->values), val);
+
+    return (slot == NULL) ? NULL : &(slot->value);
+}
+
+
+static bool veb_set_lower_bound(void *set, unsigned int val, unsigned int *found)
+{
+
+    veb_tree *tree = set;
+
+    if (veb_table_find(&(tree->values), val) != NULL) {
+
+        *found = val;
+
+        return true;
+    }
+
+    return veb_set_successor(set, val, found);
+}
+
+
+static bool veb_set_successor(void *set, unsigned int val, unsigned int *found)
+{
+
+    veb_tree *tree = set;
+    unsigned long long x = 0;
+
+    if (!veb_node_successor(tree->root, val, &x)) {
+
+        return false;
+    }
+
+    *found = (unsigned int) x;
+
+    return true;
+}
+
+
+static bool veb_set_predecessor(void *set, unsigned int val, unsigned int *found)
+{
+
+    veb_tree *tree = set;
+    unsigned long long x = 0;
+
+    if (!veb_node_predecessor(tree->root, val, &x)) {
+
+        return false;
+    }
+
+    *found = (unsigned int) x;
+
+    return true;
+}
+
+
+static bool veb_set_max(void *set, unsigned int *found)
+{
+
+    veb_tree *tree = set;
+
+    if (tree->root->empty) {
+
+        return false;
+    }
+
+    *found = (unsigned int) tree->root->max;
+
+    return true;
+}
+
+
+static unsigned int veb_set_size(void *set)
+{
+
+    veb_tree *tree = set;
+
+    return tree->values.size;
+}
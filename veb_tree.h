@@ -0,0 +1,73 @@
+/* Van Emde Boas tree header file.
+ Contains the structure and functions' prototype declarations of a layered van Emde Boas tree over 32-bit values.
+ A value is split into its high and low halves: the high half selects a cluster (a smaller tree over the low halves), and a summary tree holds the
+ high halves of the non-empty clusters. The recursion stops at 256-value bitmaps, so successor and predecessor take O(log log U) steps.
+ Clusters of the 32-bit level are kept in a hash table, and the counts and payloads of the values - in another one, so the memory is proportional
+ to the number of values in the tree, and not to the size of the universe. */
+
+
+#include <stdbool.h>
+
+#include "ordered_set.h"
+
+#ifndef VEB_TREE_H_
+#define VEB_TREE_H_
+
+
+typedef struct veb_node_s veb_node;
+
+
+typedef struct veb_slot_s {			/* A slot of the hash tables of the tree. */
+
+    unsigned long long key;
+    unsigned int count;			/* Number of instances of the key (only in the table of values.) */
+    void *value;			/* The payload of the key, or the cluster of the key (in the table of clusters.) */
+    bool used;
+} veb_slot;
+
+
+typedef struct veb_table_s {			/* Hash table with linear probing, keyed by the values or by the high halves of the values. */
+
+    veb_slot *slots;
+    unsigned int capacity;			/* Number of slots - a power of 2, or 0 before the first insertion. */
+    unsigned int size;			/* Number of used slots. */
+} veb_table;
+
+
+struct veb_node_s {			/* Van Emde Boas tree node structure - the tree over the values of the given number of bits. */
+
+    unsigned int bits;			/* The values of the node are in [0, 2^bits). */
+    bool empty;
+    unsigned long long min;			/* Not stored in the clusters (except of the leaves, which are plain bitmaps.) */
+    unsigned long long max;
+    unsigned long long words[4];			/* The bitmap of a leaf (bits <= 8). */
+    veb_node *summary;			/* Tree over the high halves of the values, whose clusters aren't empty. */
+    veb_node **clusters;			/* Array of the clusters, if there're at most 256 of them. */
+    veb_table cluster_table;			/* Hash table of the clusters otherwise. */
+};
+
+
+typedef struct veb_tree_s {			/* Van Emde Boas tree structure. */
+
+    veb_node *root;
+    veb_table values;			/* Counts and payloads of the unique values of the tree. */
+} veb_tree;
+
+
+/* Operations of the van Emde Boas tree as an ordered set (see ordered_set.h.) */
+
+extern const ordered_set_ops veb_tree_ops;
+
+
+/* Create a van Emde Boas tree instance - allocates and initializes an empty tree over 32-bit values.
+ Returns NULL on an allocation error, otherwise returns a pointer to veb_tree. */
+
+veb_tree* veb_tree_create(void);
+
+
+/* Free the tree with all of its nodes. */
+
+void veb_tree_destroy(veb_tree *tree);
+
+
+#endif /* VEB_TREE_H_ */